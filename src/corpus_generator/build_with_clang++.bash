@@ -0,0 +1 @@
+clang++ --std=c++11 -O2 -o corpus_generator.clang++ corpus_generator.cpp
@@ -0,0 +1 @@
+g++ --std=c++11 -O2 -o corpus_generator.g++ corpus_generator.cpp
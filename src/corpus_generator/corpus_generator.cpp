@@ -0,0 +1,507 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+// Generates JSON documents of a given size and shape for benchmarks
+//  The output only depends on the shape, the size and the seed so runs on
+//  different machines use the same input. Output is written in blocks so
+//  documents of several GB don't need to fit in memory.
+//
+//  Usage: corpus_generator <shape> <size> [output] [seed]
+//         corpus_generator all <size> <directory> [seed]
+//
+//    size    bytes, with an optional K, M or G suffix (1024 based), e.g. 64M
+//    output  a file name, stdout if omitted or -
+//
+//  Shapes (the document is about <size> bytes):
+//    records       an array of mixed objects, like typical API responses
+//    wide_object   one object with many members
+//    long_array    one array of small values
+//    deep_nesting  arrays and objects nested 64 levels deep, repeated
+//    strings       an array of long strings without escapes
+//    escapes       an array of strings dense in escapes, like charrefs.json
+//    numbers       an array of integers, decimals and exponents
+//    ndjson        newline delimited records, one document per line
+//
+//  Adversarial shapes (<size> is ignored):
+//    keys_1m       an object with 1,000,000 members
+//    nesting_100k  arrays nested 100,000 levels deep, json_parser rejects it
+//                  beyond CPP_JSON__MAX_DEPTH levels instead of exhausting the stack
+//    unicode_run   one string of 1,000,000 \u escapes, including surrogate pairs
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+  // Deterministic pseudo random numbers
+  struct lcg
+  {
+    explicit lcg (std::uint32_t seed)
+      : state (seed)
+    {
+    }
+
+    std::uint32_t next () noexcept
+    {
+      state = state * 1664525U + 1013904223U;
+      return state >> 8;
+    }
+
+    std::uint32_t next (std::uint32_t n) noexcept
+    {
+      return next () % n;
+    }
+
+  private:
+    std::uint32_t state;
+  };
+
+  // Buffers output and writes it in blocks
+  struct output
+  {
+    constexpr static std::size_t block_size = 1 << 20;
+
+    explicit output (std::FILE * file)
+      : file    (file)
+      , written (0)
+    {
+      buffer.reserve (block_size + 4096);
+    }
+
+    ~output ()
+    {
+      flush ();
+    }
+
+    output (output const &)             = delete;
+    output & operator= (output const &) = delete;
+
+    output & operator<< (char const * s)
+    {
+      buffer += s;
+      return check ();
+    }
+
+    output & operator<< (std::string const & s)
+    {
+      buffer += s;
+      return check ();
+    }
+
+    output & operator<< (char ch)
+    {
+      buffer += ch;
+      return check ();
+    }
+
+    output & operator<< (std::uint32_t v)
+    {
+      char digits [16];
+      std::snprintf (digits, sizeof (digits), "%u", v);
+      return *this << digits;
+    }
+
+    // Bytes written including the buffered bytes
+    std::size_t size () const noexcept
+    {
+      return written + buffer.size ();
+    }
+
+    void flush ()
+    {
+      std::fwrite (buffer.data (), 1, buffer.size (), file);
+      written += buffer.size ();
+      buffer.clear ();
+    }
+
+  private:
+    std::FILE *   file    ;
+    std::string   buffer  ;
+    std::size_t   written ;
+
+    output & check ()
+    {
+      if (buffer.size () >= block_size)
+      {
+        flush ();
+      }
+      return *this;
+    }
+  };
+
+  char const * const words [] =
+  {
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+    "india", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa",
+  };
+
+  constexpr std::uint32_t word_count = sizeof (words) / sizeof (words[0]);
+
+  void word (output & o, lcg & r)
+  {
+    o << words[r.next (word_count)];
+  }
+
+  void sentence (output & o, lcg & r, std::uint32_t count)
+  {
+    for (auto iter = 0U; iter < count; ++iter)
+    {
+      if (iter > 0)
+      {
+        o << ' ';
+      }
+      word (o, r);
+    }
+  }
+
+  void number (output & o, lcg & r)
+  {
+    // The order of evaluation of operands is unspecified, so draw the numbers
+    //  before writing them to keep the output the same on all compilers
+    switch (r.next (3))
+    {
+    case 0:
+      o << r.next (1000000);
+      break;
+    case 1:
+      {
+        auto i = r.next (100000);
+        auto f = r.next (1000);
+        o << i << '.' << f;
+      }
+      break;
+    default:
+      {
+        auto negative = r.next (2) != 0;
+        auto i        = r.next (10);
+        auto f        = r.next (100000);
+        auto negexp   = r.next (2) != 0;
+        auto e        = r.next (300);
+        o << (negative ? "-" : "") << i << '.' << f << 'e' << (negexp ? "-" : "") << e;
+      }
+      break;
+    }
+  }
+
+  void record (output & o, lcg & r, std::uint32_t id)
+  {
+    o << R"({"id":)" << id << R"(,"name":")";
+    sentence (o, r, 2);
+    o << R"(","active":)" << (r.next (2) ? "true" : "false") << R"(,"score":)";
+    number (o, r);
+    o << R"(,"tags":[)";
+    auto tags = r.next (4);
+    for (auto iter = 0U; iter < tags; ++iter)
+    {
+      o << (iter > 0 ? ",\"" : "\"");
+      word (o, r);
+      o << '"';
+    }
+    o << R"(],"parent":)";
+    if (r.next (4) == 0)
+    {
+      o << "null";
+    }
+    else
+    {
+      o << r.next (id + 1);
+    }
+    o << R"(,"description":")";
+    sentence (o, r, 4 + r.next (12));
+    o << "\"}";
+  }
+
+  // Writes "[" + values + "]" until about 'size' bytes
+  template<typename TValue>
+  void array_of (output & o, std::size_t size, TValue value)
+  {
+    o << '[';
+    for (std::uint32_t iter = 0; o.size () + 1 < size; ++iter)
+    {
+      if (iter > 0)
+      {
+        o << ',';
+      }
+      value (iter);
+    }
+    o << ']';
+  }
+
+  void nested (output & o, lcg & r, std::uint32_t depth)
+  {
+    if (depth == 0)
+    {
+      number (o, r);
+    }
+    else if (depth % 2 == 0)
+    {
+      o << R"({"level":)" << depth << R"(,"next":)";
+      nested (o, r, depth - 1);
+      o << '}';
+    }
+    else
+    {
+      o << '[';
+      nested (o, r, depth - 1);
+      o << ",\"";
+      word (o, r);
+      o << "\"]";
+    }
+  }
+
+  // Escapes found in HTML character references and typical text
+  void escaped_string (output & o, lcg & r)
+  {
+    char const * const escapes [] =
+    {
+      "\\n", "\\t", "\\\"", "\\\\", "\\/", "\\u00e5", "\\u20ac", "\\u2014", "\\ud83d\\ude00", "&amp;",
+    };
+
+    o << '"';
+    auto count = 4 + r.next (16);
+    for (auto iter = 0U; iter < count; ++iter)
+    {
+      if (r.next (2))
+      {
+        o << escapes[r.next (sizeof (escapes) / sizeof (escapes[0]))];
+      }
+      else
+      {
+        word (o, r);
+      }
+    }
+    o << '"';
+  }
+
+  void hex4 (output & o, std::uint32_t v)
+  {
+    char digits [8];
+    std::snprintf (digits, sizeof (digits), "\\u%04x", v);
+    o << digits;
+  }
+
+  bool generate (std::string const & shape, std::size_t size, output & o, std::uint32_t seed)
+  {
+    lcg r (seed);
+
+    if (shape == "records")
+    {
+      array_of (o, size, [&] (std::uint32_t iter) { o << "\n  "; record (o, r, iter); });
+    }
+    else if (shape == "wide_object")
+    {
+      o << '{';
+      for (std::uint32_t iter = 0; o.size () + 1 < size; ++iter)
+      {
+        o << (iter > 0 ? ",\"" : "\"");
+        word (o, r);
+        o << '_' << iter << "\":";
+        number (o, r);
+      }
+      o << '}';
+    }
+    else if (shape == "long_array")
+    {
+      array_of (o, size, [&] (std::uint32_t /*iter*/)
+        {
+          switch (r.next (4))
+          {
+          case 0:   o << r.next (100); break;
+          case 1:   o << (r.next (2) ? "true" : "false"); break;
+          case 2:   o << "null"; break;
+          default:  o << '"'; word (o, r); o << '"'; break;
+          }
+        });
+    }
+    else if (shape == "deep_nesting")
+    {
+      array_of (o, size, [&] (std::uint32_t /*iter*/) { nested (o, r, 64); });
+    }
+    else if (shape == "strings")
+    {
+      array_of (o, size, [&] (std::uint32_t /*iter*/) { o << '"'; sentence (o, r, 8 + r.next (64)); o << '"'; });
+    }
+    else if (shape == "escapes")
+    {
+      array_of (o, size, [&] (std::uint32_t /*iter*/) { escaped_string (o, r); });
+    }
+    else if (shape == "numbers")
+    {
+      array_of (o, size, [&] (std::uint32_t /*iter*/) { number (o, r); });
+    }
+    else if (shape == "ndjson")
+    {
+      for (std::uint32_t iter = 0; o.size () < size; ++iter)
+      {
+        record (o, r, iter);
+        o << '\n';
+      }
+    }
+    else if (shape == "keys_1m")
+    {
+      o << '{';
+      for (std::uint32_t iter = 0; iter < 1000000; ++iter)
+      {
+        o << (iter > 0 ? ",\"k" : "\"k") << iter << "\":" << iter;
+      }
+      o << '}';
+    }
+    else if (shape == "nesting_100k")
+    {
+      for (auto iter = 0; iter < 100000; ++iter)
+      {
+        o << '[';
+      }
+      for (auto iter = 0; iter < 100000; ++iter)
+      {
+        o << ']';
+      }
+    }
+    else if (shape == "unicode_run")
+    {
+      o << "[\"";
+      for (auto iter = 0; iter < 1000000; ++iter)
+      {
+        auto kind = r.next (4);
+        if (kind == 0)
+        {
+          // Surrogate pair
+          auto cp = 0x10000 + r.next (0x100000);
+          hex4 (o, 0xD800 + ((cp - 0x10000) >> 10));
+          hex4 (o, 0xDC00 + ((cp - 0x10000) & 0x3FF));
+          ++iter;
+        }
+        else
+        {
+          // Skip the surrogate range
+          auto cp = 1 + r.next (0xD7FF);
+          hex4 (o, cp);
+        }
+      }
+      o << "\"]";
+    }
+    else
+    {
+      return false;
+    }
+
+    if (shape != "ndjson")
+    {
+      o << '\n';
+    }
+
+    return true;
+  }
+
+  char const * const shapes [] =
+  {
+    "records", "wide_object", "long_array", "deep_nesting", "strings", "escapes", "numbers", "ndjson",
+    "keys_1m", "nesting_100k", "unicode_run",
+  };
+
+  std::size_t parse_size (char const * s)
+  {
+    char * end = nullptr;
+    auto size = static_cast<std::size_t> (std::strtoull (s, &end, 10));
+    switch (end ? *end : '\0')
+    {
+    case 'k': case 'K': return size << 10;
+    case 'm': case 'M': return size << 20;
+    case 'g': case 'G': return size << 30;
+    default:            return size;
+    }
+  }
+
+  bool generate_file (std::string const & shape, std::size_t size, std::string const & file_name, std::uint32_t seed)
+  {
+    auto file = file_name.empty () || file_name == "-"
+      ? stdout
+      : std::fopen (file_name.c_str (), "wb")
+      ;
+
+    if (!file)
+    {
+      std::cerr << "FAILURE: Couldn't open " << file_name << std::endl;
+      return false;
+    }
+
+    bool result;
+    {
+      output o (file);
+      result = generate (shape, size, o, seed);
+    }
+
+    if (file != stdout)
+    {
+      std::fclose (file);
+    }
+
+    if (!result)
+    {
+      std::cerr << "FAILURE: Unknown shape: " << shape << std::endl;
+    }
+
+    return result;
+  }
+}
+
+int main (int argc, char const * * argvs)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: corpus_generator <shape> <size> [output] [seed]" << std::endl;
+    std::cerr << "       corpus_generator all <size> <directory> [seed]" << std::endl;
+    std::cerr << "Shapes:";
+    for (auto && shape : shapes)
+    {
+      std::cerr << " " << shape;
+    }
+    std::cerr << std::endl;
+    return 999;
+  }
+
+  std::string   shape   = argvs[1];
+  auto          size    = parse_size (argvs[2]);
+  std::string   output  = argc > 3 ? argvs[3] : "";
+  std::uint32_t seed    = argc > 4 ? static_cast<std::uint32_t> (std::strtoul (argvs[4], nullptr, 10)) : 19740531U;
+
+  if (shape != "all")
+  {
+    return generate_file (shape, size, output, seed) ? 0 : 998;
+  }
+
+  if (output.empty ())
+  {
+    std::cerr << "FAILURE: 'all' requires an output directory" << std::endl;
+    return 997;
+  }
+
+  for (auto && s : shapes)
+  {
+    auto file_name = output + "/" + s + (std::strcmp (s, "ndjson") == 0 ? ".ndjson" : ".json");
+    std::cerr << "Generating " << file_name << "..." << std::endl;
+    if (!generate_file (s, size, file_name, seed))
+    {
+      return 998;
+    }
+  }
+
+  return 0;
+}
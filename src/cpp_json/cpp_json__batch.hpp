@@ -0,0 +1,287 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__BATCH_H
+#define CPP_JSON__BATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpp_json__document.hpp"
+
+namespace cpp_json { namespace document
+{
+  // The result of parsing one input of a batch
+  struct json_batch_result
+  {
+    json_document::ptr  document  ;     // Empty if parse failed
+    std::size_t         pos       = 0;  // The first non-consumed character or the position of the error
+    doc_string_type     error     ;     // Describes the error if parse failed
+  };
+
+  using json_batch_results = std::vector<json_batch_result>;
+
+  // json_batch_parser parses batches of independent JSON documents on a pool of threads
+  //  The threads are created once and reused for all batches. Each thread keeps its
+  //  own json_parse_session so after the first few inputs parsing only allocates
+  //  the document itself.
+  //  Threads take inputs in small chunks from a shared cursor, a thread that finishes
+  //  early keeps taking chunks so the load is balanced also when input sizes vary.
+  //  The thread calling parse_batch takes part in the work.
+  //  An input that throws while parsing (like std::bad_alloc) fails with the exception
+  //  message as error, the other inputs of the batch are still parsed.
+  //
+  //  parse_batch must not be called concurrently on the same json_batch_parser.
+  struct json_batch_parser
+  {
+    // 'concurrency' is the total number of threads parsing, including the calling thread
+    //  0 means std::thread::hardware_concurrency ()
+    explicit json_batch_parser (std::size_t concurrency = 0)
+      : inputs      (nullptr)
+      , results     (nullptr)
+      , chunk_size  (1)
+      , generation  (0)
+      , running     (0)
+      , stop        (false)
+      , next        (0)
+    {
+      if (concurrency == 0)
+      {
+        concurrency = std::thread::hardware_concurrency ();
+      }
+
+      if (concurrency == 0)
+      {
+        concurrency = 1;
+      }
+
+      for (auto iter = 0U; iter < concurrency; ++iter)
+      {
+        workers.emplace_back (new worker ());
+      }
+
+      for (auto iter = 1U; iter < concurrency; ++iter)
+      {
+        auto w = workers[iter].get ();
+        threads.emplace_back ([this, w] () { run (*w); });
+      }
+    }
+
+    ~json_batch_parser ()
+    {
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        stop = true;
+      }
+      batch_started.notify_all ();
+
+      for (auto && t : threads)
+      {
+        t.join ();
+      }
+    }
+
+    CPP_JSON__NO_COPY_MOVE (json_batch_parser);
+
+    // The number of threads parsing
+    std::size_t concurrency () const noexcept
+    {
+      return workers.size ();
+    }
+
+    // Parses all inputs, results[i] is the result of inputs[i]
+    //  Returns the number of inputs that failed to parse
+    std::size_t parse_batch (doc_strings_type const & batch, json_batch_results & batch_results)
+    {
+      batch_results.clear ();
+      batch_results.resize (batch.size ());
+
+      if (batch.empty ())
+      {
+        return 0;
+      }
+
+      // Small chunks balance the load, large chunks reduce contention on the cursor
+      auto chunks_per_thread = 8U;
+      chunk_size = batch.size () / (workers.size () * chunks_per_thread);
+      if (chunk_size == 0)
+      {
+        chunk_size = 1;
+      }
+
+      inputs  = &batch;
+      results = &batch_results;
+      next.store (0);
+
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        running = threads.size ();
+        ++generation;
+      }
+      batch_started.notify_all ();
+
+      // work doesn't throw so the pool is always done with the batch before returning
+      work (*workers.front ());
+
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        batch_done.wait (lock, [this] () { return running == 0; });
+      }
+
+      inputs  = nullptr;
+      results = nullptr;
+
+      std::size_t failures = 0;
+      for (auto && r : batch_results)
+      {
+        if (!r.document)
+        {
+          ++failures;
+        }
+      }
+
+      return failures;
+    }
+
+    // Parses all inputs, results[i] is the result of inputs[i]
+    json_batch_results parse_batch (doc_strings_type const & batch)
+    {
+      json_batch_results batch_results;
+      parse_batch (batch, batch_results);
+      return batch_results;
+    }
+
+  private:
+    // Per thread state, reused for all inputs parsed by the thread
+    struct worker
+    {
+      json_parse_session session;
+
+      // An exception (like std::bad_alloc) fails the input it was thrown for, letting
+      //  it escape would terminate a pool thread or leave the pool writing results
+      //  while the caller unwinds
+      void parse (doc_string_type const & json, json_batch_result & result) noexcept
+      {
+        try
+        {
+          session.parse (json, result.pos, result.document, result.error);
+        }
+        catch (std::exception const & e)
+        {
+          fail (result, e.what ());
+        }
+        catch (...)
+        {
+          fail (result, "Unknown exception");
+        }
+      }
+
+      static void fail (json_batch_result & result, char const * what) noexcept
+      {
+        result.document.reset ();
+        result.pos = 0;
+        try
+        {
+          result.error.assign (what, what + std::strlen (what));
+        }
+        catch (...)
+        {
+          result.error.clear ();
+        }
+      }
+    };
+
+    using workers_type = std::vector<std::unique_ptr<worker>>;
+
+    workers_type              workers       ;
+    std::vector<std::thread>  threads       ;
+
+    // The current batch, only changed when no thread is working
+    doc_strings_type const *  inputs        ;
+    json_batch_results *      results       ;
+    std::size_t               chunk_size    ;
+
+    std::mutex                mutex         ;
+    std::condition_variable   batch_started ;
+    std::condition_variable   batch_done    ;
+    std::size_t               generation    ;
+    std::size_t               running       ;
+    bool                      stop          ;
+
+    std::atomic<std::size_t>  next          ;
+
+    void work (worker & w) noexcept
+    {
+      auto && batch         = *inputs ;
+      auto && batch_results = *results;
+      auto    sz            = batch.size ();
+
+      for (;;)
+      {
+        auto first = next.fetch_add (chunk_size);
+        if (first >= sz)
+        {
+          return;
+        }
+
+        auto last = first + chunk_size < sz ? first + chunk_size : sz;
+        for (auto iter = first; iter < last; ++iter)
+        {
+          w.parse (batch[iter], batch_results[iter]);
+        }
+      }
+    }
+
+    void run (worker & w)
+    {
+      std::size_t seen = 0;
+      for (;;)
+      {
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          batch_started.wait (lock, [this, seen] () { return stop || generation != seen; });
+          if (stop)
+          {
+            return;
+          }
+          seen = generation;
+        }
+
+        work (w);
+
+        bool done;
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          done = --running == 0;
+        }
+
+        if (done)
+        {
+          batch_done.notify_one ();
+        }
+      }
+    }
+  };
+
+} }
+
+#endif  // CPP_JSON__BATCH_H
@@ -0,0 +1,293 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__CACHE_H
+#define CPP_JSON__CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cpp_json__document.hpp"
+
+namespace cpp_json { namespace document
+{
+  namespace details
+  {
+    // 64-bit hash of a buffer (MurmurHash64A), reads 8 bytes per step
+    inline std::uint64_t content_hash (void const * data, std::size_t size, std::uint64_t seed) noexcept
+    {
+      auto const m = 0xC6A4A7935BD1E995ULL;
+      auto const r = 47;
+
+      auto p = static_cast<unsigned char const *> (data);
+      auto h = seed ^ (size * m);
+
+      for (auto e = p + (size & ~std::size_t (7)); p != e; p += 8)
+      {
+        std::uint64_t k;
+        std::memcpy (&k, p, sizeof k);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+      }
+
+      switch (size & 7)
+      {
+      case 7: h ^= std::uint64_t (p[6]) << 48; // fall through
+      case 6: h ^= std::uint64_t (p[5]) << 40; // fall through
+      case 5: h ^= std::uint64_t (p[4]) << 32; // fall through
+      case 4: h ^= std::uint64_t (p[3]) << 24; // fall through
+      case 3: h ^= std::uint64_t (p[2]) << 16; // fall through
+      case 2: h ^= std::uint64_t (p[1]) << 8;  // fall through
+      case 1: h ^= std::uint64_t (p[0]);
+        h *= m;
+        break;
+      default:
+        break;
+      }
+
+      h ^= h >> r;
+      h *= m;
+      h ^= h >> r;
+
+      return h;
+    }
+  }
+
+  // Counters of a json_document_cache, see json_document_cache::stats
+  struct json_cache_stats
+  {
+    std::size_t hits      = 0;  // Lookups that returned a cached document
+    std::size_t misses    = 0;  // Lookups that parsed the input
+    std::size_t evictions = 0;  // Documents evicted to stay within the budget
+    std::size_t documents = 0;  // Documents in the cache
+    std::size_t bytes     = 0;  // The footprint of the cached documents
+  };
+
+  // json_document_cache returns the same document for inputs with the same content
+  //  instead of parsing them again, for inputs that are received many times
+  //  (configurations, feature flags, repeated payloads)
+  //
+  //    json_document_cache cache (64 << 20);
+  //    if (cache.parse (body, pos, doc)) { ... }
+  //
+  //  Documents are shared between all callers parsing the same content, this is safe
+  //  as documents are immutable (set_* and erase create new documents).
+  //
+  //  Inputs are hashed with a 64-bit hash, the cache keeps a copy of each input so
+  //  that a hit is only returned for the same content (compared with memcmp).
+  //
+  //  The cache is divided into shards selected by the hash, each shard has its own
+  //  lock, LRU list and an equal part of the budget so lookups of different
+  //  inputs rarely contend. Inputs are parsed outside the lock.
+  //  The footprint of an entry is the memory usage of its document (see
+  //  json_document::memory_usage) plus the copy of the input. Documents are
+  //  parsed eagerly (not deferred, see json_lazy_options) so the footprint
+  //  doesn't grow while they are cached. The least recently used documents of a
+  //  shard are evicted when it exceeds its budget, documents larger than the
+  //  budget of a shard are returned but not cached.
+  //
+  //  Failed parses aren't cached. Evicted documents live on while referenced.
+  //  The cache is thread-safe. Documents are allocated with json_new_delete_resource
+  //  as they are parsed concurrently and evicted in any order, which a
+  //  json_monotonic_resource doesn't support.
+  struct json_document_cache
+  {
+    // 'max_bytes' is the budget for the footprint of the cached documents
+    //  'shards' is the number of independently locked parts (at least 1)
+    explicit json_document_cache (std::size_t max_bytes, std::size_t shards = 16)
+      : shard_budget (max_bytes / (shards > 0 ? shards : 1))
+    {
+      shards = shards > 0 ? shards : 1;
+      for (auto iter = 0U; iter < shards; ++iter)
+      {
+        parts.emplace_back (new shard ());
+      }
+    }
+
+    CPP_JSON__NO_COPY_MOVE (json_document_cache);
+
+    // Gets the document of a JSON string from the cache or parses it into 'result'
+    //  'pos' is as for json_parser::parse
+    bool parse (doc_string_type const & json, std::size_t & pos, json_document::ptr & result)
+    {
+      return parse (json.data (), json.data () + json.size (), pos, result);
+    }
+
+    // Gets the document of the JSON in [begin, end) from the cache or parses it into 'result'
+    //  TChar is char (UTF-8) or doc_char_type, inputs with the same characters but
+    //  different TChar are different entries
+    //  'pos' is as for json_parser::parse
+    template<typename TChar>
+    bool parse (TChar const * begin, TChar const * end, std::size_t & pos, json_document::ptr & result)
+    {
+      auto data = reinterpret_cast<char const *> (begin);
+      auto size = static_cast<std::size_t> (end - begin) * sizeof (TChar);
+      auto hash = details::content_hash (data, size, sizeof (TChar));
+      auto && s = *parts[(hash >> 32) % parts.size ()];
+
+      {
+        std::lock_guard<std::mutex> lock (s.mutex);
+        auto found = s.find (hash, data, size, sizeof (TChar));
+        if (found != s.lru.end ())
+        {
+          ++s.stats.hits;
+          s.lru.splice (s.lru.begin (), s.lru, found);
+          pos     = found->pos;
+          result  = found->document;
+          return true;
+        }
+        ++s.stats.misses;
+      }
+
+      if (!json_parser::parse (begin, end, pos, result))
+      {
+        return false;
+      }
+
+      auto bytes = sizeof (entry) + size + result->memory_usage ().total ();
+      if (bytes > shard_budget)
+      {
+        return true;
+      }
+
+      std::lock_guard<std::mutex> lock (s.mutex);
+
+      // Another thread may have parsed the same input meanwhile, all callers get the same document
+      auto found = s.find (hash, data, size, sizeof (TChar));
+      if (found != s.lru.end ())
+      {
+        s.lru.splice (s.lru.begin (), s.lru, found);
+        result = found->document;
+        return true;
+      }
+
+      s.lru.push_front (entry { hash, std::string (data, size), sizeof (TChar), pos, bytes, result });
+      s.index.emplace (hash, s.lru.begin ());
+      s.stats.bytes += bytes;
+      ++s.stats.documents;
+
+      while (s.stats.bytes > shard_budget)
+      {
+        s.erase (std::prev (s.lru.end ()));
+        ++s.stats.evictions;
+      }
+
+      return true;
+    }
+
+    // Removes all documents, the counters are kept
+    void clear ()
+    {
+      for (auto && s : parts)
+      {
+        std::lock_guard<std::mutex> lock (s->mutex);
+        while (!s->lru.empty ())
+        {
+          s->erase (s->lru.begin ());
+        }
+      }
+    }
+
+    // Sums the counters of all shards
+    json_cache_stats stats () const
+    {
+      json_cache_stats result;
+      for (auto && s : parts)
+      {
+        std::lock_guard<std::mutex> lock (s->mutex);
+        result.hits       += s->stats.hits      ;
+        result.misses     += s->stats.misses    ;
+        result.evictions  += s->stats.evictions ;
+        result.documents  += s->stats.documents ;
+        result.bytes      += s->stats.bytes     ;
+      }
+      return result;
+    }
+
+  private:
+    struct entry
+    {
+      std::uint64_t       hash      ;
+      std::string         input     ; // The input bytes
+      std::size_t         char_size ;
+      std::size_t         pos       ;
+      std::size_t         bytes     ; // The footprint of the entry
+      json_document::ptr  document  ;
+    };
+
+    using entries = std::list<entry>;
+
+    struct shard
+    {
+      std::mutex                                                      mutex ;
+      entries                                                         lru   ; // Most recently used first
+      std::unordered_multimap<std::uint64_t, entries::iterator>       index ;
+      json_cache_stats                                                stats ;
+
+      entries::iterator find (std::uint64_t hash, char const * data, std::size_t size, std::size_t char_size)
+      {
+        auto range = index.equal_range (hash);
+        for (auto iter = range.first; iter != range.second; ++iter)
+        {
+          auto && e = *iter->second;
+          if (
+                e.char_size == char_size
+            &&  e.input.size () == size
+            &&  std::memcmp (e.input.data (), data, size) == 0
+            )
+          {
+            return iter->second;
+          }
+        }
+        return lru.end ();
+      }
+
+      void erase (entries::iterator e)
+      {
+        auto range = index.equal_range (e->hash);
+        for (auto iter = range.first; iter != range.second; ++iter)
+        {
+          if (iter->second == e)
+          {
+            index.erase (iter);
+            break;
+          }
+        }
+        stats.bytes -= e->bytes;
+        --stats.documents;
+        lru.erase (e);
+      }
+    };
+
+    std::size_t                         shard_budget  ;
+    std::vector<std::unique_ptr<shard>> parts         ;
+  };
+
+} }
+
+#endif  // CPP_JSON__CACHE_H
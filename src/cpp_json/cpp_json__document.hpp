@@ -19,17 +19,23 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cwchar>
 #include <cstdio>
-#include <deque>
+#include <new>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <tuple>
 
+#include "cpp_json__memory.hpp"
 #include "cpp_json__parser.hpp"
 
 #define CPP_JSON__NO_COPY_MOVE(name)          \
@@ -58,6 +64,7 @@ namespace cpp_json { namespace document
     struct json_element__array  ;
     struct json_element__object ;
     struct json_element__error  ;
+    struct json_element__lazy   ;
 
     struct json_document__impl  ;
   }
@@ -108,6 +115,8 @@ namespace cpp_json { namespace document
     virtual bool              is_error  () const                              = 0;
     // Returns true if DOM element represents an scalar
     virtual bool              is_scalar () const                              = 0;
+    // Returns true if DOM element represents an array
+    virtual bool              is_array  () const                              = 0;
 
     // Returns true if DOM element represents a null value
     virtual bool              is_null   () const                              = 0;
@@ -122,7 +131,73 @@ namespace cpp_json { namespace document
     virtual bool              apply     (json_element_visitor & v) const      = 0;
   };
 
-  struct json_document
+  // The memory used by a JSON document in bytes, by category
+  //  Counts capacity, ie what is allocated, slack is the part of the capacity
+  //  that holds no data. Elements shared with other documents (see json_document)
+  //  are counted by the document that created them, the documents kept alive by
+  //  the shared elements are counted in retained.
+  struct json_memory_usage
+  {
+    std::size_t document        = 0;  // The document object itself
+    std::size_t number_nodes    = 0;  // Node storage per kind of element, including unused slots
+    std::size_t string_nodes    = 0;
+    std::size_t array_nodes     = 0;
+    std::size_t object_nodes    = 0;
+    std::size_t node_slack      = 0;  // Unused slots in node storage
+    std::size_t string_payload  = 0;  // Characters of string values and member names not stored inline
+    std::size_t string_slack    = 0;  // Unused capacity in string_payload
+    std::size_t array_members   = 0;  // Member vectors of arrays
+    std::size_t object_members  = 0;  // Member vectors of objects (name, value and hash)
+    std::size_t member_slack    = 0;  // Unused capacity in array_members and object_members
+    std::size_t lazy_nodes      = 0;  // Node storage of deferred containers (see json_lazy_options)
+    std::size_t lazy_source     = 0;  // The copy of the input kept for deferred containers
+    std::size_t snapshot        = 0;  // The image of a loaded snapshot (see json_snapshot)
+    std::size_t retained        = 0;  // Other documents kept alive by shared elements, each counted once
+
+    // The total number of bytes, slack is included in the categories
+    std::size_t total () const noexcept
+    {
+      return
+          document
+        + number_nodes
+        + string_nodes
+        + array_nodes
+        + object_nodes
+        + string_payload
+        + array_members
+        + object_members
+        + lazy_nodes
+        + lazy_source
+        + snapshot
+        + retained
+        ;
+    }
+  };
+
+  // json_lazy_options selects the containers that json_parser::parse defers
+  //  A deferred container is validated but not built, the document keeps a copy of
+  //  the input and builds the container the first time size, at, get, names or
+  //  apply is invoked on it. Its members are subject to the same options so only
+  //  one level is built at a time. Building is thread-safe.
+  struct json_lazy_options
+  {
+    // Containers nested at least this deep are deferred, the root is at depth 0
+    std::size_t depth     = 1;
+    // Containers shorter than this (in chars) are built directly as building
+    //  a small container is cheaper than keeping it deferred
+    std::size_t min_size  = 0;
+  };
+
+  // json_document is immutable, the set*/erase methods return a new document
+  //  that shares all unchanged elements with the original document. Only the
+  //  containers along the path are copied. As no document is ever modified after
+  //  it's created old and new versions can be read concurrently without locks.
+  //
+  //  A path is a sequence of tokens (same semantics as RFC 6901 JSON Pointer):
+  //    for objects the token is the member name (first match), if no member matches
+  //      the last token a new member is appended
+  //    for arrays the token is a decimal index, '-' or an index equal to size appends
+  struct json_document : std::enable_shared_from_this<json_document>
   {
     using ptr = std::shared_ptr<json_document>  ;
 
@@ -137,12 +212,57 @@ namespace cpp_json { namespace document
     // Creates a string from a JSON document
     virtual doc_string_type to_string () const  = 0;
 
+    // Returns the memory used by the document, walks all elements
+    virtual json_memory_usage memory_usage () const = 0;
+
+    // Returns a new document where the element at path is replaced by a value
+    //  Returns an empty ptr if path is invalid
+    virtual ptr set_null    (doc_strings_type const & path) const                           = 0;
+    virtual ptr set_bool    (doc_strings_type const & path, bool v) const                   = 0;
+    virtual ptr set_number  (doc_strings_type const & path, double v) const                 = 0;
+    virtual ptr set_string  (doc_strings_type const & path, doc_string_type v) const        = 0;
+    // The element may belong to any document, that document is kept alive by the result
+    virtual ptr set_element (doc_strings_type const & path, json_element::ptr v) const      = 0;
+
+    // Returns a new document where the element at path is removed
+    //  Returns an empty ptr if path is invalid or denotes the root
+    virtual ptr erase       (doc_strings_type const & path) const                           = 0;
   };
 
   namespace details
   {
-    using array_members   = std::vector<json_element::ptr>                              ;
-    using object_members  = std::vector<std::tuple<doc_string_type, json_element::ptr>> ;
+    // Strings and members of a document are allocated from the document's memory resource
+    //  Object members are (name, value, hash_key (name))
+    using node_string     = std::basic_string<doc_char_type, std::char_traits<doc_char_type>, json_allocator<doc_char_type>>;
+    using array_member    = json_element::ptr                                       ;
+    using object_member   = std::tuple<node_string, json_element::ptr, std::size_t> ;
+    using array_members   = std::vector<array_member , json_allocator<array_member >> ;
+    using object_members  = std::vector<object_member, json_allocator<object_member>> ;
+
+    // FNV-1a hash of member names, used to speed up member lookups
+    template<typename TString>
+    inline std::size_t hash_key (TString const & key) noexcept
+    {
+      auto h = static_cast<std::uint64_t> (14695981039346656037ULL);
+      for (auto && c : key)
+      {
+        h ^= static_cast<std::uint64_t> (c);
+        h *= 1099511628211ULL;
+      }
+      return static_cast<std::size_t> (h);
+    }
+
+    // Compares strings with different allocators
+    template<typename TLeft, typename TRight>
+    inline bool equal_strings (TLeft const & l, TRight const & r) noexcept
+    {
+      return l.size () == r.size () && std::char_traits<doc_char_type>::compare (l.data (), r.data (), l.size ()) == 0;
+    }
+
+    inline doc_string_type to_doc_string (node_string const & s)
+    {
+      return doc_string_type (s.data (), s.size ());
+    }
 
     inline void to_string (doc_string_type & value, double d)
     {
@@ -167,69 +287,42 @@ namespace cpp_json { namespace document
       }
     }
 
-    struct json_non_printable_chars
+    // Appends ch to s, control characters are escaped
+    //  Computed without a lookup table so serializing doesn't touch shared state
+    inline void append_escaped_char (doc_string_type & s, doc_char_type ch)
     {
-      using non_printable_char  = std::array<doc_char_type      , 8 >;
-      using non_printable_chars = std::array<non_printable_char , 32>;
-
-      json_non_printable_chars ()
-      {
-        for (auto iter = 0U; iter < table.size (); ++iter)
-        {
-          auto && v = table[iter];
-          std::fill (v.begin (), v.end (), 0);
-
-          auto fmt = L"\\u%04x";
-
-          switch (iter)
-          {
-          case '\b':
-            fmt = L"\\b";
-            break;
-          case '\f':
-            fmt = L"\\f";
-            break;
-          case '\n':
-            fmt = L"\\n";
-            break;
-          case '\r':
-            fmt = L"\\r";
-            break;
-          case '\t':
-            fmt = L"\\t";
-            break;
-          }
-
-          std::swprintf (v.data (), v.size (), fmt, iter);
-        }
-      }
-
-      static json_non_printable_chars const & get ()
-      {
-        // TODO: Race condition issue (until compilers widely support magic statics)
-        static json_non_printable_chars non_printable_chars;
-        return non_printable_chars;
-      }
-
-      inline void append (doc_string_type & s, doc_char_type ch) const noexcept
-      {
-        if (ch < table.size ())
-        {
-          auto p = table[ch].data ();
-          while (*p)
-          {
-            s += *p++;
-          }
-        }
-        else
+      if (static_cast<std::uint32_t> (ch) >= 0x20)
+      {
+        s += ch;
+        return;
+      }
+
+      switch (ch)
+      {
+      case '\b':
+        s += L"\\b";
+        break;
+      case '\f':
+        s += L"\\f";
+        break;
+      case '\n':
+        s += L"\\n";
+        break;
+      case '\r':
+        s += L"\\r";
+        break;
+      case '\t':
+        s += L"\\t";
+        break;
+      default:
         {
-          s += ch;
+          auto hex = L"0123456789abcdef";
+          doc_char_type escaped[] = { L'\\', L'u', L'0', L'0', hex[(ch >> 4) & 0xF], hex[ch & 0xF], 0 };
+          s += escaped;
         }
+        break;
       }
-
-    private:
-      non_printable_chars table;
-    };
+    }
 
     struct json_element__base : json_element
     {
@@ -280,6 +373,10 @@ namespace cpp_json { namespace document
       {
         return true;
       }
+      bool is_array () const override
+      {
+        return false;
+      }
     };
 
     struct json_element__null : json_element__scalar
@@ -386,9 +483,9 @@ namespace cpp_json { namespace document
 
     struct json_element__string : json_element__scalar
     {
-      doc_string_type const value;
+      node_string const value;
 
-      inline explicit json_element__string (json_document__impl const * doc, doc_string_type v)
+      inline explicit json_element__string (json_document__impl const * doc, node_string v)
         : json_element__scalar (doc)
         , value (std::move (v))
       {
@@ -409,7 +506,7 @@ namespace cpp_json { namespace document
       }
       doc_string_type as_string () const override
       {
-        return value;
+        return to_doc_string (value);
       }
 
       bool apply (json_element_visitor & v) const
@@ -491,6 +588,11 @@ namespace cpp_json { namespace document
         return doc_strings_type ();
       }
 
+      bool is_array () const override
+      {
+        return true;
+      }
+
       bool apply (json_element_visitor & v) const
       {
         return v.visit (*this);
@@ -529,14 +631,36 @@ namespace cpp_json { namespace document
 
       ptr get (doc_string_type const & name) const override
       {
-        for (auto && kv : members)
+        return get (name, hash_key (name));
+      }
+
+      // Returns the child with name, hash must be hash_key (name)
+      ptr get (doc_string_type const & name, std::size_t hash) const
+      {
+        auto idx = find (name, hash);
+        if (idx < members.size ())
+        {
+          return std::get<1> (members[idx]);
+        }
+        else
         {
-          if (std::get<0> (kv) == name)
+          return error_element ();
+        }
+      }
+
+      // Returns the index of the first member with name, size () if not found
+      std::size_t find (doc_string_type const & name, std::size_t hash) const noexcept
+      {
+        auto sz = members.size ();
+        for (auto iter = 0U; iter < sz; ++iter)
+        {
+          auto && kv = members[iter];
+          if (std::get<2> (kv) == hash && equal_strings (std::get<0> (kv), name))
           {
-            return std::get<1> (kv);
+            return iter;
           }
         }
-        return error_element ();
+        return sz;
       }
 
       doc_strings_type names () const override
@@ -545,11 +669,16 @@ namespace cpp_json { namespace document
         result.reserve (members.size ());
         for (auto && kv : members)
         {
-          result.push_back (std::get<0> (kv));
+          result.push_back (to_doc_string (std::get<0> (kv)));
         }
         return result;
       }
 
+      bool is_array () const override
+      {
+        return false;
+      }
+
       bool apply (json_element_visitor & v) const
       {
         return v.visit (*this);
@@ -591,6 +720,10 @@ namespace cpp_json { namespace document
       {
         return true;
       }
+      bool is_array () const override
+      {
+        return false;
+      }
 
       bool is_null () const override
       {
@@ -615,6 +748,72 @@ namespace cpp_json { namespace document
       }
     };
 
+    // A container that is built the first time its members are accessed
+    //  [begin, end) is the range of the container in the document's source
+    struct json_element__lazy : json_element__container
+    {
+      std::size_t const                       begin     ;
+      std::size_t const                       end       ;
+      std::size_t const                       depth     ;
+      bool const                              array     ; // Otherwise an object
+      mutable std::atomic<json_element::ptr>  value     ;
+
+      inline explicit json_element__lazy (
+          json_document__impl const * doc
+        , std::size_t                 begin
+        , std::size_t                 end
+        , std::size_t                 depth
+        , bool                        array
+        )
+        : json_element__container (doc)
+        , begin                   (begin)
+        , end                     (end)
+        , depth                   (depth)
+        , array                   (array)
+        , value                   (nullptr)
+      {
+      }
+
+      // Builds the container on first use
+      json_element::ptr materialize () const;
+
+      std::size_t size () const override
+      {
+        return materialize ()->size ();
+      }
+
+      ptr at (std::size_t idx) const override
+      {
+        return materialize ()->at (idx);
+      }
+
+      ptr get (doc_string_type const & name) const override
+      {
+        return array
+          ? error_element ()
+          : materialize ()->get (name)
+          ;
+      }
+
+      doc_strings_type names () const override
+      {
+        return array
+          ? doc_strings_type ()
+          : materialize ()->names ()
+          ;
+      }
+
+      bool is_array () const override
+      {
+        return array;
+      }
+
+      bool apply (json_element_visitor & v) const
+      {
+        return materialize ()->apply (v);
+      }
+    };
+
     struct json_element_visitor__to_string : json_element_visitor
     {
       doc_string_type value;
@@ -633,12 +832,13 @@ namespace cpp_json { namespace document
           value += L"\\/";
           break;
         default:
-          json_non_printable_chars::get ().append (value, c);
+          append_escaped_char (value, c);
           break;
         }
       }
 
-      inline void str (doc_string_type const & s)
+      template<typename TString>
+      inline void str (TString const & s)
       {
         value += L'"';
         for (auto && c : s)
@@ -746,192 +946,852 @@ namespace cpp_json { namespace document
       }
     };
 
-    struct json_document__impl : json_document
+    // Returns the built container if e is deferred, otherwise e
+    inline json_element::ptr resolve_element (json_element::ptr e)
     {
-      using tptr = std::shared_ptr<json_document__impl>   ;
-
-      json_element__null  const         null_value        ;
-      json_element__bool  const         true_value        ;
-      json_element__bool  const         false_value       ;
-      json_element__error const         error_value       ;
+      auto lazy = dynamic_cast<json_element__lazy const *> (e);
+      return lazy ? lazy->materialize () : e;
+    }
 
-      std::deque<json_element__number>  number_values     ;
-      std::deque<json_element__string>  string_values     ;
-      std::deque<json_element__object>  object_values     ;
-      std::deque<json_element__array >  array_values      ;
+    inline json_element__array const * as_array_element (json_element::ptr e)
+    {
+      return dynamic_cast<json_element__array const *> (resolve_element (e));
+    }
 
-      json_element::ptr                 root_value        ;
+    inline json_element__object const * as_object_element (json_element::ptr e)
+    {
+      return dynamic_cast<json_element__object const *> (resolve_element (e));
+    }
 
-      json_document__impl ()
-        : null_value  (this)
-        , true_value  (this, true)
-        , false_value (this, false)
-        , error_value (this)
-        , root_value  (&null_value)
+    // Parses an array index token, '-' denotes the index after the last element
+    //  Leading zeros are not allowed (RFC 6901)
+    inline bool try_parse__index (doc_string_type const & token, std::size_t size, std::size_t & idx) noexcept
+    {
+      if (token == L"-")
       {
+        idx = size;
+        return true;
       }
 
-      json_element::ptr root () const override
+      auto sz = token.size ();
+      if (sz == 0 || (sz > 1 && token[0] == '0'))
       {
-        return root_value;
+        return false;
       }
 
-      doc_string_type to_string () const override
+      std::size_t r = 0;
+      for (auto && c : token)
       {
-        details::json_element_visitor__to_string visitor;
+        if (c < '0' || c > '9' || r > size)
+        {
+          return false;
+        }
+        r = 10*r + (c - '0');
+      }
 
-        CPP_JSON__ASSERT (root_value);
-        root_value->apply (visitor);
+      idx = r;
+      return true;
+    }
 
-        return std::move (visitor.value);
-      }
+    // Splits a JSON Pointer (RFC 6901) into tokens, '~0' is '~' and '~1' is '/'
+    //  'pos' indicates the first non-consumed character
+    inline bool try_parse__pointer (doc_string_type const & pointer, std::size_t & pos, doc_strings_type & tokens)
+    {
+      tokens.clear ();
 
-      details::json_element__number * create_number (double v)
-      {
-        number_values.emplace_back (this, v);
-        return & number_values.back ();
-      }
+      auto sz = pointer.size ();
+      pos = 0;
 
-      details::json_element__string * create_string (doc_string_type && v)
+      if (sz == 0)
       {
-        string_values.emplace_back (this, std::move (v));
-        return & string_values.back ();
+        return true;  // The empty pointer denotes the root
       }
 
-      details::json_element__array * create_array (array_members && members)
+      if (pointer[pos] != '/')
       {
-        array_values.emplace_back (this, std::move (members));
-
-        return & array_values.back ();
+        return false;
       }
 
-      details::json_element__object * create_object (object_members && members)
+      doc_string_type token;
+      token.reserve (default_size);
+
+      while (pos < sz)
       {
-        object_values.emplace_back (this, std::move (members));
+        CPP_JSON__ASSERT (pointer[pos] == '/');
+        ++pos;
+
+        token.clear ();
+        for (; pos < sz && pointer[pos] != '/'; ++pos)
+        {
+          auto c = pointer[pos];
+          if (c == '~')
+          {
+            auto n = pos + 1 < sz ? pointer[pos + 1] : 0;
+            if (n == '0')
+            {
+              token += L'~';
+            }
+            else if (n == '1')
+            {
+              token += L'/';
+            }
+            else
+            {
+              return false;
+            }
+            ++pos;
+          }
+          else
+          {
+            token += c;
+          }
+        }
 
-        return & object_values.back ();
+        tokens.push_back (token);
       }
 
-    };
+      return true;
+    }
 
-    struct json_element_context : std::enable_shared_from_this<json_element_context>
+    // node_arena stores elements in fixed size chunks so element addresses are stable
+    //  clear destroys the elements but keeps the chunks, a cleared arena is refilled
+    //  without allocating
+    template<typename T>
+    struct node_arena
     {
-      using ptr   = std::shared_ptr<json_element_context> ;
-      using ptrs  = std::vector<ptr> ;
+      constexpr static std::size_t chunk_size = 64;
 
-      json_document__impl & document;
-
-      inline json_element_context (json_document__impl & doc)
-        : document (doc)
+      explicit node_arena (json_memory_resource * resource)
+        : chunks (resource)
       {
       }
-      virtual ~json_element_context ()  = default;
 
-      CPP_JSON__NO_COPY_MOVE (json_element_context);
+      ~node_arena ()
+      {
+        clear ();
 
-      virtual bool              add_value       (json_element::ptr const & json ) = 0;
-      virtual bool              set_key         (doc_string_type && key         ) = 0;
-      virtual json_element::ptr create_element  (
-          ptrs & array_contexts
-        , ptrs & object_contexts
-        ) = 0;
-    };
+        auto resource = chunks.get_allocator ().resource ();
+        for (auto && c : chunks)
+        {
+          resource->deallocate (c, sizeof (storage_type) * chunk_size, alignof (storage_type));
+        }
+      }
 
-    using json_element_contexts = json_element_context::ptrs;
+      CPP_JSON__NO_COPY_MOVE (node_arena);
 
-    struct json_element_context__root : json_element_context
-    {
-      inline json_element_context__root (json_document__impl & doc)
-        : json_element_context (doc)
+      template<typename ...TArgs>
+      T * emplace_back (TArgs && ... args)
       {
+        auto chunk  = sz / chunk_size;
+        auto offset = sz % chunk_size;
+
+        if (chunk == chunks.size ())
+        {
+          auto resource = chunks.get_allocator ().resource ();
+          chunks.push_back (static_cast<storage_type *> (resource->allocate (sizeof (storage_type) * chunk_size, alignof (storage_type))));
+        }
+
+        auto result = new (&chunks[chunk][offset]) T (std::forward<TArgs> (args)...);
+        ++sz;
+
+        return result;
       }
 
-      virtual bool add_value (json_element::ptr const & json) override
+      void clear () noexcept
       {
-        CPP_JSON__ASSERT (json);
-        document.root_value = json;
+        for (auto iter = 0U; iter < sz; ++iter)
+        {
+          at (iter)->~T ();
+        }
+        sz = 0;
+      }
 
-        return true;
+      std::size_t size () const noexcept
+      {
+        return sz;
       }
 
-      virtual bool set_key (doc_string_type && /*key*/) override
+      // The number of elements that fit in the allocated chunks
+      std::size_t capacity () const noexcept
       {
-        CPP_JSON__ASSERT (false);
+        return chunks.size () * chunk_size;
+      }
 
-        return true;
+      // The bytes allocated by the arena
+      std::size_t allocated () const noexcept
+      {
+        return capacity () * sizeof (storage_type) + chunks.capacity () * sizeof (storage_type *);
       }
 
-      virtual json_element::ptr create_element (
-          json_element_contexts & /*array_contexts */
-        , json_element_contexts & /*object_contexts*/
-        ) override
+      template<typename TAction>
+      void for_each (TAction && action) const
       {
-        return document.root_value;
+        for (auto iter = 0U; iter < sz; ++iter)
+        {
+          action (*reinterpret_cast<T const *> (&chunks[iter / chunk_size][iter % chunk_size]));
+        }
       }
 
+    private:
+      using storage_type = typename std::aligned_storage<sizeof (T), alignof (T)>::type;
+
+      std::vector<storage_type *, json_allocator<storage_type *>> chunks  ;
+      std::size_t                                                 sz      = 0;
+
+      T * at (std::size_t idx) noexcept
+      {
+        return reinterpret_cast<T *> (&chunks[idx / chunk_size][idx % chunk_size]);
+      }
     };
 
-    struct json_element_context__array : json_element_context
+    struct json_document__impl : json_document
     {
-      array_members values;
+      using tptr  = std::shared_ptr<json_document__impl>      ;
+      using cptr  = std::shared_ptr<json_document const>      ;
+      using cptrs = std::vector<cptr>                         ;
 
-      inline json_element_context__array (json_document__impl & doc)
-        : json_element_context (doc)
+      json_memory_resource * const      resource          ;
+
+      json_element__null  const         null_value        ;
+      json_element__bool  const         true_value        ;
+      json_element__bool  const         false_value       ;
+      json_element__error const         error_value       ;
+
+      node_arena<json_element__number>  number_values     ;
+      node_arena<json_element__string>  string_values     ;
+      node_arena<json_element__object>  object_values     ;
+      node_arena<json_element__array >  array_values      ;
+      node_arena<json_element__lazy  >  lazy_values       ;
+
+      json_element::ptr                 root_value        ;
+
+      // Documents that own elements shared with this document, see share
+      cptrs                             shared_documents  ;
+
+      // The input of deferred containers and the options they are built with
+      //  lazy_mutex serializes building them as that adds elements to the document
+      node_string                       source            ;
+      json_lazy_options                 lazy_options      ;
+      mutable std::mutex                lazy_mutex        ;
+
+      json_document__impl (json_memory_resource * resource = json_new_delete_resource ())
+        : resource      (resource)
+        , null_value    (this)
+        , true_value    (this, true)
+        , false_value   (this, false)
+        , error_value   (this)
+        , number_values (resource)
+        , string_values (resource)
+        , object_values (resource)
+        , array_values  (resource)
+        , lazy_values   (resource)
+        , root_value    (&null_value)
+        , source        (resource)
       {
+        CPP_JSON__ASSERT (resource);
       }
 
-      virtual bool add_value (json_element::ptr const & json) override
+      // Creates a document, the document and all its values are allocated from 'resource'
+      static tptr create_document (json_memory_resource * resource)
       {
-        CPP_JSON__ASSERT (json);
-        values.push_back (json);
-
-        return true;
+        return std::allocate_shared<json_document__impl> (json_allocator<json_document__impl> (resource), resource);
       }
 
-      virtual bool set_key (doc_string_type && /*key*/) override
+      json_element::ptr root () const override
       {
-        CPP_JSON__ASSERT (false);
-
-        return true;
+        return root_value;
       }
 
-      virtual json_element::ptr create_element (
-          json_element_contexts & array_contexts
-        , json_element_contexts & /*object_contexts*/
-        ) override
+      // Removes all values so the document can be rebuilt, storage is kept for reuse
+      void clear () noexcept
       {
-        auto cap = values.capacity ();
-        values.shrink_to_fit ();
-
-        auto result = document.create_array (std::move (values));
-        array_contexts.push_back (shared_from_this ());
+        root_value = &null_value;
+        shared_documents.clear ();
 
-        values.reserve (cap);
+        number_values.clear ();
+        string_values.clear ();
+        object_values.clear ();
+        array_values.clear ();
+        lazy_values.clear ();
 
-        return result;
+        source.clear ();
       }
 
-    };
-
-    struct json_element_context__object : json_element_context
+      doc_string_type to_string () const override
+      {
+        details::json_element_visitor__to_string visitor;
+
+        CPP_JSON__ASSERT (root_value);
+        root_value->apply (visitor);
+
+        return std::move (visitor.value);
+      }
+
+      json_memory_usage memory_usage () const override
+      {
+        auto usage = own_memory_usage ();
+
+        // The documents retained by shared elements, directly or through other
+        //  retained documents, each counted once
+        std::vector<json_document__impl const *>          retained  ;
+        std::unordered_set<json_document__impl const *>   seen      ;
+        seen.insert (this);
+
+        auto retain = [&retained, &seen] (json_document__impl const & doc)
+          {
+            for (auto && d : doc.shared_documents)
+            {
+              auto impl = static_cast<json_document__impl const *> (d.get ());
+              if (seen.insert (impl).second)
+              {
+                retained.push_back (impl);
+              }
+            }
+          };
+
+        retain (*this);
+        for (auto iter = 0U; iter < retained.size (); ++iter)
+        {
+          retain (*retained[iter]);
+        }
+
+        for (auto && d : retained)
+        {
+          usage.retained += d->own_memory_usage ().total ();
+        }
+
+        return usage;
+      }
+
+      // The memory used by this document without the documents it retains
+      json_memory_usage own_memory_usage () const
+      {
+        std::lock_guard<std::mutex> lock (lazy_mutex);
+
+        json_memory_usage usage;
+
+        usage.document = sizeof (*this) + shared_documents.capacity () * sizeof (cptr);
+
+        auto nodes = [&usage] (std::size_t & category, std::size_t allocated, std::size_t capacity, std::size_t size, std::size_t element_size)
+          {
+            category          += allocated;
+            usage.node_slack  += (capacity - size) * element_size;
+          };
+
+        nodes (usage.number_nodes , number_values.allocated (), number_values.capacity (), number_values.size (), sizeof (json_element__number));
+        nodes (usage.string_nodes , string_values.allocated (), string_values.capacity (), string_values.size (), sizeof (json_element__string));
+        nodes (usage.array_nodes  , array_values.allocated () , array_values.capacity () , array_values.size () , sizeof (json_element__array ));
+        nodes (usage.object_nodes , object_values.allocated (), object_values.capacity (), object_values.size (), sizeof (json_element__object));
+        nodes (usage.lazy_nodes   , lazy_values.allocated ()  , lazy_values.capacity ()  , lazy_values.size ()  , sizeof (json_element__lazy  ));
+
+        // Short strings are stored inline in the string object
+        auto inline_capacity = node_string (resource).capacity ();
+        auto payload = [&usage, inline_capacity] (node_string const & s)
+          {
+            if (s.capacity () > inline_capacity)
+            {
+              usage.string_payload  += (s.capacity () + 1) * sizeof (doc_char_type);
+              usage.string_slack    += (s.capacity () - s.size ()) * sizeof (doc_char_type);
+            }
+          };
+
+        string_values.for_each ([&payload] (json_element__string const & e)
+          {
+            payload (e.value);
+          });
+
+        array_values.for_each ([&usage] (json_element__array const & e)
+          {
+            usage.array_members += e.members.capacity () * sizeof (array_member);
+            usage.member_slack  += (e.members.capacity () - e.members.size ()) * sizeof (array_member);
+          });
+
+        object_values.for_each ([&usage, &payload] (json_element__object const & e)
+          {
+            usage.object_members  += e.members.capacity () * sizeof (object_member);
+            usage.member_slack    += (e.members.capacity () - e.members.size ()) * sizeof (object_member);
+            for (auto && m : e.members)
+            {
+              payload (std::get<0> (m));
+            }
+          });
+
+        if (source.capacity () > inline_capacity)
+        {
+          usage.lazy_source = (source.capacity () + 1) * sizeof (doc_char_type);
+        }
+
+        return usage;
+      }
+
+      details::json_element__number * create_number (double v)
+      {
+        return number_values.emplace_back (this, v);
+      }
+
+      details::json_element__string * create_string (node_string && v)
+      {
+        return string_values.emplace_back (this, std::move (v));
+      }
+
+      details::json_element__array * create_array (array_members && members)
+      {
+        return array_values.emplace_back (this, std::move (members));
+      }
+
+      details::json_element__object * create_object (object_members && members)
+      {
+        return object_values.emplace_back (this, std::move (members));
+      }
+
+      details::json_element__lazy * create_lazy (std::size_t begin, std::size_t end, std::size_t depth, bool is_array)
+      {
+        return lazy_values.emplace_back (this, begin, end, depth, is_array);
+      }
+
+      ptr set_null (doc_strings_type const & path) const override
+      {
+        return update (path, [] (json_document__impl & doc) -> json_element::ptr { return &doc.null_value; });
+      }
+
+      ptr set_bool (doc_strings_type const & path, bool v) const override
+      {
+        return update (path, [v] (json_document__impl & doc) -> json_element::ptr { return v ? &doc.true_value : &doc.false_value; });
+      }
+
+      ptr set_number (doc_strings_type const & path, double v) const override
+      {
+        return update (path, [v] (json_document__impl & doc) -> json_element::ptr { return doc.create_number (v); });
+      }
+
+      ptr set_string (doc_strings_type const & path, doc_string_type v) const override
+      {
+        return update (path, [&v] (json_document__impl & doc) -> json_element::ptr { return doc.create_string (node_string (v.data (), v.size (), doc.resource)); });
+      }
+
+      ptr set_element (doc_strings_type const & path, json_element::ptr v) const override
+      {
+        auto base = dynamic_cast<json_element__base const *> (v);
+        if (!base)
+        {
+          return ptr ();
+        }
+
+        CPP_JSON__ASSERT (base->doc);
+
+        return update (path, [v] (json_document__impl & doc) -> json_element::ptr { return doc.share (v); });
+      }
+
+      ptr erase (doc_strings_type const & path) const override
+      {
+        if (path.empty ())
+        {
+          return ptr ();
+        }
+
+        return update (path, [] (json_document__impl & /*doc*/) -> json_element::ptr { return nullptr; });
+      }
+
+    private:
+      // Returns the element to store for an element owned by another document and
+      //  keeps its owner alive. Only the owners of shared elements are kept, so
+      //  a version that no element is shared from is freed when it's released.
+      //  null, true and false are replaced by this document's own values.
+      json_element::ptr share (json_element::ptr e)
+      {
+        auto base = dynamic_cast<json_element__base const *> (e);
+        if (!base || !base->doc || base->doc == this)
+        {
+          return e;
+        }
+
+        auto owner = base->doc;
+        if (e == &owner->null_value)
+        {
+          return &null_value;
+        }
+        else if (e == &owner->true_value)
+        {
+          return &true_value;
+        }
+        else if (e == &owner->false_value)
+        {
+          return &false_value;
+        }
+
+        for (auto && d : shared_documents)
+        {
+          if (d.get () == owner)
+          {
+            return e;
+          }
+        }
+
+        shared_documents.push_back (owner->shared_from_this ());
+        return e;
+      }
+
+      // Creates a new document where the elements along path are copied, the rest is shared
+      //  create returns the new element for the path, nullptr means the element is removed
+      template<typename TCreate>
+      ptr update (doc_strings_type const & path, TCreate && create) const
+      {
+        auto result = create_document (resource);
+
+        json_element::ptr root;
+        if (path.empty ())
+        {
+          root = create (*result);
+        }
+        else if (!result->copy_path (root_value, path, 0, create, root))
+        {
+          return ptr ();
+        }
+
+        if (!root)
+        {
+          return ptr ();
+        }
+
+        result->root_value = root;
+        return result;
+      }
+
+      template<typename TCreate>
+      bool copy_path (
+          json_element::ptr         current
+        , doc_strings_type const &  path
+        , std::size_t               depth
+        , TCreate &&                create
+        , json_element::ptr &       result
+        )
+      {
+        CPP_JSON__ASSERT (depth < path.size ());
+
+        auto && token = path[depth];
+        auto    last  = depth + 1 == path.size ();
+
+        if (auto a = as_array_element (current))
+        {
+          auto && members = a->members;
+          auto    sz      = members.size ();
+
+          std::size_t idx;
+          if (!try_parse__index (token, sz, idx) || idx > sz)
+          {
+            return false;
+          }
+
+          auto exists = idx < sz;
+
+          json_element::ptr child = nullptr;
+          if (last)
+          {
+            child = create (*this);
+          }
+          else if (!exists || !copy_path (members[idx], path, depth + 1, create, child))
+          {
+            return false;
+          }
+
+          if (!exists && !child)
+          {
+            return false;
+          }
+
+          array_members copy (resource);
+          copy.reserve (sz + 1);
+          for (auto iter = 0U; iter < sz; ++iter)
+          {
+            if (iter != idx)
+            {
+              copy.push_back (share (members[iter]));
+            }
+            else if (child)
+            {
+              copy.push_back (child);
+            }
+          }
+
+          if (!exists)
+          {
+            copy.push_back (child);
+          }
+
+          result = create_array (std::move (copy));
+          return true;
+        }
+        else if (auto o = as_object_element (current))
+        {
+          auto && members = o->members;
+          auto    sz      = members.size ();
+
+          auto hash   = hash_key (token);
+          auto idx    = o->find (token, hash);
+
+          auto exists = idx < sz;
+
+          json_element::ptr child = nullptr;
+          if (last)
+          {
+            child = create (*this);
+          }
+          else if (!exists || !copy_path (std::get<1> (members[idx]), path, depth + 1, create, child))
+          {
+            return false;
+          }
+
+          if (!exists && !child)
+          {
+            return false;
+          }
+
+          object_members copy (resource);
+          copy.reserve (sz + 1);
+          for (auto iter = 0U; iter < sz; ++iter)
+          {
+            if (iter != idx)
+            {
+              copy.push_back (members[iter]);
+              std::get<1> (copy.back ()) = share (std::get<1> (members[iter]));
+            }
+            else if (child)
+            {
+              copy.push_back (members[iter]);
+              std::get<1> (copy.back ()) = child;
+            }
+          }
+
+          if (!exists)
+          {
+            copy.push_back (std::make_tuple (node_string (token.data (), token.size (), resource), child, hash));
+          }
+
+          result = create_object (std::move (copy));
+          return true;
+        }
+        else
+        {
+          return false;
+        }
+      }
+    };
+
+    struct json_element_context : std::enable_shared_from_this<json_element_context>
+    {
+      using ptr   = std::shared_ptr<json_element_context> ;
+      using ptrs  = std::vector<ptr> ;
+
+      json_document__impl * document;
+
+      inline json_element_context (json_document__impl & doc)
+        : document (&doc)
+      {
+      }
+      virtual ~json_element_context ()  = default;
+
+      CPP_JSON__NO_COPY_MOVE (json_element_context);
+
+      // Binds the context to another document
+      virtual void              rebind          (json_document__impl & doc)
+      {
+        document = &doc;
+      }
+
+      virtual bool              add_value       (json_element::ptr const & json ) = 0;
+      virtual bool              set_key         (node_string && key             ) = 0;
+      virtual json_element::ptr create_element  (
+          ptrs & array_contexts
+        , ptrs & object_contexts
+        ) = 0;
+      // Discards partial values (after a failed parse) and returns the context to its pool
+      virtual void              recycle         (
+          ptrs & array_contexts
+        , ptrs & object_contexts
+        ) = 0;
+    };
+
+    using json_element_contexts = json_element_context::ptrs;
+
+    struct json_element_context__root : json_element_context
+    {
+      inline json_element_context__root (json_document__impl & doc)
+        : json_element_context (doc)
+      {
+      }
+
+      virtual bool add_value (json_element::ptr const & json) override
+      {
+        CPP_JSON__ASSERT (json);
+        document->root_value = json;
+
+        return true;
+      }
+
+      virtual bool set_key (node_string && /*key*/) override
+      {
+        CPP_JSON__ASSERT (false);
+
+        return true;
+      }
+
+      virtual json_element::ptr create_element (
+          json_element_contexts & /*array_contexts */
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+        return document->root_value;
+      }
+
+      virtual void recycle (
+          json_element_contexts & /*array_contexts */
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+      }
+
+    };
+
+    // Receives a single value without making it the root of the document
+    struct json_element_context__value : json_element_context
     {
-      doc_string_type key   ;
+      json_element::ptr value;
+
+      inline json_element_context__value (json_document__impl & doc)
+        : json_element_context  (doc)
+        , value                 (nullptr)
+      {
+      }
+
+      virtual bool add_value (json_element::ptr const & json) override
+      {
+        CPP_JSON__ASSERT (json);
+        value = json;
+
+        return true;
+      }
+
+      virtual bool set_key (node_string && /*key*/) override
+      {
+        CPP_JSON__ASSERT (false);
+
+        return true;
+      }
+
+      virtual json_element::ptr create_element (
+          json_element_contexts & /*array_contexts */
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+        return value;
+      }
+
+      virtual void recycle (
+          json_element_contexts & /*array_contexts */
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+      }
+
+    };
+
+    struct json_element_context__array : json_element_context
+    {
+      array_members values;
+
+      inline json_element_context__array (json_document__impl & doc)
+        : json_element_context  (doc)
+        , values                (doc.resource)
+      {
+      }
+
+      virtual void rebind (json_document__impl & doc) override
+      {
+        json_element_context::rebind (doc);
+
+        // Capacity from another resource can't be handed to the new document
+        if (*values.get_allocator ().resource () != *doc.resource)
+        {
+          values = array_members (doc.resource);
+        }
+      }
+
+      virtual bool add_value (json_element::ptr const & json) override
+      {
+        CPP_JSON__ASSERT (json);
+        values.push_back (json);
+
+        return true;
+      }
+
+      virtual bool set_key (node_string && /*key*/) override
+      {
+        CPP_JSON__ASSERT (false);
+
+        return true;
+      }
+
+      virtual json_element::ptr create_element (
+          json_element_contexts & array_contexts
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+        auto cap = values.capacity ();
+        values.shrink_to_fit ();
+
+        auto result = document->create_array (std::move (values));
+        array_contexts.push_back (shared_from_this ());
+
+        values.reserve (cap);
+
+        return result;
+      }
+
+      virtual void recycle (
+          json_element_contexts & array_contexts
+        , json_element_contexts & /*object_contexts*/
+        ) override
+      {
+        values.clear ();
+        array_contexts.push_back (shared_from_this ());
+      }
+
+    };
+
+    struct json_element_context__object : json_element_context
+    {
+      node_string     key   ;
       object_members  values;
 
       inline json_element_context__object (json_document__impl & doc)
-        : json_element_context (doc)
+        : json_element_context  (doc)
+        , key                   (doc.resource)
+        , values                (doc.resource)
+      {
+      }
+
+      virtual void rebind (json_document__impl & doc) override
       {
+        json_element_context::rebind (doc);
+
+        // Capacity from another resource can't be handed to the new document
+        if (*values.get_allocator ().resource () != *doc.resource)
+        {
+          key     = node_string     (doc.resource);
+          values  = object_members  (doc.resource);
+        }
       }
 
       virtual bool add_value (json_element::ptr const & json) override
       {
         CPP_JSON__ASSERT (json);
-        values.push_back (std::make_tuple (std::move (key), json));
+        auto hash = hash_key (key);
+        values.push_back (std::make_tuple (std::move (key), json, hash));
 
         return true;
       }
 
-      virtual bool set_key (doc_string_type && k) override
+      virtual bool set_key (node_string && k) override
       {
         key = std::move (k);
 
@@ -946,7 +1806,7 @@ namespace cpp_json { namespace document
         auto cap = values.capacity ();
         values.shrink_to_fit ();
 
-        auto result = document.create_object (std::move (values));
+        auto result = document->create_object (std::move (values));
         object_contexts.push_back (shared_from_this ());
 
         values.reserve (cap);
@@ -954,6 +1814,16 @@ namespace cpp_json { namespace document
         return result;
       }
 
+      virtual void recycle (
+          json_element_contexts & /*array_contexts */
+        , json_element_contexts & object_contexts
+        ) override
+      {
+        key.clear ();
+        values.clear ();
+        object_contexts.push_back (shared_from_this ());
+      }
+
     };
 
     // string_builder is used to build json strings as it has a slightly lower overhead than std::vector
@@ -977,62 +1847,239 @@ namespace cpp_json { namespace document
 
       inline ~string_builder () noexcept
       {
-        free (str);
+        free (str);
+      }
+
+      inline void clear () noexcept
+      {
+        sz = 0;
+      }
+
+      inline void push_back (char_type ch) noexcept
+      {
+        if (sz >= cap)
+        {
+          cap <<= 1;
+          str = static_cast<char_type *> (std::realloc (str, cap * sizeof (char_type)));
+          CPP_JSON__ASSERT (str);
+          CPP_JSON__ASSERT (sz < cap);
+        }
+        str[sz] = ch;
+        ++sz;
+      }
+
+      template<typename TAllocator>
+      inline std::basic_string<char_type, std::char_traits<char_type>, TAllocator> create_string (TAllocator const & allocator) const
+      {
+        return std::basic_string<char_type, std::char_traits<char_type>, TAllocator> (str, sz, allocator);
+      }
+
+    private:
+      std::size_t cap ;
+      std::size_t sz  ;
+      char_type * str ;
+    };
+
+    // string_decoder appends input chars to a document string
+    template<typename TChar>
+    struct string_decoder;
+
+    template<>
+    struct string_decoder<doc_char_type>
+    {
+      inline void clear () noexcept
+      {
+      }
+
+      inline void push (string_builder<doc_char_type> & sb, doc_char_type ch) noexcept
+      {
+        sb.push_back (ch);
+      }
+
+      inline void flush (string_builder<doc_char_type> & /*sb*/) noexcept
+      {
+      }
+    };
+
+    // Decodes UTF-8 input, malformed sequences are replaced by U+FFFD, that includes
+    //  overlong forms, encoded surrogates, values beyond U+10FFFF and F5-FF bytes
+    //  Code points outside the BMP are encoded as surrogate pairs if doc_char_type is 16-bit
+    template<>
+    struct string_decoder<char>
+    {
+      inline string_decoder () noexcept
+        : code_point  (0)
+        , minimum     (0)
+        , remaining   (0)
+      {
       }
 
       inline void clear () noexcept
       {
-        sz = 0;
+        remaining = 0;
       }
 
-      inline void push_back (char_type ch) noexcept
+      inline void push (string_builder<doc_char_type> & sb, char ch) noexcept
       {
-        if (sz >= cap)
+        auto b = static_cast<std::uint32_t> (static_cast<unsigned char> (ch));
+
+        if (remaining > 0)
         {
-          cap <<= 1;
-          str = static_cast<char_type *> (std::realloc (str, cap * sizeof (char_type)));
-          CPP_JSON__ASSERT (str);
-          CPP_JSON__ASSERT (sz < cap);
+          if ((b & 0xC0) == 0x80)
+          {
+            code_point = (code_point << 6) | (b & 0x3F);
+            if (--remaining == 0)
+            {
+              // Overlong forms, surrogates and values beyond U+10FFFF are malformed
+              auto valid =
+                    code_point >= minimum
+                &&  (code_point < 0xD800 || code_point > 0xDFFF)
+                &&  code_point <= 0x10FFFF
+                ;
+              push_code_point (sb, valid ? code_point : replacement);
+            }
+            return;
+          }
+
+          remaining = 0;
+          push_code_point (sb, replacement);
+        }
+
+        if (b < 0x80)
+        {
+          sb.push_back (static_cast<doc_char_type> (b));
+        }
+        else if ((b & 0xE0) == 0xC0)
+        {
+          code_point  = b & 0x1F;
+          minimum     = 0x80;
+          remaining   = 1;
+        }
+        else if ((b & 0xF0) == 0xE0)
+        {
+          code_point  = b & 0x0F;
+          minimum     = 0x800;
+          remaining   = 2;
+        }
+        else if (b >= 0xF0 && b <= 0xF4)
+        {
+          code_point  = b & 0x07;
+          minimum     = 0x10000;
+          remaining   = 3;
+        }
+        else
+        {
+          push_code_point (sb, replacement);
         }
-        str[sz] = ch;
-        ++sz;
       }
 
-      inline std::basic_string<char_type> create_string () const
+      // Completes the string, a truncated sequence is replaced by U+FFFD
+      inline void flush (string_builder<doc_char_type> & sb) noexcept
       {
-        return std::basic_string<char_type> (str, sz);
+        if (remaining > 0)
+        {
+          remaining = 0;
+          push_code_point (sb, replacement);
+        }
       }
 
     private:
-      std::size_t cap ;
-      std::size_t sz  ;
-      char_type * str ;
+      constexpr static std::uint32_t replacement = 0xFFFD;
+
+      std::uint32_t code_point;
+      std::uint32_t minimum   ; // The smallest code point of the sequence length
+      std::uint32_t remaining ;
+
+      static inline void push_code_point (string_builder<doc_char_type> & sb, std::uint32_t cp) noexcept
+      {
+        if (sizeof (doc_char_type) < 4 && cp > 0xFFFF)
+        {
+          cp -= 0x10000;
+          sb.push_back (static_cast<doc_char_type> (0xD800 + (cp >> 10)));
+          sb.push_back (static_cast<doc_char_type> (0xDC00 + (cp & 0x3FF)));
+        }
+        else
+        {
+          sb.push_back (static_cast<doc_char_type> (cp));
+        }
+      }
     };
 
-    struct builder_json_context
+    // Builds a JSON document from input of TChar (doc_char_type or UTF-8 encoded char)
+    //  TIter is the input "iterator", typically TChar const *
+    template<typename TChar, typename TIter = TChar const *>
+    struct basic_builder_json_context
     {
-      using string_type       = doc_string_type ;
-      using char_type         = doc_char_type   ;
-      using iter_type         = doc_iter_type   ;
+      using string_type       = std::basic_string<TChar>  ;
+      using char_type         = TChar                     ;
+      using iter_type         = TIter                     ;
 
-      json_document__impl::tptr document        ;
+      json_document__impl::tptr     document        ;
 
-      string_builder<char_type> current_string  ;
+      string_builder<doc_char_type> current_string  ;
+      string_decoder<char_type>     decoder         ;
 
-      json_element_contexts     element_context ;
-      json_element_contexts     array_contexts  ;
-      json_element_contexts     object_contexts ;
+      json_element_contexts         element_context ;
+      json_element_contexts         array_contexts  ;
+      json_element_contexts         object_contexts ;
 
-      inline builder_json_context ()
-        : document (std::make_shared<json_document__impl> ())
+      // The documents built and all their values are allocated from 'resource'
+      inline explicit basic_builder_json_context (json_memory_resource * resource = json_new_delete_resource ())
+        : basic_builder_json_context (json_document__impl::create_document (resource))
       {
+      }
+
+      // Builds into 'doc'
+      inline explicit basic_builder_json_context (json_document__impl::tptr doc)
+        : document (std::move (doc))
+      {
+        CPP_JSON__ASSERT (document);
         element_context.reserve (default_size);
-        element_context.reserve (default_size);
-        element_context.reserve (default_size);
+        array_contexts.reserve  (default_size);
+        object_contexts.reserve (default_size);
         element_context.push_back (std::make_shared<json_element_context__root> (*document));
       }
 
-      CPP_JSON__NO_COPY_MOVE (builder_json_context);
+      CPP_JSON__NO_COPY_MOVE (basic_builder_json_context);
+
+      // Prepares the context for building a new document, used when the context is
+      //  reused for many inputs. Pooled element contexts and the string buffer keep their capacity
+      inline void reset_document ()
+      {
+        reset_document (json_document__impl::create_document (document->resource));
+      }
+
+      // Prepares the context for building into 'doc' which must be empty
+      inline void reset_document (json_document__impl::tptr doc)
+      {
+        CPP_JSON__ASSERT (doc);
+        document = std::move (doc);
+
+        CPP_JSON__ASSERT (!element_context.empty ());
+        while (element_context.size () > 1)
+        {
+          element_context.back ()->recycle (array_contexts, object_contexts);
+          element_context.pop_back ();
+        }
+
+        for (auto && c : element_context)
+        {
+          c->rebind (*document);
+        }
+
+        for (auto && c : array_contexts)
+        {
+          c->rebind (*document);
+        }
+
+        for (auto && c : object_contexts)
+        {
+          c->rebind (*document);
+        }
+
+        current_string.clear ();
+        decoder.clear ();
+      }
 
       inline void expected_char (std::size_t /*pos*/, char_type /*ch*/) noexcept
       {
@@ -1053,21 +2100,24 @@ namespace cpp_json { namespace document
       inline void clear_string ()
       {
         current_string.clear ();
+        decoder.clear ();
       }
 
       inline void push_char (char_type ch)
       {
-        current_string.push_back (ch);
+        decoder.push (current_string, ch);
       }
 
       inline void push_wchar_t (wchar_t ch)
       {
+        decoder.flush (current_string);
         current_string.push_back (ch);
       }
 
-      inline string_type get_string ()
+      inline node_string get_string ()
       {
-        return current_string.create_string ();
+        decoder.flush (current_string);
+        return current_string.create_string (json_allocator<doc_char_type> (document->resource));
       }
 
       inline bool pop ()
@@ -1123,7 +2173,7 @@ namespace cpp_json { namespace document
         return true;
       }
 
-      bool member_key (string_type && s)
+      bool member_key (node_string && s)
       {
         CPP_JSON__ASSERT (!element_context.empty ());
         auto && back = element_context.back ();
@@ -1165,21 +2215,392 @@ namespace cpp_json { namespace document
         return true;
       }
 
-      bool string_value (string_type && s)
+      bool string_value (node_string && s)
+      {
+        auto v = document->create_string (std::move (s));
+
+        CPP_JSON__ASSERT (!element_context.empty ());
+        auto && back = element_context.back ();
+        CPP_JSON__ASSERT (back);
+        back->add_value (v);
+
+        return true;
+      }
+
+      bool number_value (double d)
+      {
+        auto v = document->create_number (d);
+
+        CPP_JSON__ASSERT (!element_context.empty ());
+        auto && back = element_context.back ();
+        CPP_JSON__ASSERT (back);
+        back->add_value (v);
+
+        return true;
+      }
+
+    };
+
+    using builder_json_context = basic_builder_json_context<doc_char_type>;
+  }
+
+  // json_projection selects the parts of a JSON document that json_parser::parse builds
+  //  Paths are JSON Pointers where the token '*' matches any member or array element.
+  //  Selected elements are built with all their descendants, their ancestor containers
+  //  are built with the selected members only. Everything else is validated but not built.
+  struct json_projection
+  {
+    struct node
+    {
+      doc_string_type           key       ;
+      std::size_t               hash      ;
+      std::size_t               index     ;
+      bool                      wildcard  ;
+      bool                      selected  ;
+      std::vector<std::size_t>  children  ;
+
+      node ()
+        : hash      (0)
+        , index     (no_index)
+        , wildcard  (false)
+        , selected  (false)
+      {
+      }
+
+      explicit node (doc_string_type const & k)
+        : key       (k)
+        , hash      (details::hash_key (k))
+        , index     (no_index)
+        , wildcard  (k == L"*")
+        , selected  (false)
+      {
+        if (k == L"-" || !details::try_parse__index (k, max_index, index))
+        {
+          index = no_index;
+        }
+      }
+    };
+
+    constexpr static std::size_t no_index   = static_cast<std::size_t> (-1);
+    constexpr static std::size_t max_index  = no_index / 10 - 1;
+
+    // nodes[0] is the root
+    std::vector<node> nodes;
+
+    json_projection ()
+    {
+      nodes.emplace_back ();
+    }
+
+    // Adds a path to the projection, returns false if the pointer is invalid
+    bool add (doc_string_type const & pointer)
+    {
+      std::size_t       pos   ;
+      doc_strings_type  tokens;
+      if (!details::try_parse__pointer (pointer, pos, tokens))
+      {
+        return false;
+      }
+
+      std::size_t current = 0;
+      for (auto && token : tokens)
+      {
+        auto found = false;
+        for (auto && child : nodes[current].children)
+        {
+          if (nodes[child].key == token)
+          {
+            current = child;
+            found   = true;
+            break;
+          }
+        }
+
+        if (!found)
+        {
+          auto next = nodes.size ();
+          nodes.emplace_back (token);
+          nodes[current].children.push_back (next);
+          current = next;
+        }
+      }
+
+      nodes[current].selected = true;
+      return true;
+    }
+  };
+
+  namespace details
+  {
+    // Builds the parts of the document selected by a json_projection, the rest is validated
+    //  As several paths may match (wildcards) the projection is matched like an NFA,
+    //  each container frame holds the range of matching projection nodes in 'states'
+    struct projected_builder_json_context : builder_json_context
+    {
+      using json_decision = cpp_json::parser::json_decision;
+
+      enum class match
+      {
+        none,
+        some,
+        all ,
+      };
+
+      struct frame
+      {
+        std::size_t begin ;
+        std::size_t end   ;
+        bool        all   ;
+        bool        array ;
+        std::size_t index ;
+      };
+
+      json_projection const *   projection  ;
+      std::vector<std::size_t>  states      ;
+      std::vector<frame>        frames      ;
+      match                     pending     ;
+
+      inline explicit projected_builder_json_context (json_memory_resource * resource = json_new_delete_resource ())
+        : builder_json_context  (resource)
+        , projection            (nullptr)
+        , pending               (match::none)
+      {
+        states.reserve (default_size);
+        frames.reserve (default_size);
+      }
+
+      CPP_JSON__NO_COPY_MOVE (projected_builder_json_context);
+
+      void set_projection (json_projection const & p)
+      {
+        projection = &p;
+
+        states.clear ();
+        frames.clear ();
+
+        states.push_back (0);
+        pending = p.nodes[0].selected ? match::all : match::some;
+      }
+
+      template<typename TPredicate>
+      match select (TPredicate && predicate)
+      {
+        CPP_JSON__ASSERT (projection);
+        CPP_JSON__ASSERT (!frames.empty ());
+
+        auto && nodes = projection->nodes;
+        auto && top   = frames.back ();
+
+        states.resize (top.end);
+
+        auto all = false;
+        for (auto iter = top.begin; iter < top.end; ++iter)
+        {
+          for (auto && child : nodes[states[iter]].children)
+          {
+            auto && n = nodes[child];
+            if (predicate (n))
+            {
+              states.push_back (child);
+              all = all || n.selected;
+            }
+          }
+        }
+
+        if (all)
+        {
+          return match::all;
+        }
+        else if (states.size () > top.end)
+        {
+          return match::some;
+        }
+        else
+        {
+          return match::none;
+        }
+      }
+
+      // Matches the next value in the current container
+      match next_value ()
+      {
+        if (frames.empty ())
+        {
+          return pending;
+        }
+
+        auto && top = frames.back ();
+        if (top.all)
+        {
+          return match::all;
+        }
+        else if (top.array)
+        {
+          auto idx = top.index++;
+          return select ([idx] (json_projection::node const & n) { return n.wildcard || n.index == idx; });
+        }
+        else
+        {
+          return pending;
+        }
+      }
+
+      json_decision container_begin (bool array)
+      {
+        auto b = frames.empty () ? 0U : frames.back ().end;
+        auto m = next_value ();
+
+        switch (m)
+        {
+        case match::all:
+          frames.push_back (frame {b, b, true, array, 0});
+          break;
+        case match::some:
+          frames.push_back (frame {b, states.size (), false, array, 0});
+          break;
+        default:
+          return json_decision::validate;
+        }
+
+        return array
+          ? cpp_json::parser::details::to_decision (builder_json_context::array_begin ())
+          : cpp_json::parser::details::to_decision (builder_json_context::object_begin ())
+          ;
+      }
+
+      json_decision array_begin ()
+      {
+        return container_begin (true);
+      }
+
+      bool array_end ()
+      {
+        CPP_JSON__ASSERT (!frames.empty ());
+        frames.pop_back ();
+        return builder_json_context::array_end ();
+      }
+
+      json_decision object_begin ()
+      {
+        return container_begin (false);
+      }
+
+      json_decision member_key (node_string && s)
+      {
+        CPP_JSON__ASSERT (!frames.empty ());
+
+        if (frames.back ().all)
+        {
+          pending = match::all;
+        }
+        else
+        {
+          auto hash = hash_key (s);
+          pending   = select ([hash, &s] (json_projection::node const & n) { return n.wildcard || (n.hash == hash && equal_strings (n.key, s)); });
+        }
+
+        if (pending == match::none)
+        {
+          return json_decision::validate;
+        }
+
+        return cpp_json::parser::details::to_decision (builder_json_context::member_key (std::move (s)));
+      }
+
+      bool object_end ()
+      {
+        CPP_JSON__ASSERT (!frames.empty ());
+        frames.pop_back ();
+        return builder_json_context::object_end ();
+      }
+
+      // Scalars are only built if they are selected
+
+      bool bool_value (bool b)
+      {
+        return next_value () != match::all || builder_json_context::bool_value (b);
+      }
+
+      bool null_value ()
+      {
+        return next_value () != match::all || builder_json_context::null_value ();
+      }
+
+      bool string_value (node_string && s)
+      {
+        return next_value () != match::all || builder_json_context::string_value (std::move (s));
+      }
+
+      bool number_value (double d)
+      {
+        return next_value () != match::all || builder_json_context::number_value (d);
+      }
+    };
+
+    inline json_element::ptr build_lazy (json_document__impl & doc, std::size_t begin, std::size_t end, std::size_t depth, std::size_t min_depth);
+
+    // Builds a document where containers selected by json_lazy_options are deferred
+    //  The input is the document's source or a range of it starting at 'offset'
+    struct lazy_builder_json_context : builder_json_context
+    {
+      using json_decision = cpp_json::parser::json_decision;
+
+      constexpr static std::size_t no_depth = static_cast<std::size_t> (-1);
+
+      std::size_t offset    ; // The position of the input in the document's source
+      std::size_t base      ; // The depth of the first container of the input
+      std::size_t min_depth ; // Containers at least this deep are deferred
+
+      inline lazy_builder_json_context (
+          json_document__impl::tptr doc
+        , std::size_t               offset
+        , std::size_t               base
+        , std::size_t               min_depth
+        )
+        : builder_json_context  (std::move (doc))
+        , offset                (offset)
+        , base                  (base)
+        , min_depth             (min_depth)
+      {
+      }
+
+      CPP_JSON__NO_COPY_MOVE (lazy_builder_json_context);
+
+      // The depth of a container that begins now
+      std::size_t depth () const noexcept
+      {
+        CPP_JSON__ASSERT (!element_context.empty ());
+        return base + element_context.size () - 1;
+      }
+
+      json_decision array_begin ()
+      {
+        return depth () >= min_depth
+          ? json_decision::defer
+          : cpp_json::parser::details::to_decision (builder_json_context::array_begin ())
+          ;
+      }
+
+      json_decision object_begin ()
       {
-        auto v = document->create_string (std::move (s));
-
-        CPP_JSON__ASSERT (!element_context.empty ());
-        auto && back = element_context.back ();
-        CPP_JSON__ASSERT (back);
-        back->add_value (v);
-
-        return true;
+        return depth () >= min_depth
+          ? json_decision::defer
+          : cpp_json::parser::details::to_decision (builder_json_context::object_begin ())
+          ;
       }
 
-      bool number_value (double d)
+      bool deferred_value (bool is_array, std::size_t begin, std::size_t end)
       {
-        auto v = document->create_number (d);
+        auto d = depth ();
+
+        begin += offset;
+        end   += offset;
+
+        // A small container is built right away, its members are smaller still
+        auto v = end - begin < document->lazy_options.min_size
+          ? build_lazy (*document, begin, end, d, no_depth)
+          : document->create_lazy (begin, end, d, is_array)
+          ;
 
         CPP_JSON__ASSERT (!element_context.empty ());
         auto && back = element_context.back ();
@@ -1188,7 +2609,6 @@ namespace cpp_json { namespace document
 
         return true;
       }
-
     };
 
     struct error_json_context
@@ -1321,17 +2741,72 @@ namespace cpp_json { namespace document
     {
       return & doc->null_value;
     }
+
+    // Builds the container in [begin, end) of the source of 'doc', nested containers
+    //  at least min_depth deep are deferred
+    inline json_element::ptr build_lazy (json_document__impl & doc, std::size_t begin, std::size_t end, std::size_t depth, std::size_t min_depth)
+    {
+      auto b = doc.source.data ();
+
+      cpp_json::parser::json_parser<lazy_builder_json_context> jp (
+          b + begin
+        , b + end
+        , std::static_pointer_cast<json_document__impl> (doc.shared_from_this ())
+        , begin
+        , depth
+        , min_depth
+        );
+
+      auto value = std::make_shared<json_element_context__value> (doc);
+      jp.element_context.front () = value;
+
+      // The container was validated when the document was parsed
+      auto result = jp.try_parse__element ();
+      CPP_JSON__ASSERT (result);
+      (void) result;
+
+      CPP_JSON__ASSERT (value->value);
+      return value->value;
+    }
+
+    inline json_element::ptr json_element__lazy::materialize () const
+    {
+      auto v = value.load (std::memory_order_acquire);
+      if (v)
+      {
+        return v;
+      }
+
+      std::lock_guard<std::mutex> lock (doc->lazy_mutex);
+
+      v = value.load (std::memory_order_relaxed);
+      if (!v)
+      {
+        // Documents are never const objects, building adds elements to the document
+        auto && d = const_cast<json_document__impl &> (*doc);
+        v = build_lazy (d, begin, end, depth, depth + 1);
+        value.store (v, std::memory_order_release);
+      }
+
+      return v;
+    }
   }
 
   struct json_parser
   {
     // Parses a JSON string into a JSON document 'result' if successful.
     //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
-    static bool parse (doc_string_type const & json, std::size_t & pos, json_document::ptr & result)
+    //  The document is allocated from 'resource' which must outlive it
+    static bool parse (
+        doc_string_type const & json
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
     {
       auto begin  = json.data ()        ;
       auto end    = begin + json.size ();
-      cpp_json::parser::json_parser<details::builder_json_context> jp (begin, end);
+      cpp_json::parser::json_parser<details::builder_json_context> jp (begin, end, resource);
 
       if (jp.try_parse__json ())
       {
@@ -1347,14 +2822,181 @@ namespace cpp_json { namespace document
       }
     }
 
+    // Parses a JSON string into a JSON document 'result' if successful.
+    //  'instrumentation' is an instrumentation policy (see cpp_json__instrumentation.hpp),
+    //  its state is copied into the parser and back after parsing
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    //  The document is allocated from 'resource' which must outlive it
+    template<typename TInstrumentation>
+    static bool parse_instrumented (
+        doc_string_type const & json
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , TInstrumentation &      instrumentation
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
+    {
+      auto begin  = json.data ()        ;
+      auto end    = begin + json.size ();
+      cpp_json::parser::json_parser<details::builder_json_context, TInstrumentation> jp (begin, end, resource);
+      jp.instrumentation () = instrumentation;
+
+      auto presult = jp.try_parse__json ();
+
+      instrumentation = jp.instrumentation ();
+      pos             = jp.pos ();
+
+      if (presult)
+      {
+        result  = jp.document;
+        return true;
+      }
+      else
+      {
+        result.reset ();
+        return false;
+      }
+    }
+
     // Parses a JSON string into a JSON document 'result' if successful.
     //  If parse fails 'error' contains an error description.
     //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
-    static bool parse (doc_string_type const & json, std::size_t & pos, json_document::ptr & result, doc_string_type & error)
+    //  The document is allocated from 'resource' which must outlive it
+    static bool parse (
+        doc_string_type const & json
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , doc_string_type &       error
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
+    {
+      auto begin  = json.data ()        ;
+      auto end    = begin + json.size ();
+      cpp_json::parser::json_parser<details::builder_json_context> jp (begin, end, resource);
+
+      if (jp.try_parse__json ())
+      {
+        pos     = jp.pos ();
+        result  = jp.document;
+        return true;
+      }
+      else
+      {
+        pos = jp.pos ();
+        result.reset ();
+        error = create_error (json, pos);
+        return false;
+      }
+    }
+
+    // Parses the parts of a JSON string selected by 'projection' into a JSON document 'result' if successful.
+    //  The whole JSON string is validated.
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    //  The document is allocated from 'resource' which must outlive it
+    static bool parse (
+        doc_string_type const & json
+      , json_projection const & projection
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
     {
       auto begin  = json.data ()        ;
       auto end    = begin + json.size ();
-      cpp_json::parser::json_parser<details::builder_json_context> jp (begin, end);
+      cpp_json::parser::json_parser<details::projected_builder_json_context> jp (begin, end, resource);
+      jp.set_projection (projection);
+
+      if (jp.try_parse__json ())
+      {
+        pos     = jp.pos ();
+        result  = jp.document;
+        return true;
+      }
+      else
+      {
+        pos = jp.pos ();
+        result.reset ();
+        return false;
+      }
+    }
+
+    // Parses the parts of a JSON string selected by 'projection' into a JSON document 'result' if successful.
+    //  The whole JSON string is validated.
+    //  If parse fails 'error' contains an error description.
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    //  The document is allocated from 'resource' which must outlive it
+    static bool parse (
+        doc_string_type const & json
+      , json_projection const & projection
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , doc_string_type &       error
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
+    {
+      if (parse (json, projection, pos, result, resource))
+      {
+        return true;
+      }
+      else
+      {
+        error = create_error (json, pos);
+        return false;
+      }
+    }
+
+    // Parses a JSON string into a JSON document 'result' if successful.
+    //  The whole JSON string is validated but containers selected by 'options' are
+    //  only built when accessed, the document keeps a copy of the JSON string for them.
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    //  The document is allocated from 'resource' which must outlive it
+    static bool parse (
+        doc_string_type const &   json
+      , json_lazy_options const & options
+      , std::size_t &             pos
+      , json_document::ptr &      result
+      , json_memory_resource *    resource = json_new_delete_resource ()
+      )
+    {
+      auto document = details::json_document__impl::create_document (resource);
+      document->source.assign (json.data (), json.size ());
+      document->lazy_options = options;
+
+      auto begin  = document->source.data ()        ;
+      auto end    = begin + document->source.size ();
+      cpp_json::parser::json_parser<details::lazy_builder_json_context> jp (begin, end, document, 0, 0, options.depth);
+
+      if (jp.try_parse__json ())
+      {
+        pos     = jp.pos ();
+        result  = std::move (document);
+        return true;
+      }
+      else
+      {
+        pos = jp.pos ();
+        result.reset ();
+        return false;
+      }
+    }
+
+    // Parses JSON in [begin, end) into a JSON document 'result' if successful.
+    //  The input is UTF-8 encoded char or doc_char_type, TIter is a pointer or
+    //  an input "iterator" such as json_block_iterator
+    //  'pos' indicates the first non-consumed char (which may lay beyond the last char of the input)
+    //  The document is allocated from 'resource' which must outlive it
+    template<typename TIter>
+    static bool parse (
+        TIter                   begin
+      , TIter                   end
+      , std::size_t &           pos
+      , json_document::ptr &    result
+      , json_memory_resource *  resource = json_new_delete_resource ()
+      )
+    {
+      using char_type = typename std::remove_cv<typename std::iterator_traits<TIter>::value_type>::type;
+
+      cpp_json::parser::json_parser<details::basic_builder_json_context<char_type, TIter>> jp (begin, end, resource);
 
       if (jp.try_parse__json ())
       {
@@ -1366,111 +3008,349 @@ namespace cpp_json { namespace document
       {
         pos = jp.pos ();
         result.reset ();
+        return false;
+      }
+    }
+
+  private:
+    // Creates an error description for a JSON string that failed to parse at 'pos'
+    static doc_string_type create_error (doc_string_type const & json, std::size_t pos)
+    {
+      auto begin  = json.data ()        ;
+      auto end    = begin + json.size ();
 
-        cpp_json::parser::json_parser<details::error_json_context> ejp (begin, end);
-        ejp.error_pos = jp.pos ();
-        auto eresult  = ejp.try_parse__json ();
-        CPP_JSON__ASSERT (!eresult);
+      cpp_json::parser::json_parser<details::error_json_context> ejp (begin, end);
+      ejp.error_pos = pos;
+      auto eresult  = ejp.try_parse__json ();
+      CPP_JSON__ASSERT (!eresult);
 
-        auto sz = ejp.exp_chars.size () + ejp.exp_tokens.size ();
+      auto sz = ejp.exp_chars.size () + ejp.exp_tokens.size ();
 
-        std::vector<doc_string_type> expected   = std::move (ejp.exp_tokens);
-        std::vector<doc_string_type> unexpected = std::move (ejp.unexp_tokens);
+      std::vector<doc_string_type> expected   = std::move (ejp.exp_tokens);
+      std::vector<doc_string_type> unexpected = std::move (ejp.unexp_tokens);
 
-        expected.reserve (sz);
+      expected.reserve (sz);
 
-        for (auto ch : ejp.exp_chars)
-        {
-          details::error_json_context::char_type token[] = {'\'', ch, '\'', 0};
-          expected.push_back (doc_string_type (token));
-        }
+      for (auto ch : ejp.exp_chars)
+      {
+        details::error_json_context::char_type token[] = {'\'', ch, '\'', 0};
+        expected.push_back (doc_string_type (token));
+      }
+
+      std::sort (expected.begin (), expected.end ());
+      std::sort (unexpected.begin (), unexpected.end ());
+
+      expected.erase (std::unique (expected.begin (), expected.end ()), expected.end ());
+      unexpected.erase (std::unique (unexpected.begin (), unexpected.end ()), unexpected.end ());
+
+      doc_string_type msg;
 
-        std::sort (expected.begin (), expected.end ());
-        std::sort (unexpected.begin (), unexpected.end ());
+      auto newline = [&msg] ()
+      {
+        msg += L'\n';
+      };
+
+      msg += L"Failed to parse input as JSON";
 
-        expected.erase (std::unique (expected.begin (), expected.end ()), expected.end ());
-        unexpected.erase (std::unique (unexpected.begin (), unexpected.end ()), unexpected.end ());
+      newline ();
 
-        doc_string_type msg;
+      auto left   = pos < details::hwindow_size ? 0U : pos - details::hwindow_size;
+      auto right  = std::min (json.size (), left + details::window_size);
+      auto apos   = pos - left;
 
-        auto newline = [&msg] ()
+      for (auto iter = left; iter < right; ++iter)
+      {
+        auto c = json[iter];
+        if (c < ' ')
+        {
+          msg += ' ';
+        }
+        else
         {
-          msg += L'\n';
-        };
+          msg += c;
+        }
+      }
 
-        msg += L"Failed to parse input as JSON";
+      newline ();
+      for (auto iter = 0U; iter < apos; ++iter)
+      {
+        msg += L'-';
+      }
+      msg += L"^ Pos: ";
 
-        newline ();
+      {
+        constexpr auto bsz = 12U;
+        wchar_t spos[bsz]  = {};
+        std::swprintf (spos, bsz, L"%zd", pos);
+        msg += spos;
+      }
 
-        auto left   = pos < details::hwindow_size ? 0U : pos - details::hwindow_size;
-        auto right  = std::min (json.size (), left + details::window_size);
-        auto apos   = pos - left;
+      auto append = [&msg, &newline] (wchar_t const * prepend, std::vector<doc_string_type> const & vs)
+      {
+        CPP_JSON__ASSERT (prepend);
 
-        for (auto iter = left; iter < right; ++iter)
+        if (!vs.empty ())
         {
-          auto c = json[iter];
-          if (c < ' ')
-          {
-            msg += ' ';
-          }
-          else
+          newline ();
+          msg += prepend;
+
+          auto sz = vs.size();
+          for (auto iter = 0U; iter < sz; ++iter)
           {
-            msg += c;
+            if (iter == 0U)
+            {
+            }
+            else if (iter + 1U == sz)
+            {
+              msg += L" or ";
+            }
+            else
+            {
+              msg += L", ";
+            }
+            msg += vs[iter];
           }
         }
+      };
+
+      append (L"Expected: "   , expected);
+      append (L"Unexpected: " , unexpected);
+
+      return msg;
+    }
+  };
+
+  // json_parse_session parses many JSON strings reusing its scratch buffers (element
+  //  contexts, context stacks and the string buffer), json_parser::parse creates
+  //  them for each call.
+  //
+  //  If 'reuse_documents' is true the session keeps the last document and, if the
+  //  caller has released all references to it (including documents derived
+  //  from it), reuses its storage for the next parse. Otherwise a new document is
+  //  created. So release the previous document before the next parse to benefit.
+  //
+  //  Documents are allocated from 'resource' which must outlive the session and the documents.
+  //
+  //  A session must not be used concurrently
+  struct json_parse_session
+  {
+    explicit json_parse_session (
+        bool                    reuse_documents = false
+      , json_memory_resource *  resource        = json_new_delete_resource ()
+      )
+      : parser          (nullptr, nullptr, resource)
+      , reuse_documents (reuse_documents)
+    {
+    }
+
+    CPP_JSON__NO_COPY_MOVE (json_parse_session);
+
+    // Parses a JSON string into a JSON document 'result' if successful.
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    bool parse (doc_string_type const & json, std::size_t & pos, json_document::ptr & result)
+    {
+      reset ();
+
+      parser.reset (json.c_str (), json.c_str () + json.size ());
+
+      if (parser.try_parse__json ())
+      {
+        pos     = parser.pos ();
+        result  = parser.document;
+        return true;
+      }
+      else
+      {
+        pos = parser.pos ();
+        result.reset ();
+        return false;
+      }
+    }
+
+    // Parses a JSON string into a JSON document 'result' if successful.
+    //  If parse fails 'error' contains an error description.
+    //  'pos' indicates the first non-consumed character (which may lay beyond the last character in the input string)
+    bool parse (doc_string_type const & json, std::size_t & pos, json_document::ptr & result, doc_string_type & error)
+    {
+      if (parse (json, pos, result))
+      {
+        return true;
+      }
+      else
+      {
+        // Failures are rare, so the error is created by parsing again
+        return json_parser::parse (json, pos, result, error, parser.document->resource);
+      }
+    }
+
+    // Prepares the session for the next parse, invoked by parse
+    //  Releases the session's reference to the last document unless it's reused
+    void reset ()
+    {
+      auto && document = parser.document;
+      if (reuse_documents && document && document.use_count () == 1)
+      {
+        document->clear ();
+        parser.reset_document (std::move (document));
+      }
+      else
+      {
+        parser.reset_document ();
+      }
+    }
+
+  private:
+    using builder_parser = cpp_json::parser::json_parser<details::builder_json_context>;
+
+    builder_parser  parser          ;
+    bool const      reuse_documents ;
+  };
+
+  // basic_json_array_reader parses the elements of a root array one at a time
+  //  Each element is returned as a standalone json_document (the element is the root).
+  //  Only the current element is built so peak memory is bounded by the largest element
+  //  rather than the whole input. The input is any contiguous range, for example an
+  //  in-memory buffer or a memory mapped file.
+  //  TChar is doc_char_type or char (UTF-8)
+  template<typename TChar>
+  struct basic_json_array_reader
+  {
+    using char_type = TChar             ;
+    using iter_type = char_type const * ;
+
+    inline basic_json_array_reader (iter_type begin, iter_type end) noexcept
+      : begin   (begin)
+      , end     (end)
+      , current (begin)
+      , state   (state_type::start)
+    {
+    }
+
+    CPP_JSON__NO_COPY_MOVE (basic_json_array_reader);
+
+    // Reads the next element into 'result'
+    //  Returns false at the end of the array or if parse fails
+    //  The previous document held by 'result' is released before the next element is parsed
+    bool next (json_document::ptr & result)
+    {
+      result.reset ();
 
-        newline ();
-        for (auto iter = 0U; iter < apos; ++iter)
+      switch (state)
+      {
+      case state_type::start:
+        consume__white_space ();
+        if (!try_consume__char ('['))
         {
-          msg += L'-';
+          return fail ();
         }
-        msg += L"^ Pos: ";
+        consume__white_space ();
+        state = state_type::first;
+        break;
+      case state_type::first:
+      case state_type::rest:
+        break;
+      default:
+        return false;
+      }
 
+      consume__white_space ();
+
+      if (current < end && *current == ']')
+      {
+        ++current;
+        consume__white_space ();
+        if (current < end)
         {
-          constexpr auto bsz = 12U;
-          wchar_t spos[bsz]  = {};
-          std::swprintf (spos, bsz, L"%zd", pos);
-          msg += spos;
+          return fail ();
         }
+        state = state_type::done;
+        return false;
+      }
 
-        auto append = [&msg, &newline] (wchar_t const * prepend, std::vector<doc_string_type> const & vs)
-        {
-          CPP_JSON__ASSERT (prepend);
+      if (state == state_type::rest && !try_consume__char (','))
+      {
+        return fail ();
+      }
 
-          if (!vs.empty ())
-          {
-            newline ();
-            msg += prepend;
+      cpp_json::parser::json_parser<details::basic_builder_json_context<char_type>> jp (current, end);
 
-            auto sz = vs.size();
-            for (auto iter = 0U; iter < sz; ++iter)
-            {
-              if (iter == 0U)
-              {
-              }
-              else if (iter + 1U == sz)
-              {
-                msg += L" or ";
-              }
-              else
-              {
-                msg += L", ";
-              }
-              msg += vs[iter];
-            }
-          }
-        };
+      auto presult = jp.try_parse__element ();
+      current += jp.pos ();
+
+      if (!presult)
+      {
+        return fail ();
+      }
+
+      state   = state_type::rest;
+      result  = jp.document;
+      return true;
+    }
+
+    // Returns true if parse failed
+    bool failed () const noexcept
+    {
+      return state == state_type::failed;
+    }
+
+    // Returns true if the whole array has been read
+    bool done () const noexcept
+    {
+      return state == state_type::done;
+    }
+
+    // Gets the current position, if parse failed it's the position of the error
+    std::size_t pos () const noexcept
+    {
+      return static_cast<std::size_t> (current - begin);
+    }
+
+  private:
+    enum class state_type
+    {
+      start ,
+      first ,
+      rest  ,
+      done  ,
+      failed,
+    };
 
-        append (L"Expected: "   , expected);
-        append (L"Unexpected: " , unexpected);
+    iter_type const begin   ;
+    iter_type const end     ;
+    iter_type       current ;
+    state_type      state   ;
+
+    inline bool fail () noexcept
+    {
+      state = state_type::failed;
+      return false;
+    }
 
-        error = std::move (msg);
+    inline void consume__white_space () noexcept
+    {
+      while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+      {
+        ++current;
+      }
+    }
 
+    inline bool try_consume__char (char c) noexcept
+    {
+      if (current < end && *current == c)
+      {
+        ++current;
+        return true;
+      }
+      else
+      {
         return false;
       }
     }
   };
 
+  using json_array_reader       = basic_json_array_reader<doc_char_type>;
+  using json_utf8_array_reader  = basic_json_array_reader<char>         ;
+
 } }
 
 #endif  // CPP_JSON__DOCUMENT_H
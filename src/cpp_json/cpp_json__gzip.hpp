@@ -0,0 +1,158 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__GZIP_H
+#define CPP_JSON__GZIP_H
+
+// Requires zlib, define CPP_JSON__ZLIB and link with zlib to use json_gzip_source
+#ifdef CPP_JSON__ZLIB
+
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+
+#include "cpp_json__stream.hpp"
+
+namespace cpp_json { namespace parser
+{
+  // json_gzip_source decompresses gzip (or zlib) input read from another source
+  //  Used as the source of a json_block_stream the input is decompressed in blocks
+  //  on the background thread of the stream while the parser consumes earlier
+  //  blocks, so the decompressed input is never held in memory as a whole.
+  //  Memory used is the compressed buffer, the inflate window (32 KiB) and the
+  //  blocks of the stream.
+  //  Concatenated gzip members (as produced by appending gzip files) are supported.
+  //  If the compressed input is corrupt read returns 0 (end of input) and failed
+  //  returns true, the parser then reports an error at the end of the decompressed input.
+  struct json_gzip_source : json_block_source
+  {
+    constexpr static std::size_t default_buffer_size = 1 << 16;
+
+    explicit json_gzip_source (
+        json_block_source & compressed
+      , std::size_t         buffer_size = default_buffer_size
+      )
+      : compressed  (compressed)
+      , buffer      (buffer_size > 0 ? buffer_size : default_buffer_size)
+      , done        (false)
+      , error       (false)
+      , input_eof   (false)
+    {
+      std::memset (&zs, 0, sizeof (zs));
+
+      // 15 + 32 detects gzip and zlib headers automatically
+      if (inflateInit2 (&zs, 15 + 32) != Z_OK)
+      {
+        error = true;
+        done  = true;
+      }
+    }
+
+    ~json_gzip_source ()
+    {
+      inflateEnd (&zs);
+    }
+
+    // Returns true if the compressed input was corrupt or truncated
+    bool failed () const noexcept
+    {
+      return error;
+    }
+
+    std::size_t read (char * output, std::size_t size) override
+    {
+      if (done || size == 0)
+      {
+        return 0;
+      }
+
+      zs.next_out   = reinterpret_cast<Bytef *> (output);
+      zs.avail_out  = static_cast<uInt> (size);
+
+      while (zs.avail_out > 0)
+      {
+        if (zs.avail_in == 0 && !refill ())
+        {
+          // Compressed input ended before the end of the gzip member
+          error = true;
+          done  = true;
+          break;
+        }
+
+        auto result = inflate (&zs, Z_NO_FLUSH);
+
+        if (result == Z_STREAM_END)
+        {
+          // Another gzip member may follow
+          if (zs.avail_in == 0 && !refill ())
+          {
+            done = true;
+            break;
+          }
+
+          if (inflateReset (&zs) != Z_OK)
+          {
+            error = true;
+            done  = true;
+            break;
+          }
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+          error = true;
+          done  = true;
+          break;
+        }
+      }
+
+      return size - zs.avail_out;
+    }
+
+  private:
+    json_block_source & compressed;
+    std::vector<char>   buffer    ;
+    z_stream            zs        ;
+    bool                done      ;
+    bool                error     ;
+    bool                input_eof ;
+
+    bool refill ()
+    {
+      if (input_eof)
+      {
+        return false;
+      }
+
+      auto read = compressed.read (buffer.data (), buffer.size ());
+      if (read == 0)
+      {
+        input_eof = true;
+        return false;
+      }
+
+      zs.next_in  = reinterpret_cast<Bytef *> (buffer.data ());
+      zs.avail_in = static_cast<uInt> (read);
+
+      return true;
+    }
+  };
+
+} }
+
+#endif  // CPP_JSON__ZLIB
+
+#endif  // CPP_JSON__GZIP_H
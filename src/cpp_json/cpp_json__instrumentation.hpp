@@ -0,0 +1,181 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__INSTRUMENTATION_H
+#define CPP_JSON__INSTRUMENTATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+# define CPP_JSON__RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+# include <x86intrin.h>
+# define CPP_JSON__RDTSC
+#else
+# include <chrono>
+#endif
+
+#include "cpp_json__parser.hpp"
+
+namespace cpp_json { namespace parser
+{
+  // Instrumentation policies for json_parser, see json_no_instrumentation
+
+  // true if json_timestamp returns cycles, otherwise it returns nanoseconds
+#ifdef CPP_JSON__RDTSC
+  constexpr bool json_timestamp_is_cycles = true;
+#else
+  constexpr bool json_timestamp_is_cycles = false;
+#endif
+
+  // Reads the time stamp counter, falls back on a steady clock when rdtsc isn't available
+  inline std::uint64_t json_timestamp () noexcept
+  {
+#ifdef CPP_JSON__RDTSC
+    return __rdtsc ();
+#else
+    return static_cast<std::uint64_t> (
+      std::chrono::duration_cast<std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now ().time_since_epoch ()
+      ).count ());
+#endif
+  }
+
+  // Counts bytes per token class, strings, numbers, literals and containers
+  //  Bytes not attributed to a class are structure (brackets, commas and colons)
+  struct json_counting_instrumentation : json_no_instrumentation
+  {
+    std::size_t white_space_bytes     = 0;
+    std::size_t string_bytes          = 0;
+    std::size_t number_bytes          = 0;
+    std::size_t literal_bytes         = 0;
+
+    std::size_t plain_strings         = 0;  // Strings without escapes, can be copied as is
+    std::size_t escaped_strings       = 0;
+    std::size_t escapes               = 0;
+    std::size_t numbers               = 0;
+    std::size_t literals              = 0;
+
+    std::size_t arrays                = 0;
+    std::size_t objects               = 0;
+    std::size_t array_values          = 0;
+    std::size_t object_members        = 0;
+    std::size_t max_array_size        = 0;
+    std::size_t max_object_size       = 0;
+    std::size_t max_depth             = 0;
+
+    inline void white_space (std::size_t chars) noexcept
+    {
+      white_space_bytes += chars;
+    }
+
+    inline void string (std::size_t chars, std::size_t string_escapes) noexcept
+    {
+      string_bytes  += chars;
+      escapes       += string_escapes;
+      if (string_escapes > 0)
+      {
+        ++escaped_strings;
+      }
+      else
+      {
+        ++plain_strings;
+      }
+    }
+
+    inline void number (std::size_t chars) noexcept
+    {
+      number_bytes += chars;
+      ++numbers;
+    }
+
+    inline void literal (std::size_t chars) noexcept
+    {
+      literal_bytes += chars;
+      ++literals;
+    }
+
+    inline void container_begin (bool /*is_array*/) noexcept
+    {
+      ++depth;
+      if (depth > max_depth)
+      {
+        max_depth = depth;
+      }
+    }
+
+    inline void container_end (bool is_array, std::size_t size) noexcept
+    {
+      --depth;
+      if (is_array)
+      {
+        ++arrays;
+        array_values += size;
+        if (size > max_array_size)
+        {
+          max_array_size = size;
+        }
+      }
+      else
+      {
+        ++objects;
+        object_members += size;
+        if (size > max_object_size)
+        {
+          max_object_size = size;
+        }
+      }
+    }
+
+  private:
+    std::size_t depth                 = 0;
+  };
+
+  // Counts like json_counting_instrumentation and accumulates the time spent in
+  //  each phase (cycles if json_timestamp_is_cycles, otherwise nanoseconds)
+  //  Reading the time stamp around every token is expensive, the timed parse is
+  //  noticeably slower than an uninstrumented parse so compare phases to each other
+  //  rather than to other runs.
+  struct json_cycle_instrumentation : json_counting_instrumentation
+  {
+    constexpr static std::size_t phase_count = static_cast<std::size_t> (json_phase::context) + 1;
+
+    std::uint64_t phase_ticks [phase_count] = {};
+
+    inline std::uint64_t ticks (json_phase phase) const noexcept
+    {
+      return phase_ticks[static_cast<std::size_t> (phase)];
+    }
+
+    inline void phase_begin (json_phase /*phase*/) noexcept
+    {
+      start = json_timestamp ();
+    }
+
+    inline void phase_end (json_phase phase) noexcept
+    {
+      phase_ticks[static_cast<std::size_t> (phase)] += json_timestamp () - start;
+    }
+
+  private:
+    std::uint64_t start = 0;
+  };
+
+} }
+
+#endif  // CPP_JSON__INSTRUMENTATION_H
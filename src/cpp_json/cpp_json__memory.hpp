@@ -0,0 +1,302 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__MEMORY_H
+#define CPP_JSON__MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "cpp_json__parser.hpp"
+
+namespace cpp_json { namespace document
+{
+  // json_memory_resource supplies the storage of JSON documents
+  //  The interface follows C++17 std::pmr::memory_resource so a pmr resource is
+  //  adapted by forwarding the three virtual functions.
+  //  A resource must outlive all documents allocated from it.
+  struct json_memory_resource
+  {
+    constexpr static std::size_t max_align = alignof (std::max_align_t);
+
+    json_memory_resource ()           = default;
+    virtual ~json_memory_resource ()  = default;
+
+    inline void * allocate (std::size_t bytes, std::size_t alignment = max_align)
+    {
+      return do_allocate (bytes, alignment);
+    }
+
+    inline void deallocate (void * p, std::size_t bytes, std::size_t alignment = max_align)
+    {
+      do_deallocate (p, bytes, alignment);
+    }
+
+    inline bool is_equal (json_memory_resource const & other) const noexcept
+    {
+      return this == &other || do_is_equal (other);
+    }
+
+  protected:
+    virtual void * do_allocate    (std::size_t bytes, std::size_t alignment)          = 0;
+    virtual void   do_deallocate  (void * p, std::size_t bytes, std::size_t alignment) = 0;
+    virtual bool   do_is_equal    (json_memory_resource const & other) const noexcept = 0;
+  };
+
+  inline bool operator== (json_memory_resource const & l, json_memory_resource const & r) noexcept
+  {
+    return l.is_equal (r);
+  }
+
+  inline bool operator!= (json_memory_resource const & l, json_memory_resource const & r) noexcept
+  {
+    return !l.is_equal (r);
+  }
+
+  namespace details
+  {
+    struct new_delete_resource : json_memory_resource
+    {
+    protected:
+      void * do_allocate (std::size_t bytes, std::size_t alignment) override
+      {
+        // C++11 operator new doesn't support extended alignments
+        CPP_JSON__ASSERT (alignment <= max_align);
+        (void) alignment;
+        return ::operator new (bytes);
+      }
+
+      void do_deallocate (void * p, std::size_t /*bytes*/, std::size_t /*alignment*/) override
+      {
+        ::operator delete (p);
+      }
+
+      bool do_is_equal (json_memory_resource const & other) const noexcept override
+      {
+        return dynamic_cast<new_delete_resource const *> (&other) != nullptr;
+      }
+    };
+  }
+
+  // The default resource, uses operator new and delete
+  inline json_memory_resource * json_new_delete_resource () noexcept
+  {
+    static details::new_delete_resource resource;
+    return &resource;
+  }
+
+  // json_monotonic_resource hands out memory from a buffer and releases it all at once
+  //  Useful as a per-request arena: documents allocated from it are cheap to build
+  //  and destroy, the memory is returned when the resource is destroyed or released.
+  //  Starts with an optional caller supplied buffer, then takes geometrically
+  //  growing chunks from the upstream resource.
+  //  Not thread safe.
+  struct json_monotonic_resource : json_memory_resource
+  {
+    constexpr static std::size_t default_chunk_size = 1 << 12;
+
+    explicit json_monotonic_resource (json_memory_resource * upstream = json_new_delete_resource ()) noexcept
+      : json_monotonic_resource (nullptr, 0, upstream)
+    {
+    }
+
+    json_monotonic_resource (
+        void *                  buffer
+      , std::size_t             size
+      , json_memory_resource *  upstream = json_new_delete_resource ()
+      ) noexcept
+      : upstream        (upstream)
+      , initial_buffer  (static_cast<char *> (buffer))
+      , initial_size    (size)
+      , current         (initial_buffer)
+      , remaining       (size)
+      , first_size      (size > default_chunk_size ? size : default_chunk_size)
+      , next_size       (first_size)
+      , chunks          (nullptr)
+      , upstream_bytes  (0)
+    {
+      CPP_JSON__ASSERT (upstream);
+    }
+
+    ~json_monotonic_resource ()
+    {
+      release ();
+    }
+
+    json_monotonic_resource (json_monotonic_resource const &)             = delete;
+    json_monotonic_resource & operator= (json_monotonic_resource const &) = delete;
+
+    // Returns all chunks to the upstream resource, the initial buffer is reused
+    //  and chunk sizes start over
+    void release () noexcept
+    {
+      while (chunks)
+      {
+        auto c = chunks;
+        chunks = c->prev;
+        upstream->deallocate (c, c->size);
+      }
+
+      current         = initial_buffer;
+      remaining       = initial_size  ;
+      next_size       = first_size    ;
+      upstream_bytes  = 0             ;
+    }
+
+    // The number of bytes taken from the upstream resource
+    std::size_t upstream_allocated () const noexcept
+    {
+      return upstream_bytes;
+    }
+
+  protected:
+    void * do_allocate (std::size_t bytes, std::size_t alignment) override
+    {
+      if (auto p = try_allocate (bytes, alignment))
+      {
+        return p;
+      }
+
+      auto size = sizeof (chunk) + bytes + alignment;
+      while (next_size < size)
+      {
+        next_size <<= 1;
+      }
+
+      auto c  = static_cast<chunk *> (upstream->allocate (next_size));
+      c->prev = chunks;
+      c->size = next_size;
+      chunks  = c;
+
+      upstream_bytes  += next_size;
+      current         = reinterpret_cast<char *> (c + 1);
+      remaining       = next_size - sizeof (chunk);
+      next_size       <<= 1;
+
+      auto p = try_allocate (bytes, alignment);
+      CPP_JSON__ASSERT (p);
+      return p;
+    }
+
+    void do_deallocate (void * /*p*/, std::size_t /*bytes*/, std::size_t /*alignment*/) override
+    {
+    }
+
+    bool do_is_equal (json_memory_resource const & other) const noexcept override
+    {
+      return this == &other;
+    }
+
+  private:
+    // Aligned so the memory following the header is aligned
+    struct alignas (std::max_align_t) chunk
+    {
+      chunk *     prev;
+      std::size_t size;
+    };
+
+    json_memory_resource *  upstream        ;
+    char *                  initial_buffer  ;
+    std::size_t             initial_size    ;
+    char *                  current         ;
+    std::size_t             remaining       ;
+    std::size_t const       first_size      ;
+    std::size_t             next_size       ;
+    chunk *                 chunks          ;
+    std::size_t             upstream_bytes  ;
+
+    void * try_allocate (std::size_t bytes, std::size_t alignment) noexcept
+    {
+      auto address  = reinterpret_cast<std::uintptr_t> (current);
+      auto padding  = (alignment - address % alignment) % alignment;
+
+      if (padding + bytes > remaining)
+      {
+        return nullptr;
+      }
+
+      auto result = current + padding;
+      current   += padding + bytes;
+      remaining -= padding + bytes;
+
+      return result;
+    }
+  };
+
+  // json_allocator is a standard allocator that allocates from a json_memory_resource
+  //  Like std::pmr::polymorphic_allocator but propagates on container copy, move and swap
+  //  so that reused containers follow the document they are moved to
+  template<typename T>
+  struct json_allocator
+  {
+    using value_type                              = T             ;
+    using propagate_on_container_copy_assignment  = std::true_type;
+    using propagate_on_container_move_assignment  = std::true_type;
+    using propagate_on_container_swap             = std::true_type;
+
+    json_allocator () noexcept
+      : res (json_new_delete_resource ())
+    {
+    }
+
+    json_allocator (json_memory_resource * r) noexcept
+      : res (r)
+    {
+      CPP_JSON__ASSERT (res);
+    }
+
+    template<typename U>
+    json_allocator (json_allocator<U> const & other) noexcept
+      : res (other.resource ())
+    {
+    }
+
+    T * allocate (std::size_t n)
+    {
+      return static_cast<T *> (res->allocate (n * sizeof (T), alignof (T)));
+    }
+
+    void deallocate (T * p, std::size_t n) noexcept
+    {
+      res->deallocate (p, n * sizeof (T), alignof (T));
+    }
+
+    json_memory_resource * resource () const noexcept
+    {
+      return res;
+    }
+
+  private:
+    json_memory_resource * res;
+  };
+
+  template<typename T, typename U>
+  inline bool operator== (json_allocator<T> const & l, json_allocator<U> const & r) noexcept
+  {
+    return *l.resource () == *r.resource ();
+  }
+
+  template<typename T, typename U>
+  inline bool operator!= (json_allocator<T> const & l, json_allocator<U> const & r) noexcept
+  {
+    return !(l == r);
+  }
+
+} }
+
+#endif  // CPP_JSON__MEMORY_H
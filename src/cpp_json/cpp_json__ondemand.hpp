@@ -0,0 +1,462 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__ONDEMAND_H
+#define CPP_JSON__ONDEMAND_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpp_json__reader.hpp"
+
+namespace cpp_json { namespace parser
+{
+  // basic_json_ondemand is a view of a JSON document that parses while it's navigated
+  //
+  //    json_ondemand doc (begin, end);
+  //    auto id = doc[L"user"][L"id"].as_int64 ();
+  //
+  //  Navigation moves a basic_json_reader forward over the input. Only the tokens
+  //  passed on the way to a value are parsed, members and elements that aren't
+  //  needed are skipped with the fast skip kernels (which only check brackets and
+  //  strings) and no nodes are allocated.
+  //
+  //  The input is read once, front to back, so:
+  //    members must be looked up in the order they appear in the document,
+  //      looking up a member that was already passed returns an invalid value
+  //    array elements must be accessed in increasing index order
+  //    a value is valid until the cursor moves past it, scalar values are passed
+  //      as soon as another value is accessed
+  //  Accessing an invalid value returns an invalid value or the default value.
+  //
+  //  The input must outlive the view, TIter is as for basic_json_reader.
+  template<typename TChar, typename TIter = TChar const *>
+  struct basic_json_ondemand
+  {
+    using char_type   = TChar                             ;
+    using string_type = std::basic_string<char_type>      ;
+    using iter_type   = TIter                             ;
+    using reader_type = basic_json_reader<TChar, TIter>   ;
+
+    // A value in the document, cheap to copy
+    struct value
+    {
+      value () noexcept
+        : owner (nullptr)
+        , stamp (0)
+        , depth (0)
+        , kind  (json_token::error)
+      {
+      }
+
+      // The kind of value, array_begin/object_begin for containers
+      //  json_token::error if the value is invalid
+      json_token token () const noexcept
+      {
+        return is_valid () ? kind : json_token::error;
+      }
+
+      // Returns true if the value was found and hasn't been passed by the cursor
+      bool is_valid () const noexcept
+      {
+        return owner && (is_container () ? owner->is_open (depth, stamp) : owner->sequence == stamp);
+      }
+
+      // Finds the member 'name' of an object
+      value operator[] (string_type const & name) const
+      {
+        return owner && kind == json_token::object_begin && owner->is_open (depth, stamp)
+          ? owner->find (depth, name)
+          : value ()
+          ;
+      }
+
+      value operator[] (char_type const * name) const
+      {
+        return (*this)[string_type (name)];
+      }
+
+      // Gets the element at 'idx' of an array
+      value at (std::size_t idx) const
+      {
+        return owner && kind == json_token::array_begin && owner->is_open (depth, stamp)
+          ? owner->element (depth, idx)
+          : value ()
+          ;
+      }
+
+      // Invokes action (value) for each remaining element of an array
+      //  Returns false if the value isn't an array or if the input is invalid
+      template<typename TAction>
+      bool for_each_element (TAction && action) const
+      {
+        return owner && kind == json_token::array_begin && owner->is_open (depth, stamp)
+          ? owner->for_each (depth, [&action] (basic_json_ondemand & o, json_token t) { action (o.make_value (t)); })
+          : false
+          ;
+      }
+
+      // Invokes action (string_type const & name, value) for each remaining member of an object
+      //  Returns false if the value isn't an object or if the input is invalid
+      template<typename TAction>
+      bool for_each_member (TAction && action) const
+      {
+        return owner && kind == json_token::object_begin && owner->is_open (depth, stamp)
+          ? owner->for_each (depth, [&action] (basic_json_ondemand & o, json_token)
+              {
+                o.key = o.reader.string ();
+                action (static_cast<string_type const &> (o.key), o.make_value (o.advance ()));
+              })
+          : false
+          ;
+      }
+
+      bool is_null () const noexcept
+      {
+        return token () == json_token::null_value;
+      }
+
+      bool get_bool (bool & v) const noexcept
+      {
+        if (token () == json_token::bool_value)
+        {
+          v = owner->reader.boolean ();
+          return true;
+        }
+        return false;
+      }
+
+      bool get_double (double & v) const noexcept
+      {
+        if (token () == json_token::number_value)
+        {
+          v = owner->reader.number ();
+          return true;
+        }
+        return false;
+      }
+
+      // Numbers are parsed as doubles, so integers beyond 2^53 lose precision
+      //  Fails if the number isn't an integer or doesn't fit
+      bool get_int64 (std::int64_t & v) const noexcept
+      {
+        double d;
+        if (
+              get_double (d)
+          &&  d >= -9223372036854775808.0
+          &&  d <   9223372036854775808.0
+          &&  static_cast<double> (static_cast<std::int64_t> (d)) == d
+          )
+        {
+          v = static_cast<std::int64_t> (d);
+          return true;
+        }
+        return false;
+      }
+
+      bool get_string (string_type & v) const
+      {
+        if (token () == json_token::string_value)
+        {
+          v = owner->reader.string ();
+          return true;
+        }
+        return false;
+      }
+
+      bool as_bool (bool default_value = false) const noexcept
+      {
+        get_bool (default_value);
+        return default_value;
+      }
+
+      double as_double (double default_value = 0.0) const noexcept
+      {
+        get_double (default_value);
+        return default_value;
+      }
+
+      std::int64_t as_int64 (std::int64_t default_value = 0) const noexcept
+      {
+        get_int64 (default_value);
+        return default_value;
+      }
+
+      string_type as_string (string_type default_value = string_type ()) const
+      {
+        get_string (default_value);
+        return default_value;
+      }
+
+    private:
+      friend struct basic_json_ondemand;
+
+      basic_json_ondemand * owner ;
+      std::size_t           stamp ; // The sequence number of the value's first token
+      std::size_t           depth ; // For containers the depth of the container, otherwise of the parent
+      json_token            kind  ;
+
+      bool is_container () const noexcept
+      {
+        return kind == json_token::array_begin || kind == json_token::object_begin;
+      }
+    };
+
+    basic_json_ondemand (iter_type begin, iter_type end)
+      : reader    (begin, end)
+      , sequence  (0)
+    {
+      opened.reserve (64);
+      counts.reserve (64);
+      key.reserve (64);
+
+      advance ();
+      root_value = make_value (reader.token ());
+    }
+
+    basic_json_ondemand (basic_json_ondemand const &)             = delete;
+    basic_json_ondemand & operator= (basic_json_ondemand const &) = delete;
+
+    // The root array or object
+    value root () const noexcept
+    {
+      return root_value;
+    }
+
+    value operator[] (string_type const & name) const
+    {
+      return root_value[name];
+    }
+
+    value operator[] (char_type const * name) const
+    {
+      return root_value[name];
+    }
+
+    value at (std::size_t idx) const
+    {
+      return root_value.at (idx);
+    }
+
+    // Returns true if invalid JSON was found while navigating
+    //  Only the parts of the input that were passed are checked
+    bool failed () const noexcept
+    {
+      return reader.token () == json_token::error;
+    }
+
+    // Gets the position of the cursor, on error it's the position of the error
+    std::size_t pos () const noexcept
+    {
+      return reader.pos ();
+    }
+
+  private:
+    reader_type               reader      ;
+    std::size_t               sequence    ; // Incremented each time the cursor moves
+    std::vector<std::size_t>  opened      ; // The sequence number of each open container
+    std::vector<std::size_t>  counts      ; // The number of elements or members read of each open container
+    string_type               key         ; // The member name passed to for_each actions
+    value                     root_value  ;
+
+    static bool is_begin (json_token t) noexcept
+    {
+      return t == json_token::array_begin || t == json_token::object_begin;
+    }
+
+    static bool is_end (json_token t) noexcept
+    {
+      return t == json_token::array_end || t == json_token::object_end;
+    }
+
+    value make_value (json_token t) noexcept
+    {
+      value v;
+      if (t != json_token::error && t != json_token::eos && !is_end (t) && t != json_token::member_key)
+      {
+        v.owner = this;
+        v.stamp = sequence;
+        v.depth = reader.depth ();
+        v.kind  = t;
+      }
+      return v;
+    }
+
+    // Returns true if the container opened at 'stamp' on 'depth' is still open
+    bool is_open (std::size_t depth, std::size_t stamp) const noexcept
+    {
+      return depth > 0 && depth <= opened.size () && opened[depth - 1] == stamp;
+    }
+
+    json_token advance ()
+    {
+      auto t = reader.next ();
+      ++sequence;
+
+      if (is_begin (t))
+      {
+        opened.push_back (sequence);
+        counts.push_back (0);
+      }
+      else if (is_end (t))
+      {
+        opened.pop_back ();
+        counts.pop_back ();
+      }
+
+      return t;
+    }
+
+    // Skips the container whose begin token is the current token
+    bool skip_container ()
+    {
+      ++sequence;
+      opened.pop_back ();
+      counts.pop_back ();
+      return reader.skip ();
+    }
+
+    // Moves the cursor to the end of the current value of the container at 'depth'
+    bool unwind (std::size_t depth)
+    {
+      while (reader.depth () > depth)
+      {
+        auto t = reader.token ();
+        if (is_begin (t))
+        {
+          if (!skip_container ())
+          {
+            return false;
+          }
+        }
+        else if (t == json_token::member_key)
+        {
+          ++sequence;
+          if (!reader.skip ())
+          {
+            return false;
+          }
+          advance ();
+        }
+        else if (t == json_token::error || t == json_token::eos)
+        {
+          return false;
+        }
+        else
+        {
+          advance ();
+        }
+      }
+
+      return reader.token () != json_token::error;
+    }
+
+    value find (std::size_t depth, string_type const & name)
+    {
+      if (!unwind (depth))
+      {
+        return value ();
+      }
+
+      for (;;)
+      {
+        auto t = advance ();
+        if (t != json_token::member_key)
+        {
+          // object_end (not found) or error
+          return value ();
+        }
+
+        ++counts[depth - 1];
+
+        if (reader.string () == name)
+        {
+          return make_value (advance ());
+        }
+
+        ++sequence;
+        if (!reader.skip ())
+        {
+          return value ();
+        }
+      }
+    }
+
+    value element (std::size_t depth, std::size_t idx)
+    {
+      if (!unwind (depth))
+      {
+        return value ();
+      }
+
+      while (counts[depth - 1] <= idx)
+      {
+        auto t = advance ();
+        if (t == json_token::array_end || t == json_token::error)
+        {
+          return value ();
+        }
+
+        if (counts[depth - 1]++ == idx)
+        {
+          return make_value (t);
+        }
+
+        if (is_begin (t) && !skip_container ())
+        {
+          return value ();
+        }
+      }
+
+      // Already passed
+      return value ();
+    }
+
+    // Invokes visit (*this, token) with the first token of each remaining element or member
+    template<typename TVisit>
+    bool for_each (std::size_t depth, TVisit && visit)
+    {
+      for (;;)
+      {
+        // The previous visit may have navigated into the value
+        if (!unwind (depth))
+        {
+          return false;
+        }
+
+        auto t = advance ();
+        if (is_end (t))
+        {
+          return true;
+        }
+        else if (t == json_token::error)
+        {
+          return false;
+        }
+
+        ++counts[depth - 1];
+        visit (*this, t);
+      }
+    }
+  };
+
+  using json_ondemand      = basic_json_ondemand<wchar_t>;
+  using json_utf8_ondemand = basic_json_ondemand<char>   ;
+
+} }
+
+#endif  // CPP_JSON__ONDEMAND_H
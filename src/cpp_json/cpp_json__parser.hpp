@@ -19,14 +19,215 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CPP_JSON__SSE2
+# include <emmintrin.h>
+# ifdef _MSC_VER
+#   include <intrin.h>
+# endif
+#endif
 
 #define CPP_JSON__ASSERT    assert
 #define CPP_JSON__PICK(s)    json_string_literal<char_type>::pick (s, L##s)
 
+// The default limit of nested arrays and objects, json_parser is recursive so
+//  deeper input would exhaust the stack. Define CPP_JSON__MAX_DEPTH to change it
+#ifndef CPP_JSON__MAX_DEPTH
+# define CPP_JSON__MAX_DEPTH 1024
+#endif
+
 namespace cpp_json { namespace parser
 {
+  // array_begin, object_begin and member_key may return a json_decision instead of bool
+  //  skip means the parser scans past the array, object or member value without invoking
+  //  any more callbacks for it (array_end/object_end are not invoked for skipped containers).
+  //  Skipped values are only checked for balanced brackets and terminated strings
+  //  validate is like skip but the skipped value is fully validated
+  //  defer (array_begin and object_begin only) is like validate but afterwards the context's
+  //  deferred_value (is_array, begin, end) is invoked with the position range of the container
+  enum class json_decision
+  {
+    abort   ,
+    proceed ,
+    skip    ,
+    validate,
+    defer   ,
+  };
+
   namespace details
   {
+    constexpr json_decision to_decision (bool b) noexcept
+    {
+      return b ? json_decision::proceed : json_decision::abort;
+    }
+
+    constexpr json_decision to_decision (json_decision d) noexcept
+    {
+      return d;
+    }
+
+    // Only contexts that return json_decision::defer need to implement deferred_value
+    template<typename TContext>
+    inline auto invoke__deferred_value (TContext & context, bool is_array, std::size_t begin, std::size_t end, int)
+      -> decltype (context.deferred_value (is_array, begin, end))
+    {
+      return context.deferred_value (is_array, begin, end);
+    }
+
+    template<typename TContext>
+    inline bool invoke__deferred_value (TContext & /*context*/, bool /*is_array*/, std::size_t /*begin*/, std::size_t /*end*/, long)
+    {
+      CPP_JSON__ASSERT (false);
+      return false;
+    }
+
+    template<typename TChar>
+    constexpr bool is_structural (TChar ch) noexcept
+    {
+      return ch == '"' || ch == '[' || ch == ']' || ch == '\\' || ch == '{' || ch == '}';
+    }
+
+    template<typename TChar>
+    constexpr bool is_string_end (TChar ch) noexcept
+    {
+      return ch == '"' || ch == '\\';
+    }
+
+    // True if advancing TIter can't throw, json_block_iterator may throw when it
+    //  fetches the next block
+    template<typename TIter>
+    struct json_nothrow_advance : std::integral_constant<bool, noexcept (++std::declval<TIter &> ())>
+    {
+    };
+
+    // Finds the first char that is a quote, a backslash or a bracket
+    template<typename TIter>
+    inline TIter find__structural (TIter b, TIter e) noexcept (json_nothrow_advance<TIter>::value)
+    {
+      while (b < e && !is_structural (*b))
+      {
+        ++b;
+      }
+      return b;
+    }
+
+    // Finds the first char that is a quote or a backslash
+    template<typename TIter>
+    inline TIter find__string_end (TIter b, TIter e) noexcept (json_nothrow_advance<TIter>::value)
+    {
+      while (b < e && !is_string_end (*b))
+      {
+        ++b;
+      }
+      return b;
+    }
+
+#ifdef CPP_JSON__SSE2
+    template<std::size_t Size>
+    struct json_sse2;
+
+    template<>
+    struct json_sse2<1>
+    {
+      static __m128i set1 (int c) noexcept                { return _mm_set1_epi8 (static_cast<char> (c)); }
+      static __m128i eq   (__m128i a, __m128i b) noexcept { return _mm_cmpeq_epi8 (a, b); }
+    };
+
+    template<>
+    struct json_sse2<2>
+    {
+      static __m128i set1 (int c) noexcept                { return _mm_set1_epi16 (static_cast<short> (c)); }
+      static __m128i eq   (__m128i a, __m128i b) noexcept { return _mm_cmpeq_epi16 (a, b); }
+    };
+
+    template<>
+    struct json_sse2<4>
+    {
+      static __m128i set1 (int c) noexcept                { return _mm_set1_epi32 (c); }
+      static __m128i eq   (__m128i a, __m128i b) noexcept { return _mm_cmpeq_epi32 (a, b); }
+    };
+
+    inline unsigned int first_bit (unsigned int mask) noexcept
+    {
+      CPP_JSON__ASSERT (mask != 0);
+#ifdef _MSC_VER
+      unsigned long idx;
+      _BitScanForward (&idx, mask);
+      return idx;
+#else
+      return static_cast<unsigned int> (__builtin_ctz (mask));
+#endif
+    }
+
+    template<typename TChar>
+    inline TChar const * find__structural (TChar const * b, TChar const * e) noexcept
+    {
+      using sse2 = json_sse2<sizeof (TChar)>;
+      constexpr auto width = sizeof (__m128i) / sizeof (TChar);
+
+      auto quote      = sse2::set1 ('"' );
+      auto backslash  = sse2::set1 ('\\');
+      auto lbracket   = sse2::set1 ('[' );
+      auto rbracket   = sse2::set1 (']' );
+      auto lbrace     = sse2::set1 ('{' );
+      auto rbrace     = sse2::set1 ('}' );
+
+      for (; e - b >= static_cast<std::ptrdiff_t> (width); b += width)
+      {
+        auto v = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (b));
+        auto m = _mm_or_si128 (
+            _mm_or_si128 (
+                _mm_or_si128 (sse2::eq (v, quote), sse2::eq (v, backslash))
+              , _mm_or_si128 (sse2::eq (v, lbracket), sse2::eq (v, rbracket))
+              )
+          , _mm_or_si128 (sse2::eq (v, lbrace), sse2::eq (v, rbrace))
+          );
+        auto mask = static_cast<unsigned int> (_mm_movemask_epi8 (m));
+        if (mask != 0)
+        {
+          return b + first_bit (mask) / sizeof (TChar);
+        }
+      }
+
+      while (b < e && !is_structural (*b))
+      {
+        ++b;
+      }
+      return b;
+    }
+
+    template<typename TChar>
+    inline TChar const * find__string_end (TChar const * b, TChar const * e) noexcept
+    {
+      using sse2 = json_sse2<sizeof (TChar)>;
+      constexpr auto width = sizeof (__m128i) / sizeof (TChar);
+
+      auto quote      = sse2::set1 ('"' );
+      auto backslash  = sse2::set1 ('\\');
+
+      for (; e - b >= static_cast<std::ptrdiff_t> (width); b += width)
+      {
+        auto v = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (b));
+        auto m = _mm_or_si128 (sse2::eq (v, quote), sse2::eq (v, backslash));
+        auto mask = static_cast<unsigned int> (_mm_movemask_epi8 (m));
+        if (mask != 0)
+        {
+          return b + first_bit (mask) / sizeof (TChar);
+        }
+      }
+
+      while (b < e && !is_string_end (*b))
+      {
+        ++b;
+      }
+      return b;
+    }
+#endif
+
     template<typename TChar>
     struct json_string_literal;
 
@@ -98,6 +299,7 @@ namespace cpp_json { namespace parser
         , token__char                 (CPP_JSON__PICK ("char"       ))
         , token__escapes              (CPP_JSON__PICK ("\"\\/bfnrtu"))
         , token__new_line             (CPP_JSON__PICK ("NEWLINE"    ))
+        , token__nesting              (CPP_JSON__PICK ("NESTING"    ))
         , token__root_value_preludes  (CPP_JSON__PICK ("{["         ))
         , token__value_preludes       (CPP_JSON__PICK ("\"{[-"      ))
       {
@@ -112,11 +314,124 @@ namespace cpp_json { namespace parser
       string_type const token__char               ;
       string_type const token__escapes            ;
       string_type const token__new_line           ;
+      string_type const token__nesting            ;
       string_type const token__root_value_preludes;
       string_type const token__value_preludes     ;
     };
+
+    // Used to validate skipped values, ignores everything
+    template<typename TString, typename TIter>
+    struct json_validate_context
+    {
+      using string_type = TString                           ;
+      using char_type   = typename string_type::value_type  ;
+      using iter_type   = TIter                             ;
+
+      string_type empty;
+
+      inline void expected_char     (std::size_t /*pos*/, char_type /*ch*/) noexcept                  {}
+      inline void expected_chars    (std::size_t /*pos*/, string_type const & /*chs*/) noexcept       {}
+      inline void expected_token    (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+      inline void unexpected_token  (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+
+      inline void clear_string      () noexcept                                                       {}
+      inline void push_char         (char_type /*ch*/) noexcept                                       {}
+      inline void push_wchar_t      (wchar_t /*ch*/) noexcept                                         {}
+      inline string_type const & get_string () const noexcept                                         { return empty; }
+
+      inline bool array_begin       () noexcept                                                       { return true; }
+      inline bool array_end         () noexcept                                                       { return true; }
+      inline bool object_begin      () noexcept                                                       { return true; }
+      inline bool member_key        (string_type const & /*s*/) noexcept                              { return true; }
+      inline bool object_end        () noexcept                                                       { return true; }
+      inline bool bool_value        (bool /*b*/) noexcept                                             { return true; }
+      inline bool null_value        () noexcept                                                       { return true; }
+      inline bool string_value      (string_type const & /*s*/) noexcept                              { return true; }
+      inline bool number_value      (double /*d*/) noexcept                                           { return true; }
+    };
   }
 
+  // The parsing phases timed by an instrumentation policy
+  //  The phases don't overlap, time outside them is spent on structure (brackets,
+  //  commas, colons) and dispatch
+  enum class json_phase
+  {
+    white_space ,
+    string      ,   // Member names and string values, including escapes
+    number      ,
+    literal     ,   // null, true and false
+    context     ,   // Callbacks into the context, for a DOM this is building and allocation
+  };
+
+  // The default instrumentation policy of json_parser, does nothing and compiles to nothing
+  //  A policy implements the methods below, they are invoked by the parser as it
+  //  parses the input. See cpp_json__instrumentation.hpp for policies that count and time.
+  //  Values that are skipped or validated only (see json_decision) are not reported.
+  struct json_no_instrumentation
+  {
+    // 'chars' white space chars were consumed
+    inline void white_space     (std::size_t /*chars*/) noexcept                        {}
+    // A string of 'chars' chars (including quotes) with 'escapes' escape sequences was parsed
+    inline void string          (std::size_t /*chars*/, std::size_t /*escapes*/) noexcept {}
+    // A number literal of 'chars' chars was parsed
+    inline void number          (std::size_t /*chars*/) noexcept                        {}
+    // null, true or false of 'chars' chars was parsed
+    inline void literal         (std::size_t /*chars*/) noexcept                        {}
+    // An array or object was opened
+    inline void container_begin (bool /*is_array*/) noexcept                            {}
+    // An array or object with 'size' values was closed
+    inline void container_end   (bool /*is_array*/, std::size_t /*size*/) noexcept      {}
+    // Brackets the phases, used to time them
+    inline void phase_begin     (json_phase /*phase*/) noexcept                         {}
+    inline void phase_end       (json_phase /*phase*/) noexcept                         {}
+  };
+
+  namespace details
+  {
+    // Holds the instrumentation of json_parser without exposing its members as members
+    //  of the parser, where they could clash with members of the context
+    template<typename TInstrumentation, bool = std::is_empty<TInstrumentation>::value>
+    struct json_instrumentation_holder
+    {
+      inline TInstrumentation & get_instrumentation () noexcept
+      {
+        return instrumentation_state;
+      }
+
+      inline TInstrumentation const & get_instrumentation () const noexcept
+      {
+        return instrumentation_state;
+      }
+
+    private:
+      TInstrumentation instrumentation_state;
+    };
+
+    // Stateless policies share one instance so they take no space in the parser
+    template<typename TInstrumentation>
+    struct json_instrumentation_holder<TInstrumentation, true>
+    {
+      inline TInstrumentation & get_instrumentation () noexcept
+      {
+        return instrumentation_instance;
+      }
+
+      inline TInstrumentation const & get_instrumentation () const noexcept
+      {
+        return instrumentation_instance;
+      }
+
+    private:
+      static TInstrumentation instrumentation_instance;
+    };
+
+    template<typename TInstrumentation>
+    TInstrumentation json_instrumentation_holder<TInstrumentation, true>::instrumentation_instance;
+  }
+
+  template<typename TChar, typename TIter>
+  struct basic_json_reader;
+
   // TContext must fulfill the following contract
   //  struct some_json_context
   //  {
@@ -146,6 +461,11 @@ namespace cpp_json { namespace parser
   //    string_type const & get_string ();
   //
   //    // The following methods are invoked when JSON values are discovered
+  //    //  array_begin, object_begin and member_key may return json_decision to skip values
+  //
+  //    //  A context that returns json_decision::defer must also implement
+  //    //    bool deferred_value (bool is_array, std::size_t begin, std::size_t end);
+  //    //  where [begin, end) are the positions of the container including the brackets
   //
   //    bool array_begin ();
   //    bool array_end ();
@@ -163,13 +483,20 @@ namespace cpp_json { namespace parser
   //    bool number_value (double d);
   //
   //  };
-  template<typename TContext>
-  struct json_parser : TContext
+  //
+  //  TInstrumentation is an instrumentation policy, see json_no_instrumentation
+  //
+  //  Arrays and objects nested deeper than the max depth (CPP_JSON__MAX_DEPTH by default,
+  //  see set_max_depth) fail to parse with an unexpected NESTING token. The contents
+  //  of skipped containers are scanned without recursion and aren't limited
+  template<typename TContext, typename TInstrumentation = json_no_instrumentation>
+  struct json_parser : TContext, details::json_instrumentation_holder<TInstrumentation>
   {
-    using context_type    = TContext                            ;
-    using char_type       = typename context_type::char_type    ;
-    using string_type     = typename context_type::string_type  ;
-    using iter_type       = typename context_type::iter_type    ;
+    using context_type          = TContext                            ;
+    using instrumentation_type  = TInstrumentation                    ;
+    using char_type             = typename context_type::char_type    ;
+    using string_type           = typename context_type::string_type  ;
+    using iter_type             = typename context_type::iter_type    ;
 
     constexpr json_parser (iter_type begin, iter_type end) noexcept
       : begin   (begin)
@@ -178,6 +505,41 @@ namespace cpp_json { namespace parser
     {
     }
 
+    // 'args' are passed to the context constructor
+    template<typename ...TArgs>
+    json_parser (iter_type begin, iter_type end, TArgs && ... args)
+      : context_type  (std::forward<TArgs> (args)...)
+      , begin         (begin)
+      , end           (end)
+      , current       (begin)
+    {
+    }
+
+    // Resets the parser to parse [b, e), the context is not reset
+    inline void reset (iter_type b, iter_type e) noexcept
+    {
+      begin         = b;
+      end           = e;
+      current       = b;
+      nesting_depth = 0;
+    }
+
+    // Sets the maximum number of nested arrays and objects
+    inline void set_max_depth (std::size_t md) noexcept
+    {
+      max_nesting_depth = md;
+    }
+
+    inline instrumentation_type & instrumentation () noexcept
+    {
+      return details::json_instrumentation_holder<TInstrumentation>::get_instrumentation ();
+    }
+
+    inline instrumentation_type const & instrumentation () const noexcept
+    {
+      return details::json_instrumentation_holder<TInstrumentation>::get_instrumentation ();
+    }
+
     // Gets current parser position
     constexpr std::size_t pos () const noexcept
     {
@@ -196,13 +558,34 @@ namespace cpp_json { namespace parser
         ;
     }
 
+    // Tries to parse a single JSON value of any kind followed by optional white space
+    //  Parsing stops after the value, used to parse values embedded in a larger input
+    bool try_parse__element ()
+    {
+      return
+            consume__white_space ()
+        &&  try_parse__value ()
+        ;
+    }
+
   private:
+    template<typename TOtherContext, typename TOtherInstrumentation>
+    friend struct json_parser;
+
+    template<typename TChar, typename TIter>
+    friend struct basic_json_reader;
+
+    using validate_parser = json_parser<details::json_validate_context<string_type, iter_type>>;
+
     static details::json_tokens<string_type>  tokens            ;
     static details::json_pow10table           pow10table        ;
 
-    iter_type const begin                                       ;
-    iter_type const end                                         ;
+    iter_type       begin                                       ;
+    iter_type       end                                         ;
     iter_type       current                                     ;
+    // Named to not clash with members of the context
+    std::size_t     nesting_depth     = 0                       ;
+    std::size_t     max_nesting_depth = CPP_JSON__MAX_DEPTH     ;
 
     constexpr bool eos () const noexcept
     {
@@ -219,7 +602,7 @@ namespace cpp_json { namespace parser
       return *current;
     }
 
-    inline void adv () noexcept
+    inline void adv () noexcept (details::json_nothrow_advance<iter_type>::value)
     {
       ++current;
     }
@@ -236,6 +619,12 @@ namespace cpp_json { namespace parser
       return false;
     }
 
+    bool raise__nesting ()
+    {
+      context_type::unexpected_token (pos (), tokens.token__nesting);
+      return false;
+    }
+
     bool raise__value ()
     {
       auto p = pos ();
@@ -287,12 +676,21 @@ namespace cpp_json { namespace parser
       return ch >= '0' && ch <= '9';
     }
 
-    inline bool consume__white_space () noexcept
+    inline std::size_t chars_since (iter_type start) const noexcept
     {
+      return static_cast<std::size_t> (current - start);
+    }
+
+    inline bool consume__white_space () noexcept (details::json_nothrow_advance<iter_type>::value)
+    {
+      instrumentation ().phase_begin (json_phase::white_space);
+      auto scurrent = current;
       while (neos () && is_white_space (ch ()))
       {
         adv ();
       }
+      instrumentation ().white_space (chars_since (scurrent));
+      instrumentation ().phase_end (json_phase::white_space);
       return true;
     }
 
@@ -342,7 +740,7 @@ namespace cpp_json { namespace parser
       }
     }
 
-    inline bool try_consume__token (string_type const & tk) noexcept
+    inline bool try_consume__token (string_type const & tk) noexcept (details::json_nothrow_advance<iter_type>::value)
     {
       auto tsz = tk.size ();
 
@@ -374,9 +772,14 @@ namespace cpp_json { namespace parser
 
     bool try_parse__null ()
     {
-      if (try_consume__token (tokens.token__null))
+      instrumentation ().phase_begin (json_phase::literal);
+      auto consumed = try_consume__token (tokens.token__null);
+      instrumentation ().phase_end (json_phase::literal);
+
+      if (consumed)
       {
-        return context_type::null_value ();
+        instrumentation ().literal (tokens.token__null.size ());
+        return context_callback ([this] () { return context_type::null_value (); });
       }
       else
       {
@@ -386,9 +789,14 @@ namespace cpp_json { namespace parser
 
     bool try_parse__true ()
     {
-      if (try_consume__token (tokens.token__true))
+      instrumentation ().phase_begin (json_phase::literal);
+      auto consumed = try_consume__token (tokens.token__true);
+      instrumentation ().phase_end (json_phase::literal);
+
+      if (consumed)
       {
-        return context_type::bool_value (true);
+        instrumentation ().literal (tokens.token__true.size ());
+        return context_callback ([this] () { return context_type::bool_value (true); });
       }
       else
       {
@@ -398,9 +806,14 @@ namespace cpp_json { namespace parser
 
     bool try_parse__false ()
     {
-      if (try_consume__token (tokens.token__false))
+      instrumentation ().phase_begin (json_phase::literal);
+      auto consumed = try_consume__token (tokens.token__false);
+      instrumentation ().phase_end (json_phase::literal);
+
+      if (consumed)
       {
-        return context_type::bool_value (false);
+        instrumentation ().literal (tokens.token__false.size ());
+        return context_callback ([this] () { return context_type::bool_value (false); });
       }
       else
       {
@@ -504,23 +917,32 @@ namespace cpp_json { namespace parser
 
     bool try_parse__number ()
     {
+      instrumentation ().phase_begin (json_phase::number);
+      auto scurrent = current;
+
       auto hasMinus = try_consume__char ('-');
 
       auto i = 0.0;
       auto f = 0.0;
       auto e = 0;
 
-      if (
+      auto parsed =
             try_parse__uint0    (i)
         &&  try_parse__fraction (f)
         &&  try_parse__exponent (e)
-        )
+        ;
+
+      instrumentation ().phase_end (json_phase::number);
+
+      if (parsed)
       {
+        instrumentation ().number (chars_since (scurrent));
+
         auto uu = i + f;
         auto ff = hasMinus ? -uu : uu;
         auto ee = pow10 (e);
         auto rr = ff*ee;
-        return context_type::number_value (rr);
+        return context_callback ([this, rr] () { return context_type::number_value (rr); });
       }
       else
       {
@@ -528,7 +950,17 @@ namespace cpp_json { namespace parser
       }
     }
 
-    bool try_parse__chars ()
+    // Invokes a context callback inside the context phase
+    template<typename TCallback>
+    inline auto context_callback (TCallback && callback) -> decltype (callback ())
+    {
+      instrumentation ().phase_begin (json_phase::context);
+      auto result = callback ();
+      instrumentation ().phase_end (json_phase::context);
+      return result;
+    }
+
+    bool try_parse__chars (std::size_t & escapes)
     {
       context_type::clear_string ();
 
@@ -560,7 +992,13 @@ namespace cpp_json { namespace parser
           return false;
         case '\\':
           {
+            ++escapes;
             adv ();
+            if (eos ())
+            {
+              return raise__escapes () || raise__eos ();
+            }
+
             auto e = ch ();
             switch (e)
             {
@@ -590,13 +1028,13 @@ namespace cpp_json { namespace parser
 
                 for (auto iter = 0U; iter < 4U; ++iter)
                 {
+                  adv ();
                   if (eos ())
                   {
                     return raise__hex_digit () || raise__eos ();
                   }
 
                   wresult = wresult << 4;
-                  adv ();
                   auto hd = ch ();
                   switch (hd)
                   {
@@ -648,18 +1086,31 @@ namespace cpp_json { namespace parser
 
     inline bool try_parse__string_impl ()
     {
-      return
+      instrumentation ().phase_begin (json_phase::string);
+      auto scurrent = current;
+      std::size_t escapes = 0;
+
+      auto result =
             try_consume__char ('"')
-        &&  try_parse__chars  ()
+        &&  try_parse__chars  (escapes)
         &&  try_consume__char ('"')
         ;
+
+      instrumentation ().phase_end (json_phase::string);
+
+      if (result)
+      {
+        instrumentation ().string (chars_since (scurrent), escapes);
+      }
+
+      return result;
     }
 
     bool try_parse__string ()
     {
       return
             try_parse__string_impl ()
-        &&  context_type::string_value (context_type::get_string ())
+        &&  context_callback ([this] () { return context_type::string_value (context_type::get_string ()); })
         ;
     }
 
@@ -668,7 +1119,7 @@ namespace cpp_json { namespace parser
       return first || (try_consume__char (',') && consume__white_space  ());
     }
 
-    bool try_parse__array_values ()
+    bool try_parse__array_values (std::size_t & size)
     {
       auto first = true;
       for (;;)
@@ -682,6 +1133,7 @@ namespace cpp_json { namespace parser
           &&  try_parse__value        ()
           )
         {
+          ++size;
         }
         else
         {
@@ -693,25 +1145,83 @@ namespace cpp_json { namespace parser
 
     bool try_parse__array ()
     {
-      return
-            try_consume__char         ('[')
-        &&  consume__white_space      ()
-        &&  context_type::array_begin ()
-        &&  try_parse__array_values   ()
-        &&  try_consume__char         (']')
-        &&  context_type::array_end   ()
-        ;
+      if (nesting_depth >= max_nesting_depth)
+      {
+        return raise__nesting ();
+      }
+
+      ++nesting_depth;
+      auto result = try_parse__array_impl ();
+      --nesting_depth;
+      return result;
     }
 
-    bool try_parse__member_key ()
+    bool try_parse__array_impl ()
     {
-      return
-            try_parse__string_impl ()
-        &&  context_type::member_key (context_type::get_string ())
-        ;
+      auto start = pos ();
+      if (!(try_consume__char ('[') && consume__white_space ()))
+      {
+        return false;
+      }
+
+      switch (details::to_decision (context_callback ([this] () { return context_type::array_begin (); })))
+      {
+      case json_decision::proceed:
+        {
+          instrumentation ().container_begin (true);
+          std::size_t size = 0;
+          auto result =
+                try_parse__array_values (size)
+            &&  try_consume__char       (']')
+            ;
+          instrumentation ().container_end (true, size);
+          return result && context_callback ([this] () { return context_type::array_end (); });
+        }
+      case json_decision::skip:
+        return try_skip__container ();
+      case json_decision::validate:
+        return try_validate__array_values ();
+      case json_decision::defer:
+        return
+              try_validate__array_values ()
+          &&  context_callback ([this, start] () { return details::invoke__deferred_value (static_cast<context_type &> (*this), true, start, pos (), 0); })
+          ;
+      default:
+        return false;
+      }
     }
 
-    bool try_parse__object_members ()
+    bool try_parse__member ()
+    {
+      if (!try_parse__string_impl ())
+      {
+        return false;
+      }
+
+      auto decision = details::to_decision (context_callback ([this] () { return context_type::member_key (context_type::get_string ()); }));
+
+      if (
+            decision == json_decision::abort
+        ||  !consume__white_space ()
+        ||  !try_consume__char    (':')
+        ||  !consume__white_space ()
+        )
+      {
+        return false;
+      }
+
+      switch (decision)
+      {
+      case json_decision::skip:
+        return try_skip__value ();
+      case json_decision::validate:
+        return try_validate__value ();
+      default:
+        return try_parse__value ();
+      }
+    }
+
+    bool try_parse__object_members (std::size_t & size)
     {
       auto first = true;
       for (;;)
@@ -722,13 +1232,10 @@ namespace cpp_json { namespace parser
         }
         else if (
               try_consume__delimiter  (first)
-          &&  try_parse__member_key   ()
-          &&  consume__white_space    ()
-          &&  try_consume__char       (':')
-          &&  consume__white_space    ()
-          &&  try_parse__value        ()
+          &&  try_parse__member       ()
           )
         {
+          ++size;
         }
         else
         {
@@ -740,14 +1247,202 @@ namespace cpp_json { namespace parser
 
     bool try_parse__object ()
     {
-      return
-            try_consume__char         ('{')
-        &&  consume__white_space      ()
-        &&  context_type::object_begin()
-        &&  try_parse__object_members ()
-        &&  try_consume__char         ('}')
-        &&  context_type::object_end  ()
+      if (nesting_depth >= max_nesting_depth)
+      {
+        return raise__nesting ();
+      }
+
+      ++nesting_depth;
+      auto result = try_parse__object_impl ();
+      --nesting_depth;
+      return result;
+    }
+
+    bool try_parse__object_impl ()
+    {
+      auto start = pos ();
+      if (!(try_consume__char ('{') && consume__white_space ()))
+      {
+        return false;
+      }
+
+      switch (details::to_decision (context_callback ([this] () { return context_type::object_begin (); })))
+      {
+      case json_decision::proceed:
+        {
+          instrumentation ().container_begin (false);
+          std::size_t size = 0;
+          auto result =
+                try_parse__object_members (size)
+            &&  try_consume__char         ('}')
+            ;
+          instrumentation ().container_end (false, size);
+          return result && context_callback ([this] () { return context_type::object_end (); });
+        }
+      case json_decision::skip:
+        return try_skip__container ();
+      case json_decision::validate:
+        return try_validate__object_members ();
+      case json_decision::defer:
+        return
+              try_validate__object_members ()
+          &&  context_callback ([this, start] () { return details::invoke__deferred_value (static_cast<context_type &> (*this), false, start, pos (), 0); })
+          ;
+      default:
+        return false;
+      }
+    }
+
+    // The try_validate__* methods parse with a context that ignores all values
+
+    // Validate parsers continue from the current depth
+    validate_parser make_validate_parser () const
+    {
+      validate_parser vp (current, end);
+      vp.nesting_depth      = nesting_depth     ;
+      vp.max_nesting_depth  = max_nesting_depth ;
+      return vp;
+    }
+
+    bool try_validate__value ()
+    {
+      auto vp = make_validate_parser ();
+      auto result = vp.try_parse__value ();
+      current = vp.current;
+      return result;
+    }
+
+    // Validates the rest of an array, current is positioned after the opening bracket
+    bool try_validate__array_values ()
+    {
+      auto vp = make_validate_parser ();
+      std::size_t size = 0;
+      auto result =
+            vp.try_parse__array_values  (size)
+        &&  vp.try_consume__char        (']')
+        ;
+      current = vp.current;
+      return result;
+    }
+
+    // Validates the rest of an object, current is positioned after the opening brace
+    bool try_validate__object_members ()
+    {
+      auto vp = make_validate_parser ();
+      std::size_t size = 0;
+      auto result =
+            vp.try_parse__object_members  (size)
+        &&  vp.try_consume__char          ('}')
         ;
+      current = vp.current;
+      return result;
+    }
+
+    // Skips the rest of a string, current is positioned after the opening quote
+    //  and is left on the closing quote
+    bool try_skip__chars ()
+    {
+      for (;;)
+      {
+        current = details::find__string_end (current, end);
+
+        if (eos ())
+        {
+          return raise__char () || raise__eos ();
+        }
+        else if (ch () == '"')
+        {
+          return true;
+        }
+
+        // Skip the escape and the escaped char
+        adv ();
+        if (eos ())
+        {
+          return raise__escapes () || raise__eos ();
+        }
+        adv ();
+      }
+    }
+
+    // Skips the rest of an array or object, current is positioned after the opening bracket
+    //  Only balanced brackets and terminated strings are checked
+    bool try_skip__container ()
+    {
+      auto depth = 1U;
+      for (;;)
+      {
+        current = details::find__structural (current, end);
+
+        if (eos ())
+        {
+          return raise__eos ();
+        }
+
+        switch (ch ())
+        {
+        case '"':
+          adv ();
+          if (!try_skip__chars ())
+          {
+            return false;
+          }
+          break;
+        case '[':
+        case '{':
+          ++depth;
+          break;
+        case ']':
+        case '}':
+          if (--depth == 0)
+          {
+            adv ();
+            return consume__white_space ();
+          }
+          break;
+        default:
+          break;
+        }
+
+        adv ();
+      }
+    }
+
+    // Skips a value, scalars are only checked to be non-empty
+    bool try_skip__value ()
+    {
+      if (eos ())
+      {
+        return raise__value () || raise__eos ();
+      }
+
+      switch (ch ())
+      {
+      case '[':
+      case '{':
+        adv ();
+        return try_skip__container ();
+      case '"':
+        adv ();
+        if (try_skip__chars ())
+        {
+          adv ();
+          return consume__white_space ();
+        }
+        else
+        {
+          return false;
+        }
+      default:
+        {
+          auto scurrent = current;
+          while (neos () && !is_white_space (ch ()) && ch () != ',' && ch () != ']' && ch () != '}')
+          {
+            adv ();
+          }
+          return (scurrent != current || raise__value ()) && consume__white_space ();
+        }
+      }
     }
 
     bool try_parse__value ()
@@ -832,11 +1527,11 @@ namespace cpp_json { namespace parser
     }
   };
 
-  template<typename TContext>
-  details::json_pow10table json_parser<TContext>::pow10table;
+  template<typename TContext, typename TInstrumentation>
+  details::json_pow10table json_parser<TContext, TInstrumentation>::pow10table;
 
-  template<typename TContext>
-  details::json_tokens<typename TContext::string_type> json_parser<TContext>::tokens;
+  template<typename TContext, typename TInstrumentation>
+  details::json_tokens<typename TContext::string_type> json_parser<TContext, TInstrumentation>::tokens;
 
 } }
 
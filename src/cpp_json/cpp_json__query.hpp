@@ -0,0 +1,317 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__QUERY_H
+#define CPP_JSON__QUERY_H
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "cpp_json__document.hpp"
+
+namespace cpp_json { namespace document
+{
+  // json_query is a path into a JSON document that is compiled once and evaluated many times
+  //  Member names are pre-hashed and array indices are pre-parsed.
+  //
+  //  Supported syntaxes:
+  //    JSON Pointer (RFC 6901): /store/book/0/title ('~0' is '~', '~1' is '/')
+  //    Dotted path            : store.book[0].title or store.book.0.title
+  //                             ('\' escapes '.', '[' and '\' in member names)
+  //
+  //  Like JSON Pointer a token is used as a member name for objects and as an index for arrays
+  struct json_query
+  {
+    constexpr static std::size_t no_index = std::numeric_limits<std::size_t>::max ();
+
+    struct segment
+    {
+      doc_string_type key   ;
+      std::size_t     hash  ;
+      std::size_t     index ; // no_index if key isn't a valid array index
+
+      explicit segment (doc_string_type k)
+        : key   (std::move (k))
+        , hash  (details::hash_key (key))
+        , index (no_index)
+      {
+        if (key != L"-" && !details::try_parse__index (key, max_index, index))
+        {
+          index = no_index;
+        }
+      }
+
+      bool operator== (segment const & o) const noexcept
+      {
+        return hash == o.hash && key == o.key;
+      }
+
+    private:
+      constexpr static std::size_t max_index = no_index / 10 - 1;
+    };
+
+    using segments_type = std::vector<segment>;
+
+    segments_type segments;
+
+    // Compiles a JSON Pointer into a query 'result' if successful.
+    //  'pos' indicates the first non-consumed character
+    static bool compile_pointer (doc_string_type const & pointer, std::size_t & pos, json_query & result)
+    {
+      result.segments.clear ();
+
+      doc_strings_type tokens;
+      if (!details::try_parse__pointer (pointer, pos, tokens))
+      {
+        return false;
+      }
+
+      result.segments.reserve (tokens.size ());
+      for (auto && token : tokens)
+      {
+        result.segments.emplace_back (std::move (token));
+      }
+
+      return true;
+    }
+
+    // Compiles a dotted path into a query 'result' if successful.
+    //  'pos' indicates the first non-consumed character
+    static bool compile_path (doc_string_type const & path, std::size_t & pos, json_query & result)
+    {
+      result.segments.clear ();
+
+      auto sz = path.size ();
+      pos = 0;
+
+      if (sz == 0)
+      {
+        return true;  // The empty path denotes the root
+      }
+
+      doc_string_type token;
+      token.reserve (details::default_size);
+
+      for (;;)
+      {
+        if (path[pos] == '[')
+        {
+          ++pos;
+
+          token.clear ();
+          for (; pos < sz && path[pos] >= '0' && path[pos] <= '9'; ++pos)
+          {
+            token += path[pos];
+          }
+
+          if (token.empty () || pos >= sz || path[pos] != ']')
+          {
+            return false;
+          }
+          ++pos;
+
+          result.segments.emplace_back (token);
+        }
+        else
+        {
+          token.clear ();
+          for (; pos < sz && path[pos] != '.' && path[pos] != '['; ++pos)
+          {
+            auto c = path[pos];
+            if (c == '\\')
+            {
+              if (++pos >= sz)
+              {
+                return false;
+              }
+              c = path[pos];
+            }
+            token += c;
+          }
+
+          if (token.empty ())
+          {
+            return false;
+          }
+
+          result.segments.emplace_back (token);
+        }
+
+        if (pos >= sz)
+        {
+          return true;
+        }
+        else if (path[pos] == '.')
+        {
+          if (++pos >= sz)
+          {
+            return false;
+          }
+        }
+        else if (path[pos] != '[')
+        {
+          return false;
+        }
+      }
+    }
+
+    // Evaluates the query starting at element
+    //  if not found returns an error DOM element
+    json_element::ptr evaluate (json_element::ptr element) const
+    {
+      CPP_JSON__ASSERT (element);
+
+      for (auto && s : segments)
+      {
+        element = step (element, s);
+      }
+
+      return element;
+    }
+
+    // Evaluates the query starting at the document root
+    //  if not found returns an error DOM element
+    json_element::ptr evaluate (json_document const & doc) const
+    {
+      return evaluate (doc.root ());
+    }
+
+    static json_element::ptr step (json_element::ptr element, segment const & s)
+    {
+      CPP_JSON__ASSERT (element);
+
+      if (auto o = details::as_object_element (element))
+      {
+        return o->get (s.key, s.hash);
+      }
+      else if (element->is_array ())
+      {
+        // at returns an error DOM element when out of bounds (no_index for names)
+        return element->at (s.index);
+      }
+      else
+      {
+        // Other kinds of objects (snapshots), scalars return an error DOM element
+        return element->get (s.key);
+      }
+    }
+  };
+
+  // json_query_set evaluates many compiled queries against one document
+  //  Queries are merged into a prefix tree so that shared prefixes are only traversed once
+  struct json_query_set
+  {
+    using results_type = std::vector<json_element::ptr>;
+
+    json_query_set ()
+    {
+      nodes.emplace_back ();
+    }
+
+    // Adds a query, returns the index of its result in the results of 'evaluate'
+    std::size_t add (json_query const & query)
+    {
+      std::size_t current = 0;
+      for (auto && s : query.segments)
+      {
+        auto found = false;
+        for (auto && child : nodes[current].children)
+        {
+          if (nodes[child].step == s)
+          {
+            current = child;
+            found   = true;
+            break;
+          }
+        }
+
+        if (!found)
+        {
+          auto next = nodes.size ();
+          nodes.emplace_back (s);
+          nodes[current].children.push_back (next);
+          current = next;
+        }
+      }
+
+      auto result = query_count++;
+      nodes[current].queries.push_back (result);
+      return result;
+    }
+
+    // Number of added queries
+    std::size_t size () const noexcept
+    {
+      return query_count;
+    }
+
+    // Evaluates all queries starting at element, results[i] is the result of query i
+    //  Queries that don't match yields an error DOM element
+    void evaluate (json_element::ptr element, results_type & results) const
+    {
+      CPP_JSON__ASSERT (element);
+
+      results.resize (query_count);
+      evaluate (0, element, results);
+    }
+
+    // Evaluates all queries starting at the document root
+    void evaluate (json_document const & doc, results_type & results) const
+    {
+      evaluate (doc.root (), results);
+    }
+
+  private:
+    struct node
+    {
+      json_query::segment       step      ;
+      std::vector<std::size_t>  children  ;
+      std::vector<std::size_t>  queries   ;
+
+      node ()
+        : step (doc_string_type ())
+      {
+      }
+
+      explicit node (json_query::segment const & s)
+        : step (s)
+      {
+      }
+    };
+
+    std::vector<node> nodes       ;
+    std::size_t       query_count = 0;
+
+    void evaluate (std::size_t current, json_element::ptr element, results_type & results) const
+    {
+      auto && n = nodes[current];
+
+      for (auto && q : n.queries)
+      {
+        results[q] = element;
+      }
+
+      for (auto && child : n.children)
+      {
+        evaluate (child, json_query::step (element, nodes[child].step), results);
+      }
+    }
+  };
+
+} }
+
+#endif  // CPP_JSON__QUERY_H
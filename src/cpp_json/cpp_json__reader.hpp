@@ -0,0 +1,563 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__READER_H
+#define CPP_JSON__READER_H
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cpp_json__parser.hpp"
+
+namespace cpp_json { namespace parser
+{
+  enum class json_token
+  {
+    none        ,
+    error       ,
+    eos         ,
+    array_begin ,
+    array_end   ,
+    object_begin,
+    member_key  ,
+    object_end  ,
+    null_value  ,
+    bool_value  ,
+    number_value,
+    string_value,
+  };
+
+  namespace details
+  {
+    // Appends UTF-16 code units from escape sequences to a string
+    template<typename TChar>
+    struct json_escape_appender;
+
+    template<>
+    struct json_escape_appender<wchar_t>
+    {
+      inline void append (std::wstring & s, wchar_t ch)
+      {
+        s.push_back (ch);
+      }
+
+      inline void flush (std::wstring & /*s*/) noexcept
+      {
+      }
+    };
+
+    // Encodes UTF-16 code units as UTF-8, surrogate pairs are combined
+    //  and unpaired surrogates are replaced by U+FFFD
+    template<>
+    struct json_escape_appender<char>
+    {
+      inline void append (std::string & s, wchar_t ch)
+      {
+        auto c = static_cast<unsigned long> (ch);
+
+        if (c >= 0xDC00 && c <= 0xDFFF && high != 0)
+        {
+          encode (s, 0x10000 + ((high - 0xD800) << 10) + (c - 0xDC00));
+          high = 0;
+          return;
+        }
+
+        flush (s);
+
+        if (c >= 0xD800 && c <= 0xDBFF)
+        {
+          high = c;
+        }
+        else if (c >= 0xDC00 && c <= 0xDFFF)
+        {
+          encode (s, 0xFFFD);
+        }
+        else
+        {
+          encode (s, c);
+        }
+      }
+
+      inline void flush (std::string & s)
+      {
+        if (high != 0)
+        {
+          high = 0;
+          encode (s, 0xFFFD);
+        }
+      }
+
+    private:
+      unsigned long high = 0;
+
+      static void encode (std::string & s, unsigned long c)
+      {
+        if (c < 0x80)
+        {
+          s.push_back (static_cast<char> (c));
+        }
+        else if (c < 0x800)
+        {
+          s.push_back (static_cast<char> (0xC0 | (c >> 6)));
+          s.push_back (static_cast<char> (0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+          s.push_back (static_cast<char> (0xE0 | (c >> 12)));
+          s.push_back (static_cast<char> (0x80 | ((c >> 6) & 0x3F)));
+          s.push_back (static_cast<char> (0x80 | (c & 0x3F)));
+        }
+        else
+        {
+          s.push_back (static_cast<char> (0xF0 | (c >> 18)));
+          s.push_back (static_cast<char> (0x80 | ((c >> 12) & 0x3F)));
+          s.push_back (static_cast<char> (0x80 | ((c >> 6) & 0x3F)));
+          s.push_back (static_cast<char> (0x80 | (c & 0x3F)));
+        }
+      }
+    };
+
+    // Records the last scalar found by the parser kernels
+    template<typename TChar, typename TIter>
+    struct json_reader_context
+    {
+      using char_type   = TChar                       ;
+      using string_type = std::basic_string<char_type>;
+      using iter_type   = TIter                       ;
+
+      string_type                     value   ;
+      double                          number  = 0.0;
+      bool                            boolean = false;
+      json_token                      token   = json_token::none;
+      json_escape_appender<char_type> escapes ;
+
+      inline void expected_char     (std::size_t /*pos*/, char_type /*ch*/) noexcept                  {}
+      inline void expected_chars    (std::size_t /*pos*/, string_type const & /*chs*/) noexcept       {}
+      inline void expected_token    (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+      inline void unexpected_token  (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+
+      inline void clear_string ()
+      {
+        value.clear ();
+      }
+
+      inline void push_char (char_type ch)
+      {
+        escapes.flush (value);
+        value.push_back (ch);
+      }
+
+      inline void push_wchar_t (wchar_t ch)
+      {
+        escapes.append (value, ch);
+      }
+
+      inline string_type const & get_string ()
+      {
+        escapes.flush (value);
+        return value;
+      }
+
+      inline bool array_begin       () noexcept                                                       { token = json_token::array_begin ; return true; }
+      inline bool array_end         () noexcept                                                       { token = json_token::array_end   ; return true; }
+      inline bool object_begin      () noexcept                                                       { token = json_token::object_begin; return true; }
+      inline bool member_key        (string_type const & /*s*/) noexcept                              { token = json_token::member_key  ; return true; }
+      inline bool object_end        () noexcept                                                       { token = json_token::object_end  ; return true; }
+      inline bool null_value        () noexcept                                                       { token = json_token::null_value  ; return true; }
+      inline bool string_value      (string_type const & /*s*/) noexcept                              { token = json_token::string_value; return true; }
+
+      inline bool bool_value (bool b) noexcept
+      {
+        token   = json_token::bool_value;
+        boolean = b;
+        return true;
+      }
+
+      inline bool number_value (double d) noexcept
+      {
+        token   = json_token::number_value;
+        number  = d;
+        return true;
+      }
+    };
+  }
+
+  // basic_json_reader is a pull parser, each call to next returns the next token
+  //  Parsing is paused between calls so the caller controls the flow, for example a
+  //  recursive descent deserializer can call next as it descends into the input.
+  //  The reader uses the same kernels as json_parser and reuses its string buffer so
+  //  reading tokens doesn't allocate (except when the nesting grows beyond 64 levels or
+  //  a string is longer than any seen before).
+  //
+  //  Like json_parser the root value must be an array or an object.
+  //  After json_token::error or json_token::eos next keeps returning the same token.
+  //
+  //  The reader is also an input range of tokens:
+  //    for (auto token : reader) { ... }
+  //  iterates until eos or error (neither is included).
+  //
+  //  TIter is the input "iterator", typically TChar const * (see also json_block_iterator)
+  template<typename TChar, typename TIter = TChar const *>
+  struct basic_json_reader
+  {
+    using char_type   = TChar                       ;
+    using string_type = std::basic_string<char_type>;
+    using iter_type   = TIter                       ;
+
+    basic_json_reader (iter_type begin, iter_type end)
+      : parser  (begin, end)
+      , state   (state_type::root_value)
+    {
+      stack.reserve (64);
+      parser.value.reserve (64);
+      parser.consume__white_space ();
+    }
+
+    basic_json_reader (basic_json_reader const &)             = delete;
+    basic_json_reader & operator= (basic_json_reader const &) = delete;
+
+    // Reads the next token
+    json_token next ()
+    {
+      parser.token = read ();
+      return parser.token;
+    }
+
+    // The current token
+    json_token token () const noexcept
+    {
+      return parser.token;
+    }
+
+    // The member name (member_key) or the string (string_value) of the current token
+    //  The reference is valid until the next call to next
+    string_type const & string () const noexcept
+    {
+      return parser.value;
+    }
+
+    // The number of the current token (number_value)
+    double number () const noexcept
+    {
+      return parser.number;
+    }
+
+    // The boolean of the current token (bool_value)
+    bool boolean () const noexcept
+    {
+      return parser.boolean;
+    }
+
+    // The number of open arrays and objects
+    std::size_t depth () const noexcept
+    {
+      return stack.size ();
+    }
+
+    // Gets current reader position, on error it's the position of the error
+    std::size_t pos () const noexcept
+    {
+      return parser.pos ();
+    }
+
+    // Skips the contents of the current token without producing any tokens
+    //  array_begin/object_begin : skips to the end of the container, the token becomes array_end/object_end
+    //  member_key               : skips the member value
+    //  Returns false if the current token is something else or if skip failed
+    //  Like json_decision::skip skipped values are only checked for balanced brackets and terminated strings
+    bool skip ()
+    {
+      switch (parser.token)
+      {
+      case json_token::array_begin:
+      case json_token::object_begin:
+        if (!parser.try_skip__container ())
+        {
+          fail ();
+          return false;
+        }
+        parser.token = parser.token == json_token::array_begin
+          ? json_token::array_end
+          : json_token::object_end
+          ;
+        stack.pop_back ();
+        state = after_value ();
+        return true;
+      case json_token::member_key:
+        if (!parser.try_skip__value ())
+        {
+          fail ();
+          return false;
+        }
+        state = state_type::object_next;
+        return true;
+      default:
+        return false;
+      }
+    }
+
+    struct iterator
+    {
+      using iterator_category = std::input_iterator_tag ;
+      using value_type        = json_token              ;
+      using difference_type   = std::ptrdiff_t          ;
+      using pointer           = json_token const *      ;
+      using reference         = json_token const &      ;
+
+      explicit iterator (basic_json_reader * r = nullptr) noexcept
+        : reader (r)
+      {
+        if (reader && !is_token (reader->token ()))
+        {
+          increment ();
+        }
+      }
+
+      json_token const & operator* () const noexcept
+      {
+        return reader->parser.token;
+      }
+
+      iterator & operator++ ()
+      {
+        increment ();
+        return *this;
+      }
+
+      bool operator== (iterator const & o) const noexcept
+      {
+        return reader == o.reader;
+      }
+
+      bool operator!= (iterator const & o) const noexcept
+      {
+        return reader != o.reader;
+      }
+
+    private:
+      basic_json_reader * reader;
+
+      static bool is_token (json_token t) noexcept
+      {
+        return t != json_token::none && t != json_token::eos && t != json_token::error;
+      }
+
+      void increment ()
+      {
+        if (!is_token (reader->next ()))
+        {
+          reader = nullptr;
+        }
+      }
+    };
+
+    // Starts at the next token unless the current token hasn't been consumed by a range loop yet
+    iterator begin ()
+    {
+      return iterator (this);
+    }
+
+    iterator end () noexcept
+    {
+      return iterator ();
+    }
+
+  private:
+    enum class state_type
+    {
+      root_value  ,
+      root_end    ,
+      array_first ,
+      array_next  ,
+      object_first,
+      object_next ,
+      member_value,
+      done        ,
+      failed      ,
+    };
+
+    using parser_type = json_parser<details::json_reader_context<char_type, iter_type>>;
+
+    parser_type       parser  ;
+    state_type        state   ;
+    std::vector<bool> stack   ; // true for arrays, false for objects
+
+    inline json_token fail () noexcept
+    {
+      state = state_type::failed;
+      return json_token::error;
+    }
+
+    inline state_type after_value () const noexcept
+    {
+      if (stack.empty ())
+      {
+        return state_type::root_end;
+      }
+      else
+      {
+        return stack.back () ? state_type::array_next : state_type::object_next;
+      }
+    }
+
+    json_token read ()
+    {
+      switch (state)
+      {
+      case state_type::root_value:
+        if (parser.test__char ('[') || parser.test__char ('{'))
+        {
+          return read_value ();
+        }
+        else
+        {
+          return fail ();
+        }
+      case state_type::root_end:
+        if (parser.eos ())
+        {
+          state = state_type::done;
+          return json_token::eos;
+        }
+        else
+        {
+          return fail ();
+        }
+      case state_type::array_first:
+        return parser.test__char (']') ? read_end (']') : read_value ();
+      case state_type::array_next:
+        if (parser.test__char (']'))
+        {
+          return read_end (']');
+        }
+        else
+        {
+          return parser.try_consume__delimiter (false) ? read_value () : fail ();
+        }
+      case state_type::object_first:
+        return parser.test__char ('}') ? read_end ('}') : read_key ();
+      case state_type::object_next:
+        if (parser.test__char ('}'))
+        {
+          return read_end ('}');
+        }
+        else
+        {
+          return parser.try_consume__delimiter (false) ? read_key () : fail ();
+        }
+      case state_type::member_value:
+        return read_value ();
+      case state_type::done:
+        return json_token::eos;
+      default:
+        return json_token::error;
+      }
+    }
+
+    json_token read_end (char c)
+    {
+      parser.adv ();
+      parser.consume__white_space ();
+      stack.pop_back ();
+      state = after_value ();
+      return c == ']' ? json_token::array_end : json_token::object_end;
+    }
+
+    json_token read_key ()
+    {
+      if (
+            parser.try_parse__string_impl ()
+        &&  parser.consume__white_space   ()
+        &&  parser.try_consume__char      (':')
+        &&  parser.consume__white_space   ()
+        )
+      {
+        state = state_type::member_value;
+        return json_token::member_key;
+      }
+      else
+      {
+        return fail ();
+      }
+    }
+
+    json_token read_value ()
+    {
+      if (parser.eos ())
+      {
+        return fail ();
+      }
+
+      switch (parser.ch ())
+      {
+      case '[':
+        parser.adv ();
+        parser.consume__white_space ();
+        stack.push_back (true);
+        state = state_type::array_first;
+        return json_token::array_begin;
+      case '{':
+        parser.adv ();
+        parser.consume__white_space ();
+        stack.push_back (false);
+        state = state_type::object_first;
+        return json_token::object_begin;
+      case 'n':
+        return read_scalar (parser.try_parse__null ());
+      case 't':
+        return read_scalar (parser.try_parse__true ());
+      case 'f':
+        return read_scalar (parser.try_parse__false ());
+      case '"':
+        return read_scalar (parser.try_parse__string ());
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+        return read_scalar (parser.try_parse__number ());
+      default:
+        return fail ();
+      }
+    }
+
+    json_token read_scalar (bool result)
+    {
+      if (result && parser.consume__white_space ())
+      {
+        state = after_value ();
+        return parser.token;
+      }
+      else
+      {
+        return fail ();
+      }
+    }
+  };
+
+  using json_reader       = basic_json_reader<wchar_t>;
+  using json_utf8_reader  = basic_json_reader<char>   ;
+
+} }
+
+#endif  // CPP_JSON__READER_H
@@ -0,0 +1,905 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__SNAPSHOT_H
+#define CPP_JSON__SNAPSHOT_H
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#   define NOMINMAX
+# endif
+# ifndef WIN32_LEAN_AND_MEAN
+#   define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "cpp_json__document.hpp"
+
+namespace cpp_json { namespace document
+{
+  namespace details
+  {
+    // A snapshot image is position independent, all references are offsets from
+    //  the start of the image and all fields are 64-bit aligned:
+    //
+    //    header
+    //    nodes         children are written before their parents, the root last
+    //    string table  entries are (length, chars padded to 64 bits), each string
+    //                  is stored once and referenced by offset from the table start
+    //
+    //  A node starts with a word holding the tag (low 8 bits) and the node index:
+    //    null, false, true   tag                     (stored once per image)
+    //    number              tag, double
+    //    string              tag, string
+    //    array               tag, count, count * child
+    //    object              tag, count, count * (name string, hash_key (name), child)
+    //
+    //  The image uses the byte order and doc_char_type of the writer, the header
+    //  records both and load rejects images that don't match.
+    enum class snapshot_tag : std::uint8_t
+    {
+      null_value    ,
+      false_value   ,
+      true_value    ,
+      number_value  ,
+      string_value  ,
+      array_value   ,
+      object_value  ,
+    };
+
+    struct snapshot_header
+    {
+      char          magic       [8] ;
+      std::uint32_t version         ;
+      std::uint32_t char_size       ;
+      std::uint64_t byte_order      ;
+      std::uint64_t size            ; // The size of the image
+      std::uint64_t root            ; // The offset of the root node
+      std::uint64_t nodes           ; // The number of nodes
+      std::uint64_t strings         ; // The offset of the string table
+      std::uint64_t reserved        ;
+    };
+
+    constexpr char          snapshot_magic []     = "cppjsnap";
+    constexpr std::uint32_t snapshot_version      = 1;
+    constexpr std::uint64_t snapshot_byte_order   = 0x0102030405060708ULL;
+
+    inline std::size_t snapshot_padded (std::size_t size) noexcept
+    {
+      return (size + 7) & ~static_cast<std::size_t> (7);
+    }
+
+    // Writes the nodes of a document with json_element_visitor, 'last' is the offset
+    //  of the last written node
+    struct snapshot_writer : json_element_visitor
+    {
+      std::vector<char> &                               image   ;
+      std::vector<char>                                 strings ;
+      std::unordered_map<doc_string_type, std::uint64_t> interned;
+      std::uint64_t                                     nodes   ;
+      std::uint64_t                                     last    ;
+      std::uint64_t                                     scalars [3];  // null, false and true
+
+      explicit snapshot_writer (std::vector<char> & image)
+        : image   (image)
+        , nodes   (0)
+        , last    (0)
+        , scalars {0, 0, 0}
+      {
+      }
+
+      void word (std::vector<char> & target, std::uint64_t w)
+      {
+        char bytes[sizeof (w)];
+        std::memcpy (bytes, &w, sizeof (w));
+        target.insert (target.end (), bytes, bytes + sizeof (w));
+      }
+
+      void begin_node (snapshot_tag tag)
+      {
+        last = image.size ();
+        word (image, static_cast<std::uint64_t> (tag) | (nodes << 8));
+        ++nodes;
+      }
+
+      // Adds s to the string table unless already there
+      template<typename TString>
+      std::uint64_t string (TString const & s)
+      {
+        auto key  = doc_string_type (s.data (), s.size ());
+        auto find = interned.find (key);
+        if (find != interned.end ())
+        {
+          return find->second;
+        }
+
+        auto offset = static_cast<std::uint64_t> (strings.size ());
+        word (strings, s.size ());
+
+        auto bytes = s.size () * sizeof (doc_char_type);
+        auto chars = reinterpret_cast<char const *> (s.data ());
+        strings.insert (strings.end (), chars, chars + bytes);
+        strings.resize (snapshot_padded (strings.size ()), 0);
+
+        interned.emplace (std::move (key), offset);
+        return offset;
+      }
+
+      void scalar (snapshot_tag tag)
+      {
+        auto && offset = scalars[static_cast<std::size_t> (tag)];
+        if (offset == 0)
+        {
+          begin_node (tag);
+          offset = last;
+        }
+        last = offset;
+      }
+
+      std::uint64_t child (json_element::ptr c)
+      {
+        if (c)
+        {
+          c->apply (*this);
+        }
+        else
+        {
+          scalar (snapshot_tag::null_value);
+        }
+        return last;
+      }
+
+      bool visit (json_element__null    const & /*v*/) override
+      {
+        scalar (snapshot_tag::null_value);
+        return true;
+      }
+
+      bool visit (json_element__bool    const & v) override
+      {
+        scalar (v.value ? snapshot_tag::true_value : snapshot_tag::false_value);
+        return true;
+      }
+
+      bool visit (json_element__number  const & v) override
+      {
+        std::uint64_t w;
+        std::memcpy (&w, &v.value, sizeof (w));
+
+        begin_node (snapshot_tag::number_value);
+        word (image, w);
+        return true;
+      }
+
+      bool visit (json_element__string  const & v) override
+      {
+        auto s = string (v.value);
+
+        begin_node (snapshot_tag::string_value);
+        word (image, s);
+        return true;
+      }
+
+      bool visit (json_element__array   const & v) override
+      {
+        std::vector<std::uint64_t> children;
+        children.reserve (v.members.size ());
+        for (auto && c : v.members)
+        {
+          children.push_back (child (c));
+        }
+
+        begin_node (snapshot_tag::array_value);
+        word (image, children.size ());
+        for (auto && c : children)
+        {
+          word (image, c);
+        }
+        return true;
+      }
+
+      bool visit (json_element__object  const & v) override
+      {
+        std::vector<std::uint64_t> children;
+        children.reserve (3 * v.members.size ());
+        for (auto && kv : v.members)
+        {
+          children.push_back (string (std::get<0> (kv)));
+          children.push_back (std::get<2> (kv));
+          children.push_back (child (std::get<1> (kv)));
+        }
+
+        begin_node (snapshot_tag::object_value);
+        word (image, v.members.size ());
+        for (auto && c : children)
+        {
+          word (image, c);
+        }
+        return true;
+      }
+
+      // Documents don't contain error elements, written as null
+      bool visit (json_element__error   const & /*v*/) override
+      {
+        scalar (snapshot_tag::null_value);
+        return true;
+      }
+    };
+
+    // The image of a snapshot document, either owned or a read-only file mapping
+    struct snapshot_image
+    {
+      snapshot_image () noexcept
+        : data    (nullptr)
+        , size    (0)
+#ifdef _WIN32
+        , mapping (nullptr)
+#endif
+      {
+      }
+
+      ~snapshot_image ()
+      {
+#ifdef _WIN32
+        if (mapping)
+        {
+          UnmapViewOfFile (data);
+          CloseHandle (mapping);
+        }
+#else
+        if (owned.empty () && data)
+        {
+          munmap (const_cast<char *> (data), size);
+        }
+#endif
+      }
+
+      CPP_JSON__NO_COPY_MOVE (snapshot_image);
+
+      void own (std::vector<char> && image) noexcept
+      {
+        owned = std::move (image);
+        data  = owned.data ();
+        size  = owned.size ();
+      }
+
+      bool map (std::string const & file_name)
+      {
+#ifdef _WIN32
+        auto file = CreateFileA (file_name.c_str (), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+          return false;
+        }
+
+        LARGE_INTEGER sz;
+        auto result = GetFileSizeEx (file, &sz) && sz.QuadPart > 0;
+        if (result)
+        {
+          mapping = CreateFileMappingA (file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+          data    = mapping ? static_cast<char const *> (MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+          size    = static_cast<std::size_t> (sz.QuadPart);
+          if (mapping && !data)
+          {
+            CloseHandle (mapping);
+            mapping = nullptr;
+          }
+          result = data != nullptr;
+        }
+
+        CloseHandle (file);
+        return result;
+#else
+        auto fd = open (file_name.c_str (), O_RDONLY);
+        if (fd < 0)
+        {
+          return false;
+        }
+
+        struct stat st;
+        auto result = fstat (fd, &st) == 0 && st.st_size > 0;
+        if (result)
+        {
+          auto p = mmap (nullptr, static_cast<std::size_t> (st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+          result = p != MAP_FAILED;
+          if (result)
+          {
+            data = static_cast<char const *> (p);
+            size = static_cast<std::size_t> (st.st_size);
+          }
+        }
+
+        close (fd);
+        return result;
+#endif
+      }
+
+      char const *      data    ;
+      std::size_t       size    ;
+
+    private:
+      std::vector<char> owned   ;
+#ifdef _WIN32
+      HANDLE            mapping ;
+#endif
+    };
+
+    struct json_document__snapshot;
+
+    // A view of a node of a snapshot, views are created on first access
+    struct json_element__snapshot : json_element
+    {
+      constexpr static std::uint64_t error_offset = 0;
+
+      json_document__snapshot const * doc     ;
+      std::uint64_t const             offset  ; // error_offset for the error element
+
+      inline json_element__snapshot (json_document__snapshot const * doc, std::uint64_t offset) noexcept
+        : doc     (doc)
+        , offset  (offset)
+      {
+      }
+
+      inline snapshot_tag         tag     () const noexcept;
+      inline std::uint64_t        word    (std::size_t idx) const noexcept;
+      inline doc_string_type      string  (std::uint64_t s) const;
+      inline ptr                  element (std::uint64_t node) const;
+      inline ptr                  error_element () const noexcept;
+
+      bool is_container () const noexcept
+      {
+        return offset != error_offset && (tag () == snapshot_tag::array_value || tag () == snapshot_tag::object_value);
+      }
+
+      std::size_t size () const override
+      {
+        return is_container () ? static_cast<std::size_t> (word (1)) : 0;
+      }
+
+      ptr at (std::size_t idx) const override
+      {
+        if (!is_container () || idx >= size ())
+        {
+          return error_element ();
+        }
+
+        return tag () == snapshot_tag::array_value
+          ? element (word (2 + idx))
+          : element (word (2 + 3*idx + 2))
+          ;
+      }
+
+      ptr get (doc_string_type const & name) const override
+      {
+        if (offset == error_offset || tag () != snapshot_tag::object_value)
+        {
+          return error_element ();
+        }
+
+        auto hash = hash_key (name);
+        auto sz   = size ();
+        for (auto iter = 0U; iter < sz; ++iter)
+        {
+          auto m = 2 + 3*iter;
+          if (word (m + 1) == hash && string (word (m)) == name)
+          {
+            return element (word (m + 2));
+          }
+        }
+
+        return error_element ();
+      }
+
+      doc_strings_type names () const override
+      {
+        doc_strings_type result;
+        if (offset != error_offset && tag () == snapshot_tag::object_value)
+        {
+          auto sz = size ();
+          result.reserve (sz);
+          for (auto iter = 0U; iter < sz; ++iter)
+          {
+            result.push_back (string (word (2 + 3*iter)));
+          }
+        }
+        return result;
+      }
+
+      bool is_error () const override
+      {
+        return offset == error_offset;
+      }
+
+      bool is_scalar () const override
+      {
+        return !is_container ();
+      }
+
+      bool is_array () const override
+      {
+        return offset != error_offset && tag () == snapshot_tag::array_value;
+      }
+
+      bool is_null () const override
+      {
+        return offset != error_offset && tag () == snapshot_tag::null_value;
+      }
+
+      bool as_bool () const override
+      {
+        if (offset == error_offset)
+        {
+          return false;
+        }
+
+        switch (tag ())
+        {
+        case snapshot_tag::true_value:
+          return true;
+        case snapshot_tag::number_value:
+          return number () != 0.0;
+        case snapshot_tag::string_value:
+          return string (word (1)).size () > 0;
+        default:
+          return false;
+        }
+      }
+
+      double as_number () const override
+      {
+        if (offset == error_offset)
+        {
+          return 0.0;
+        }
+
+        switch (tag ())
+        {
+        case snapshot_tag::true_value:
+          return 1.0;
+        case snapshot_tag::number_value:
+          return number ();
+        case snapshot_tag::string_value:
+          {
+            auto s = string (word (1));
+            doc_char_type * e = nullptr;
+            return std::wcstof (s.c_str (), &e);
+          }
+        default:
+          return 0.0;
+        }
+      }
+
+      doc_string_type as_string () const override
+      {
+        if (offset == error_offset)
+        {
+          return L"\"error\"";
+        }
+
+        switch (tag ())
+        {
+        case snapshot_tag::null_value:
+          return L"null";
+        case snapshot_tag::false_value:
+          return L"false";
+        case snapshot_tag::true_value:
+          return L"true";
+        case snapshot_tag::number_value:
+          {
+            doc_string_type result;
+            result.reserve (default_size);
+            to_string (result, number ());
+            return result;
+          }
+        case snapshot_tag::string_value:
+          return string (word (1));
+        default:
+          return doc_string_type ();
+        }
+      }
+
+      // Visitors expect document elements so equivalent temporary elements
+      //  are visited, members of containers are snapshot elements
+      bool apply (json_element_visitor & v) const override
+      {
+        if (offset == error_offset)
+        {
+          json_element__error e (nullptr);
+          return v.visit (e);
+        }
+
+        switch (tag ())
+        {
+        case snapshot_tag::null_value:
+          {
+            json_element__null e (nullptr);
+            return v.visit (e);
+          }
+        case snapshot_tag::false_value:
+        case snapshot_tag::true_value:
+          {
+            json_element__bool e (nullptr, tag () == snapshot_tag::true_value);
+            return v.visit (e);
+          }
+        case snapshot_tag::number_value:
+          {
+            json_element__number e (nullptr, number ());
+            return v.visit (e);
+          }
+        case snapshot_tag::string_value:
+          {
+            auto s = string (word (1));
+            json_element__string e (nullptr, node_string (s.data (), s.size (), json_new_delete_resource ()));
+            return v.visit (e);
+          }
+        case snapshot_tag::array_value:
+          {
+            auto sz = size ();
+            array_members members (json_new_delete_resource ());
+            members.reserve (sz);
+            for (auto iter = 0U; iter < sz; ++iter)
+            {
+              members.push_back (at (iter));
+            }
+            json_element__array e (nullptr, std::move (members));
+            return v.visit (e);
+          }
+        case snapshot_tag::object_value:
+          {
+            auto sz = size ();
+            object_members members (json_new_delete_resource ());
+            members.reserve (sz);
+            for (auto iter = 0U; iter < sz; ++iter)
+            {
+              auto m = 2 + 3*iter;
+              auto s = string (word (m));
+              members.push_back (std::make_tuple (node_string (s.data (), s.size (), json_new_delete_resource ()), element (word (m + 2)), static_cast<std::size_t> (word (m + 1))));
+            }
+            json_element__object e (nullptr, std::move (members));
+            return v.visit (e);
+          }
+        default:
+          return false;
+        }
+      }
+
+    private:
+      double number () const noexcept
+      {
+        auto w = word (1);
+        double d;
+        std::memcpy (&d, &w, sizeof (d));
+        return d;
+      }
+    };
+
+    struct json_document__snapshot : json_document
+    {
+      using tptr = std::shared_ptr<json_document__snapshot>;
+
+      snapshot_image          image       ;
+      snapshot_header const * header      ;
+      json_element__snapshot  error_value ;
+
+      json_document__snapshot ()
+        : header      (nullptr)
+        , error_value (this, json_element__snapshot::error_offset)
+        , slots       (nullptr)
+      {
+      }
+
+      // Views are never destroyed, they own nothing and destroying them would touch
+      //  the slots of every node
+      ~json_document__snapshot ()
+      {
+        std::free (slots);
+      }
+
+      // Checks the header and prepares the view slots, nodes are checked by element
+      bool open ()
+      {
+        if (
+              image.size < sizeof (snapshot_header)
+          ||  reinterpret_cast<std::uintptr_t> (image.data) % alignof (std::uint64_t) != 0
+           )
+        {
+          return false;
+        }
+
+        header = reinterpret_cast<snapshot_header const *> (image.data);
+
+        if (
+              std::memcmp (header->magic, snapshot_magic, sizeof (header->magic)) != 0
+          ||  header->version     != snapshot_version
+          ||  header->char_size   != sizeof (doc_char_type)
+          ||  header->byte_order  != snapshot_byte_order
+          ||  header->size        != image.size
+          ||  header->root        <  sizeof (snapshot_header)
+          ||  header->root        >= header->strings
+          ||  header->strings     >  image.size
+          ||  header->strings % sizeof (std::uint64_t) != 0
+          ||  header->nodes       == 0
+          ||  header->nodes       >  image.size
+          )
+        {
+          return false;
+        }
+
+        // Zeroed memory from calloc is typically mapped on first touch so only
+        //  the slots of accessed nodes cost memory
+        slots = static_cast<slot *> (std::calloc (static_cast<std::size_t> (header->nodes), sizeof (slot)));
+        return slots != nullptr;
+      }
+
+      json_element::ptr root () const override
+      {
+        return element (header->root);
+      }
+
+      doc_string_type to_string () const override
+      {
+        details::json_element_visitor__to_string visitor;
+        root ()->apply (visitor);
+        return std::move (visitor.value);
+      }
+
+      json_memory_usage memory_usage () const override
+      {
+        json_memory_usage usage;
+        usage.document = sizeof (*this) + static_cast<std::size_t> (header->nodes) * sizeof (slot);
+        usage.snapshot = image.size;
+        return usage;
+      }
+
+      // Snapshots are read-only
+      ptr set_null    (doc_strings_type const & /*path*/) const                           override { return ptr (); }
+      ptr set_bool    (doc_strings_type const & /*path*/, bool /*v*/) const               override { return ptr (); }
+      ptr set_number  (doc_strings_type const & /*path*/, double /*v*/) const             override { return ptr (); }
+      ptr set_string  (doc_strings_type const & /*path*/, doc_string_type /*v*/) const    override { return ptr (); }
+      ptr set_element (doc_strings_type const & /*path*/, json_element::ptr /*v*/) const  override { return ptr (); }
+      ptr erase       (doc_strings_type const & /*path*/) const                           override { return ptr (); }
+
+      std::uint64_t word (std::uint64_t offset) const noexcept
+      {
+        CPP_JSON__ASSERT (offset + sizeof (std::uint64_t) <= image.size);
+        return *reinterpret_cast<std::uint64_t const *> (image.data + offset);
+      }
+
+      // Gets the string at offset 's' of the string table, empty if the entry isn't
+      //  inside the image
+      doc_string_type string (std::uint64_t s) const
+      {
+        auto table  = image.size - header->strings;
+        if (s % sizeof (std::uint64_t) != 0 || s >= table || table - s < sizeof (std::uint64_t))
+        {
+          return doc_string_type ();
+        }
+
+        auto offset = header->strings + s;
+        auto sz     = word (offset);
+        if (sz > (table - s - sizeof (std::uint64_t)) / sizeof (doc_char_type))
+        {
+          return doc_string_type ();
+        }
+
+        return doc_string_type (
+            reinterpret_cast<doc_char_type const *> (image.data + offset + sizeof (std::uint64_t))
+          , static_cast<std::size_t> (sz)
+          );
+      }
+
+      // Gets the view of the node at 'offset', creating it on first access
+      //  Images loaded from files may be corrupt, nodes that aren't inside the
+      //  node area or that have an unknown tag or index are error elements
+      json_element::ptr element (std::uint64_t offset) const
+      {
+        if (
+              offset % sizeof (std::uint64_t) != 0
+          ||  offset < sizeof (snapshot_header)
+          ||  offset >= header->strings
+           )
+        {
+          return &error_value;
+        }
+
+        auto head   = word (offset);
+        auto index  = head >> 8;
+        auto words  = (header->strings - offset) / sizeof (std::uint64_t);
+        if (index >= header->nodes || !node_fits (static_cast<snapshot_tag> (head & 0xFF), offset, words))
+        {
+          return &error_value;
+        }
+
+        auto && s = slots[index];
+        if (s.state.load (std::memory_order_acquire) != slot_ready)
+        {
+          std::uint8_t expected = slot_empty;
+          if (s.state.compare_exchange_strong (expected, slot_creating, std::memory_order_acq_rel))
+          {
+            new (&s.storage) json_element__snapshot (this, offset);
+            s.state.store (slot_ready, std::memory_order_release);
+          }
+          else
+          {
+            while (s.state.load (std::memory_order_acquire) != slot_ready)
+            {
+              std::this_thread::yield ();
+            }
+          }
+        }
+
+        // Nodes of a corrupt image may share an index
+        auto view = reinterpret_cast<json_element__snapshot const *> (&s.storage);
+        return view->offset == offset ? view : &error_value;
+      }
+
+    private:
+      // Checks that the node fits in the 'words' words left of the node area
+      bool node_fits (snapshot_tag tag, std::uint64_t offset, std::uint64_t words) const noexcept
+      {
+        switch (tag)
+        {
+        case snapshot_tag::null_value:
+        case snapshot_tag::false_value:
+        case snapshot_tag::true_value:
+          return true;
+        case snapshot_tag::number_value:
+        case snapshot_tag::string_value:
+          return words >= 2;
+        case snapshot_tag::array_value:
+          return words >= 2 && word (offset + sizeof (std::uint64_t)) <= words - 2;
+        case snapshot_tag::object_value:
+          return words >= 2 && word (offset + sizeof (std::uint64_t)) <= (words - 2) / 3;
+        default:
+          return false;
+        }
+      }
+
+      constexpr static std::uint8_t slot_empty    = 0;
+      constexpr static std::uint8_t slot_creating = 1;
+      constexpr static std::uint8_t slot_ready    = 2;
+
+      struct slot
+      {
+        std::atomic<std::uint8_t>                                                                             state   ;
+        typename std::aligned_storage<sizeof (json_element__snapshot), alignof (json_element__snapshot)>::type storage ;
+      };
+
+      slot * slots;
+    };
+
+    inline snapshot_tag json_element__snapshot::tag () const noexcept
+    {
+      return static_cast<snapshot_tag> (doc->word (offset) & 0xFF);
+    }
+
+    inline std::uint64_t json_element__snapshot::word (std::size_t idx) const noexcept
+    {
+      return doc->word (offset + idx * sizeof (std::uint64_t));
+    }
+
+    inline doc_string_type json_element__snapshot::string (std::uint64_t s) const
+    {
+      return doc->string (s);
+    }
+
+    inline json_element::ptr json_element__snapshot::element (std::uint64_t node) const
+    {
+      return doc->element (node);
+    }
+
+    inline json_element::ptr json_element__snapshot::error_element () const noexcept
+    {
+      return &doc->error_value;
+    }
+  }
+
+  // json_snapshot saves a document as a compact binary image and loads it back without
+  //  parsing. A loaded snapshot is a read-only json_document (set_* and erase return an
+  //  empty ptr), elements are views of the image that are created on first access.
+  //  Loading from a file maps it so load time doesn't depend on the size of the document.
+  //  Load checks the header, nodes and strings are checked when accessed so a
+  //  corrupt image reads as error elements and empty strings.
+  struct json_snapshot
+  {
+    // Writes 'doc' as a snapshot image to 'image'
+    static void save (json_document const & doc, std::vector<char> & image)
+    {
+      using namespace details;
+
+      image.clear ();
+      image.resize (sizeof (snapshot_header), 0);
+
+      snapshot_writer writer (image);
+      writer.child (doc.root ());
+
+      snapshot_header header = {};
+      std::memcpy (header.magic, snapshot_magic, sizeof (header.magic));
+      header.version    = snapshot_version;
+      header.char_size  = sizeof (doc_char_type);
+      header.byte_order = snapshot_byte_order;
+      header.root       = writer.last;
+      header.nodes      = writer.nodes;
+      header.strings    = image.size ();
+
+      image.insert (image.end (), writer.strings.begin (), writer.strings.end ());
+      header.size       = image.size ();
+
+      std::memcpy (image.data (), &header, sizeof (header));
+    }
+
+    // Writes 'doc' as a snapshot image to the file 'file_name'
+    static bool save (json_document const & doc, std::string const & file_name)
+    {
+      std::vector<char> image;
+      save (doc, image);
+
+      std::ofstream file (file_name, std::ios::binary);
+      file.write (image.data (), static_cast<std::streamsize> (image.size ()));
+      return file.good ();
+    }
+
+    // Loads a snapshot image, the document owns the image
+    static bool load (std::vector<char> image, json_document::ptr & result)
+    {
+      auto doc = std::make_shared<details::json_document__snapshot> ();
+      doc->image.own (std::move (image));
+      return open (std::move (doc), result);
+    }
+
+    // Loads a snapshot image by mapping the file 'file_name' into memory
+    static bool load (std::string const & file_name, json_document::ptr & result)
+    {
+      auto doc = std::make_shared<details::json_document__snapshot> ();
+      if (!doc->image.map (file_name))
+      {
+        result.reset ();
+        return false;
+      }
+      return open (std::move (doc), result);
+    }
+
+  private:
+    static bool open (details::json_document__snapshot::tptr doc, json_document::ptr & result)
+    {
+      if (doc->open ())
+      {
+        result = std::move (doc);
+        return true;
+      }
+      else
+      {
+        result.reset ();
+        return false;
+      }
+    }
+  };
+} }
+
+#endif  // CPP_JSON__SNAPSHOT_H
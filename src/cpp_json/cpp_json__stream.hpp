@@ -0,0 +1,496 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__STREAM_H
+#define CPP_JSON__STREAM_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpp_json__parser.hpp"
+
+namespace cpp_json { namespace parser
+{
+  // json_block_source produces the input of a json_block_stream in blocks
+  struct json_block_source
+  {
+    json_block_source ()                                      = default;
+    virtual ~json_block_source ()                             = default;
+
+    json_block_source (json_block_source const &)             = delete;
+    json_block_source & operator= (json_block_source const &) = delete;
+
+    // Reads at most 'size' bytes into 'buffer', returns 0 at end of input
+    //  Invoked by the background thread of the stream
+    virtual std::size_t read (char * buffer, std::size_t size) = 0;
+  };
+
+  // Reads blocks from a C stream, works for files and pipes (for example stdin)
+  //  The FILE is not closed by the source
+  //  If reading fails read returns 0 (end of input) and failed returns true, the
+  //  parser then reports an error at the end of the input read so far.
+  struct json_file_source : json_block_source
+  {
+    explicit json_file_source (std::FILE * file) noexcept
+      : file  (file)
+      , error (false)
+    {
+      CPP_JSON__ASSERT (file);
+    }
+
+    // Returns true if reading the C stream failed
+    bool failed () const noexcept
+    {
+      return error;
+    }
+
+    std::size_t read (char * buffer, std::size_t size) override
+    {
+      if (error)
+      {
+        return 0;
+      }
+
+      auto sz = std::fread (buffer, 1, size, file);
+      // A short read is either end of file or an error
+      if (sz < size && std::ferror (file))
+      {
+        error = true;
+      }
+      return sz;
+    }
+
+  private:
+    std::FILE * file  ;
+    bool        error ;
+  };
+
+  // Reads blocks from memory, for example compressed input held in memory
+  struct json_memory_source : json_block_source
+  {
+    json_memory_source (char const * begin, char const * end) noexcept
+      : current (begin)
+      , end     (end)
+    {
+      CPP_JSON__ASSERT (begin <= end);
+    }
+
+    std::size_t read (char * buffer, std::size_t size) override
+    {
+      auto available = static_cast<std::size_t> (end - current);
+      auto sz        = size < available ? size : available;
+      std::copy (current, current + sz, buffer);
+      current += sz;
+      return sz;
+    }
+
+  private:
+    char const *        current ;
+    char const * const  end     ;
+  };
+
+  struct json_block_iterator;
+
+  // json_block_stream overlaps reading and parsing of an input
+  //  A background thread reads the input in blocks while the parser consumes
+  //  earlier blocks. The stream owns 'block_count' blocks of 'block_size' bytes:
+  //  when all blocks are either filled and waiting or in use by the parser the
+  //  thread waits (backpressure) so memory is bounded by block_count*block_size.
+  //  Two blocks are held by the parser (the current and the previous block, as the
+  //  parser may look a few chars back or ahead) so block_count must be at least 3.
+  //  Blocks are filled completely (except the last) and are at least min_block_size
+  //  bytes so looking back or ahead never spans more than one block boundary.
+  //
+  //  If 'background' is false blocks are read on demand by the parsing thread,
+  //  this serializes I/O and parsing and is mainly useful for comparisons.
+  //
+  //  The stream is single pass, begin may only be called once.
+  struct json_block_stream
+  {
+    constexpr static std::size_t default_block_size   = 1 << 20 ;
+    constexpr static std::size_t default_block_count  = 4       ;
+    constexpr static std::size_t min_block_size       = 64      ;
+
+    explicit json_block_stream (
+        json_block_source & source
+      , std::size_t         block_size  = default_block_size
+      , std::size_t         block_count = default_block_count
+      , bool                background  = true
+      )
+      : source      (source)
+      , blocks      (block_count < 3 ? 3 : block_count)
+      , first_seq   (0)
+      , eof         (false)
+      , stop        (false)
+    {
+      for (auto && b : blocks)
+      {
+        b.data.resize (block_size < min_block_size ? min_block_size : block_size);
+        free_blocks.push_back (&b);
+      }
+
+      if (background)
+      {
+        reader = std::thread ([this] () { read_blocks (); });
+      }
+    }
+
+    ~json_block_stream ()
+    {
+      if (reader.joinable ())
+      {
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          stop = true;
+        }
+        free_changed.notify_all ();
+        reader.join ();
+      }
+    }
+
+    json_block_stream (json_block_stream const &)             = delete;
+    json_block_stream & operator= (json_block_stream const &) = delete;
+
+    inline json_block_iterator begin ();
+    inline json_block_iterator end () noexcept;
+
+  private:
+    friend struct json_block_iterator;
+
+    struct block
+    {
+      std::vector<char> data ;
+      std::size_t       size = 0;
+    };
+
+    json_block_source &     source        ;
+    std::vector<block>      blocks        ;
+
+    // Owned by the parsing thread
+    std::deque<block *>     window        ; // Blocks in use by the parser
+    std::size_t             first_seq     ; // Sequence number of window.front ()
+
+    // Shared with the background thread
+    std::mutex              mutex         ;
+    std::condition_variable free_changed  ;
+    std::condition_variable ready_changed ;
+    std::deque<block *>     free_blocks   ;
+    std::deque<block *>     ready_blocks  ;
+    bool                    eof           ;
+    bool                    stop          ;
+
+    std::thread             reader        ;
+
+    void fill (block & b)
+    {
+      b.size = 0;
+      for (;;)
+      {
+        auto read = source.read (b.data.data () + b.size, b.data.size () - b.size);
+        b.size += read;
+        if (read == 0 || b.size == b.data.size ())
+        {
+          return;
+        }
+      }
+    }
+
+    void read_blocks ()
+    {
+      for (;;)
+      {
+        block * b = nullptr;
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          free_changed.wait (lock, [this] () { return stop || !free_blocks.empty (); });
+          if (stop)
+          {
+            return;
+          }
+          b = free_blocks.front ();
+          free_blocks.pop_front ();
+        }
+
+        fill (*b);
+
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          if (b->size == 0)
+          {
+            free_blocks.push_back (b);
+            eof = true;
+          }
+          else
+          {
+            ready_blocks.push_back (b);
+          }
+        }
+        ready_changed.notify_one ();
+
+        if (b->size == 0)
+        {
+          return;
+        }
+      }
+    }
+
+    // Gets the next filled block, nullptr at end of input
+    block * acquire ()
+    {
+      if (!reader.joinable ())
+      {
+        if (eof)
+        {
+          return nullptr;
+        }
+
+        CPP_JSON__ASSERT (!free_blocks.empty ());
+        auto b = free_blocks.front ();
+        free_blocks.pop_front ();
+
+        fill (*b);
+        if (b->size == 0)
+        {
+          free_blocks.push_back (b);
+          eof = true;
+          return nullptr;
+        }
+
+        return b;
+      }
+
+      std::unique_lock<std::mutex> lock (mutex);
+      ready_changed.wait (lock, [this] () { return eof || !ready_blocks.empty (); });
+      if (ready_blocks.empty ())
+      {
+        return nullptr;
+      }
+
+      auto b = ready_blocks.front ();
+      ready_blocks.pop_front ();
+      return b;
+    }
+
+    void release (block * b)
+    {
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        free_blocks.push_back (b);
+      }
+      free_changed.notify_one ();
+    }
+
+    // Gets block 'seq', only the two most recent blocks are retained
+    //  Returns nullptr at end of input
+    block * fetch (std::size_t seq)
+    {
+      CPP_JSON__ASSERT (seq >= first_seq);
+
+      if (seq < first_seq + window.size ())
+      {
+        return window[seq - first_seq];
+      }
+
+      CPP_JSON__ASSERT (seq == first_seq + window.size ());
+
+      auto b = acquire ();
+      if (!b)
+      {
+        return nullptr;
+      }
+
+      window.push_back (b);
+      while (window.size () > 2)
+      {
+        release (window.front ());
+        window.pop_front ();
+        ++first_seq;
+      }
+
+      return b;
+    }
+  };
+
+  // json_block_iterator iterates the chars of a json_block_stream, used as
+  //  iter_type for json_parser contexts. The default constructed iterator is the end.
+  //  Dereferencing the end yields '\0'
+  struct json_block_iterator
+  {
+    using iterator_category = std::forward_iterator_tag ;
+    using value_type        = char                      ;
+    using difference_type   = std::ptrdiff_t            ;
+    using pointer           = char const *              ;
+    using reference         = char                      ;
+
+    json_block_iterator () noexcept = default;
+
+    explicit json_block_iterator (json_block_stream * stream)
+      : stream (stream)
+    {
+      load ();
+    }
+
+    inline char operator* () const noexcept
+    {
+      return current < last ? *current : '\0';
+    }
+
+    inline json_block_iterator & operator++ ()
+    {
+      if (current < last)
+      {
+        if (++current == last)
+        {
+          base += static_cast<std::size_t> (last - first);
+          ++seq;
+          load ();
+        }
+      }
+      else
+      {
+        past = true;
+      }
+      return *this;
+    }
+
+    inline json_block_iterator operator++ (int)
+    {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    inline json_block_iterator operator+ (std::size_t n) const
+    {
+      auto copy = *this;
+      for (; n > 0; --n)
+      {
+        ++copy;
+      }
+      return copy;
+    }
+
+    // The number of chars between two iterators (not valid for the end)
+    friend inline std::ptrdiff_t operator- (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      return static_cast<std::ptrdiff_t> (l.offset ()) - static_cast<std::ptrdiff_t> (r.offset ());
+    }
+
+    friend inline bool operator< (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      if (!r.stream)
+      {
+        return l.stream && !l.at_end ();
+      }
+      else if (!l.stream)
+      {
+        return false;
+      }
+      else
+      {
+        return l.offset () < r.offset ();
+      }
+    }
+
+    friend inline bool operator<= (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      if (!r.stream)
+      {
+        return !l.stream || !l.past;
+      }
+      else
+      {
+        return !(r < l);
+      }
+    }
+
+    friend inline bool operator> (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      return r < l;
+    }
+
+    friend inline bool operator>= (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      return !(l < r);
+    }
+
+    friend inline bool operator== (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      return !(l < r) && !(r < l);
+    }
+
+    friend inline bool operator!= (json_block_iterator const & l, json_block_iterator const & r) noexcept
+    {
+      return !(l == r);
+    }
+
+  private:
+    json_block_stream * stream  = nullptr ;
+    std::size_t         seq     = 0       ;
+    std::size_t         base    = 0       ; // Offset of the first char of the current block
+    char const *        first   = nullptr ;
+    char const *        current = nullptr ;
+    char const *        last    = nullptr ;
+    bool                past    = false   ; // Advanced beyond the end of input
+
+    inline bool at_end () const noexcept
+    {
+      return current >= last;
+    }
+
+    inline std::size_t offset () const noexcept
+    {
+      return base + static_cast<std::size_t> (current - first);
+    }
+
+    void load ()
+    {
+      auto b = stream->fetch (seq);
+      if (b)
+      {
+        first   = b->data.data ();
+        current = first;
+        last    = first + b->size;
+      }
+      else
+      {
+        first   = nullptr;
+        current = nullptr;
+        last    = nullptr;
+      }
+    }
+  };
+
+  inline json_block_iterator json_block_stream::begin ()
+  {
+    return json_block_iterator (this);
+  }
+
+  inline json_block_iterator json_block_stream::end () noexcept
+  {
+    return json_block_iterator ();
+  }
+
+} }
+
+#endif  // CPP_JSON__STREAM_H
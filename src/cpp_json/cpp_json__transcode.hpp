@@ -0,0 +1,1237 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__TRANSCODE_H
+#define CPP_JSON__TRANSCODE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "cpp_json__parser.hpp"
+#include "cpp_json__reader.hpp"
+#include "cpp_json__writer.hpp"
+
+// Transcoding between JSON and the binary formats CBOR (RFC 8949) and MessagePack
+//
+//  JSON to binary: basic_cbor_json_context and basic_msgpack_json_context are json_parser
+//  contexts that encode each value as the parser finds it, no document is built.
+//
+//  Binary to JSON: basic_cbor_reader and basic_msgpack_reader decode an encoded value
+//  and push it to a writer (see basic_json_writer).
+//
+//  json_cbor and json_msgpack wrap both directions:
+//
+//    std::size_t       pos ;
+//    std::vector<char> cbor;
+//    if (json_cbor::from_json (json, pos, cbor)) { ... }
+//
+//    std::string       out ;
+//    if (json_cbor::to_json (cbor, pos, out)) { ... }
+//
+//  Numbers that are integers in the range of std::int64_t are encoded as integers,
+//  other numbers as single precision floats when that's exact and otherwise as double
+//  precision floats. Strings are encoded as UTF-8.
+namespace cpp_json { namespace parser
+{
+  namespace details
+  {
+    // Returns true if d is an integer that fits in std::int64_t (-0 isn't)
+    inline bool is_int64 (double d) noexcept
+    {
+      return
+            d >= -9223372036854775808.0
+        &&  d <   9223372036854775808.0
+        &&  static_cast<double> (static_cast<std::int64_t> (d)) == d
+        &&  !(d == 0 && std::signbit (d))
+        ;
+    }
+
+    // Returns true if d is exactly representable as a float
+    inline bool is_float (double d) noexcept
+    {
+      return
+            std::abs (d) <= std::numeric_limits<float>::max ()
+        &&  static_cast<double> (static_cast<float> (d)) == d
+        ;
+    }
+
+    inline std::uint32_t float_bits (float f) noexcept
+    {
+      std::uint32_t bits;
+      std::memcpy (&bits, &f, sizeof bits);
+      return bits;
+    }
+
+    inline std::uint64_t double_bits (double d) noexcept
+    {
+      std::uint64_t bits;
+      std::memcpy (&bits, &d, sizeof bits);
+      return bits;
+    }
+
+    inline double from_float_bits (std::uint64_t bits) noexcept
+    {
+      auto b = static_cast<std::uint32_t> (bits);
+      float f;
+      std::memcpy (&f, &b, sizeof f);
+      return f;
+    }
+
+    inline double from_double_bits (std::uint64_t bits) noexcept
+    {
+      double d;
+      std::memcpy (&d, &bits, sizeof d);
+      return d;
+    }
+
+    // The part shared by the encoding contexts: string building and output
+    template<typename TChar, typename TIter>
+    struct binary_json_context
+    {
+      using char_type   = TChar                       ;
+      using string_type = std::basic_string<char_type>;
+      using iter_type   = TIter                       ;
+
+      // The encoded value
+      std::vector<char> output;
+
+      inline void expected_char     (std::size_t /*pos*/, char_type /*ch*/) noexcept                  {}
+      inline void expected_chars    (std::size_t /*pos*/, string_type const & /*chs*/) noexcept       {}
+      inline void expected_token    (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+      inline void unexpected_token  (std::size_t /*pos*/, string_type const & /*token*/) noexcept     {}
+
+      inline void clear_string ()
+      {
+        value.clear ();
+      }
+
+      inline void push_char (char_type ch)
+      {
+        escapes.flush (value);
+        value.push_back (ch);
+      }
+
+      inline void push_wchar_t (wchar_t ch)
+      {
+        escapes.append (value, ch);
+      }
+
+      inline string_type const & get_string ()
+      {
+        escapes.flush (value);
+        return value;
+      }
+
+    protected:
+      string_type                     value   ;
+      json_escape_appender<char_type> escapes ;
+      std::string                     utf8    ;
+
+      inline void put (unsigned b)
+      {
+        output.push_back (static_cast<char> (b));
+      }
+
+      // Appends the 'bytes' least significant bytes of v, big endian
+      inline void put_be (std::uint64_t v, std::size_t bytes)
+      {
+        for (auto iter = bytes; iter > 0; --iter)
+        {
+          put (static_cast<unsigned> ((v >> (8 * (iter - 1))) & 0xFF));
+        }
+      }
+
+      inline void put_bytes (std::string const & s)
+      {
+        output.insert (output.end (), s.begin (), s.end ());
+      }
+
+      // char strings are already UTF-8
+      inline std::string const & to_utf8 (std::string const & s) noexcept
+      {
+        return s;
+      }
+
+      // wchar_t strings may contain UTF-16 surrogate pairs (from escapes or as the
+      //  native encoding), they are combined like the escapes for char strings are
+      inline std::string const & to_utf8 (std::wstring const & s)
+      {
+        utf8.clear ();
+        json_escape_appender<char> appender;
+        for (auto ch : s)
+        {
+          appender.append (utf8, ch);
+        }
+        appender.flush (utf8);
+        return utf8;
+      }
+    };
+
+    // Decoding limits shared by the readers
+    enum class binary_limits : std::size_t
+    {
+      // Binary input is nested in a few bytes per level, the limit keeps hostile
+      //  input from exhausting the stack
+      max_depth = 1024,
+    };
+  }
+
+  // basic_cbor_json_context is a json_parser context that encodes JSON as CBOR
+  //
+  //    json_parser<cbor_utf8_json_context> jp (begin, end);
+  //    if (jp.try_parse__json ()) { send (jp.output); }
+  //
+  //  Arrays and objects are encoded with indefinite lengths (terminated by a break)
+  //  as their lengths aren't known when they begin, so nothing is patched or moved.
+  template<typename TChar, typename TIter = TChar const *>
+  struct basic_cbor_json_context : details::binary_json_context<TChar, TIter>
+  {
+    using string_type = typename details::binary_json_context<TChar, TIter>::string_type;
+
+    inline bool array_begin ()
+    {
+      this->put (0x9F);
+      return true;
+    }
+
+    inline bool array_end ()
+    {
+      this->put (0xFF);
+      return true;
+    }
+
+    inline bool object_begin ()
+    {
+      this->put (0xBF);
+      return true;
+    }
+
+    inline bool member_key (string_type const & s)
+    {
+      put_string (s);
+      return true;
+    }
+
+    inline bool object_end ()
+    {
+      this->put (0xFF);
+      return true;
+    }
+
+    inline bool null_value ()
+    {
+      this->put (0xF6);
+      return true;
+    }
+
+    inline bool bool_value (bool b)
+    {
+      this->put (b ? 0xF5 : 0xF4);
+      return true;
+    }
+
+    inline bool number_value (double d)
+    {
+      if (details::is_int64 (d))
+      {
+        auto i = static_cast<std::int64_t> (d);
+        if (i >= 0)
+        {
+          put_head (0, static_cast<std::uint64_t> (i));
+        }
+        else
+        {
+          put_head (1, static_cast<std::uint64_t> (-(i + 1)));
+        }
+      }
+      else if (details::is_float (d))
+      {
+        this->put (0xFA);
+        this->put_be (details::float_bits (static_cast<float> (d)), 4);
+      }
+      else
+      {
+        this->put (0xFB);
+        this->put_be (details::double_bits (d), 8);
+      }
+      return true;
+    }
+
+    inline bool string_value (string_type const & s)
+    {
+      put_string (s);
+      return true;
+    }
+
+  private:
+    // Appends the initial byte of a data item and its argument in the fewest bytes
+    void put_head (unsigned major, std::uint64_t v)
+    {
+      major <<= 5;
+      if (v < 24)
+      {
+        this->put (major | static_cast<unsigned> (v));
+      }
+      else if (v <= 0xFF)
+      {
+        this->put (major | 24);
+        this->put_be (v, 1);
+      }
+      else if (v <= 0xFFFF)
+      {
+        this->put (major | 25);
+        this->put_be (v, 2);
+      }
+      else if (v <= 0xFFFFFFFF)
+      {
+        this->put (major | 26);
+        this->put_be (v, 4);
+      }
+      else
+      {
+        this->put (major | 27);
+        this->put_be (v, 8);
+      }
+    }
+
+    void put_string (string_type const & s)
+    {
+      auto && utf8 = this->to_utf8 (s);
+      put_head (3, utf8.size ());
+      this->put_bytes (utf8);
+    }
+  };
+
+  // basic_msgpack_json_context is a json_parser context that encodes JSON as MessagePack
+  //
+  //  MessagePack has no indefinite lengths so room for the largest header (5 bytes)
+  //  is reserved when an array or object begins and the header is written when it
+  //  ends and its size is known (back-patching). The smallest header that fits is
+  //  used, the unused reserved bytes are removed in a single pass when the outermost
+  //  container ends so each byte is moved at most once.
+  template<typename TChar, typename TIter = TChar const *>
+  struct basic_msgpack_json_context : details::binary_json_context<TChar, TIter>
+  {
+    using string_type = typename details::binary_json_context<TChar, TIter>::string_type;
+
+    basic_msgpack_json_context ()
+    {
+      open.reserve (64);
+      gaps.reserve (64);
+    }
+
+    inline bool array_begin ()
+    {
+      begin_container (true);
+      return true;
+    }
+
+    inline bool array_end ()
+    {
+      end_container (0x90, 0xDC);
+      return true;
+    }
+
+    inline bool object_begin ()
+    {
+      begin_container (false);
+      return true;
+    }
+
+    inline bool member_key (string_type const & s)
+    {
+      ++open.back ().count;
+      put_string (s);
+      return true;
+    }
+
+    inline bool object_end ()
+    {
+      end_container (0x80, 0xDE);
+      return true;
+    }
+
+    inline bool null_value ()
+    {
+      begin_value ();
+      this->put (0xC0);
+      return true;
+    }
+
+    inline bool bool_value (bool b)
+    {
+      begin_value ();
+      this->put (b ? 0xC3 : 0xC2);
+      return true;
+    }
+
+    inline bool number_value (double d)
+    {
+      begin_value ();
+      if (details::is_int64 (d))
+      {
+        auto i = static_cast<std::int64_t> (d);
+        if (i >= 0)
+        {
+          put_uint (static_cast<std::uint64_t> (i));
+        }
+        else
+        {
+          put_int (i);
+        }
+      }
+      else if (details::is_float (d))
+      {
+        this->put (0xCA);
+        this->put_be (details::float_bits (static_cast<float> (d)), 4);
+      }
+      else
+      {
+        this->put (0xCB);
+        this->put_be (details::double_bits (d), 8);
+      }
+      return true;
+    }
+
+    inline bool string_value (string_type const & s)
+    {
+      begin_value ();
+      put_string (s);
+      return true;
+    }
+
+  private:
+    enum
+    {
+      max_header_size = 5,
+    };
+
+    struct container
+    {
+      std::size_t offset  ; // Where the header is reserved
+      std::size_t count   ; // Elements or members
+      bool        is_array;
+    };
+
+    // Reserved bytes not used by a header
+    struct gap
+    {
+      std::size_t offset  ;
+      std::size_t size    ;
+    };
+
+    std::vector<container>  open;
+    std::vector<gap>        gaps;
+
+    // Counts a value if it's an array element, members are counted by their keys
+    inline void begin_value ()
+    {
+      if (!open.empty () && open.back ().is_array)
+      {
+        ++open.back ().count;
+      }
+    }
+
+    void begin_container (bool is_array)
+    {
+      begin_value ();
+      open.push_back (container { this->output.size (), 0, is_array });
+      this->output.resize (this->output.size () + max_header_size);
+    }
+
+    // fix is the fixarray/fixmap prefix, sized16 the array16/map16 type (+1 for 32 bits)
+    void end_container (unsigned fix, unsigned sized16)
+    {
+      auto c = open.back ();
+      open.pop_back ();
+
+      char          header[5];
+      std::size_t   sz = 0;
+      auto          put_header = [&header, &sz] (std::uint64_t v) { header[sz++] = static_cast<char> (v & 0xFF); };
+
+      if (c.count < 16)
+      {
+        put_header (fix | c.count);
+      }
+      else if (c.count <= 0xFFFF)
+      {
+        put_header (sized16);
+        put_header (c.count >> 8);
+        put_header (c.count);
+      }
+      else
+      {
+        put_header (sized16 + 1);
+        put_header (c.count >> 24);
+        put_header (c.count >> 16);
+        put_header (c.count >> 8);
+        put_header (c.count);
+      }
+
+      // The header ends where the content begins, the unused bytes precede it
+      auto && output  = this->output;
+      auto    unused  = max_header_size - sz;
+      std::copy (header, header + sz, output.begin () + static_cast<std::ptrdiff_t> (c.offset + unused));
+      if (unused > 0)
+      {
+        gaps.push_back (gap { c.offset, unused });
+      }
+
+      if (open.empty ())
+      {
+        remove_gaps ();
+      }
+    }
+
+    // Moves the bytes between the gaps down over them
+    void remove_gaps ()
+    {
+      if (gaps.empty ())
+      {
+        return;
+      }
+
+      // Inner containers end first so the gaps are recorded out of order
+      std::sort (gaps.begin (), gaps.end (), [] (gap const & l, gap const & r) { return l.offset < r.offset; });
+
+      auto && output  = this->output;
+      auto    to      = output.begin () + static_cast<std::ptrdiff_t> (gaps.front ().offset);
+      for (auto iter = gaps.begin (); iter != gaps.end (); ++iter)
+      {
+        auto next = iter + 1;
+        auto from = output.begin () + static_cast<std::ptrdiff_t> (iter->offset + iter->size);
+        auto last = next != gaps.end ()
+          ? output.begin () + static_cast<std::ptrdiff_t> (next->offset)
+          : output.end ()
+          ;
+        to = std::copy (from, last, to);
+      }
+
+      output.erase (to, output.end ());
+      gaps.clear ();
+    }
+
+    void put_uint (std::uint64_t v)
+    {
+      if (v < 0x80)
+      {
+        this->put (static_cast<unsigned> (v));
+      }
+      else if (v <= 0xFF)
+      {
+        this->put (0xCC);
+        this->put_be (v, 1);
+      }
+      else if (v <= 0xFFFF)
+      {
+        this->put (0xCD);
+        this->put_be (v, 2);
+      }
+      else if (v <= 0xFFFFFFFF)
+      {
+        this->put (0xCE);
+        this->put_be (v, 4);
+      }
+      else
+      {
+        this->put (0xCF);
+        this->put_be (v, 8);
+      }
+    }
+
+    void put_int (std::int64_t i)
+    {
+      auto v = static_cast<std::uint64_t> (i);
+      if (i >= -32)
+      {
+        this->put (static_cast<unsigned> (v & 0xFF));
+      }
+      else if (i >= -128)
+      {
+        this->put (0xD0);
+        this->put_be (v, 1);
+      }
+      else if (i >= -32768)
+      {
+        this->put (0xD1);
+        this->put_be (v, 2);
+      }
+      else if (i >= -2147483647 - 1)
+      {
+        this->put (0xD2);
+        this->put_be (v, 4);
+      }
+      else
+      {
+        this->put (0xD3);
+        this->put_be (v, 8);
+      }
+    }
+
+    void put_string (string_type const & s)
+    {
+      auto && utf8 = this->to_utf8 (s);
+      auto sz = utf8.size ();
+      if (sz < 32)
+      {
+        this->put (0xA0 | static_cast<unsigned> (sz));
+      }
+      else if (sz <= 0xFF)
+      {
+        this->put (0xD9);
+        this->put_be (sz, 1);
+      }
+      else if (sz <= 0xFFFF)
+      {
+        this->put (0xDA);
+        this->put_be (sz, 2);
+      }
+      else
+      {
+        this->put (0xDB);
+        this->put_be (sz, 4);
+      }
+      this->put_bytes (utf8);
+    }
+  };
+
+  // basic_cbor_reader decodes a CBOR data item and pushes it to a writer
+  //
+  //  TWriter has the value callbacks of a json_parser context with std::string as
+  //  string_type, typically json_utf8_writer. Decoding stops when a callback returns false.
+  //
+  //  Definite and indefinite lengths are supported, tags are skipped and undefined is
+  //  decoded as null. Byte strings, simple values other than false/true/null/undefined
+  //  and map keys that aren't text strings have no JSON equivalent and fail decoding.
+  //  Text strings are passed on without validating the UTF-8.
+  template<typename TWriter = json_utf8_writer>
+  struct basic_cbor_reader
+  {
+    using writer_type = TWriter;
+
+    basic_cbor_reader (char const * begin, char const * end, writer_type & writer) noexcept
+      : begin   (begin)
+      , end     (end)
+      , current (begin)
+      , writer  (writer)
+    {
+    }
+
+    // Gets the current position, on failure it's near the invalid data item
+    std::size_t pos () const noexcept
+    {
+      return static_cast<std::size_t> (current - begin);
+    }
+
+    // Tries to decode a single data item that must be followed by end of input
+    bool try_read ()
+    {
+      return try_read__value (0) && current == end;
+    }
+
+  private:
+    char const *  begin   ;
+    char const *  end     ;
+    char const *  current ;
+    writer_type & writer  ;
+    std::string   value   ;
+
+    inline std::size_t remaining () const noexcept
+    {
+      return static_cast<std::size_t> (end - current);
+    }
+
+    inline unsigned peek () const noexcept
+    {
+      return static_cast<unsigned char> (*current);
+    }
+
+    inline std::uint64_t read_be (std::size_t bytes) noexcept
+    {
+      std::uint64_t v = 0;
+      for (auto iter = 0U; iter < bytes; ++iter)
+      {
+        v = (v << 8) | static_cast<unsigned char> (*current++);
+      }
+      return v;
+    }
+
+    // Reads the initial byte and the argument of a data item, info is 31 for
+    //  indefinite lengths and breaks
+    bool try_read__head (unsigned & major, unsigned & info, std::uint64_t & arg) noexcept
+    {
+      if (current == end)
+      {
+        return false;
+      }
+
+      auto b  = peek ();
+      major   = b >> 5;
+      info    = b & 0x1F;
+      ++current;
+
+      if (info < 24)
+      {
+        arg = info;
+        return true;
+      }
+      else if (info < 28)
+      {
+        auto bytes = std::size_t (1) << (info - 24);
+        if (remaining () < bytes)
+        {
+          return false;
+        }
+        arg = read_be (bytes);
+        return true;
+      }
+      else if (info == 31)
+      {
+        arg = 0;
+        return major >= 2 && major <= 5;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    // Returns true and consumes the break if the current byte is a break
+    inline bool try_consume__break () noexcept
+    {
+      if (current != end && peek () == 0xFF)
+      {
+        ++current;
+        return true;
+      }
+      return false;
+    }
+
+    bool try_read__text (unsigned info, std::uint64_t arg)
+    {
+      if (info != 31)
+      {
+        if (arg > remaining ())
+        {
+          return false;
+        }
+        auto sz = static_cast<std::size_t> (arg);
+        value.assign (current, sz);
+        current += sz;
+        return true;
+      }
+
+      // Indefinite length text is a sequence of definite length chunks
+      value.clear ();
+      while (!try_consume__break ())
+      {
+        unsigned      major ;
+        unsigned      chunk ;
+        std::uint64_t sz    ;
+        if (!try_read__head (major, chunk, sz) || major != 3 || chunk == 31 || sz > remaining ())
+        {
+          return false;
+        }
+        value.append (current, static_cast<std::size_t> (sz));
+        current += static_cast<std::size_t> (sz);
+      }
+      return true;
+    }
+
+    bool try_read__array (unsigned info, std::uint64_t arg, std::size_t depth)
+    {
+      if (!writer.array_begin ())
+      {
+        return false;
+      }
+
+      if (info == 31)
+      {
+        while (!try_consume__break ())
+        {
+          if (!try_read__value (depth + 1))
+          {
+            return false;
+          }
+        }
+      }
+      else
+      {
+        // Each element is at least one byte
+        if (arg > remaining ())
+        {
+          return false;
+        }
+        for (auto iter = arg; iter > 0; --iter)
+        {
+          if (!try_read__value (depth + 1))
+          {
+            return false;
+          }
+        }
+      }
+
+      return writer.array_end ();
+    }
+
+    bool try_read__member (std::size_t depth)
+    {
+      unsigned      major ;
+      unsigned      info  ;
+      std::uint64_t arg   ;
+      return
+            try_read__head (major, info, arg)
+        &&  major == 3
+        &&  try_read__text (info, arg)
+        &&  writer.member_key (static_cast<std::string const &> (value))
+        &&  try_read__value (depth + 1)
+        ;
+    }
+
+    bool try_read__map (unsigned info, std::uint64_t arg, std::size_t depth)
+    {
+      if (!writer.object_begin ())
+      {
+        return false;
+      }
+
+      if (info == 31)
+      {
+        while (!try_consume__break ())
+        {
+          if (!try_read__member (depth))
+          {
+            return false;
+          }
+        }
+      }
+      else
+      {
+        // Each member is at least two bytes
+        if (arg > remaining () / 2)
+        {
+          return false;
+        }
+        for (auto iter = arg; iter > 0; --iter)
+        {
+          if (!try_read__member (depth))
+          {
+            return false;
+          }
+        }
+      }
+
+      return writer.object_end ();
+    }
+
+    static double from_half_bits (std::uint64_t bits) noexcept
+    {
+      auto exp  = static_cast<int> ((bits >> 10) & 0x1F);
+      auto mant = static_cast<double> (bits & 0x3FF);
+      auto v    = exp == 0
+        ? std::ldexp (mant, -24)
+        : exp != 31
+          ? std::ldexp (mant + 1024, exp - 25)
+          : mant == 0
+            ? std::numeric_limits<double>::infinity ()
+            : std::numeric_limits<double>::quiet_NaN ()
+        ;
+      return (bits & 0x8000) ? -v : v;
+    }
+
+    bool try_read__value (std::size_t depth)
+    {
+      if (depth > static_cast<std::size_t> (details::binary_limits::max_depth))
+      {
+        return false;
+      }
+
+      unsigned      major ;
+      unsigned      info  ;
+      std::uint64_t arg   ;
+      if (!try_read__head (major, info, arg))
+      {
+        return false;
+      }
+
+      switch (major)
+      {
+      case 0:
+        return writer.number_value (static_cast<double> (arg));
+      case 1:
+        return writer.number_value (-1.0 - static_cast<double> (arg));
+      case 3:
+        return try_read__text (info, arg) && writer.string_value (static_cast<std::string const &> (value));
+      case 4:
+        return try_read__array (info, arg, depth);
+      case 5:
+        return try_read__map (info, arg, depth);
+      case 6:
+        // Tags annotate the following data item
+        return try_read__value (depth + 1);
+      case 7:
+        switch (info)
+        {
+        case 20:
+          return writer.bool_value (false);
+        case 21:
+          return writer.bool_value (true);
+        case 22:
+        case 23:
+          return writer.null_value ();
+        case 25:
+          return writer.number_value (from_half_bits (arg));
+        case 26:
+          return writer.number_value (details::from_float_bits (arg));
+        case 27:
+          return writer.number_value (details::from_double_bits (arg));
+        default:
+          return false;
+        }
+      default:
+        // Byte strings
+        return false;
+      }
+    }
+  };
+
+  // basic_msgpack_reader decodes a MessagePack object and pushes it to a writer
+  //
+  //  TWriter is as for basic_cbor_reader. Binary, extension types and map keys that
+  //  aren't strings have no JSON equivalent and fail decoding.
+  template<typename TWriter = json_utf8_writer>
+  struct basic_msgpack_reader
+  {
+    using writer_type = TWriter;
+
+    basic_msgpack_reader (char const * begin, char const * end, writer_type & writer) noexcept
+      : begin   (begin)
+      , end     (end)
+      , current (begin)
+      , writer  (writer)
+    {
+    }
+
+    // Gets the current position, on failure it's near the invalid object
+    std::size_t pos () const noexcept
+    {
+      return static_cast<std::size_t> (current - begin);
+    }
+
+    // Tries to decode a single object that must be followed by end of input
+    bool try_read ()
+    {
+      return try_read__value (0) && current == end;
+    }
+
+  private:
+    char const *  begin   ;
+    char const *  end     ;
+    char const *  current ;
+    writer_type & writer  ;
+    std::string   value   ;
+
+    inline std::size_t remaining () const noexcept
+    {
+      return static_cast<std::size_t> (end - current);
+    }
+
+    // Reads a big endian value of 'bytes' bytes
+    bool try_read__be (std::size_t bytes, std::uint64_t & v) noexcept
+    {
+      if (remaining () < bytes)
+      {
+        return false;
+      }
+      v = 0;
+      for (auto iter = 0U; iter < bytes; ++iter)
+      {
+        v = (v << 8) | static_cast<unsigned char> (*current++);
+      }
+      return true;
+    }
+
+    bool try_read__string (std::uint64_t sz)
+    {
+      if (sz > remaining ())
+      {
+        return false;
+      }
+      value.assign (current, static_cast<std::size_t> (sz));
+      current += static_cast<std::size_t> (sz);
+      return true;
+    }
+
+    // Reads the length of a str8/16/32 string (tag is the type byte)
+    bool try_read__key (std::uint64_t & sz) noexcept
+    {
+      if (current == end)
+      {
+        return false;
+      }
+      auto tag = static_cast<unsigned char> (*current++);
+      if (tag >= 0xA0 && tag <= 0xBF)
+      {
+        sz = tag & 0x1F;
+        return true;
+      }
+      else if (tag >= 0xD9 && tag <= 0xDB)
+      {
+        return try_read__be (std::size_t (1) << (tag - 0xD9), sz);
+      }
+      return false;
+    }
+
+    bool try_read__array (std::uint64_t count, std::size_t depth)
+    {
+      // Each element is at least one byte
+      if (count > remaining () || !writer.array_begin ())
+      {
+        return false;
+      }
+      for (auto iter = count; iter > 0; --iter)
+      {
+        if (!try_read__value (depth + 1))
+        {
+          return false;
+        }
+      }
+      return writer.array_end ();
+    }
+
+    bool try_read__map (std::uint64_t count, std::size_t depth)
+    {
+      // Each member is at least two bytes
+      if (count > remaining () / 2 || !writer.object_begin ())
+      {
+        return false;
+      }
+      for (auto iter = count; iter > 0; --iter)
+      {
+        std::uint64_t sz;
+        if (
+              !try_read__key (sz)
+          ||  !try_read__string (sz)
+          ||  !writer.member_key (static_cast<std::string const &> (value))
+          ||  !try_read__value (depth + 1)
+          )
+        {
+          return false;
+        }
+      }
+      return writer.object_end ();
+    }
+
+    // Reads a two's complement integer of 'bytes' bytes
+    bool try_read__int (std::size_t bytes)
+    {
+      std::uint64_t v;
+      if (!try_read__be (bytes, v))
+      {
+        return false;
+      }
+      auto shift = 64 - 8 * bytes;
+      auto i     = static_cast<std::int64_t> (v << shift) >> shift;
+      return writer.number_value (static_cast<double> (i));
+    }
+
+    bool try_read__value (std::size_t depth)
+    {
+      if (depth > static_cast<std::size_t> (details::binary_limits::max_depth) || current == end)
+      {
+        return false;
+      }
+
+      auto tag = static_cast<unsigned char> (*current++);
+
+      if (tag < 0x80)
+      {
+        return writer.number_value (tag);
+      }
+      else if (tag < 0x90)
+      {
+        return try_read__map (tag & 0x0F, depth);
+      }
+      else if (tag < 0xA0)
+      {
+        return try_read__array (tag & 0x0F, depth);
+      }
+      else if (tag < 0xC0)
+      {
+        return try_read__string (tag & 0x1F) && writer.string_value (static_cast<std::string const &> (value));
+      }
+      else if (tag >= 0xE0)
+      {
+        return writer.number_value (static_cast<signed char> (tag));
+      }
+
+      std::uint64_t v;
+      switch (tag)
+      {
+      case 0xC0:
+        return writer.null_value ();
+      case 0xC2:
+        return writer.bool_value (false);
+      case 0xC3:
+        return writer.bool_value (true);
+      case 0xCA:
+        return try_read__be (4, v) && writer.number_value (details::from_float_bits (v));
+      case 0xCB:
+        return try_read__be (8, v) && writer.number_value (details::from_double_bits (v));
+      case 0xCC:
+      case 0xCD:
+      case 0xCE:
+      case 0xCF:
+        return try_read__be (std::size_t (1) << (tag - 0xCC), v) && writer.number_value (static_cast<double> (v));
+      case 0xD0:
+      case 0xD1:
+      case 0xD2:
+      case 0xD3:
+        return try_read__int (std::size_t (1) << (tag - 0xD0));
+      case 0xD9:
+      case 0xDA:
+      case 0xDB:
+        return
+              try_read__be (std::size_t (1) << (tag - 0xD9), v)
+          &&  try_read__string (v)
+          &&  writer.string_value (static_cast<std::string const &> (value))
+          ;
+      case 0xDC:
+      case 0xDD:
+        return try_read__be (tag == 0xDC ? 2 : 4, v) && try_read__array (v, depth);
+      case 0xDE:
+      case 0xDF:
+        return try_read__be (tag == 0xDE ? 2 : 4, v) && try_read__map (v, depth);
+      default:
+        // 0xC1 is never used, the rest are binary and extension types
+        return false;
+      }
+    }
+  };
+
+  using cbor_json_context         = basic_cbor_json_context<wchar_t>    ;
+  using cbor_utf8_json_context    = basic_cbor_json_context<char>       ;
+  using msgpack_json_context      = basic_msgpack_json_context<wchar_t> ;
+  using msgpack_utf8_json_context = basic_msgpack_json_context<char>    ;
+
+  namespace details
+  {
+    template<typename TContext, typename TChar>
+    bool transcode_from_json (TChar const * begin, TChar const * end, std::size_t & pos, std::vector<char> & binary)
+    {
+      json_parser<TContext> jp (begin, end);
+
+      // Reuses the capacity of binary
+      jp.output.swap (binary);
+      jp.output.clear ();
+
+      auto result = jp.try_parse__json ();
+      pos = jp.pos ();
+
+      binary.swap (jp.output);
+      if (!result)
+      {
+        binary.clear ();
+      }
+
+      return result;
+    }
+
+    template<typename TReader>
+    bool transcode_to_json (char const * begin, char const * end, std::size_t & pos, std::string & json)
+    {
+      json_utf8_writer writer;
+
+      // Reuses the capacity of json
+      writer.output.swap (json);
+      writer.clear ();
+
+      TReader reader (begin, end, writer);
+      auto result = reader.try_read ();
+      pos = reader.pos ();
+
+      json.swap (writer.output);
+      if (!result)
+      {
+        json.clear ();
+      }
+
+      return result;
+    }
+  }
+
+  // Transcodes between JSON and CBOR, JSON is produced as UTF-8
+  //  On failure pos is the position of the error and the output is empty
+  struct json_cbor
+  {
+    template<typename TChar>
+    static bool from_json (TChar const * begin, TChar const * end, std::size_t & pos, std::vector<char> & cbor)
+    {
+      return details::transcode_from_json<basic_cbor_json_context<TChar>> (begin, end, pos, cbor);
+    }
+
+    template<typename TChar>
+    static bool from_json (std::basic_string<TChar> const & json, std::size_t & pos, std::vector<char> & cbor)
+    {
+      return from_json (json.data (), json.data () + json.size (), pos, cbor);
+    }
+
+    static bool to_json (char const * begin, char const * end, std::size_t & pos, std::string & json)
+    {
+      return details::transcode_to_json<basic_cbor_reader<>> (begin, end, pos, json);
+    }
+
+    static bool to_json (std::vector<char> const & cbor, std::size_t & pos, std::string & json)
+    {
+      return to_json (cbor.data (), cbor.data () + cbor.size (), pos, json);
+    }
+  };
+
+  // Transcodes between JSON and MessagePack, JSON is produced as UTF-8
+  //  On failure pos is the position of the error and the output is empty
+  struct json_msgpack
+  {
+    template<typename TChar>
+    static bool from_json (TChar const * begin, TChar const * end, std::size_t & pos, std::vector<char> & msgpack)
+    {
+      return details::transcode_from_json<basic_msgpack_json_context<TChar>> (begin, end, pos, msgpack);
+    }
+
+    template<typename TChar>
+    static bool from_json (std::basic_string<TChar> const & json, std::size_t & pos, std::vector<char> & msgpack)
+    {
+      return from_json (json.data (), json.data () + json.size (), pos, msgpack);
+    }
+
+    static bool to_json (char const * begin, char const * end, std::size_t & pos, std::string & json)
+    {
+      return details::transcode_to_json<basic_msgpack_reader<>> (begin, end, pos, json);
+    }
+
+    static bool to_json (std::vector<char> const & msgpack, std::size_t & pos, std::string & json)
+    {
+      return to_json (msgpack.data (), msgpack.data () + msgpack.size (), pos, json);
+    }
+  };
+
+} }
+
+#endif  // CPP_JSON__TRANSCODE_H
@@ -0,0 +1,251 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__WRITER_H
+#define CPP_JSON__WRITER_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+namespace cpp_json { namespace parser
+{
+  namespace details
+  {
+    // Formats d with the fewest digits (15 or 17) that parse back to d
+    inline int format_number (char (&buffer)[32], double d)
+    {
+      auto sz = std::snprintf (buffer, sizeof buffer, "%.15g", d);
+      if (std::strtod (buffer, nullptr) != d)
+      {
+        sz = std::snprintf (buffer, sizeof buffer, "%.17g", d);
+      }
+      return sz;
+    }
+  }
+
+  // basic_json_writer writes compact JSON text as values are pushed, no document is built
+  //
+  //    json_utf8_writer w;
+  //    w.object_begin ();
+  //    w.member_key ("id");
+  //    w.number_value (3);
+  //    w.object_end ();
+  //    // w.output == R"({"id":3})"
+  //
+  //  The methods are the value callbacks of a json_parser context (see json_parser)
+  //  so the writer can be driven by anything producing those callbacks.
+  //  The caller is responsible for balancing begin/end and for pushing a value
+  //  after each member key.
+  //
+  //  Strings are written as is apart from escaping '"', '\' and control characters,
+  //  for json_utf8_writer strings are expected to be UTF-8.
+  //  Numbers that aren't finite are written as the strings "NaN", "-Inf" and "+Inf"
+  //  like json_document::to_string does.
+  template<typename TChar>
+  struct basic_json_writer
+  {
+    using char_type   = TChar                       ;
+    using string_type = std::basic_string<char_type>;
+
+    string_type output;
+
+    // Clears the output, the capacity is kept so a writer can be reused
+    void clear () noexcept
+    {
+      output.clear ();
+      separator = false;
+    }
+
+    bool array_begin ()
+    {
+      begin_value ();
+      output.push_back ('[');
+      separator = false;
+      return true;
+    }
+
+    bool array_end ()
+    {
+      output.push_back (']');
+      separator = true;
+      return true;
+    }
+
+    bool object_begin ()
+    {
+      begin_value ();
+      output.push_back ('{');
+      separator = false;
+      return true;
+    }
+
+    bool member_key (string_type const & s)
+    {
+      begin_value ();
+      append_string (s.data (), s.size ());
+      output.push_back (':');
+      separator = false;
+      return true;
+    }
+
+    bool object_end ()
+    {
+      output.push_back ('}');
+      separator = true;
+      return true;
+    }
+
+    bool null_value ()
+    {
+      begin_value ();
+      append_ascii ("null");
+      return true;
+    }
+
+    bool bool_value (bool b)
+    {
+      begin_value ();
+      append_ascii (b ? "true" : "false");
+      return true;
+    }
+
+    bool number_value (double d)
+    {
+      begin_value ();
+      if (std::isnan (d))
+      {
+        append_ascii ("\"NaN\"");
+      }
+      else if (std::isinf (d))
+      {
+        append_ascii (d < 0 ? "\"-Inf\"" : "\"+Inf\"");
+      }
+      else
+      {
+        char buffer[32];
+        auto sz = details::format_number (buffer, d);
+        output.append (buffer, buffer + sz);
+      }
+      return true;
+    }
+
+    bool string_value (string_type const & s)
+    {
+      begin_value ();
+      append_string (s.data (), s.size ());
+      return true;
+    }
+
+  private:
+    using uchar_type = typename std::make_unsigned<char_type>::type;
+
+    bool separator = false; // True if the next value is preceded by ','
+
+    inline void begin_value ()
+    {
+      if (separator)
+      {
+        output.push_back (',');
+      }
+      separator = true;
+    }
+
+    inline void append_ascii (char const * s)
+    {
+      for (; *s; ++s)
+      {
+        output.push_back (static_cast<char_type> (*s));
+      }
+    }
+
+    static inline bool is_plain (char_type ch) noexcept
+    {
+      return static_cast<uchar_type> (ch) >= 0x20 && ch != '"' && ch != '\\';
+    }
+
+    // Appends runs of plain characters at once, only escapes are appended per character
+    void append_string (char_type const * s, std::size_t sz)
+    {
+      output.push_back ('"');
+
+      auto e = s + sz;
+      while (s != e)
+      {
+        auto run = s;
+        while (run != e && is_plain (*run))
+        {
+          ++run;
+        }
+        output.append (s, run);
+
+        if (run == e)
+        {
+          break;
+        }
+
+        append_escaped (*run);
+        s = run + 1;
+      }
+
+      output.push_back ('"');
+    }
+
+    void append_escaped (char_type ch)
+    {
+      switch (ch)
+      {
+      case '"':
+        append_ascii ("\\\"");
+        break;
+      case '\\':
+        append_ascii ("\\\\");
+        break;
+      case '\b':
+        append_ascii ("\\b");
+        break;
+      case '\f':
+        append_ascii ("\\f");
+        break;
+      case '\n':
+        append_ascii ("\\n");
+        break;
+      case '\r':
+        append_ascii ("\\r");
+        break;
+      case '\t':
+        append_ascii ("\\t");
+        break;
+      default:
+        {
+          auto hex = "0123456789abcdef";
+          auto c   = static_cast<uchar_type> (ch);
+          char escaped[] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xF], hex[c & 0xF], 0 };
+          append_ascii (escaped);
+        }
+        break;
+      }
+    }
+  };
+
+  using json_writer       = basic_json_writer<wchar_t>;
+  using json_utf8_writer  = basic_json_writer<char>   ;
+
+} }
+
+#endif  // CPP_JSON__WRITER_H
@@ -0,0 +1 @@
+clang++ --std=c++11 -pthread -Wall -O2 -DNDEBUG -o scaling_benchmark.clang++ scaling_benchmark.cpp
@@ -0,0 +1 @@
+g++ --std=c++11 -pthread -O2 -DNDEBUG -o scaling_benchmark.g++ scaling_benchmark.cpp
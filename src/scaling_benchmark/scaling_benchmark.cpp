@@ -0,0 +1,263 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+// Measures how parse throughput scales when one parser runs per thread
+//  Each thread parses the whole corpus 'rounds' times (weak scaling), so with
+//  perfect scaling the wall time is the same for any number of threads.
+//
+//  Allocators:
+//    default : json_parser::parse, memory from the global allocator. Run with
+//              LD_PRELOAD=libjemalloc.so (or tcmalloc) to measure another malloc
+//    session : a json_parse_session per thread that reuses its documents
+//    arena   : a json_monotonic_resource per thread released after each document
+//
+//  Usage: scaling_benchmark [max_threads] [rounds]
+//  Built separately from test_suite as test_suite replaces malloc to count allocations
+
+#include "../cpp_json/cpp_json__document.hpp"
+#include "../test_suite/test_cases.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  using namespace cpp_json::document;
+
+  struct corpus
+  {
+    std::vector<std::wstring> documents ;
+    std::size_t               bytes     = 0;
+  };
+
+  // Parses one document with the thread's state
+  using parse_function  = std::function<bool (std::wstring const &)>;
+  using make_parser     = std::function<parse_function ()>;
+
+  struct allocator_mode
+  {
+    char const *  name  ;
+    make_parser   make  ;
+  };
+
+  std::vector<allocator_mode> allocator_modes ()
+  {
+    std::vector<allocator_mode> modes;
+
+    modes.push_back (allocator_mode { "default", [] ()
+      {
+        return parse_function ([] (std::wstring const & json)
+          {
+            std::size_t         pos ;
+            json_document::ptr  doc ;
+            return json_parser::parse (json, pos, doc);
+          });
+      }});
+
+    modes.push_back (allocator_mode { "session", [] ()
+      {
+        auto session = std::make_shared<json_parse_session> (true);
+        return parse_function ([session] (std::wstring const & json)
+          {
+            std::size_t         pos ;
+            json_document::ptr  doc ;
+            return session->parse (json, pos, doc);
+          });
+      }});
+
+    modes.push_back (allocator_mode { "arena", [] ()
+      {
+        auto arena = std::make_shared<json_monotonic_resource> ();
+        return parse_function ([arena] (std::wstring const & json)
+          {
+            auto result = false;
+            {
+              std::size_t         pos ;
+              json_document::ptr  doc ;
+              result = json_parser::parse (json, pos, doc, arena.get ());
+            }
+            arena->release ();
+            return result;
+          });
+      }});
+
+    return modes;
+  }
+
+  // Returns the wall time in seconds for 'threads' threads parsing the corpus 'rounds' times each
+  double run (corpus const & c, allocator_mode const & mode, std::size_t threads, std::size_t rounds)
+  {
+    std::atomic<std::size_t>  ready     (0);
+    std::atomic<bool>         go        (false);
+    std::atomic<std::size_t>  failures  (0);
+
+    std::vector<std::thread> workers;
+    for (auto iter = 0U; iter < threads; ++iter)
+    {
+      workers.emplace_back ([&] ()
+        {
+          auto parse = mode.make ();
+
+          // Warm up, then wait for all threads so they start together
+          for (auto && json : c.documents)
+          {
+            parse (json);
+          }
+
+          ++ready;
+          while (!go.load ())
+          {
+            std::this_thread::yield ();
+          }
+
+          for (auto round = 0U; round < rounds; ++round)
+          {
+            for (auto && json : c.documents)
+            {
+              if (!parse (json))
+              {
+                ++failures;
+              }
+            }
+          }
+        });
+    }
+
+    while (ready.load () < threads)
+    {
+      std::this_thread::yield ();
+    }
+
+    auto then = std::chrono::high_resolution_clock::now ();
+    go = true;
+
+    for (auto && w : workers)
+    {
+      w.join ();
+    }
+    auto now  = std::chrono::high_resolution_clock::now ();
+
+    if (failures.load () > 0)
+    {
+      std::cout << "FAILURE: " << failures.load () << " documents failed to parse" << std::endl;
+    }
+
+    return std::chrono::duration<double> (now - then).count ();
+  }
+
+  std::vector<std::size_t> thread_counts (std::size_t max_threads)
+  {
+    std::vector<std::size_t> counts;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2)
+    {
+      counts.push_back (threads);
+    }
+    counts.push_back (max_threads);
+    return counts;
+  }
+}
+
+int main (int argc, char const * * argvs)
+{
+  auto exe = argvs[0];
+
+  std::size_t max_threads = argc > 1 ? std::atoi (argvs[1]) : 0;
+  std::size_t rounds      = argc > 2 ? std::atoi (argvs[2]) : 0;
+
+  if (max_threads == 0)
+  {
+    max_threads = std::thread::hardware_concurrency ();
+  }
+
+  if (max_threads == 0)
+  {
+    max_threads = 1;
+  }
+
+  if (rounds == 0)
+  {
+    rounds = 20;
+  }
+
+  auto test_cases = find_test_cases (exe);
+  if (test_cases.empty ())
+  {
+    std::cout << "FAILURE: Couldn't find test_cases directory" << std::endl;
+    return 999;
+  }
+
+  corpus c;
+  for (auto && file_name : { "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json", "contacts.json", "Simple.json" })
+  {
+    auto json = read_binary_file (test_cases + "/json/" + file_name);
+    c.bytes += json.size ();
+    c.documents.push_back (widen (json));
+  }
+
+  auto megabytes = static_cast<double> (c.bytes) / (1 << 20);
+
+  std::cout
+    << "Corpus: " << c.documents.size () << " documents, " << c.bytes << " bytes"
+    << ", rounds per thread: " << rounds
+    << ", hardware threads: " << std::thread::hardware_concurrency ()
+    << std::endl;
+
+  std::cout << std::fixed << std::setprecision (1);
+
+  for (auto && mode : allocator_modes ())
+  {
+    std::cout
+      << std::endl << "Allocator: " << mode.name << std::endl
+      << std::setw (8) << "threads"
+      << std::setw (12) << "seconds"
+      << std::setw (12) << "MB/s"
+      << std::setw (16) << "MB/s/thread"
+      << std::setw (14) << "efficiency"
+      << std::endl;
+
+    double single = 0;
+    for (auto && threads : thread_counts (max_threads))
+    {
+      auto seconds    = run (c, mode, threads, rounds);
+      auto throughput = megabytes * rounds * threads / seconds;
+      auto per_thread = throughput / threads;
+
+      if (threads == 1)
+      {
+        single = per_thread;
+      }
+
+      std::cout
+        << std::setw (8) << threads
+        << std::setw (12) << std::setprecision (3) << seconds << std::setprecision (1)
+        << std::setw (12) << throughput
+        << std::setw (16) << per_thread
+        << std::setw (13) << (single > 0 ? 100.0 * per_thread / single : 0.0) << "%"
+        << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,344 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete to count allocations
+//  With glibc malloc, calloc, realloc, reallocarray, the aligned variants
+//  (memalign, posix_memalign, aligned_alloc, valloc, pvalloc) and free are
+//  replaced as well so that allocations made by C code (and string_builder)
+//  are counted. Sizes are then
+//  taken from malloc_usable_size. Otherwise each allocation made through operator
+//  new is prefixed with its size so that live bytes can be tracked.
+//  AddressSanitizer and ThreadSanitizer replace malloc themselves so malloc isn't
+//  replaced when they are active.
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+# define CPP_JSON__SANITIZER
+#elif defined(__has_feature)
+# if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#   define CPP_JSON__SANITIZER
+# endif
+#endif
+
+#if defined(__GLIBC__) && !defined(CPP_JSON__SANITIZER)
+# define CPP_JSON__COUNT_MALLOC
+# include <malloc.h>
+# include <unistd.h>
+
+extern "C"
+{
+  void * __libc_malloc    (std::size_t size);
+  void * __libc_calloc    (std::size_t count, std::size_t size);
+  void * __libc_realloc   (void * ptr, std::size_t size);
+  void   __libc_free      (void * ptr);
+  void * __libc_memalign  (std::size_t alignment, std::size_t size);
+}
+#endif
+
+namespace
+{
+  std::atomic<std::size_t> allocations  (0);
+  std::atomic<std::size_t> bytes        (0);
+  std::atomic<std::size_t> live_bytes   (0);
+  std::atomic<std::size_t> peak_bytes   (0);
+
+  void count_alloc (std::size_t size) noexcept
+  {
+    allocations.fetch_add (1, std::memory_order_relaxed);
+    bytes.fetch_add (size, std::memory_order_relaxed);
+    auto live = live_bytes.fetch_add (size, std::memory_order_relaxed) + size;
+
+    auto peak = peak_bytes.load (std::memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak (peak, live, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  void count_free (std::size_t size) noexcept
+  {
+    live_bytes.fetch_sub (size, std::memory_order_relaxed);
+  }
+
+#ifdef CPP_JSON__COUNT_MALLOC
+  void * counted_alloc (std::size_t size) noexcept
+  {
+    // Counted by malloc
+    return std::malloc (size);
+  }
+
+  void counted_free (void * ptr) noexcept
+  {
+    std::free (ptr);
+  }
+#else
+  // Keeps the allocations aligned as malloc does
+  constexpr std::size_t prefix_size = 16;
+
+  void * counted_alloc (std::size_t size) noexcept
+  {
+    auto p = static_cast<char *> (std::malloc (size + prefix_size));
+    if (!p)
+    {
+      return nullptr;
+    }
+
+    *reinterpret_cast<std::size_t *> (p) = size;
+    count_alloc (size);
+
+    return p + prefix_size;
+  }
+
+  void counted_free (void * ptr) noexcept
+  {
+    if (!ptr)
+    {
+      return;
+    }
+
+    auto p = static_cast<char *> (ptr) - prefix_size;
+    count_free (*reinterpret_cast<std::size_t *> (p));
+
+    std::free (p);
+  }
+#endif
+
+  void * counted_new (std::size_t size)
+  {
+    for (;;)
+    {
+      if (auto p = counted_alloc (size == 0 ? 1 : size))
+      {
+        return p;
+      }
+
+      auto handler = std::get_new_handler ();
+      if (!handler)
+      {
+        throw std::bad_alloc ();
+      }
+      handler ();
+    }
+  }
+}
+
+#ifdef CPP_JSON__COUNT_MALLOC
+extern "C"
+{
+  void * malloc (std::size_t size) noexcept
+  {
+    auto p = __libc_malloc (size);
+    if (p)
+    {
+      count_alloc (malloc_usable_size (p));
+    }
+    return p;
+  }
+
+  void * calloc (std::size_t count, std::size_t size) noexcept
+  {
+    auto p = __libc_calloc (count, size);
+    if (p)
+    {
+      count_alloc (malloc_usable_size (p));
+    }
+    return p;
+  }
+
+  void * realloc (void * ptr, std::size_t size) noexcept
+  {
+    auto old_size = ptr ? malloc_usable_size (ptr) : 0;
+    auto p        = __libc_realloc (ptr, size);
+    if (p)
+    {
+      if (ptr)
+      {
+        count_free (old_size);
+      }
+      count_alloc (malloc_usable_size (p));
+    }
+    else if (ptr && size == 0)
+    {
+      // realloc (ptr, 0) frees ptr and returns NULL
+      count_free (old_size);
+    }
+    return p;
+  }
+
+  void * reallocarray (void * ptr, std::size_t count, std::size_t size) noexcept
+  {
+    if (size != 0 && count > static_cast<std::size_t> (-1) / size)
+    {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    return realloc (ptr, count * size);
+  }
+
+  void * memalign (std::size_t alignment, std::size_t size) noexcept
+  {
+    auto p = __libc_memalign (alignment, size);
+    if (p)
+    {
+      count_alloc (malloc_usable_size (p));
+    }
+    return p;
+  }
+
+  int posix_memalign (void ** ptr, std::size_t alignment, std::size_t size) noexcept
+  {
+    auto p = __libc_memalign (alignment, size);
+    if (!p)
+    {
+      return ENOMEM;
+    }
+    count_alloc (malloc_usable_size (p));
+    *ptr = p;
+    return 0;
+  }
+
+  void * aligned_alloc (std::size_t alignment, std::size_t size) noexcept
+  {
+    return memalign (alignment, size);
+  }
+
+  void * valloc (std::size_t size) noexcept
+  {
+    return memalign (static_cast<std::size_t> (sysconf (_SC_PAGESIZE)), size);
+  }
+
+  // Like valloc but the size is rounded up to a multiple of the page size
+  void * pvalloc (std::size_t size) noexcept
+  {
+    auto page = static_cast<std::size_t> (sysconf (_SC_PAGESIZE));
+    return memalign (page, size == 0 ? page : (size + page - 1) / page * page);
+  }
+
+  void free (void * ptr) noexcept
+  {
+    if (ptr)
+    {
+      count_free (malloc_usable_size (ptr));
+      __libc_free (ptr);
+    }
+  }
+}
+#endif
+
+bool allocation_counter_includes_malloc ()
+{
+#ifdef CPP_JSON__COUNT_MALLOC
+  return true;
+#else
+  return false;
+#endif
+}
+
+allocation_counters get_allocation_counters ()
+{
+  allocation_counters result;
+  result.allocations  = allocations.load ();
+  result.bytes        = bytes.load ();
+  result.live_bytes   = live_bytes.load ();
+  result.peak_bytes   = peak_bytes.load ();
+  return result;
+}
+
+void reset_peak_bytes ()
+{
+  peak_bytes.store (live_bytes.load ());
+}
+
+allocation_counters operator- (allocation_counters const & after, allocation_counters const & before)
+{
+  allocation_counters result;
+  result.allocations  = after.allocations - before.allocations;
+  result.bytes        = after.bytes - before.bytes;
+  result.live_bytes   = after.live_bytes > before.live_bytes ? after.live_bytes - before.live_bytes : 0;
+  result.peak_bytes   = after.peak_bytes > before.live_bytes ? after.peak_bytes - before.live_bytes : 0;
+  return result;
+}
+
+void * operator new (std::size_t size)
+{
+  return counted_new (size);
+}
+
+void * operator new[] (std::size_t size)
+{
+  return counted_new (size);
+}
+
+void * operator new (std::size_t size, std::nothrow_t const &) noexcept
+{
+  try
+  {
+    return counted_new (size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+void * operator new[] (std::size_t size, std::nothrow_t const &) noexcept
+{
+  try
+  {
+    return counted_new (size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+void operator delete (void * ptr) noexcept
+{
+  counted_free (ptr);
+}
+
+void operator delete[] (void * ptr) noexcept
+{
+  counted_free (ptr);
+}
+
+void operator delete (void * ptr, std::nothrow_t const &) noexcept
+{
+  counted_free (ptr);
+}
+
+void operator delete[] (void * ptr, std::nothrow_t const &) noexcept
+{
+  counted_free (ptr);
+}
+
+void operator delete (void * ptr, std::size_t) noexcept
+{
+  counted_free (ptr);
+}
+
+void operator delete[] (void * ptr, std::size_t) noexcept
+{
+  counted_free (ptr);
+}
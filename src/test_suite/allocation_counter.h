@@ -0,0 +1,42 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__ALLOCATION_COUNTER_H
+#define CPP_JSON__ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts allocations made through operator new (and malloc where supported) in the test_suite process
+struct allocation_counters
+{
+  std::size_t allocations   ;
+  std::size_t bytes         ; // Total bytes allocated
+  std::size_t live_bytes    ; // Bytes allocated but not yet freed
+  std::size_t peak_bytes    ; // Highest live_bytes since reset_peak_bytes
+};
+
+allocation_counters get_allocation_counters ();
+
+// Returns true if allocations made by malloc are counted, otherwise only operator new is counted
+bool allocation_counter_includes_malloc ();
+
+// Sets peak_bytes to the current live_bytes
+void reset_peak_bytes ();
+
+// Returns the counters of 'after' relative to 'before', live_bytes and peak_bytes are relative to before.live_bytes
+allocation_counters operator- (allocation_counters const & after, allocation_counters const & before);
+
+#endif  // CPP_JSON__ALLOCATION_COUNTER_H
@@ -1 +1,25 @@
-clang++ --std=c++11 -Wall -o cpp_json.clang++ test_suite.cpp linker_test_case.cpp
+# All libraries are built with the same optimization flags so the comparisons are fair
+#  e.g. OPTIMIZE="-O2 -DNDEBUG" bash build_with_clang++.bash
+OPTIMIZE="${OPTIMIZE:-}"
+
+# Comparisons with other JSON libraries are built when they are vendored in external
+COMPETITORS=""
+if [ -f ../../external/rapidjson/include/rapidjson/document.h ]; then
+  COMPETITORS="$COMPETITORS -DCPP_JSON__RAPIDJSON -I../../external/rapidjson/include"
+fi
+if [ -f ../../external/nlohmann/include/nlohmann/json.hpp ]; then
+  COMPETITORS="$COMPETITORS -DCPP_JSON__NLOHMANN -I../../external/nlohmann/include"
+fi
+if [ -f ../../external/simdjson/simdjson.cpp ]; then
+  # simdjson requires C++17
+  clang++ --std=c++17 $OPTIMIZE -DCPP_JSON__SIMDJSON -I../../external/simdjson -c perf__simdjson.cpp ../../external/simdjson/simdjson.cpp || exit 1
+  COMPETITORS="$COMPETITORS -DCPP_JSON__SIMDJSON perf__simdjson.o simdjson.o"
+fi
+
+# gzip input is supported when zlib is installed
+ZLIB=""
+if echo '#include <zlib.h>' | clang++ -E -x c++ - > /dev/null 2>&1; then
+  ZLIB="-DCPP_JSON__ZLIB -lz"
+fi
+
+clang++ --std=c++11 $OPTIMIZE -pthread -Wall -o cpp_json.clang++ test_suite.cpp linker_test_case.cpp perf__cpp_json_stream.cpp perf__cpp_json_batch.cpp perf__cpp_json_gzip.cpp perf__cpp_json_session.cpp perf__cpp_json_profile.cpp perf__cpp_json_kernels.cpp perf__cpp_json_latency.cpp allocation_counter.cpp hardware_counters.cpp perf__cpp_json_callback.cpp perf__cpp_json_document.cpp perf__jsoncpp_callback.cpp perf__competitors.cpp ../../external/jsoncpp/lib_json/json_reader.cpp ../../external/jsoncpp/lib_json/json_value.cpp ../../external/jsoncpp/lib_json/json_writer.cpp -I../../external/jsoncpp/include $COMPETITORS $ZLIB
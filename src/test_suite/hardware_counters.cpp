@@ -0,0 +1,182 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "hardware_counters.h"
+
+#include <cstring>
+
+#ifdef __linux__
+# define CPP_JSON__PERF_EVENT
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace
+{
+  char const * const event_names [hardware_event_count] =
+  {
+    "cycles"        ,
+    "instructions"  ,
+    "branch_misses" ,
+    "l1d_misses"    ,
+    "llc_misses"    ,
+    "dtlb_misses"   ,
+  };
+
+#ifdef CPP_JSON__PERF_EVENT
+  constexpr std::uint64_t cache_event (std::uint64_t cache, std::uint64_t op, std::uint64_t result)
+  {
+    return cache | (op << 8) | (result << 16);
+  }
+
+  struct event_config
+  {
+    std::uint32_t type  ;
+    std::uint64_t config;
+  };
+
+  event_config const event_configs [hardware_event_count] =
+  {
+    { PERF_TYPE_HARDWARE  , PERF_COUNT_HW_CPU_CYCLES                                                                      },
+    { PERF_TYPE_HARDWARE  , PERF_COUNT_HW_INSTRUCTIONS                                                                    },
+    { PERF_TYPE_HARDWARE  , PERF_COUNT_HW_BRANCH_MISSES                                                                   },
+    { PERF_TYPE_HW_CACHE  , cache_event (PERF_COUNT_HW_CACHE_L1D , PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { PERF_TYPE_HARDWARE  , PERF_COUNT_HW_CACHE_MISSES                                                                    },
+    { PERF_TYPE_HW_CACHE  , cache_event (PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+  };
+
+  int open_event (event_config const & ec)
+  {
+    perf_event_attr attr;
+    std::memset (&attr, 0, sizeof (attr));
+
+    attr.size           = sizeof (attr);
+    attr.type           = ec.type;
+    attr.config         = ec.config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread, any cpu
+    return static_cast<int> (syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+}
+
+char const * hardware_event_name (hardware_event e)
+{
+  return event_names[static_cast<std::size_t> (e)];
+}
+
+hardware_counter_group::hardware_counter_group ()
+{
+  for (auto iter = 0U; iter < hardware_event_count; ++iter)
+  {
+#ifdef CPP_JSON__PERF_EVENT
+    fds[iter] = open_event (event_configs[iter]);
+#else
+    fds[iter] = -1;
+#endif
+  }
+}
+
+hardware_counter_group::~hardware_counter_group ()
+{
+#ifdef CPP_JSON__PERF_EVENT
+  for (auto fd : fds)
+  {
+    if (fd >= 0)
+    {
+      close (fd);
+    }
+  }
+#endif
+}
+
+bool hardware_counter_group::available () const
+{
+  for (auto fd : fds)
+  {
+    if (fd >= 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void hardware_counter_group::start ()
+{
+#ifdef CPP_JSON__PERF_EVENT
+  for (auto fd : fds)
+  {
+    if (fd >= 0)
+    {
+      ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+hardware_counters hardware_counter_group::stop ()
+{
+  hardware_counters result;
+  std::memset (&result, 0, sizeof (result));
+
+#ifdef CPP_JSON__PERF_EVENT
+  for (auto fd : fds)
+  {
+    if (fd >= 0)
+    {
+      ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for (auto iter = 0U; iter < hardware_event_count; ++iter)
+  {
+    auto fd = fds[iter];
+    if (fd < 0)
+    {
+      continue;
+    }
+
+    // value, time enabled, time running
+    std::uint64_t read_values [3] = {};
+    if (read (fd, read_values, sizeof (read_values)) != sizeof (read_values) || read_values[2] == 0)
+    {
+      continue;
+    }
+
+    // The kernel multiplexes events when there are more events than hardware counters
+    auto scaled = read_values[2] < read_values[1]
+      ? static_cast<std::uint64_t> (static_cast<double> (read_values[0]) * read_values[1] / read_values[2])
+      : read_values[0]
+      ;
+
+    result.supported[iter]  = true;
+    result.values[iter]     = scaled;
+  }
+#endif
+
+  return result;
+}
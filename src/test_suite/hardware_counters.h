@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__HARDWARE_COUNTERS_H
+#define CPP_JSON__HARDWARE_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The hardware events counted, index into hardware_counters::values
+enum class hardware_event
+{
+  cycles        ,
+  instructions  ,
+  branch_misses ,
+  l1d_misses    , // L1 data cache read misses
+  llc_misses    , // Last level cache misses
+  dtlb_misses   , // Data TLB read misses
+};
+
+constexpr std::size_t hardware_event_count = static_cast<std::size_t> (hardware_event::dtlb_misses) + 1;
+
+char const * hardware_event_name (hardware_event e);
+
+// Counter values of a measured run
+struct hardware_counters
+{
+  bool          supported [hardware_event_count]; // false if the event couldn't be opened
+  std::uint64_t values    [hardware_event_count]; // Scaled if the kernel multiplexed the event
+
+  std::uint64_t value (hardware_event e) const
+  {
+    return values[static_cast<std::size_t> (e)];
+  }
+
+  bool is_supported (hardware_event e) const
+  {
+    return supported[static_cast<std::size_t> (e)];
+  }
+};
+
+// Reads hardware performance counters of the calling thread with perf_event_open
+//  Only available on Linux, and only if the kernel allows it (see
+//  /proc/sys/kernel/perf_event_paranoid), events that can't be opened are
+//  reported as not supported. Kernel and hypervisor time is excluded.
+struct hardware_counter_group
+{
+  hardware_counter_group ();
+  ~hardware_counter_group ();
+
+  hardware_counter_group (hardware_counter_group const &)             = delete;
+  hardware_counter_group & operator= (hardware_counter_group const &) = delete;
+
+  // Returns true if at least one event is counted
+  bool available () const;
+
+  // Resets and starts the counters
+  void start ();
+
+  // Stops the counters and returns the values since start
+  hardware_counters stop ();
+
+private:
+  int fds [hardware_event_count];
+};
+
+#endif  // CPP_JSON__HARDWARE_COUNTERS_H
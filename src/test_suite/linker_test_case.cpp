@@ -16,4 +16,16 @@
 
 #include "stdafx.h"
 
+#include "../cpp_json/cpp_json__batch.hpp"
+#include "../cpp_json/cpp_json__cache.hpp"
 #include "../cpp_json/cpp_json__document.hpp"
+#include "../cpp_json/cpp_json__gzip.hpp"
+#include "../cpp_json/cpp_json__instrumentation.hpp"
+#include "../cpp_json/cpp_json__memory.hpp"
+#include "../cpp_json/cpp_json__ondemand.hpp"
+#include "../cpp_json/cpp_json__query.hpp"
+#include "../cpp_json/cpp_json__reader.hpp"
+#include "../cpp_json/cpp_json__snapshot.hpp"
+#include "../cpp_json/cpp_json__stream.hpp"
+#include "../cpp_json/cpp_json__transcode.hpp"
+#include "../cpp_json/cpp_json__writer.hpp"
@@ -0,0 +1,85 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+// Optional comparisons with other JSON libraries, each is built only when its
+//  sources are vendored in external (the build scripts define the macros):
+//
+//    CPP_JSON__RAPIDJSON   external/rapidjson/include/rapidjson/*.h
+//    CPP_JSON__NLOHMANN    external/nlohmann/include/nlohmann/json.hpp
+//    CPP_JSON__SIMDJSON    external/simdjson/simdjson.h and simdjson.cpp, see perf__simdjson.cpp
+//
+//  All parse UTF-8 input from a std::string.
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__parser.hpp"
+
+#ifdef CPP_JSON__RAPIDJSON
+# include "rapidjson/document.h"
+# include "rapidjson/reader.h"
+#endif
+
+#ifdef CPP_JSON__NLOHMANN
+# include "nlohmann/json.hpp"
+#endif
+
+#ifdef CPP_JSON__RAPIDJSON
+
+namespace
+{
+  // Counts the events like nop_json_context does for cpp_json
+  struct rapidjson_nop_handler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, rapidjson_nop_handler>
+  {
+    std::size_t count = 0;
+
+    bool Default ()
+    {
+      ++count;
+      return true;
+    }
+  };
+}
+
+void perf__rapidjson_sax (std::string const & json_document)
+{
+  rapidjson::Reader             reader  ;
+  rapidjson::StringStream       stream  (json_document.c_str ());
+  rapidjson_nop_handler         handler ;
+
+  auto presult = reader.Parse (stream, handler);
+  CPP_JSON__ASSERT (!presult.IsError ());
+  CPP_JSON__ASSERT (handler.count > 0);
+  (void) presult;
+}
+
+void perf__rapidjson_document (std::string const & json_document)
+{
+  rapidjson::Document document;
+  document.Parse (json_document.c_str ());
+  CPP_JSON__ASSERT (!document.HasParseError ());
+}
+
+#endif
+
+#ifdef CPP_JSON__NLOHMANN
+
+void perf__nlohmann_document (std::string const & json_document)
+{
+  auto document = nlohmann::json::parse (json_document);
+  CPP_JSON__ASSERT (!document.is_null ());
+}
+
+#endif
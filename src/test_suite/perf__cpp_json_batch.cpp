@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__batch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+  template<typename TAction>
+  long long time_once (TAction action)
+  {
+    auto then = std::chrono::high_resolution_clock::now ();
+    action ();
+    auto now  = std::chrono::high_resolution_clock::now ();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds> (now - then).count ();
+  }
+
+  void report (char const * name, long long ms, std::size_t count)
+  {
+    std::cout
+      << name << ": Milliseconds: " << ms
+      << " (documents/s: " << (ms > 0 ? static_cast<long long> (count) * 1000 / ms : 0) << ")"
+      << std::endl;
+  }
+}
+
+// Compares json_parser::parse in a loop with json_batch_parser on a batch of 'count'
+//  documents taken round robin from 'json_documents'
+void perf__parse_json_batch (std::vector<std::wstring> const & json_documents, std::size_t count)
+{
+  using namespace cpp_json::document;
+
+  if (json_documents.empty ())
+  {
+    std::cout << "No documents to parse" << std::endl;
+    return;
+  }
+
+  doc_strings_type batch;
+  batch.reserve (count);
+  for (auto iter = 0U; iter < count; ++iter)
+  {
+    batch.push_back (json_documents[iter % json_documents.size ()]);
+  }
+
+  std::cout << "Parsing a batch of " << count << " documents..." << std::endl;
+
+  std::vector<json_document::ptr> documents (count);
+
+  auto time__naive = time_once ([&] ()
+    {
+      for (auto iter = 0U; iter < count; ++iter)
+      {
+        std::size_t pos;
+        json_parser::parse (batch[iter], pos, documents[iter]);
+      }
+    });
+  report ("naive loop", time__naive, count);
+
+  documents.clear ();
+
+  json_batch_results results;
+
+  {
+    json_batch_parser parser (1);
+    parser.parse_batch (batch, results);  // Warm up
+    auto time__batch_1 = time_once ([&] () { parser.parse_batch (batch, results); });
+    report ("parse_batch (1 thread)", time__batch_1, count);
+  }
+
+  auto concurrency = std::thread::hardware_concurrency ();
+  if (concurrency > 1)
+  {
+    json_batch_parser parser (concurrency);
+    parser.parse_batch (batch, results);  // Warm up
+    auto time__batch_n = time_once ([&] () { parser.parse_batch (batch, results); });
+    std::cout << "(" << concurrency << " threads) ";
+    report ("parse_batch", time__batch_n, count);
+  }
+}
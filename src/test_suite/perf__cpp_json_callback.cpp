@@ -21,17 +21,18 @@
 
 namespace
 {
-  std::wstring empty;
-
-  struct nop_json_context
+  // TChar is wchar_t for the wide char API and char for UTF-8
+  template<typename TChar>
+  struct basic_nop_json_context
   {
-    using string_type = std::wstring    ; // Type of string, typically std::wstring
-    using char_type   = wchar_t         ; // Type of char, typically wchar_t
-    using iter_type   = wchar_t const * ; // Type of string "iterator", typically wchar_t const *
+    using string_type = std::basic_string<TChar>  ; // Type of string, typically std::wstring
+    using char_type   = TChar                     ; // Type of char, typically wchar_t
+    using iter_type   = TChar const *             ; // Type of string "iterator", typically wchar_t const *
 
     std::size_t count;
+    string_type empty;
 
-    nop_json_context ()
+    basic_nop_json_context ()
       : count (0)
     {
     }
@@ -135,6 +136,40 @@ namespace
       return true;
     }
   };
+
+  using nop_json_context = basic_nop_json_context<wchar_t>;
+
+  // Skips every container below the root value
+  struct skip_json_context : nop_json_context
+  {
+    bool root_seen;
+
+    skip_json_context ()
+      : root_seen (false)
+    {
+    }
+
+    inline cpp_json::parser::json_decision container_begin ()
+    {
+      ++count;
+      if (root_seen)
+      {
+        return cpp_json::parser::json_decision::skip;
+      }
+      root_seen = true;
+      return cpp_json::parser::json_decision::proceed;
+    }
+
+    inline cpp_json::parser::json_decision array_begin ()
+    {
+      return container_begin ();
+    }
+
+    inline cpp_json::parser::json_decision object_begin ()
+    {
+      return container_begin ();
+    }
+  };
 }
 
 void perf__parse_json_callback (std::wstring const & json_document)
@@ -150,3 +185,31 @@ void perf__parse_json_callback (std::wstring const & json_document)
 
   CPP_JSON__ASSERT (jp.count > 0);
 }
+
+void perf__parse_json_callback_skip (std::wstring const & json_document)
+{
+  auto json_begin     = json_document.data ();
+  auto json_end       = json_begin + json_document.size ();
+
+  cpp_json::parser::json_parser<skip_json_context> jp (json_begin, json_end);
+
+  auto presult  = jp.try_parse__json ();
+
+  CPP_JSON__ASSERT (presult);
+
+  CPP_JSON__ASSERT (jp.count > 0);
+}
+
+void perf__parse_json_callback_utf8 (std::string const & json_document)
+{
+  auto json_begin     = json_document.data ();
+  auto json_end       = json_begin + json_document.size ();
+
+  cpp_json::parser::json_parser<basic_nop_json_context<char>> jp (json_begin, json_end);
+
+  auto presult  = jp.try_parse__json ();
+
+  CPP_JSON__ASSERT (presult);
+
+  CPP_JSON__ASSERT (jp.count > 0);
+}
@@ -29,3 +29,16 @@ void perf__parse_json_document (std::wstring const & json_document)
 
   CPP_JSON__ASSERT (presult);
 }
+
+void perf__parse_json_document_utf8 (std::string const & json_document)
+{
+  using namespace cpp_json::document;
+
+  std::size_t         pos     ;
+  json_document::ptr  document;
+
+  auto begin    = json_document.data ();
+  auto presult  = json_parser::parse (begin, begin + json_document.size (), pos, document);
+
+  CPP_JSON__ASSERT (presult);
+}
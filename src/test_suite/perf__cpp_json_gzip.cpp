@@ -0,0 +1,108 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__document.hpp"
+#include "../cpp_json/cpp_json__gzip.hpp"
+
+#ifdef CPP_JSON__ZLIB
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+  using namespace cpp_json::document;
+  using cpp_json::parser::json_block_stream   ;
+  using cpp_json::parser::json_gzip_source    ;
+  using cpp_json::parser::json_memory_source  ;
+
+  template<typename TAction>
+  long long time_it (std::size_t count, TAction action)
+  {
+    auto then = std::chrono::high_resolution_clock::now ();
+    for (auto iter = 0U; iter < count; ++iter)
+    {
+      action ();
+    }
+    auto now  = std::chrono::high_resolution_clock::now ();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds> (now - then).count ();
+  }
+
+  // The common approach: decompress into a buffer and parse the buffer
+  std::size_t parse_buffered (std::string const & compressed)
+  {
+    json_memory_source  source (compressed.data (), compressed.data () + compressed.size ());
+    json_gzip_source    gzip   (source);
+
+    std::string buffer;
+    std::size_t size = 0;
+    do
+    {
+      buffer.resize (size + json_gzip_source::default_buffer_size);
+      size += gzip.read (&buffer[size], json_gzip_source::default_buffer_size);
+    }
+    while (size == buffer.size ());
+    buffer.resize (size);
+
+    std::size_t         pos ;
+    json_document::ptr  doc ;
+    auto presult = json_parser::parse (buffer.data (), buffer.data () + buffer.size (), pos, doc);
+    CPP_JSON__ASSERT (presult);
+
+    return buffer.capacity ();
+  }
+
+  // Decompresses on the stream thread while parsing
+  std::size_t parse_streamed (std::string const & compressed, std::size_t block_size)
+  {
+    json_memory_source  source (compressed.data (), compressed.data () + compressed.size ());
+    json_gzip_source    gzip   (source);
+    json_block_stream   stream (gzip, block_size);
+
+    std::size_t         pos ;
+    json_document::ptr  doc ;
+    auto presult = json_parser::parse (stream.begin (), stream.end (), pos, doc);
+    CPP_JSON__ASSERT (presult);
+
+    return block_size * json_block_stream::default_block_count + json_gzip_source::default_buffer_size;
+  }
+}
+
+// Compares decompressing to a buffer and then parsing with streaming decompression
+//  'json' is the decompressed input, 'compressed' the gzip compressed input
+void perf__parse_json_gzip (std::string const & file_name, std::string const & json, std::string const & compressed, std::size_t count)
+{
+  // Smaller blocks than the default, the test cases are small
+  auto block_size = std::size_t (1) << 14;
+
+  std::size_t buffered_bytes = 0;
+  std::size_t streamed_bytes = 0;
+
+  auto time__buffered = time_it (count, [&] () { buffered_bytes = parse_buffered (compressed); });
+  auto time__streamed = time_it (count, [&] () { streamed_bytes = parse_streamed (compressed, block_size); });
+
+  std::cout
+    << "Processing: " << file_name
+    << " (" << json.size () << " bytes, " << compressed.size () << " compressed)" << std::endl
+    << "gzip_buffered: Milliseconds: " << time__buffered << " (input buffers: " << buffered_bytes << " bytes)" << std::endl
+    << "gzip_streamed: Milliseconds: " << time__streamed << " (input buffers: " << streamed_bytes << " bytes)" << std::endl
+    ;
+}
+
+#endif
@@ -0,0 +1,198 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+void perf__parse_json_callback      (std::wstring const & json_document);
+void perf__parse_json_document      (std::wstring const & json_document);
+
+// Microbenchmarks of the parser kernels
+//  Each input is generated so that a single kernel does nearly all the work:
+//
+//    white_space   consume__white_space  [<indented lines>]
+//    string_*      try_parse__chars      ["<long string>"]
+//    number_*      try_parse__number     [<number>,<number>,...]
+//    literals      try_consume__token    [true,false,null,...]
+//    dom_*         builder_json_context  [[],[],...] parsed into a document, and
+//                                        with the nop callback context for comparison
+//
+//  Inputs are parsed through the public API so that the kernels are measured as
+//  inlined into the parser. The root value must be an array or an object.
+namespace
+{
+  // Inputs are about this many chars, large enough to not be dominated by setup
+  //  but small enough to stay in L2/L3
+  constexpr std::size_t input_size = 1 << 18;
+
+  struct kernel_input
+  {
+    char const *  name    ;
+    std::wstring  json    ;
+    std::size_t   elements;   // The unit of ns/element
+  };
+
+  // Deterministic pseudo random numbers so runs are comparable
+  struct lcg
+  {
+    std::uint32_t state = 19740531U;
+
+    std::uint32_t next () noexcept
+    {
+      state = state * 1664525U + 1013904223U;
+      return state >> 8;
+    }
+  };
+
+  // Elements are white space chars
+  kernel_input white_space ()
+  {
+    kernel_input result { "white_space", L"[", 0 };
+    while (result.json.size () < input_size)
+    {
+      result.json += L"\n                ";
+      result.elements += 17;
+    }
+    result.json += L"]";
+    return result;
+  }
+
+  // Elements are the chars of the string
+  template<typename TAppend>
+  kernel_input string (char const * name, TAppend append)
+  {
+    kernel_input result { name, L"[\"", 0 };
+    while (result.json.size () < input_size)
+    {
+      result.elements += append (result.json);
+    }
+    result.json += L"\"]";
+    return result;
+  }
+
+  // Elements are numbers or literals
+  template<typename TAppend>
+  kernel_input values (char const * name, TAppend append)
+  {
+    kernel_input result { name, L"[", 0 };
+    lcg random;
+    while (result.json.size () < input_size)
+    {
+      if (result.elements > 0)
+      {
+        result.json += L",";
+      }
+      append (result.json, random);
+      ++result.elements;
+    }
+    result.json += L"]";
+    return result;
+  }
+
+  // Elements are containers, 'container' holds 'count' containers
+  kernel_input containers (char const * name, wchar_t const * container, std::size_t count)
+  {
+    kernel_input result { name, L"[", 0 };
+    while (result.json.size () < input_size)
+    {
+      if (result.json.size () > 1)
+      {
+        result.json += L",";
+      }
+      result.json += container;
+      result.elements += count;
+    }
+    result.json += L"]";
+    return result;
+  }
+
+  std::wstring to_wstring (std::uint32_t v)
+  {
+    auto s = std::to_string (v);
+    return std::wstring (s.begin (), s.end ());
+  }
+
+  template<typename TParse>
+  void run (kernel_input const & input, char const * api, std::size_t megabytes, TParse parse)
+  {
+    auto repeat = (megabytes << 20) / input.json.size ();
+    if (repeat == 0)
+    {
+      repeat = 1;
+    }
+
+    parse (input.json);
+
+    auto then = std::chrono::high_resolution_clock::now ();
+    for (auto iter = 0U; iter < repeat; ++iter)
+    {
+      parse (input.json);
+    }
+    auto now  = std::chrono::high_resolution_clock::now ();
+
+    auto ns     = static_cast<double> (std::chrono::duration_cast<std::chrono::nanoseconds> (now - then).count ());
+    auto chars  = static_cast<double> (input.json.size ()) * repeat;
+
+    std::cout
+      << std::left << std::setw (20) << input.name
+      << std::setw (10) << api
+      << std::right << std::fixed
+      << std::setprecision (2) << std::setw (10) << ns / (static_cast<double> (input.elements) * repeat) << " ns/element"
+      << std::setprecision (1) << std::setw (10) << (ns > 0 ? chars * 1000.0 / ns : 0.0) << " MB/s"
+      << std::endl;
+  }
+}
+
+// Runs each kernel microbenchmark on about 'megabytes' MiB of input chars
+//  MB/s counts input chars, for the non-ASCII strings a char is more than one byte in UTF-8
+void perf__parse_json_kernels (std::size_t megabytes)
+{
+  kernel_input const inputs [] =
+  {
+    white_space (),
+    string ("string_ascii"  , [] (std::wstring & s) { s += L"The quick brown fox jumps over the lazy dog. "; return 45; }),
+    string ("string_unicode", [] (std::wstring & s) { s += L"Съешь же ещё этих мягких французских булок. "; return 44; }),
+    string ("string_escapes", [] (std::wstring & s) { s += L"a\\n\\t\\\"\\\\\\u00e5\\u20ac"; return 7; }),
+    values ("number_integer" , [] (std::wstring & s, lcg & r) { s += to_wstring (r.next () % 1000000); }),
+    values ("number_decimal" , [] (std::wstring & s, lcg & r) { s += to_wstring (r.next () % 10000) + L"." + to_wstring (r.next () % 1000); }),
+    values ("number_exponent", [] (std::wstring & s, lcg & r) { s += L"-" + to_wstring (r.next () % 10) + L"." + to_wstring (r.next () % 10000) + L"e-" + to_wstring (r.next () % 300); }),
+    values ("literals"       , [] (std::wstring & s, lcg & r) { wchar_t const * const ls [] = { L"true", L"false", L"null" }; s += ls[r.next () % 3]; }),
+    containers ("dom_arrays"  , L"[]"         , 1),
+    containers ("dom_objects" , L"{}"         , 1),
+    containers ("dom_nested"  , L"[[[[{}]]]]" , 5),
+  };
+
+  std::cout << "Kernel microbenchmarks, " << megabytes << " MiB per kernel" << std::endl;
+
+  for (auto && input : inputs)
+  {
+    run (input, "callback", megabytes, perf__parse_json_callback);
+  }
+
+  // DOM building: the difference to the callback context is the cost of building
+  for (auto && input : inputs)
+  {
+    if (std::string (input.name).compare (0, 4, "dom_") == 0)
+    {
+      run (input, "document", megabytes, perf__parse_json_document);
+    }
+  }
+}
@@ -0,0 +1,247 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__document.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+void perf__parse_json_callback      (std::wstring const & json_document);
+
+namespace
+{
+  using clock_type = std::chrono::steady_clock;
+
+  // A histogram with HDR (high dynamic range) buckets: values below 2^sub_bits are
+  //  recorded exactly, larger values with sub_bits - 1 significant bits (< 1.6% error)
+  struct latency_histogram
+  {
+    constexpr static unsigned sub_bits  = 7;
+    constexpr static unsigned half      = 1U << (sub_bits - 1);
+
+    latency_histogram ()
+      : buckets (64 * half + 2 * half, 0)
+      , count   (0)
+      , max     (0)
+    {
+    }
+
+    void record (std::uint64_t ns)
+    {
+      ++buckets[index_of (ns)];
+      ++count;
+      if (ns > max)
+      {
+        max = ns;
+      }
+    }
+
+    // The highest value of the bucket containing the percentile 'p' (0-100)
+    std::uint64_t percentile (double p) const
+    {
+      if (count == 0)
+      {
+        return 0;
+      }
+
+      auto rank = static_cast<std::uint64_t> (p / 100.0 * count + 0.5);
+      if (rank == 0)
+      {
+        rank = 1;
+      }
+
+      std::uint64_t seen = 0;
+      for (auto iter = 0U; iter < buckets.size (); ++iter)
+      {
+        seen += buckets[iter];
+        if (seen >= rank)
+        {
+          auto v = upper_of (iter);
+          return v < max ? v : max;
+        }
+      }
+
+      return max;
+    }
+
+    std::uint64_t maximum () const
+    {
+      return max;
+    }
+
+  private:
+    std::vector<std::uint64_t>  buckets ;
+    std::uint64_t               count   ;
+    std::uint64_t               max     ;
+
+    static unsigned index_of (std::uint64_t v)
+    {
+      if (v < 2 * half)
+      {
+        return static_cast<unsigned> (v);
+      }
+
+      unsigned msb = 0;
+      while ((v >> msb) > 1)
+      {
+        ++msb;
+      }
+
+      auto shift = msb - sub_bits + 1;
+      return shift * half + static_cast<unsigned> (v >> shift);
+    }
+
+    static std::uint64_t upper_of (unsigned index)
+    {
+      if (index < 2 * half)
+      {
+        return index;
+      }
+
+      auto shift    = index / half - 1;
+      auto mantissa = static_cast<std::uint64_t> (index % half + half);
+      return ((mantissa + 1) << shift) - 1;
+    }
+  };
+
+  // Allocates and frees blocks of varying sizes until stopped, to expose
+  //  jitter caused by contention and fragmentation in the allocator
+  struct allocation_noise
+  {
+    allocation_noise ()
+      : stop (false)
+      , thread ([this] () { run (); })
+    {
+    }
+
+    ~allocation_noise ()
+    {
+      stop = true;
+      thread.join ();
+    }
+
+  private:
+    std::atomic<bool> stop  ;
+    std::thread       thread;
+
+    void run ()
+    {
+      std::vector<std::unique_ptr<char []>> blocks (1024);
+      std::uint32_t state = 19740531U;
+      while (!stop)
+      {
+        state     = state * 1664525U + 1013904223U;
+        auto slot = (state >> 8) % blocks.size ();
+        auto size = 16U << ((state >> 20) % 12);
+        blocks[slot].reset (new char [size]);
+        blocks[slot][0] = static_cast<char> (state);
+      }
+    }
+  };
+
+  std::uint64_t elapsed_ns (clock_type::time_point then)
+  {
+    return static_cast<std::uint64_t> (
+      std::chrono::duration_cast<std::chrono::nanoseconds> (clock_type::now () - then).count ());
+  }
+
+  void report (char const * operation, latency_histogram const & h)
+  {
+    auto us = [] (std::uint64_t ns) { return static_cast<double> (ns) / 1000.0; };
+    std::cout
+      << "  " << std::left << std::setw (12) << operation << std::right
+      << std::fixed << std::setprecision (1)
+      << " p50: "   << std::setw (9) << us (h.percentile (50.0))
+      << " p90: "   << std::setw (9) << us (h.percentile (90.0))
+      << " p99: "   << std::setw (9) << us (h.percentile (99.0))
+      << " p999: "  << std::setw (9) << us (h.percentile (99.9))
+      << " max: "   << std::setw (9) << us (h.maximum ())
+      << " (us)"
+      << std::endl;
+  }
+}
+
+// Times each of 'count' parses of 'json_document' individually and reports latency
+//  percentiles for the callback parser, parsing into a document, destroying the
+//  document and to_string
+//  If 'noise' is true an allocation heavy thread runs in the background
+void perf__parse_json_latency (std::string const & file_name, std::wstring const & json_document, std::size_t count, bool noise)
+{
+  using namespace cpp_json::document;
+
+  std::unique_ptr<allocation_noise> noise_thread;
+  if (noise)
+  {
+    noise_thread.reset (new allocation_noise ());
+  }
+
+  latency_histogram callback  ;
+  latency_histogram parse     ;
+  latency_histogram teardown  ;
+  latency_histogram to_string ;
+
+  // The first iteration warms up and isn't recorded
+  for (auto iter = 0U; iter <= count; ++iter)
+  {
+    auto record = iter > 0;
+
+    auto then = clock_type::now ();
+    perf__parse_json_callback (json_document);
+    auto ns_callback = elapsed_ns (then);
+
+    std::size_t         pos;
+    json_document::ptr  doc;
+    then = clock_type::now ();
+    auto presult = json_parser::parse (json_document, pos, doc);
+    auto ns_parse = elapsed_ns (then);
+    CPP_JSON__ASSERT (presult);
+
+    then = clock_type::now ();
+    auto s = doc->to_string ();
+    auto ns_to_string = elapsed_ns (then);
+    CPP_JSON__ASSERT (!s.empty ());
+
+    then = clock_type::now ();
+    doc.reset ();
+    auto ns_teardown = elapsed_ns (then);
+
+    if (record)
+    {
+      callback.record   (ns_callback);
+      parse.record      (ns_parse);
+      to_string.record  (ns_to_string);
+      teardown.record   (ns_teardown);
+    }
+  }
+
+  std::cout
+    << "Processing: " << file_name << " (" << json_document.size () << " chars, "
+    << count << " times" << (noise ? ", with allocation noise" : "") << ")" << std::endl;
+
+  report ("callback"  , callback);
+  report ("parse"     , parse);
+  report ("teardown"  , teardown);
+  report ("to_string" , to_string);
+}
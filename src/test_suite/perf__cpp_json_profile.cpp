@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__document.hpp"
+#include "../cpp_json/cpp_json__instrumentation.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+  using cpp_json::parser::json_cycle_instrumentation  ;
+  using cpp_json::parser::json_phase                  ;
+
+  double percent (double part, double total)
+  {
+    return total > 0 ? 100.0 * part / total : 0.0;
+  }
+
+  void report_bytes (char const * name, std::size_t bytes, std::size_t total)
+  {
+    std::cout
+      << "  " << std::left << std::setw (12) << name << std::right
+      << std::setw (10) << bytes << " chars"
+      << std::setw (7) << std::fixed << std::setprecision (1) << percent (static_cast<double> (bytes), static_cast<double> (total)) << "%"
+      << std::endl;
+  }
+
+  void report_phase (char const * name, std::uint64_t ticks, std::uint64_t total, std::size_t chars)
+  {
+    std::cout
+      << "  " << std::left << std::setw (12) << name << std::right
+      << std::setw (14) << ticks
+      << std::setw (7) << std::fixed << std::setprecision (1) << percent (static_cast<double> (ticks), static_cast<double> (total)) << "%"
+      << " (" << std::setprecision (2) << (chars > 0 ? static_cast<double> (ticks) / chars : 0.0) << " per char)"
+      << std::endl;
+  }
+}
+
+// Parses 'json_document' into a document 'count' times with json_cycle_instrumentation
+//  and prints where the bytes are and where the time goes
+void perf__parse_json_profile (std::string const & file_name, std::wstring const & json_document, std::size_t count)
+{
+  using namespace cpp_json::document;
+
+  if (count == 0)
+  {
+    count = 1;
+  }
+
+  json_cycle_instrumentation instrumentation;
+  for (auto iter = 0U; iter < count; ++iter)
+  {
+    std::size_t         pos;
+    json_document::ptr  doc;
+    auto presult = json_parser::parse_instrumented (json_document, pos, doc, instrumentation);
+    CPP_JSON__ASSERT (presult);
+  }
+
+  auto && i     = instrumentation;
+  auto    total = json_document.size () * count;
+  auto    structure = total - i.white_space_bytes - i.string_bytes - i.number_bytes - i.literal_bytes;
+
+  std::cout
+    << "Processing: " << file_name << " (" << json_document.size () << " chars, " << count << " times)" << std::endl
+    << "Chars per token class:" << std::endl
+    ;
+  report_bytes ("white space" , i.white_space_bytes , total);
+  report_bytes ("string"      , i.string_bytes      , total);
+  report_bytes ("number"      , i.number_bytes      , total);
+  report_bytes ("literal"     , i.literal_bytes     , total);
+  report_bytes ("structure"   , structure           , total);
+
+  std::cout
+    << "Values (per document):" << std::endl
+    << "  strings: " << (i.plain_strings + i.escaped_strings) / count
+    << " (" << i.escaped_strings / count << " with escapes, " << i.escapes / count << " escapes)" << std::endl
+    << "  numbers: " << i.numbers / count << ", literals: " << i.literals / count << std::endl
+    << "  arrays: " << i.arrays / count << " (max size " << i.max_array_size << ", " << i.array_values / count << " values)" << std::endl
+    << "  objects: " << i.objects / count << " (max size " << i.max_object_size << ", " << i.object_members / count << " members)" << std::endl
+    << "  max depth: " << i.max_depth << std::endl
+    ;
+
+  std::uint64_t phases = 0;
+  for (auto ticks : i.phase_ticks)
+  {
+    phases += ticks;
+  }
+
+  std::cout
+    << (cpp_json::parser::json_timestamp_is_cycles ? "Cycles" : "Nanoseconds") << " per phase:" << std::endl
+    ;
+  report_phase ("white space" , i.ticks (json_phase::white_space) , phases, i.white_space_bytes );
+  report_phase ("string"      , i.ticks (json_phase::string)      , phases, i.string_bytes      );
+  report_phase ("number"      , i.ticks (json_phase::number)      , phases, i.number_bytes      );
+  report_phase ("literal"     , i.ticks (json_phase::literal)     , phases, i.literal_bytes     );
+  report_phase ("context"     , i.ticks (json_phase::context)     , phases, total               );
+}
@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__document.hpp"
+
+#include "allocation_counter.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+  using namespace cpp_json::document;
+
+  template<typename TParse>
+  void measure (char const * name, std::vector<std::wstring> const & json_documents, std::size_t count, TParse parse)
+  {
+    // Warm up, lets the session grow its buffers
+    for (auto && json : json_documents)
+    {
+      parse (json);
+    }
+
+    auto before = get_allocation_counters ();
+    auto then   = std::chrono::high_resolution_clock::now ();
+
+    for (auto iter = 0U; iter < count; ++iter)
+    {
+      parse (json_documents[iter % json_documents.size ()]);
+    }
+
+    auto now    = std::chrono::high_resolution_clock::now ();
+    auto after  = get_allocation_counters () - before;
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds> (now - then).count ();
+
+    std::cout
+      << name << ": Milliseconds: " << ms
+      << " (allocations/document: " << static_cast<double> (after.allocations) / count
+      << ", bytes/document: " << after.bytes / count
+      << ")" << std::endl;
+  }
+}
+
+// Compares the allocations made by json_parser::parse with json_parse_session when
+//  parsing 'count' documents taken round robin from 'json_documents'
+//  Note: string_builder uses malloc so its buffer isn't counted
+void perf__parse_json_session (std::vector<std::wstring> const & json_documents, std::size_t count)
+{
+  if (json_documents.empty () || count == 0)
+  {
+    std::cout << "No documents to parse" << std::endl;
+    return;
+  }
+
+  std::cout << "Parsing " << count << " documents..." << std::endl;
+
+  measure ("json_parser::parse", json_documents, count, [] (std::wstring const & json)
+    {
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+      json_parser::parse (json, pos, doc);
+    });
+
+  {
+    json_parse_session session;
+    measure ("json_parse_session", json_documents, count, [&session] (std::wstring const & json)
+      {
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        session.parse (json, pos, doc);
+      });
+  }
+
+  {
+    json_parse_session session (true);
+    measure ("json_parse_session (reuse_documents)", json_documents, count, [&session] (std::wstring const & json)
+      {
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        session.parse (json, pos, doc);
+      });
+  }
+}
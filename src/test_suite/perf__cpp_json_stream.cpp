@@ -0,0 +1,159 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__reader.hpp"
+#include "../cpp_json/cpp_json__stream.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+  using namespace cpp_json::parser;
+
+  using stream_reader = basic_json_reader<char, json_block_iterator>;
+
+  struct file_closer
+  {
+    void operator() (std::FILE * file) const noexcept
+    {
+      std::fclose (file);
+    }
+  };
+
+  using file_ptr = std::unique_ptr<std::FILE, file_closer>;
+
+  // Writes a root array of objects of about 'megabytes' MiB
+  void generate_synthetic (std::FILE * file, std::size_t megabytes)
+  {
+    auto const size = megabytes << 20;
+
+    std::string element;
+    std::size_t written = 0;
+
+    std::fputs ("[\n", file);
+    for (std::size_t iter = 0; written < size; ++iter)
+    {
+      element.clear ();
+      if (iter > 0)
+      {
+        element += ",\n";
+      }
+      element += R"({"id":)";
+      element += std::to_string (iter);
+      element += R"(,"name":"element_)";
+      element += std::to_string (iter);
+      element += R"(","price":)";
+      element += std::to_string (iter % 1000);
+      element += R"(.25,"tags":["a","b\tc"],"active":true,"next":null})";
+
+      std::fwrite (element.data (), 1, element.size (), file);
+      written += element.size ();
+    }
+    std::fputs ("\n]\n", file);
+    std::fflush (file);
+  }
+
+  template<typename TAction>
+  long long time_once (TAction action)
+  {
+    auto then = std::chrono::high_resolution_clock::now ();
+    action ();
+    auto now  = std::chrono::high_resolution_clock::now ();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds> (now - then).count ();
+  }
+
+  std::size_t read_all (std::FILE * file)
+  {
+    std::vector<char> buffer (json_block_stream::default_block_size);
+    std::size_t       total = 0;
+
+    std::rewind (file);
+    while (auto read = std::fread (buffer.data (), 1, buffer.size (), file))
+    {
+      total += read;
+    }
+
+    return total;
+  }
+
+  std::size_t parse_all (std::FILE * file, bool background)
+  {
+    std::rewind (file);
+
+    json_file_source  source (file);
+    json_block_stream stream (source, json_block_stream::default_block_size, json_block_stream::default_block_count, background);
+    stream_reader     reader (stream.begin (), stream.end ());
+
+    std::size_t tokens = 0;
+    for (auto token : reader)
+    {
+      (void) token;
+      ++tokens;
+    }
+
+    if (source.failed ())
+    {
+      std::cout << "Stream read failed" << std::endl;
+    }
+    else if (reader.token () != json_token::eos)
+    {
+      std::cout << "Stream parse failed at: " << reader.pos () << std::endl;
+    }
+
+    return tokens;
+  }
+}
+
+// Compares reading and then parsing a file (I/O + parse) with overlapped reading
+//  and parsing (max (I/O, parse)) on a synthetic file of 'megabytes' MiB
+//  Note: the file is likely to be in the OS cache so I/O is mostly memory copies
+void perf__parse_json_stream (std::size_t megabytes)
+{
+  file_ptr file (std::tmpfile ());
+  if (!file)
+  {
+    std::cout << "Failed to create temporary file" << std::endl;
+    return;
+  }
+
+  std::cout << "Generating " << megabytes << " MiB of synthetic JSON..." << std::endl;
+  generate_synthetic (file.get (), megabytes);
+
+  std::size_t bytes   = 0;
+  std::size_t tokens  = 0;
+
+  auto time__io         = time_once ([&] () { bytes   = read_all  (file.get ()); });
+  auto time__sequential = time_once ([&] () { tokens  = parse_all (file.get (), false); });
+  auto time__pipelined  = time_once ([&] () { tokens  = parse_all (file.get (), true); });
+
+  auto time__parse      = time__sequential > time__io ? time__sequential - time__io : 0;
+
+  std::cout << "Bytes: " << bytes << ", Tokens: " << tokens << std::endl;
+  std::cout << "io: Milliseconds: " << time__io << std::endl;
+  std::cout << "parse (estimated): Milliseconds: " << time__parse << std::endl;
+  std::cout << "sequential (io + parse): Milliseconds: " << time__sequential << std::endl;
+  std::cout << "pipelined (max (io, parse)): Milliseconds: " << time__pipelined
+            << " (ideal: " << (time__io > time__parse ? time__io : time__parse) << ")"
+            << std::endl;
+}
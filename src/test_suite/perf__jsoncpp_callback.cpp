@@ -27,3 +27,15 @@ void perf__jsoncpp_document (std::string const & json_document)
   assert (presult);
 
 }
+
+// Parses the document and returns it, used to measure the memory it holds
+std::shared_ptr<void> perf__jsoncpp_document_retained (std::string const & json_document)
+{
+  auto result = std::make_shared<Json::Value> ();
+
+  Json::Reader reader;
+  auto presult = reader.parse (json_document, *result, false);
+  assert (presult);
+
+  return result;
+}
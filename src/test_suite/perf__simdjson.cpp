@@ -0,0 +1,93 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+// Optional comparison with simdjson, built when the single header release
+//  (simdjson.h and simdjson.cpp) is vendored in external/simdjson
+//  simdjson requires C++17 so this file is compiled separately from the rest
+//  of the test_suite, see build_with_g++.bash
+
+#include "stdafx.h"
+
+#include "../cpp_json/cpp_json__parser.hpp"
+
+#ifdef CPP_JSON__SIMDJSON
+
+#include "simdjson.h"
+
+namespace
+{
+  // Counts the scalar values so that on-demand parsing visits the whole document
+  std::size_t visit (simdjson::ondemand::value value)
+  {
+    switch (value.type ())
+    {
+    case simdjson::ondemand::json_type::array:
+      {
+        std::size_t count = 0;
+        for (auto element : value.get_array ())
+        {
+          count += visit (element.value ());
+        }
+        return count;
+      }
+    case simdjson::ondemand::json_type::object:
+      {
+        std::size_t count = 0;
+        for (auto field : value.get_object ())
+        {
+          std::string_view key = field.unescaped_key ();
+          count += key.size () > 0 ? 1 : 0;
+          count += visit (field.value ());
+        }
+        return count;
+      }
+    case simdjson::ondemand::json_type::string:
+      return std::string_view (value.get_string ()).size () > 0 ? 1 : 0;
+    case simdjson::ondemand::json_type::number:
+      return static_cast<double> (value.get_double ()) != 0 ? 1 : 0;
+    case simdjson::ondemand::json_type::boolean:
+      return bool (value.get_bool ()) ? 1 : 0;
+    default:
+      return value.is_null () ? 1 : 0;
+    }
+  }
+}
+
+// The parsers are reused, as simdjson recommends, so the padded copy of the
+//  input is what is allocated per document
+
+void perf__simdjson_document (std::string const & json_document)
+{
+  static thread_local simdjson::dom::parser parser;
+
+  simdjson::dom::element document;
+  auto error = parser.parse (json_document).get (document);
+  CPP_JSON__ASSERT (!error);
+  (void) error;
+}
+
+void perf__simdjson_ondemand (std::string const & json_document)
+{
+  static thread_local simdjson::ondemand::parser parser;
+
+  simdjson::padded_string json (json_document);
+  auto document = parser.iterate (json);
+  auto count    = visit (document.get_value ());
+  CPP_JSON__ASSERT (count > 0);
+  (void) count;
+}
+
+#endif
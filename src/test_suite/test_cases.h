@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------------------------
+// Copyright 2015 Mårten Rånge
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------------------------
+
+#ifndef CPP_JSON__TEST_CASES_H
+#define CPP_JSON__TEST_CASES_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Helpers to load the files in the test_cases directory, shared by test_suite and scaling_benchmark
+
+// Finds the test_cases directory by searching upwards from the directory of the executable
+//  Doesn't depend on filesystem support, returns an empty string if not found
+inline std::string find_test_cases (char const * exe)
+{
+  std::string directory = exe ? exe : "";
+  auto separator = directory.find_last_of ("/\\");
+  directory = separator == std::string::npos
+    ? std::string (".")
+    : directory.substr (0, separator)
+    ;
+
+  for (auto iter = 0; iter < 6; ++iter)
+  {
+    auto test_cases = directory + "/test_cases";
+    std::ifstream probe (test_cases + "/json/Simple.json");
+    if (probe)
+    {
+      return test_cases;
+    }
+    directory += "/..";
+  }
+
+  return std::string ();
+}
+
+inline std::string read_binary_file (std::string const & file_name)
+{
+  std::ifstream       input_stream (file_name, std::ios::binary);
+  std::ostringstream  content;
+  content << input_stream.rdbuf ();
+  return content.str ();
+}
+
+// Only used for test cases that are known to be ASCII
+inline std::wstring widen (std::string const & s)
+{
+  return std::wstring (s.begin (), s.end ());
+}
+
+#endif  // CPP_JSON__TEST_CASES_H
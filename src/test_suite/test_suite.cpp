@@ -16,21 +16,44 @@
 
 #include "stdafx.h"
 
+#include "../cpp_json/cpp_json__batch.hpp"
+#include "../cpp_json/cpp_json__cache.hpp"
 #include "../cpp_json/cpp_json__document.hpp"
+#include "../cpp_json/cpp_json__gzip.hpp"
+#include "../cpp_json/cpp_json__instrumentation.hpp"
+#include "../cpp_json/cpp_json__memory.hpp"
+#include "../cpp_json/cpp_json__ondemand.hpp"
+#include "../cpp_json/cpp_json__query.hpp"
+#include "../cpp_json/cpp_json__reader.hpp"
+#include "../cpp_json/cpp_json__snapshot.hpp"
+#include "../cpp_json/cpp_json__stream.hpp"
+#include "../cpp_json/cpp_json__transcode.hpp"
+#include "../cpp_json/cpp_json__writer.hpp"
+
+#include "allocation_counter.h"
+#include "hardware_counters.h"
+#include "test_cases.h"
 
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <locale>
 #include <sstream>
+#include <thread>
 
 #include <deque>
 #include <set>
 
+#ifdef __GLIBC__
+# include <malloc.h> // pvalloc
+#endif
+
 #if _MSC_VER >= 1900
 # define CPP_JSON__FILESYSTEM // VS 2015 supports a preliminary version of filesystem
 #endif
@@ -43,9 +66,33 @@ using namespace std::tr2::sys;
 
 #define TEST_EQ(expected, actual) test_eq (__FILE__, __LINE__, expected, #expected, actual, #actual)
 
-void perf__parse_json_callback  (std::wstring const & json_document);
-void perf__parse_json_document  (std::wstring const & json_document);
-void perf__jsoncpp_document     (std::string const & json_document);
+void perf__parse_json_callback      (std::wstring const & json_document);
+void perf__parse_json_callback_skip (std::wstring const & json_document);
+void perf__parse_json_document      (std::wstring const & json_document);
+void perf__jsoncpp_document         (std::string const & json_document);
+void perf__parse_json_callback_utf8 (std::string const & json_document);
+std::shared_ptr<void> perf__jsoncpp_document_retained (std::string const & json_document);
+void perf__parse_json_document_utf8 (std::string const & json_document);
+#ifdef CPP_JSON__RAPIDJSON
+void perf__rapidjson_sax            (std::string const & json_document);
+void perf__rapidjson_document       (std::string const & json_document);
+#endif
+#ifdef CPP_JSON__NLOHMANN
+void perf__nlohmann_document        (std::string const & json_document);
+#endif
+#ifdef CPP_JSON__SIMDJSON
+void perf__simdjson_document        (std::string const & json_document);
+void perf__simdjson_ondemand        (std::string const & json_document);
+#endif
+void perf__parse_json_stream        (std::size_t megabytes);
+void perf__parse_json_batch         (std::vector<std::wstring> const & json_documents, std::size_t count);
+void perf__parse_json_session       (std::vector<std::wstring> const & json_documents, std::size_t count);
+void perf__parse_json_kernels       (std::size_t megabytes);
+void perf__parse_json_latency       (std::string const & file_name, std::wstring const & json_document, std::size_t count, bool noise);
+void perf__parse_json_profile       (std::string const & file_name, std::wstring const & json_document, std::size_t count);
+#ifdef CPP_JSON__ZLIB
+void perf__parse_json_gzip          (std::string const & file_name, std::string const & json, std::string const & compressed, std::size_t count);
+#endif
 
 namespace
 {
@@ -525,6 +572,9 @@ namespace
         auto time__cpp_json_callback = time_it (count, [&json_wdocument] () { perf__parse_json_callback (json_wdocument); });
         std::cout << "cpp_json_callback: Milliseconds: " << time__cpp_json_callback << std::endl;
 
+        auto time__cpp_json_callback_skip = time_it (count, [&json_wdocument] () { perf__parse_json_callback_skip (json_wdocument); });
+        std::cout << "cpp_json_callback_skip: Milliseconds: " << time__cpp_json_callback_skip << std::endl;
+
         auto time__cpp_json_document = time_it (count, [&json_wdocument] () { perf__parse_json_document (json_wdocument); });
         std::cout << "cpp_json_document: Milliseconds: " << time__cpp_json_document << std::endl;
 
@@ -535,184 +585,895 @@ namespace
   }
 #endif
 
-  void manual_test_cases ()
+#ifdef CPP_JSON__ZLIB
+  // Compresses s in gzip format
+  std::string gzip_compress (std::string const & s)
   {
-    std::cout << "Running 'manual_test_cases'..." << std::endl;
+    z_stream zs;
+    std::memset (&zs, 0, sizeof (zs));
+
+    // 15 + 16 writes a gzip header
+    auto init = deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    CPP_JSON__ASSERT (init == Z_OK);
+
+    std::string result (deflateBound (&zs, static_cast<uLong> (s.size ())), '\0');
+
+    zs.next_in    = reinterpret_cast<Bytef *> (const_cast<char *> (s.data ()));
+    zs.avail_in   = static_cast<uInt> (s.size ());
+    zs.next_out   = reinterpret_cast<Bytef *> (&result.front ());
+    zs.avail_out  = static_cast<uInt> (result.size ());
+
+    auto deflated = deflate (&zs, Z_FINISH);
+    CPP_JSON__ASSERT (deflated == Z_STREAM_END);
+
+    result.resize (zs.total_out);
+    deflateEnd (&zs);
+
+    return result;
+  }
+#endif
+
+  // Runs each API 'count' times on the performance test cases and reports hardware
+  //  counters per byte and per document
+  void counters_benchmark (std::string const & test_cases, std::size_t count)
+  {
+    hardware_counter_group group;
+    if (!group.available ())
+    {
+      std::cout << "Hardware counters not available (perf_event_open failed)" << std::endl;
+    }
+
+    for (auto && file_name : { "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json" })
+    {
+      auto json   = read_binary_file (test_cases + "/json/" + file_name);
+      auto wjson  = widen (json);
+
+      std::cout << "Processing: " << file_name << " (" << json.size () << " bytes, " << count << " times)" << std::endl;
+
+      auto run = [&group, &json, count] (char const * api, std::function<void ()> const & parse)
+        {
+          // time_it runs parse count + 1 times, the first run warms up
+          group.start ();
+          auto ms       = time_it (count, parse);
+          auto counters = group.stop ();
+
+          std::cout << api << ": Milliseconds: " << ms << std::endl;
+
+          auto bytes = static_cast<double> (json.size ()) * (count + 1);
+          for (auto iter = 0U; iter < hardware_event_count; ++iter)
+          {
+            auto e = static_cast<hardware_event> (iter);
+            if (!counters.is_supported (e))
+            {
+              continue;
+            }
 
+            auto v = static_cast<double> (counters.value (e));
+            std::cout
+              << "  " << std::left << std::setw (16) << hardware_event_name (e) << std::right
+              << std::fixed << std::setprecision (3)
+              << std::setw (12) << v / bytes << " /byte"
+              << std::setprecision (0)
+              << std::setw (16) << v / (count + 1) << " /document"
+              << std::endl;
+          }
+
+          if (counters.is_supported (hardware_event::cycles) && counters.value (hardware_event::cycles) > 0)
+          {
+            std::cout
+              << "  IPC: " << std::setprecision (2)
+              << static_cast<double> (counters.value (hardware_event::instructions)) / counters.value (hardware_event::cycles)
+              << std::endl;
+          }
+        };
+
+      run ("cpp_json_callback"      , [&wjson] () { perf__parse_json_callback (wjson); });
+      run ("cpp_json_callback_skip" , [&wjson] () { perf__parse_json_callback_skip (wjson); });
+      run ("cpp_json_document"      , [&wjson] () { perf__parse_json_document (wjson); });
+      run ("jsoncpp_document"       , [&json] () { perf__jsoncpp_document (json); });
+    }
+  }
+
+  // Reports the memory held by a parsed document per input byte, for cpp_json by
+  //  json_document::memory_usage and measured by the allocation counter, and for jsoncpp
+  //  measured by the allocation counter
+  void memory_benchmark (std::string const & test_cases)
+  {
     using namespace cpp_json::document;
 
-    std::vector<doc_string_type> test_cases =
+    auto bytes_per_byte = [] (std::size_t bytes, std::size_t input)
       {
-        LR"({
-"abc":"012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
-"abc",
-})"                                                                                         ,
-        LR"({
-"abc":"012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
-"abc",
-012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789
-})"                                                                                         ,
-        LR"({
-"abc",
-012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789
-})"                                                                                         ,
-        LR"([null, 123,-123E100,"Test\tHello", true,false, [true,null],[],{}, {"x":true}])" ,
-        LR"(["\b\f\n\r\t\u0010"])"                                                          ,
-        LR"(
-{
-  "x":null,
-  "y":3
-})"                                                                                         ,
-        LR"(["\u004Abc"])"                                                                  ,
-        LR"({:null})"                                                                       ,
-        LR"([)"                                                                             ,
-        LR"({"abc":})"                                                                      ,
-        LR"(
-{
-  "x":null,
-  })"                                                                                       ,
+        return input > 0 ? static_cast<double> (bytes) / input : 0.0;
       };
 
-    for (auto && test_case : test_cases)
+    std::cout
+      << std::left << std::setw (24) << "file"
+      << std::right << std::setw (10) << "bytes"
+      << std::setw (14) << "memory_usage"
+      << std::setw (10) << "/byte"
+      << std::setw (14) << "cpp_json"
+      << std::setw (10) << "/byte"
+      << std::setw (14) << "jsoncpp"
+      << std::setw (10) << "/byte"
+      << std::endl;
+
+    for (auto && file_name : { "Simple.json", "contacts.json", "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json" })
     {
-      std::size_t         pos     ;
-      json_document::ptr  document;
-      doc_string_type     error   ;
+      auto json   = read_binary_file (test_cases + "/json/" + file_name);
+      auto wjson  = widen (json);
 
-      std::wcout << "TEST_CASE: "<< test_case << std::endl;
+      std::size_t         pos;
+      json_document::ptr  doc;
 
-      if (json_parser::parse (test_case, pos, document, error))
+      auto before = get_allocation_counters ();
+      json_parser::parse (wjson, pos, doc);
+      auto cpp_json_live = (get_allocation_counters () - before).live_bytes;
+
+      CPP_JSON__ASSERT (doc);
+      auto usage = doc->memory_usage ();
+
+      before = get_allocation_counters ();
+      auto jsoncpp_doc  = perf__jsoncpp_document_retained (json);
+      auto jsoncpp_live = (get_allocation_counters () - before).live_bytes;
+
+      std::cout
+        << std::left << std::setw (24) << file_name
+        << std::right << std::setw (10) << json.size ()
+        << std::fixed << std::setprecision (2)
+        << std::setw (14) << usage.total ()   << std::setw (10) << bytes_per_byte (usage.total (), json.size ())
+        << std::setw (14) << cpp_json_live    << std::setw (10) << bytes_per_byte (cpp_json_live, json.size ())
+        << std::setw (14) << jsoncpp_live     << std::setw (10) << bytes_per_byte (jsoncpp_live, json.size ())
+        << std::endl;
+
+      std::cout
+        << "  nodes (number/string/array/object): "
+        << usage.number_nodes << "/" << usage.string_nodes << "/" << usage.array_nodes << "/" << usage.object_nodes
+        << ", node slack: " << usage.node_slack
+        << ", string payload: " << usage.string_payload << " (slack " << usage.string_slack << ")"
+        << ", members (array/object): " << usage.array_members << "/" << usage.object_members
+        << " (slack " << usage.member_slack << ")"
+        << std::endl;
+    }
+  }
+
+  // Compares cpp_json with the other JSON libraries that are available, on UTF-8 input
+  //  See perf__competitors.cpp for how to add the libraries
+  void competitors_benchmark (std::string const & test_cases, std::size_t count)
+  {
+    using perf_function = void (*) (std::string const &);
+
+    struct competitor
+    {
+      char const *  name  ;
+      perf_function parse ;
+    };
+
+    competitor const competitors [] =
+    {
+      { "cpp_json_callback"   , perf__parse_json_callback_utf8  },
+      { "cpp_json_document"   , perf__parse_json_document_utf8  },
+      { "jsoncpp_document"    , perf__jsoncpp_document          },
+#ifdef CPP_JSON__RAPIDJSON
+      { "rapidjson_sax"       , perf__rapidjson_sax             },
+      { "rapidjson_document"  , perf__rapidjson_document        },
+#endif
+#ifdef CPP_JSON__NLOHMANN
+      { "nlohmann_document"   , perf__nlohmann_document         },
+#endif
+#ifdef CPP_JSON__SIMDJSON
+      { "simdjson_document"   , perf__simdjson_document         },
+      { "simdjson_ondemand"   , perf__simdjson_ondemand         },
+#endif
+    };
+
+    for (auto && file_name : { "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json" })
+    {
+      auto json = read_binary_file (test_cases + "/json/" + file_name);
+
+      std::cout << "Processing: " << file_name << " (" << json.size () << " bytes, " << count << " times)" << std::endl;
+
+      for (auto && c : competitors)
       {
-        auto json2  = document->to_string ();
-        std::wcout
-          << L"SUCCESS: Pos: " << pos << L" Json: " << json2 << std::endl;
+        auto parse  = c.parse;
+        auto ms     = time_it (count, [parse, &json] () { parse (json); });
+        // time_it doesn't time the warm up run
+        auto mbs    = ms > 0 ? static_cast<double> (json.size ()) * count / 1000.0 / ms : 0.0;
+
+        std::cout
+          << "  " << std::left << std::setw (20) << c.name << std::right
+          << " Milliseconds: " << std::setw (6) << ms
+          << " (MB/s: " << std::fixed << std::setprecision (1) << mbs << ")"
+          << std::endl;
       }
-      else
+    }
+  }
+
+  // Reads the last scalar of the document by following the last member or element
+  //  of each container, the worst case for the on-demand view as it has to skip
+  //  everything before it, compared to the DOM and the callback parser
+  void ondemand_benchmark (std::string const & test_cases, std::size_t count)
+  {
+    using namespace cpp_json::document;
+    using cpp_json::parser::json_ondemand;
+
+    // A member name, or the index of an element if the name is empty
+    using step = std::pair<doc_string_type, std::size_t>;
+
+    for (auto && file_name : { "Simple.json", "contacts.json", "charrefs.json", "GitHub.json", "WorldBank.json", "topic.json" })
+    {
+      auto json = widen (read_binary_file (test_cases + "/json/" + file_name));
+
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+      auto presult = json_parser::parse (json, pos, doc);
+      CPP_JSON__ASSERT (presult);
+      (void) presult;
+
+      std::vector<step> path;
+      for (auto e = doc->root (); !e->is_scalar () && e->size () > 0;)
       {
-        std::wcout
-          << L"FAILURE: Pos: " << pos << L" Error: " << error << std::endl;
+        auto names  = e->names ();
+        auto last   = e->size () - 1;
+        path.push_back (names.empty () ? step (doc_string_type (), last) : step (names.back (), last));
+        e = e->at (last);
       }
+
+      auto time__callback = time_it (count, [&json] () { perf__parse_json_callback (json); });
+
+      auto time__document = time_it (count, [&json, &path] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, pos, doc);
+          auto value = doc->root ();
+          for (auto && s : path)
+          {
+            value = s.first.empty () ? value->at (s.second) : value->get (s.first);
+          }
+          CPP_JSON__ASSERT (!value->is_error ());
+          (void) value;
+        });
+
+      auto time__ondemand = time_it (count, [&json, &path] ()
+        {
+          json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+          auto value = doc.root ();
+          for (auto && s : path)
+          {
+            value = s.first.empty () ? value.at (s.second) : value[s.first];
+          }
+          CPP_JSON__ASSERT (value.is_valid ());
+          (void) value;
+        });
+
+      std::cout
+        << "Processing: " << file_name << " (" << json.size () << " chars, depth " << path.size () << ", " << count << " times)" << std::endl
+        << "  callback           Milliseconds: " << std::setw (6) << time__callback << std::endl
+        << "  document + lookup  Milliseconds: " << std::setw (6) << time__document << std::endl
+        << "  ondemand lookup    Milliseconds: " << std::setw (6) << time__ondemand << std::endl
+        ;
     }
   }
 
-  struct document_test_case
+  // Compares parsing into a document with deferring the containers below the root,
+  //  and the cost of then reading the top level
+  void lazy_benchmark (std::string const & test_cases, std::size_t count)
   {
-    int         index     ;
-    std::size_t size      ;
-    bool        at        ;
-    bool        get       ;
-    bool        names     ;
-    bool        is_error  ;
-    bool        is_scalar ;
-    bool        is_null   ;
-    bool        as_bool   ;
-    double      as_number ;
-    std::string as_string ;
-  };
+    using namespace cpp_json::document;
 
-  void document_test_cases ()
-  {
-    std::wcout << "Running 'document_test_cases'..." << std::endl;
+    for (auto && file_name : { "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json", "topic.json" })
+    {
+      auto json = widen (read_binary_file (test_cases + "/json/" + file_name));
+
+      json_lazy_options options;
+      options.depth = 1;
+
+      // Visits the members of the root and the members of its members
+      auto read_top = [] (json_document const & doc)
+        {
+          auto root = doc.root ();
+          std::size_t sz = 0;
+          for (auto iter = 0U; iter < root->size (); ++iter)
+          {
+            sz += root->at (iter)->size ();
+          }
+          return sz;
+        };
+
+      auto time__eager = time_it (count, [&json] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, pos, doc);
+        });
+
+      auto time__lazy = time_it (count, [&json, &options] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, options, pos, doc);
+        });
+
+      auto time__lazy_top = time_it (count, [&json, &options, &read_top] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, options, pos, doc);
+          auto sz = read_top (*doc);
+          CPP_JSON__ASSERT (sz > 0);
+          (void) sz;
+        });
+
+      std::cout
+        << "Processing: " << file_name << " (" << json.size () << " chars, " << count << " times)" << std::endl
+        << "  document           Milliseconds: " << std::setw (6) << time__eager    << std::endl
+        << "  lazy               Milliseconds: " << std::setw (6) << time__lazy     << std::endl
+        << "  lazy + top level   Milliseconds: " << std::setw (6) << time__lazy_top << std::endl
+        ;
+    }
+  }
 
+  // Compares parsing a document with loading its snapshot, from memory and by
+  //  mapping a file, and reading the whole document (to_string) from each
+  void snapshot_benchmark (std::string const & test_cases, std::size_t count)
+  {
     using namespace cpp_json::document;
 
-    // TODO: Improve DOM testing
+    auto file_name = std::string ("snapshot_benchmark.bin");
 
-    //                                   0    1 2   3    4     5  6    7     8           9  10 11
-    doc_string_type json_document = LR"([null,0,125,1.25,"125","",true,false,[true,null],[],{},{"xyz":true,"zyx":null}])";
+    for (auto && json_file : { "charrefs-full.json", "GitHub.json", "WorldBank.json", "topic.json" })
+    {
+      auto json = widen (read_binary_file (test_cases + "/json/" + json_file));
 
-    std::size_t         pos   ;
-    json_document::ptr  doc   ;
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+      auto presult = json_parser::parse (json, pos, doc);
+      CPP_JSON__ASSERT (presult);
+      (void) presult;
 
-    if (json_parser::parse (json_document, pos, doc))
+      std::vector<char> image;
+      json_snapshot::save (*doc, image);
+      json_snapshot::save (*doc, file_name);
+
+      auto time__parse = time_it (count, [&json] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, pos, doc);
+        });
+
+      auto time__load_file = time_it (count, [&file_name] ()
+        {
+          json_document::ptr doc;
+          json_snapshot::load (file_name, doc);
+          CPP_JSON__ASSERT (doc->root ()->size () > 0);
+        });
+
+      auto time__to_string = time_it (count, [&doc] () { doc->to_string (); });
+
+      json_document::ptr snapshot;
+      json_snapshot::load (image, snapshot);
+      auto time__snapshot_to_string = time_it (count, [&snapshot] () { snapshot->to_string (); });
+
+      std::cout
+        << "Processing: " << json_file << " (" << json.size () << " chars, snapshot " << image.size () << " bytes, " << count << " times)" << std::endl
+        << "  parse              Milliseconds: " << std::setw (6) << time__parse              << std::endl
+        << "  load (mapped)      Milliseconds: " << std::setw (6) << time__load_file          << std::endl
+        << "  to_string          Milliseconds: " << std::setw (6) << time__to_string          << std::endl
+        << "  snapshot to_string Milliseconds: " << std::setw (6) << time__snapshot_to_string << std::endl
+        ;
+    }
+
+    std::remove (file_name.c_str ());
+  }
+
+  // Compares parsing into a document (the first half of walking a document to encode it)
+  //  with transcoding JSON to CBOR and MessagePack directly and back to JSON
+  //  Throughput is in MB of JSON per second
+  void transcode_benchmark (std::string const & test_cases, std::size_t count)
+  {
+    using namespace cpp_json::parser;
+
+    for (auto && file_name : { "Simple.json", "contacts.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json", "topic.json" })
     {
-      CPP_JSON__ASSERT (doc);
+      auto json = read_binary_file (test_cases + "/json/" + file_name);
+      auto b    = json.data ();
+      auto e    = b + json.size ();
+
+      std::size_t       pos     ;
+      std::vector<char> cbor    ;
+      std::vector<char> msgpack ;
+      std::string       back    ;
+
+      auto cresult = json_cbor::from_json (json, pos, cbor) && json_cbor::to_json (cbor, pos, back);
+      auto mresult = json_msgpack::from_json (json, pos, msgpack) && json_msgpack::to_json (msgpack, pos, back);
+      CPP_JSON__ASSERT (cresult && mresult);
+      (void) cresult;
+      (void) mresult;
+
+      auto time__document = time_it (count, [b, e] ()
+        {
+          std::size_t                             pos ;
+          cpp_json::document::json_document::ptr  doc ;
+          cpp_json::document::json_parser::parse (b, e, pos, doc);
+        });
 
-      auto result = doc->root ();
-      CPP_JSON__ASSERT (result);
+      std::vector<char> output;
+      std::string       text  ;
 
-      std::vector<document_test_case> oracles
-      {
+      auto time__to_cbor      = time_it (count, [&] () { json_cbor::from_json (b, e, pos, output); });
+      auto time__to_msgpack   = time_it (count, [&] () { json_msgpack::from_json (b, e, pos, output); });
+      auto time__from_cbor    = time_it (count, [&] () { json_cbor::to_json (cbor, pos, text); });
+      auto time__from_msgpack = time_it (count, [&] () { json_msgpack::to_json (msgpack, pos, text); });
+
+      auto throughput = [&json, count] (long long ms)
         {
-          -1            , // index
-          12            , // size
-          true          , // at
-          true          , // get
-          true          , // names
-          false         , // is_error
-          false         , // is_scalar
-          false         , // is_null
-          false         , // as_bool
-          0             , // as_number
-          ""            , // as_string
-        },
+          return ms > 0 ? static_cast<double> (json.size ()) * count / (ms * 1000.0) : 0.0;
+        };
+
+      auto report = [&throughput] (char const * name, long long ms)
         {
-          0             , // index
-          0             , // size
-          true          , // at
-          true          , // get
-          true          , // names
-          false         , // is_error
-          true          , // is_scalar
-          true          , // is_null
-          false         , // as_bool
-          0             , // as_number
-          "null"        , // as_string
-        },
+          std::cout
+            << "  " << std::left << std::setw (19) << name << std::right
+            << "Milliseconds: " << std::setw (6) << ms
+            << " (" << std::fixed << std::setprecision (1) << throughput (ms) << " MB/s)" << std::endl
+            ;
+          std::cout.unsetf (std::ios::floatfield);
+        };
+
+      std::cout
+        << "Processing: " << file_name << " (" << json.size () << " bytes, CBOR " << cbor.size () << " bytes, MessagePack " << msgpack.size () << " bytes, " << count << " times)" << std::endl
+        ;
+      report ("document"        , time__document    );
+      report ("JSON to CBOR"    , time__to_cbor     );
+      report ("JSON to MsgPack" , time__to_msgpack  );
+      report ("CBOR to JSON"    , time__from_cbor   );
+      report ("MsgPack to JSON" , time__from_msgpack);
+    }
+  }
+
+  // Compares parsing a document with getting it from a json_document_cache (a hit
+  //  hashes and compares the input), from one thread and from several threads
+  void cache_benchmark (std::string const & test_cases, std::size_t count)
+  {
+    using namespace cpp_json::document;
+
+    auto concurrency = std::max (2U, std::thread::hardware_concurrency ());
+
+    for (auto && file_name : { "Simple.json", "contacts.json", "charrefs-full.json", "GitHub.json", "WorldBank.json", "topic.json" })
+    {
+      auto json = widen (read_binary_file (test_cases + "/json/" + file_name));
+
+      json_document_cache cache (256 << 20);
+
+      auto time__parse = time_it (count, [&json] ()
         {
-          1             , // index
-          0             , // size
-          true          , // at
-          true          , // get
-          true          , // names
-          false         , // is_error
-          true          , // is_scalar
-          false         , // is_null
-          false         , // as_bool
-          0             , // as_number
-          "0"           , // as_string
-        },
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, pos, doc);
+        });
+
+      auto time__cache = time_it (count, [&json, &cache] ()
         {
-          2             , // index
-          0             , // size
-          true          , // at
-          true          , // get
-          true          , // names
-          false         , // is_error
-          true          , // is_scalar
-          false         , // is_null
-          true          , // as_bool
-          125           , // as_number
-          "125"         , // as_string
-        },
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          cache.parse (json, pos, doc);
+        });
+
+      // Each thread does count / concurrency lookups
+      auto time__threads = time_it (1, [&json, &cache, concurrency, count] ()
         {
-          3             , // index
-          0             , // size
+          std::vector<std::thread> threads;
+          for (auto iter = 0U; iter < concurrency; ++iter)
+          {
+            threads.emplace_back ([&json, &cache, concurrency, count] ()
+              {
+                for (auto i = 0U; i < count / concurrency; ++i)
+                {
+                  std::size_t         pos ;
+                  json_document::ptr  doc ;
+                  cache.parse (json, pos, doc);
+                }
+              });
+          }
+
+          for (auto && t : threads)
+          {
+            t.join ();
+          }
+        });
+
+      std::cout
+        << "Processing: " << file_name << " (" << json.size () << " chars, " << count << " times)" << std::endl
+        << "  parse              Milliseconds: " << std::setw (6) << time__parse    << std::endl
+        << "  cache hit          Milliseconds: " << std::setw (6) << time__cache    << std::endl
+        << "  cache hit x " << std::setw (2) << concurrency << "    Milliseconds: " << std::setw (6) << time__threads << std::endl
+        ;
+    }
+  }
+
+  // Benchmarks run on demand, run with: test_suite <size> <benchmark>
+  void benchmark_test_cases (char const * exe, std::string const & benchmark, int size)
+  {
+    std::cout << "Running 'benchmark_test_cases'..." << std::endl;
+
+    auto test_cases = find_test_cases (exe);
+
+    if (benchmark == "stream")
+    {
+      perf__parse_json_stream (size > 0 ? static_cast<std::size_t> (size) : 1024U);
+    }
+    else if (benchmark == "kernels")
+    {
+      perf__parse_json_kernels (size > 0 ? static_cast<std::size_t> (size) : 64U);
+    }
+    else if (test_cases.empty ())
+    {
+      ++errors;
+      std::cout << "FAILURE: Couldn't find test_cases directory" << std::endl;
+    }
+    else if (benchmark == "batch")
+    {
+      std::vector<std::wstring> documents;
+      for (auto && file_name : { "Simple.json", "contacts.json" })
+      {
+        documents.push_back (widen (read_binary_file (test_cases + "/json/" + file_name)));
+      }
+      perf__parse_json_batch (documents, size > 0 ? static_cast<std::size_t> (size) : 100000U);
+    }
+    else if (benchmark == "session")
+    {
+      std::vector<std::wstring> documents;
+      for (auto && file_name : { "Simple.json", "contacts.json" })
+      {
+        documents.push_back (widen (read_binary_file (test_cases + "/json/" + file_name)));
+      }
+      perf__parse_json_session (documents, size > 0 ? static_cast<std::size_t> (size) : 10000U);
+    }
+    else if (benchmark == "latency" || benchmark == "latency_noise")
+    {
+      // From small to large documents
+      for (auto && file_name : { "Simple.json", "contacts.json", "WorldBank.json", "GitHub.json", "charrefs.json", "charrefs-full.json", "topic.json" })
+      {
+        auto json = widen (read_binary_file (test_cases + "/json/" + file_name));
+        perf__parse_json_latency (file_name, json, size > 0 ? static_cast<std::size_t> (size) : 1000U, benchmark == "latency_noise");
+      }
+    }
+    else if (benchmark == "profile")
+    {
+      for (auto && file_name : { "Simple.json", "contacts.json", "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json" })
+      {
+        auto json = widen (read_binary_file (test_cases + "/json/" + file_name));
+        perf__parse_json_profile (file_name, json, size > 0 ? static_cast<std::size_t> (size) : 100U);
+      }
+    }
+    else if (benchmark == "cache")
+    {
+      cache_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 1000U);
+    }
+    else if (benchmark == "transcode")
+    {
+      transcode_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+    else if (benchmark == "snapshot")
+    {
+      snapshot_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+    else if (benchmark == "lazy")
+    {
+      lazy_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+    else if (benchmark == "ondemand")
+    {
+      ondemand_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+    else if (benchmark == "memory")
+    {
+      memory_benchmark (test_cases);
+    }
+    else if (benchmark == "competitors")
+    {
+      competitors_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+    else if (benchmark == "counters")
+    {
+      counters_benchmark (test_cases, size > 0 ? static_cast<std::size_t> (size) : 100U);
+    }
+#ifdef CPP_JSON__ZLIB
+    else if (benchmark == "gzip")
+    {
+      // The test cases used by performance_test_cases
+      for (auto && file_name : { "topic.json", "charrefs-full.json", "charrefs.json", "GitHub.json", "WorldBank.json" })
+      {
+        auto json = read_binary_file (test_cases + "/json/" + file_name);
+        perf__parse_json_gzip (file_name, json, gzip_compress (json), size > 0 ? static_cast<std::size_t> (size) : 100U);
+      }
+    }
+#endif
+    else
+    {
+      ++errors;
+      std::cout << "FAILURE: Unknown benchmark: " << benchmark << std::endl;
+    }
+  }
+
+  // Allocation budgets per test file and API, measured by parsing the file once
+  //  Only enforced when malloc is counted (glibc without sanitizers) as the numbers
+  //  depend on the standard library. Budgets have about 5% headroom on allocations and 10% on peak
+  //  bytes, lower a budget when a change improves it.
+  struct allocation_budget
+  {
+    char const *  file_name       ;
+    char const *  api             ;
+    std::size_t   max_allocations ;
+    std::size_t   max_peak_bytes  ;
+  };
+
+  allocation_budget const allocation_budgets[] =
+    {
+      { "Simple.json",        "cpp_json_callback",      0,        0 },
+      { "Simple.json",        "cpp_json_document",     23,    12288 },
+      { "Simple.json",        "jsoncpp_document",      21,     2048 },
+      { "contacts.json",      "cpp_json_callback",      0,        0 },
+      { "contacts.json",      "cpp_json_document",     69,    15360 },
+      { "contacts.json",      "jsoncpp_document",      87,     8192 },
+      { "topic.json",         "cpp_json_callback",      0,        0 },
+      { "topic.json",         "cpp_json_document",   4197,   720896 },
+      { "topic.json",         "jsoncpp_document",   10883,   607232 },
+      { "charrefs-full.json", "cpp_json_callback",      0,        0 },
+      { "charrefs-full.json", "cpp_json_document",   7185,   999424 },
+      { "charrefs-full.json", "jsoncpp_document",   23628,  1144832 },
+      { "charrefs.json",      "cpp_json_callback",      0,        0 },
+      { "charrefs.json",      "cpp_json_document",   6504,   893952 },
+      { "charrefs.json",      "jsoncpp_document",   21387,  1035264 },
+      { "GitHub.json",        "cpp_json_callback",      0,        0 },
+      { "GitHub.json",        "cpp_json_document",   2435,   435200 },
+      { "GitHub.json",        "jsoncpp_document",    5936,   323584 },
+      { "WorldBank.json",     "cpp_json_callback",      0,        0 },
+      { "WorldBank.json",     "cpp_json_document",    913,   108544 },
+      { "WorldBank.json",     "jsoncpp_document",    2231,   109568 },
+    };
+
+  void allocation_test_cases (char const * exe)
+  {
+    std::cout << "Running 'allocation_test_cases'..." << std::endl;
+
+    auto test_cases = find_test_cases (exe);
+    if (test_cases.empty ())
+    {
+      ++errors;
+      std::cout << "FAILURE: Couldn't find test_cases directory" << std::endl;
+      return;
+    }
+
+    auto enforce = allocation_counter_includes_malloc ();
+
+#ifdef __GLIBC__
+    // The C allocation functions are counted and balanced, realloc (p, 0) frees p
+    if (enforce)
+    {
+      void * volatile sink;
+      auto before = get_allocation_counters ();
+
+      sink = std::malloc (100);
+      sink = std::realloc (sink, 0);
+      std::free (sink);
+      sink = reallocarray (nullptr, 10, 10);
+      std::free (sink);
+      sink = valloc (100);
+      std::free (sink);
+      sink = pvalloc (100);
+      std::free (sink);
+
+      auto after = get_allocation_counters ();
+      TEST_EQ (before.live_bytes, after.live_bytes);
+      TEST_EQ (true, after.allocations - before.allocations >= 4);
+    }
+#endif
+
+    auto measure = [] (std::function<void ()> const & parse)
+      {
+        auto before = get_allocation_counters ();
+        reset_peak_bytes ();
+        parse ();
+        return get_allocation_counters () - before;
+      };
+
+    std::cout
+      << std::left << std::setw (24) << "file"
+      << std::setw (20) << "api"
+      << std::right << std::setw (12) << "allocations"
+      << std::setw (12) << "bytes"
+      << std::setw (12) << "peak bytes"
+      << std::endl;
+
+    std::string file_name;
+    std::string json;
+    std::wstring wjson;
+
+    for (auto && budget : allocation_budgets)
+    {
+      if (file_name != budget.file_name)
+      {
+        file_name = budget.file_name;
+        json      = read_binary_file (test_cases + "/json/" + file_name);
+        wjson     = widen (json);
+      }
+
+      std::string api = budget.api;
+
+      allocation_counters counters;
+      if (api == "cpp_json_callback")
+      {
+        counters = measure ([&wjson] () { perf__parse_json_callback (wjson); });
+      }
+      else if (api == "cpp_json_document")
+      {
+        counters = measure ([&wjson] () { perf__parse_json_document (wjson); });
+      }
+      else if (api == "jsoncpp_document")
+      {
+        counters = measure ([&json] () { perf__jsoncpp_document (json); });
+      }
+      else
+      {
+        ++errors;
+        std::cout << "FAILURE: Unknown api: " << api << std::endl;
+        continue;
+      }
+
+      std::cout
+        << std::left << std::setw (24) << file_name
+        << std::setw (20) << api
+        << std::right << std::setw (12) << counters.allocations
+        << std::setw (12) << counters.bytes
+        << std::setw (12) << counters.peak_bytes
+        << std::endl;
+
+      if (enforce && counters.allocations > budget.max_allocations)
+      {
+        ++errors;
+        std::cout
+          << "FAILURE: " << file_name << ", " << api << ": " << counters.allocations
+          << " allocations exceeds the budget of " << budget.max_allocations << std::endl;
+      }
+
+      if (enforce && counters.peak_bytes > budget.max_peak_bytes)
+      {
+        ++errors;
+        std::cout
+          << "FAILURE: " << file_name << ", " << api << ": " << counters.peak_bytes
+          << " peak bytes exceeds the budget of " << budget.max_peak_bytes << std::endl;
+      }
+    }
+  }
+
+  void manual_test_cases ()
+  {
+    std::cout << "Running 'manual_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    std::vector<doc_string_type> test_cases =
+      {
+        LR"({
+"abc":"012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
+"abc",
+})"                                                                                         ,
+        LR"({
+"abc":"012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
+"abc",
+012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789
+})"                                                                                         ,
+        LR"({
+"abc",
+012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789
+})"                                                                                         ,
+        LR"([null, 123,-123E100,"Test\tHello", true,false, [true,null],[],{}, {"x":true}])" ,
+        LR"(["\b\f\n\r\t\u0010"])"                                                          ,
+        LR"(
+{
+  "x":null,
+  "y":3
+})"                                                                                         ,
+        LR"(["\u004Abc"])"                                                                  ,
+        LR"({:null})"                                                                       ,
+        LR"([)"                                                                             ,
+        LR"({"abc":})"                                                                      ,
+        LR"(
+{
+  "x":null,
+  })"                                                                                       ,
+      };
+
+    for (auto && test_case : test_cases)
+    {
+      std::size_t         pos     ;
+      json_document::ptr  document;
+      doc_string_type     error   ;
+
+      std::wcout << "TEST_CASE: "<< test_case << std::endl;
+
+      if (json_parser::parse (test_case, pos, document, error))
+      {
+        auto json2  = document->to_string ();
+        std::wcout
+          << L"SUCCESS: Pos: " << pos << L" Json: " << json2 << std::endl;
+      }
+      else
+      {
+        std::wcout
+          << L"FAILURE: Pos: " << pos << L" Error: " << error << std::endl;
+      }
+    }
+  }
+
+  struct document_test_case
+  {
+    int         index     ;
+    std::size_t size      ;
+    bool        at        ;
+    bool        get       ;
+    bool        names     ;
+    bool        is_error  ;
+    bool        is_scalar ;
+    bool        is_null   ;
+    bool        as_bool   ;
+    double      as_number ;
+    std::string as_string ;
+  };
+
+  void document_test_cases ()
+  {
+    std::wcout << "Running 'document_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    // TODO: Improve DOM testing
+
+    //                                   0    1 2   3    4     5  6    7     8           9  10 11
+    doc_string_type json_document = LR"([null,0,125,1.25,"125","",true,false,[true,null],[],{},{"xyz":true,"zyx":null}])";
+
+    std::size_t         pos   ;
+    json_document::ptr  doc   ;
+
+    if (json_parser::parse (json_document, pos, doc))
+    {
+      CPP_JSON__ASSERT (doc);
+
+      auto result = doc->root ();
+      CPP_JSON__ASSERT (result);
+
+      std::vector<document_test_case> oracles
+      {
+        {
+          -1            , // index
+          12            , // size
           true          , // at
           true          , // get
           true          , // names
           false         , // is_error
-          true          , // is_scalar
+          false         , // is_scalar
           false         , // is_null
-          true          , // as_bool
-          1.25          , // as_number
-          "1.25"        , // as_string
+          false         , // as_bool
+          0             , // as_number
+          ""            , // as_string
         },
         {
-          4             , // index
+          0             , // index
           0             , // size
           true          , // at
           true          , // get
           true          , // names
           false         , // is_error
           true          , // is_scalar
-          false         , // is_null
-          true          , // as_bool
-          125           , // as_number
-          "125"         , // as_string
+          true          , // is_null
+          false         , // as_bool
+          0             , // as_number
+          "null"        , // as_string
         },
         {
-          5             , // index
+          1             , // index
           0             , // size
           true          , // at
           true          , // get
@@ -722,10 +1483,10 @@ namespace
           false         , // is_null
           false         , // as_bool
           0             , // as_number
-          ""            , // as_string
+          "0"           , // as_string
         },
         {
-          6             , // index
+          2             , // index
           0             , // size
           true          , // at
           true          , // get
@@ -734,11 +1495,11 @@ namespace
           true          , // is_scalar
           false         , // is_null
           true          , // as_bool
-          1             , // as_number
-          "true"        , // as_string
+          125           , // as_number
+          "125"         , // as_string
         },
         {
-          7             , // index
+          3             , // index
           0             , // size
           true          , // at
           true          , // get
@@ -746,21 +1507,73 @@ namespace
           false         , // is_error
           true          , // is_scalar
           false         , // is_null
-          false         , // as_bool
-          0             , // as_number
-          "false"       , // as_string
+          true          , // as_bool
+          1.25          , // as_number
+          "1.25"        , // as_string
         },
         {
-          8             , // index
-          2             , // size
+          4             , // index
+          0             , // size
           true          , // at
           true          , // get
           true          , // names
           false         , // is_error
-          false         , // is_scalar
+          true          , // is_scalar
           false         , // is_null
-          false         , // as_bool
-          0             , // as_number
+          true          , // as_bool
+          125           , // as_number
+          "125"         , // as_string
+        },
+        {
+          5             , // index
+          0             , // size
+          true          , // at
+          true          , // get
+          true          , // names
+          false         , // is_error
+          true          , // is_scalar
+          false         , // is_null
+          false         , // as_bool
+          0             , // as_number
+          ""            , // as_string
+        },
+        {
+          6             , // index
+          0             , // size
+          true          , // at
+          true          , // get
+          true          , // names
+          false         , // is_error
+          true          , // is_scalar
+          false         , // is_null
+          true          , // as_bool
+          1             , // as_number
+          "true"        , // as_string
+        },
+        {
+          7             , // index
+          0             , // size
+          true          , // at
+          true          , // get
+          true          , // names
+          false         , // is_error
+          true          , // is_scalar
+          false         , // is_null
+          false         , // as_bool
+          0             , // as_number
+          "false"       , // as_string
+        },
+        {
+          8             , // index
+          2             , // size
+          true          , // at
+          true          , // get
+          true          , // names
+          false         , // is_error
+          false         , // is_scalar
+          false         , // is_null
+          false         , // as_bool
+          0             , // as_number
           ""            , // as_string
         },
         {
@@ -790,94 +1603,2535 @@ namespace
           ""            , // as_string
         },
         {
-          11            , // index
-          2             , // size
-          true          , // at
-          true          , // get
-          false         , // names
-          false         , // is_error
-          false         , // is_scalar
-          false         , // is_null
-          false         , // as_bool
-          0             , // as_number
-          ""            , // as_string
-        },
+          11            , // index
+          2             , // size
+          true          , // at
+          true          , // get
+          false         , // names
+          false         , // is_error
+          false         , // is_scalar
+          false         , // is_null
+          false         , // as_bool
+          0             , // as_number
+          ""            , // as_string
+        },
+      };
+
+      auto size = result->size ();
+
+      for (auto && oracle : oracles)
+      {
+        auto index = oracle.index;
+        auto actual =
+            index > -1
+          ? result->at (index)
+          : result
+          ;
+
+        std::cout << "Testing against index: " << index << std::endl;
+
+        TEST_EQ (oracle.size      , actual->size ());
+        TEST_EQ (oracle.at        , actual->at  (size)->is_error ());
+        TEST_EQ (oracle.get       , actual->get (L"")->is_error ());
+        TEST_EQ (oracle.names     , actual->names ().empty ());
+        TEST_EQ (oracle.is_error  , actual->is_error ());
+        TEST_EQ (oracle.is_scalar , actual->is_scalar ());
+        TEST_EQ (oracle.is_null   , actual->is_null ());
+        TEST_EQ (oracle.as_bool   , actual->as_bool ());
+        TEST_EQ (oracle.as_number , actual->as_number ());
+        TEST_EQ (oracle.as_string , to_ascii (actual->as_string ()));
+      }
+
+      {
+        auto actual     = result->at (8);
+        auto true_value = actual->at (0);
+        auto null_value = actual->at (1);
+
+        TEST_EQ (2        , actual->size ());
+        TEST_EQ (true     , true_value->as_bool ());
+        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
+        TEST_EQ (false    , null_value->as_bool ());
+        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+      }
+
+      {
+        auto actual     = result->at (11);
+        auto true_value = actual->at (0);
+        auto null_value = actual->at (1);
+
+        TEST_EQ (2        , actual->size ());
+        TEST_EQ (true     , true_value->as_bool ());
+        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
+        TEST_EQ (false    , null_value->as_bool ());
+        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+      }
+
+      {
+        auto actual     = result->at (11);
+        auto names      = actual->names ();
+        auto true_value = actual->get (L"xyz");
+        auto null_value = actual->get (L"zyx");
+
+        doc_strings_type oracle = {L"xyz", L"zyx"};
+
+        TEST_EQ (2        , actual->size ());
+        TEST_EQ (true     , names == oracle);
+        TEST_EQ (true     , true_value->as_bool ());
+        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
+        TEST_EQ (false    , null_value->as_bool ());
+        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+      }
+
+      // TODO: Test mutability
+    }
+    else
+    {
+      ++errors;
+      std::cout
+        << "FAILURE: Pos: " << pos << std::endl;
+    }
+  }
+
+  void persistent_test_cases ()
+  {
+    std::wcout << "Running 'persistent_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_string_type json_document = LR"({"a":{"b":1,"c":[true,null]},"d":"x"})";
+
+    std::size_t         pos   ;
+    json_document::ptr  doc   ;
+
+    if (json_parser::parse (json_document, pos, doc))
+    {
+      auto root = doc->root ();
+
+      auto updated = doc->set_number ({L"a", L"b"}, 2);
+      TEST_EQ (true, static_cast<bool> (updated));
+      if (updated)
+      {
+        auto uroot = updated->root ();
+        TEST_EQ (1    , root->get (L"a")->get (L"b")->as_number ());
+        TEST_EQ (2    , uroot->get (L"a")->get (L"b")->as_number ());
+        // Unchanged subtrees are shared
+        TEST_EQ (true , root->get (L"d") == uroot->get (L"d"));
+        TEST_EQ (true , root->get (L"a")->get (L"c") == uroot->get (L"a")->get (L"c"));
+        TEST_EQ (false, root->get (L"a") == uroot->get (L"a"));
+      }
+
+      auto appended = doc->set_string ({L"a", L"c", L"-"}, L"y");
+      TEST_EQ (true, static_cast<bool> (appended));
+      if (appended)
+      {
+        TEST_EQ (2    , root->get (L"a")->get (L"c")->size ());
+        TEST_EQ (3    , appended->root ()->get (L"a")->get (L"c")->size ());
+        TEST_EQ ("y"  , to_ascii (appended->root ()->get (L"a")->get (L"c")->at (2)->as_string ()));
+      }
+
+      auto erased = doc->erase ({L"a", L"c", L"0"});
+      TEST_EQ (true, static_cast<bool> (erased));
+      if (erased)
+      {
+        TEST_EQ (true , erased->root ()->get (L"a")->get (L"c")->at (0)->is_null ());
+        TEST_EQ ("{\"a\":{\"b\":1, \"c\":[null]}, \"d\":\"x\"}", to_ascii (erased->to_string ()));
+      }
+
+      auto added = doc->set_bool ({L"e"}, true);
+      TEST_EQ (true, static_cast<bool> (added));
+      if (added)
+      {
+        TEST_EQ (3    , added->root ()->size ());
+        TEST_EQ (true , added->root ()->get (L"e")->as_bool ());
+      }
+
+      TEST_EQ (false, static_cast<bool> (doc->set_null ({L"x", L"y"})));
+      TEST_EQ (false, static_cast<bool> (doc->set_null ({L"a", L"c", L"01"})));
+      TEST_EQ (false, static_cast<bool> (doc->set_null ({L"a", L"c", L"3"})));
+      TEST_EQ (false, static_cast<bool> (doc->set_null ({L"d", L"x"})));
+      TEST_EQ (false, static_cast<bool> (doc->erase ({L"x"})));
+      TEST_EQ (false, static_cast<bool> (doc->erase ({})));
+
+      // Grafted elements keep their document alive
+      json_document::ptr other;
+      if (json_parser::parse (LR"([{"z":3}])", pos, other))
+      {
+        auto grafted = doc->set_element ({L"d"}, other->root ()->at (0));
+        other.reset ();
+        doc.reset ();
+        root = nullptr;
+
+        TEST_EQ (true, static_cast<bool> (grafted));
+        if (grafted)
+        {
+          TEST_EQ (3  , grafted->root ()->get (L"d")->get (L"z")->as_number ());
+          TEST_EQ (1  , grafted->root ()->get (L"a")->get (L"b")->as_number ());
+        }
+      }
+      else
+      {
+        ++errors;
+        std::cout
+          << "FAILURE: Pos: " << pos << std::endl;
+      }
+    }
+    else
+    {
+      ++errors;
+      std::cout
+        << "FAILURE: Pos: " << pos << std::endl;
+    }
+
+    // Versions only keep the documents that own their shared elements alive
+    {
+      json_document::ptr original;
+      TEST_EQ (true, json_parser::parse (LR"({"a":{"x":1,"y":[1,2]},"b":[true,false,null]})", pos, original));
+
+      std::weak_ptr<cpp_json::document::json_document> first;
+      auto current = original;
+      for (auto iter = 0; iter < 10; ++iter)
+      {
+        auto next = current->set_number ({L"a", L"x"}, iter);
+        if (iter == 0)
+        {
+          first = next;
+        }
+        current = next;
+      }
+
+      // The first version only owned the path that later versions copied again
+      TEST_EQ (true, first.expired ());
+      TEST_EQ (9.0 , current->root ()->get (L"a")->get (L"x")->as_number ());
+      TEST_EQ (2.0 , current->root ()->get (L"a")->get (L"y")->at (1)->as_number ());
+
+      // Once nothing is shared the original is released
+      std::weak_ptr<cpp_json::document::json_document> weak_original = original;
+      auto replaced = current->set_null ({L"b"})->set_null ({L"a"});
+      original.reset ();
+      current.reset ();
+      TEST_EQ (true, weak_original.expired ());
+      TEST_EQ ("{\"a\":null, \"b\":null}", to_ascii (replaced->to_string ()));
+    }
+  }
+
+  void query_test_cases ()
+  {
+    std::wcout << "Running 'query_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_string_type json_document = LR"({"a":{"b":[10,{"c":true}],"0":"zero","x/y":1,"t~":2,"p.q":3},"d":null})";
+
+    std::size_t         pos   ;
+    json_document::ptr  doc   ;
+
+    if (json_parser::parse (json_document, pos, doc))
+    {
+      auto pointer = [&doc] (doc_string_type const & p)
+      {
+        std::size_t pos;
+        json_query  query;
+        TEST_EQ (true, json_query::compile_pointer (p, pos, query));
+        return query.evaluate (*doc);
+      };
+
+      auto path = [&doc] (doc_string_type const & p)
+      {
+        std::size_t pos;
+        json_query  query;
+        TEST_EQ (true, json_query::compile_path (p, pos, query));
+        return query.evaluate (*doc);
+      };
+
+      TEST_EQ (true   , pointer (L"") == doc->root ());
+      TEST_EQ (10     , pointer (L"/a/b/0")->as_number ());
+      TEST_EQ (true   , pointer (L"/a/b/1/c")->as_bool ());
+      TEST_EQ ("zero" , to_ascii (pointer (L"/a/0")->as_string ()));
+      TEST_EQ (1      , pointer (L"/a/x~1y")->as_number ());
+      TEST_EQ (2      , pointer (L"/a/t~0")->as_number ());
+      TEST_EQ (true   , pointer (L"/d")->is_null ());
+      TEST_EQ (true   , pointer (L"/a/b/2")->is_error ());
+      TEST_EQ (true   , pointer (L"/a/b/01")->is_error ());
+      TEST_EQ (true   , pointer (L"/a/b/-")->is_error ());
+      TEST_EQ (true   , pointer (L"/a/zzz")->is_error ());
+      TEST_EQ (true   , pointer (L"/d/x")->is_error ());
+
+      TEST_EQ (true   , path (L"") == doc->root ());
+      TEST_EQ (10     , path (L"a.b[0]")->as_number ());
+      TEST_EQ (10     , path (L"a.b.0")->as_number ());
+      TEST_EQ (true   , path (L"a.b[1].c")->as_bool ());
+      TEST_EQ ("zero" , to_ascii (path (L"a[0]")->as_string ()));
+      TEST_EQ (3      , path (LR"(a.p\.q)")->as_number ());
+      TEST_EQ (true   , path (L"a.b[5]")->is_error ());
+
+      {
+        std::size_t pos;
+        json_query  query;
+        TEST_EQ (false, json_query::compile_pointer (L"a", pos, query));
+        TEST_EQ (false, json_query::compile_pointer (L"/a~2", pos, query));
+        TEST_EQ (false, json_query::compile_path (L"a..b", pos, query));
+        TEST_EQ (false, json_query::compile_path (L"a.", pos, query));
+        TEST_EQ (false, json_query::compile_path (L"a[x]", pos, query));
+        TEST_EQ (false, json_query::compile_path (L"a[0", pos, query));
+      }
+
+      {
+        json_query_set queries;
+        std::vector<std::size_t> indices;
+        for (auto && p : {L"/a/b/0", L"/a/b/1/c", L"/a/0", L"/d", L"/a/missing", L"/a/b/0"})
+        {
+          std::size_t pos;
+          json_query  query;
+          TEST_EQ (true, json_query::compile_pointer (p, pos, query));
+          indices.push_back (queries.add (query));
+        }
+
+        json_query_set::results_type results;
+        queries.evaluate (*doc, results);
+
+        TEST_EQ (6      , results.size ());
+        TEST_EQ (10     , results[indices[0]]->as_number ());
+        TEST_EQ (true   , results[indices[1]]->as_bool ());
+        TEST_EQ ("zero" , to_ascii (results[indices[2]]->as_string ()));
+        TEST_EQ (true   , results[indices[3]]->is_null ());
+        TEST_EQ (true   , results[indices[4]]->is_error ());
+        TEST_EQ (10     , results[indices[5]]->as_number ());
+      }
+    }
+    else
+    {
+      ++errors;
+      std::cout
+        << "FAILURE: Pos: " << pos << std::endl;
+    }
+  }
+
+  // Records values as a compact string, skips members named "skip" and containers at depth 'skip_depth'
+  template<typename TString>
+  struct skip_json_context
+  {
+    using string_type = TString                           ;
+    using char_type   = typename string_type::value_type  ;
+    using iter_type   = char_type const *                 ;
+
+    string_type   current_string  ;
+    std::string   result          ;
+    std::size_t   depth           ;
+    std::size_t   skip_depth      ;
+
+    skip_json_context ()
+      : depth       (0)
+      , skip_depth  (0)
+    {
+    }
+
+    CPP_JSON__NO_COPY_MOVE (skip_json_context);
+
+    void expected_char    (std::size_t /*pos*/, char_type /*ch*/) noexcept {}
+    void expected_chars   (std::size_t /*pos*/, string_type const & /*chs*/) noexcept {}
+    void expected_token   (std::size_t /*pos*/, string_type const & /*token*/) noexcept {}
+    void unexpected_token (std::size_t /*pos*/, string_type const & /*token*/) noexcept {}
+
+    void clear_string ()
+    {
+      current_string.clear ();
+    }
+
+    void push_char (char_type ch)
+    {
+      current_string.push_back (ch);
+    }
+
+    void push_wchar_t (wchar_t ch)
+    {
+      current_string.push_back (static_cast<char_type> (ch));
+    }
+
+    string_type const & get_string () noexcept
+    {
+      return current_string;
+    }
+
+    cpp_json::parser::json_decision container_begin (char ch)
+    {
+      ++depth;
+      if (depth == skip_depth)
+      {
+        --depth;
+        result += '~';
+        return cpp_json::parser::json_decision::skip;
+      }
+      result += ch;
+      return cpp_json::parser::json_decision::proceed;
+    }
+
+    bool container_end (char ch)
+    {
+      --depth;
+      result += ch;
+      return true;
+    }
+
+    cpp_json::parser::json_decision array_begin ()
+    {
+      return container_begin ('[');
+    }
+
+    bool array_end ()
+    {
+      return container_end (']');
+    }
+
+    cpp_json::parser::json_decision object_begin ()
+    {
+      return container_begin ('{');
+    }
+
+    cpp_json::parser::json_decision member_key (string_type const & s)
+    {
+      auto key = to_ascii (std::wstring (s.begin (), s.end ()));
+      result += key;
+      result += ':';
+      if (key == "skip")
+      {
+        result += '~';
+        return cpp_json::parser::json_decision::skip;
+      }
+      return cpp_json::parser::json_decision::proceed;
+    }
+
+    bool object_end ()
+    {
+      return container_end ('}');
+    }
+
+    bool bool_value (bool b)
+    {
+      result += b ? 't' : 'f';
+      return true;
+    }
+
+    bool null_value ()
+    {
+      result += 'n';
+      return true;
+    }
+
+    bool string_value (string_type const & s)
+    {
+      result += '"';
+      result += to_ascii (std::wstring (s.begin (), s.end ()));
+      result += '"';
+      return true;
+    }
+
+    bool number_value (double d)
+    {
+      result += std::to_string (static_cast<int> (d));
+      return true;
+    }
+  };
+
+  template<typename TString>
+  std::tuple<bool, std::size_t, std::string> skip_parse (TString const & json, std::size_t skip_depth)
+  {
+    auto b = json.data ();
+    auto e = b + json.size ();
+    cpp_json::parser::json_parser<skip_json_context<TString>> jp (b, e);
+    jp.skip_depth = skip_depth;
+    auto result = jp.try_parse__json ();
+    return std::make_tuple (result, jp.pos (), jp.result);
+  }
+
+  void skip_test_cases ()
+  {
+    std::wcout << "Running 'skip_test_cases'..." << std::endl;
+
+    auto test = [] (std::string const & json, std::size_t skip_depth, bool expected_result, std::string const & expected)
+    {
+      auto ar = skip_parse (json, skip_depth);
+      auto wr = skip_parse (std::wstring (json.begin (), json.end ()), skip_depth);
+
+      TEST_EQ (expected_result, std::get<0> (ar));
+      TEST_EQ (expected_result, std::get<0> (wr));
+      TEST_EQ (std::get<1> (ar), std::get<1> (wr));
+      if (expected_result)
+      {
+        TEST_EQ (json.size (), std::get<1> (ar));
+        TEST_EQ (expected, std::get<2> (ar));
+        TEST_EQ (expected, std::get<2> (wr));
+      }
+    };
+
+    // Long strings exercise the vectorized scan
+    std::string long_string = R"("0123456789abcdef0123456789abcdef\"[{0123456789abcdef]}\\")";
+
+    test (R"({"a":1,"skip":{"x":[1,2,{"y":"}]"}]},"b":2})"                      , 0, true , R"({a:1skip:~b:2})");
+    test (R"({"skip":[1,"\"]",[[]]] , "b":true})"                              , 0, true , R"({skip:~b:t})");
+    test (R"({"skip":"abc\"def","skip":123.5e3 ,"skip":null,"c":null})"        , 0, true , R"({skip:~skip:~skip:~c:n})");
+    test (R"([1,[2,[3,"x"]],{"a":[4]},5])"                                      , 2, true , R"([1~~5])");
+    test (R"([1,[2,[3,"x"]],{"a":[4]},5])"                                      , 3, true , R"([1[2~]{a:~}5])");
+    test (R"({"a":[)" + long_string + "," + long_string + R"(],"skip":[)" + long_string + R"(],"z":0})", 2, true, R"({a:~skip:~z:0})");
+    test (R"([[)" + long_string + R"(],[)" + long_string + R"(]])"              , 2, true , R"([~~])");
+    test (R"([1] )"                                                             , 1, true , R"(~)");
+    test (R"({"skip":[1,2)"                                                     , 0, false, "");
+    test (R"({"skip":"abc)"                                                     , 0, false, "");
+    test (R"({"skip":})"                                                        , 0, false, "");
+    test (R"([[1,"]"] x)"                                                       , 2, false, "");
+  }
+
+  void nesting_test_cases ()
+  {
+    std::wcout << "Running 'nesting_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    std::size_t const max_depth = CPP_JSON__MAX_DEPTH;
+
+    auto nested = [] (std::size_t depth)
+    {
+      return doc_string_type (depth, L'[') + doc_string_type (depth, L']');
+    };
+
+    {
+      std::size_t         pos     ;
+      json_document::ptr  document;
+      doc_string_type     error   ;
+
+      TEST_EQ (true , json_parser::parse (nested (max_depth), pos, document));
+
+      // Fails on the first bracket beyond the limit instead of exhausting the stack
+      TEST_EQ (false, json_parser::parse (nested (max_depth + 1), pos, document, error));
+      TEST_EQ (max_depth, pos);
+      TEST_EQ (true , error.find (L"NESTING") != doc_string_type::npos);
+
+      TEST_EQ (false, json_parser::parse (nested (100000), pos, document));
+      TEST_EQ (max_depth, pos);
+
+      doc_string_type object;
+      for (auto iter = 0U; iter < max_depth; ++iter)
+      {
+        object += LR"({"a":)";
+      }
+      object += L"{}" + doc_string_type (max_depth, L'}');
+      TEST_EQ (false, json_parser::parse (object, pos, document));
+    }
+
+    {
+      // Deferred containers are validated with the same limit
+      std::size_t         pos     ;
+      json_document::ptr  document;
+      json_lazy_options   options ;
+
+      TEST_EQ (true , json_parser::parse (nested (max_depth), options, pos, document));
+      TEST_EQ (false, json_parser::parse (nested (max_depth + 1), options, pos, document));
+      TEST_EQ (max_depth, pos);
+    }
+
+    {
+      std::string json = "[1,[2,[3,[4]]]]";
+      auto b = json.data ();
+      auto e = b + json.size ();
+
+      cpp_json::parser::json_parser<skip_json_context<std::string>> jp (b, e);
+      jp.skip_depth = 10;
+      jp.set_max_depth (3);
+      TEST_EQ (false, jp.try_parse__json ());
+      TEST_EQ (9U   , jp.pos ());
+
+      // The contents of skipped containers are scanned without recursion and aren't limited
+      cpp_json::parser::json_parser<skip_json_context<std::string>> sjp (b, e);
+      sjp.skip_depth = 2;
+      sjp.set_max_depth (2);
+      TEST_EQ (true     , sjp.try_parse__json ());
+      TEST_EQ ("[1~]"   , sjp.result);
+    }
+  }
+
+  void projection_test_cases ()
+  {
+    std::wcout << "Running 'projection_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_string_type json_document = LR"({"user":{"id":7,"name":"x","tags":["a","b"]},"items":[{"price":1,"q":2},{"q":3},{"price":4,"x":[1,{"y":2}]},5],"other":{"z":[1,2,3]}})";
+
+    auto test = [&json_document] (std::vector<doc_string_type> const & paths, std::string const & expected)
+    {
+      json_projection projection;
+      for (auto && path : paths)
+      {
+        TEST_EQ (true, projection.add (path));
+      }
+
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+
+      if (json_parser::parse (json_document, projection, pos, doc))
+      {
+        TEST_EQ (json_document.size (), pos);
+        TEST_EQ (expected, to_ascii (doc->to_string ()));
+      }
+      else
+      {
+        ++errors;
+        std::cout
+          << "FAILURE: Pos: " << pos << std::endl;
+      }
+    };
+
+    test ({L"/user/id"}                     , R"({"user":{"id":7}})");
+    test ({L"/user/id", L"/items/*/price"}  , R"({"user":{"id":7}, "items":[{"price":1}, {}, {"price":4}]})");
+    test ({L"/items/2/x", L"/items/0"}      , R"({"items":[{"price":1, "q":2}, {"x":[1, {"y":2}]}]})");
+    test ({L"/items/*/x/1/y"}               , R"({"items":[{}, {}, {"x":[{"y":2}]}]})");
+    test ({L"/user/tags/1", L"/other"}      , R"({"user":{"tags":["b"]}, "other":{"z":[1, 2, 3]}})");
+    test ({L"/missing"}                     , R"({})");
+    test ({L""}                             , to_ascii ([&json_document] ()
+      {
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        return json_parser::parse (json_document, pos, doc) ? doc->to_string () : doc_string_type ();
+      } ()));
+
+    {
+      json_projection projection;
+      TEST_EQ (false, projection.add (L"user"));
+      TEST_EQ (true , projection.add (L"/user/id"));
+
+      // Skipped parts are validated
+      std::size_t         pos   ;
+      json_document::ptr  doc   ;
+      doc_string_type     error ;
+
+      doc_string_type invalid = LR"({"user":{"id":1},"other":[1,2,01]})";
+      TEST_EQ (false, json_parser::parse (invalid, projection, pos, doc, error));
+      TEST_EQ (31   , pos);
+      TEST_EQ (false, error.empty ());
+
+      doc_string_type invalid_string = LR"({"other":"abc\x","user":{"id":1}})";
+      TEST_EQ (false, json_parser::parse (invalid_string, projection, pos, doc));
+      TEST_EQ (14   , pos);
+    }
+  }
+
+  void array_reader_test_cases ()
+  {
+    std::wcout << "Running 'array_reader_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    auto read_all = [] (doc_string_type const & json, std::string & result) -> bool
+    {
+      json_array_reader   reader (json.c_str (), json.c_str () + json.size ());
+      json_document::ptr  doc;
+
+      result.clear ();
+      while (reader.next (doc))
+      {
+        result += to_ascii (doc->to_string ());
+        result += '|';
+      }
+
+      TEST_EQ (!reader.failed (), reader.done ());
+
+      return reader.done ();
+    };
+
+    std::string result;
+
+    TEST_EQ (true , read_all (LR"( [1, "a", [2,3] ,{"b":null}] )", result));
+    TEST_EQ (std::string (R"(1|"a"|[2, 3]|{"b":null}|)"), result);
+
+    TEST_EQ (true , read_all (L"[]", result));
+    TEST_EQ (std::string (), result);
+
+    TEST_EQ (true , read_all (L" [ true ] ", result));
+    TEST_EQ (std::string ("true|"), result);
+
+    TEST_EQ (false, read_all (L"[1,2", result));
+    TEST_EQ (std::string ("1|2|"), result);
+
+    TEST_EQ (false, read_all (L"[1,,2]", result));
+    TEST_EQ (std::string ("1|"), result);
+
+    TEST_EQ (false, read_all (L"[1] x", result));
+    TEST_EQ (false, read_all (L"{}", result));
+    TEST_EQ (false, read_all (L"1", result));
+    TEST_EQ (false, read_all (L"", result));
+
+    {
+      doc_string_type     json = L"[1,[2,x]]";
+      json_array_reader   reader (json.c_str (), json.c_str () + json.size ());
+      json_document::ptr  doc;
+
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (false, reader.next (doc));
+      TEST_EQ (true , reader.failed ());
+      TEST_EQ (6    , reader.pos ());
+      TEST_EQ (false, static_cast<bool> (doc));
+      // Once failed the reader stays failed
+      TEST_EQ (false, reader.next (doc));
+    }
+
+    // UTF-8 input
+    {
+      std::string json = u8"[\"a\u00e5\u20ac\U0001F600\", \"\\u00e5\", {\"\u00e5\":1}, \"\xff\"]";
+
+      json_utf8_array_reader  reader (json.c_str (), json.c_str () + json.size ());
+      json_document::ptr      doc;
+
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (true , doc_string_type (L"a\u00e5\u20ac\U0001F600") == doc->root ()->as_string ());
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (true , doc_string_type (L"\u00e5") == doc->root ()->as_string ());
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (1.0  , doc->root ()->get (L"\u00e5")->as_number ());
+      // Malformed UTF-8 is replaced by U+FFFD
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (true , doc_string_type (L"\uFFFD") == doc->root ()->as_string ());
+      TEST_EQ (false, reader.next (doc));
+      TEST_EQ (true , reader.done ());
+      TEST_EQ (json.size (), reader.pos ());
+    }
+
+    // Input ending inside an escape, exact size buffers so reading past the end
+    //  is caught by sanitizers
+    for (auto && truncated : { "[1,\"\\", "[1,\"\\u", "[1,\"\\u00" })
+    {
+      auto size   = std::strlen (truncated);
+      std::unique_ptr<char[]> buffer (new char[size]);
+      std::memcpy (buffer.get (), truncated, size);
+
+      json_utf8_array_reader  reader (buffer.get (), buffer.get () + size);
+      json_document::ptr      doc;
+
+      TEST_EQ (true , reader.next (doc));
+      TEST_EQ (false, reader.next (doc));
+      TEST_EQ (true , reader.failed ());
+      TEST_EQ (size , reader.pos ());
+    }
+
+    // Malformed UTF-8 is replaced by one U+FFFD per sequence
+    {
+      auto decode = [] (std::string const & chars)
+      {
+        auto json = "[\"" + chars + "\"]";
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        TEST_EQ (true, json_parser::parse (json.data (), json.data () + json.size (), pos, doc));
+        return doc ? doc->root ()->at (0)->as_string () : doc_string_type ();
+      };
+
+      // Overlong forms
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xC0\x80"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xC1\xBF"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xE0\x80\xAF"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xF0\x8F\xBF\xBF"));
+      // Encoded surrogates
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xED\xA0\x80"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xED\xBF\xBF"));
+      // Beyond U+10FFFF
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xF4\x90\x80\x80"));
+      // F5-FF lead bytes, the continuation bytes are malformed too
+      TEST_EQ (true, doc_string_type (L"\uFFFDx") == decode ("\xF5x"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD\uFFFD\uFFFD\uFFFD") == decode ("\xF7\xBF\xBF\xBF"));
+      TEST_EQ (true, doc_string_type (L"\uFFFD")  == decode ("\xFF"));
+      // The limits are valid
+      TEST_EQ (true, doc_string_type (L"\u0080")  == decode ("\xC2\x80"));
+      TEST_EQ (true, doc_string_type (L"\u0800")  == decode ("\xE0\xA0\x80"));
+      TEST_EQ (true, doc_string_type (L"\uD7FF")  == decode ("\xED\x9F\xBF"));
+      TEST_EQ (true, doc_string_type (L"\uE000")  == decode ("\xEE\x80\x80"));
+      TEST_EQ (true, doc_string_type (L"\U00010000") == decode ("\xF0\x90\x80\x80"));
+      TEST_EQ (true, doc_string_type (L"\U0010FFFF") == decode ("\xF4\x8F\xBF\xBF"));
+    }
+
+    // UTF-8 documents
+    {
+      std::string         json = u8"{\"k\":\"\u00e5\"}";
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+
+      TEST_EQ (true , json_parser::parse (json.c_str (), json.c_str () + json.size (), pos, doc));
+      TEST_EQ (json.size (), pos);
+      TEST_EQ (true , doc_string_type (L"\u00e5") == doc->root ()->get (L"k")->as_string ());
+
+      std::string invalid = "[1,]";
+      TEST_EQ (false, json_parser::parse (invalid.c_str (), invalid.c_str () + invalid.size (), pos, doc));
+      TEST_EQ (3    , pos);
+      TEST_EQ (false, static_cast<bool> (doc));
+    }
+  }
+
+  // A recursive descent deserializer built on the pull reader, prints the value of the
+  //  current token in a compact form. Members named 'skip' are skipped
+  template<typename TReader>
+  bool read_value (TReader & reader, std::string & result)
+  {
+    using cpp_json::parser::json_token;
+
+    switch (reader.token ())
+    {
+    case json_token::array_begin:
+      result += '[';
+      for (;;)
+      {
+        if (reader.next () == json_token::array_end)
+        {
+          result += ']';
+          return true;
+        }
+        else if (!read_value (reader, result))
+        {
+          return false;
+        }
+      }
+    case json_token::object_begin:
+      result += '{';
+      for (;;)
+      {
+        switch (reader.next ())
+        {
+        case json_token::object_end:
+          result += '}';
+          return true;
+        case json_token::member_key:
+          {
+            auto key = to_ascii (std::wstring (reader.string ().begin (), reader.string ().end ()));
+            result += key;
+            result += ':';
+            if (key == "skip")
+            {
+              result += '~';
+              if (!reader.skip ())
+              {
+                return false;
+              }
+            }
+            else
+            {
+              reader.next ();
+              if (!read_value (reader, result))
+              {
+                return false;
+              }
+            }
+          }
+          break;
+        default:
+          return false;
+        }
+      }
+    case json_token::null_value:
+      result += "null";
+      return true;
+    case json_token::bool_value:
+      result += reader.boolean () ? "true" : "false";
+      return true;
+    case json_token::number_value:
+      result += std::to_string (static_cast<int> (reader.number ()));
+      return true;
+    case json_token::string_value:
+      result += '\'';
+      result += to_ascii (std::wstring (reader.string ().begin (), reader.string ().end ()));
+      result += '\'';
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  void reader_test_cases ()
+  {
+    std::wcout << "Running 'reader_test_cases'..." << std::endl;
+
+    using namespace cpp_json::parser;
+
+    auto read = [] (std::wstring const & json, std::string & result) -> bool
+    {
+      json_reader reader (json.c_str (), json.c_str () + json.size ());
+
+      result.clear ();
+      return
+            reader.next () != json_token::error
+        &&  read_value (reader, result)
+        &&  reader.next () == json_token::eos
+        &&  reader.depth () == 0
+        ;
+    };
+
+    std::string result;
+
+    TEST_EQ (true , read (LR"( {"a" : [1, true, null, "x\ty"], "skip":[{"a":"]"}], "b":{"skip":1,"c":false}, "d":[]} )", result));
+    TEST_EQ (std::string ("{a:[1truenull'x\ty']skip:~b:{skip:~c:false}d:[]}"), result);
+
+    TEST_EQ (true , read (L"[[],{},[[-2]]]", result));
+    TEST_EQ (std::string ("[[]{}[[-2]]]"), result);
+
+    TEST_EQ (false, read (L"[1,]", result));
+    TEST_EQ (false, read (L"[1 2]", result));
+    TEST_EQ (false, read (L"{\"a\" 1}", result));
+    TEST_EQ (false, read (L"{\"a\":1,}", result));
+    TEST_EQ (false, read (L"[1] 2", result));
+    TEST_EQ (false, read (L"1", result));
+    TEST_EQ (false, read (L"", result));
+
+    // Tokens and positions
+    {
+      std::wstring  json = LR"({"a":[1,"b"]})";
+      json_reader   reader (json.c_str (), json.c_str () + json.size ());
+
+      TEST_EQ (true , json_token::object_begin  == reader.next ());
+      TEST_EQ (1    , reader.depth ());
+      TEST_EQ (true , json_token::member_key    == reader.next ());
+      TEST_EQ (true , std::wstring (L"a") == reader.string ());
+      TEST_EQ (true , json_token::array_begin   == reader.next ());
+      TEST_EQ (2    , reader.depth ());
+      TEST_EQ (true , json_token::number_value  == reader.next ());
+      TEST_EQ (1.0  , reader.number ());
+      TEST_EQ (7    , reader.pos ());
+      TEST_EQ (true , json_token::string_value  == reader.next ());
+      TEST_EQ (true , std::wstring (L"b") == reader.string ());
+      TEST_EQ (true , json_token::array_end     == reader.next ());
+      TEST_EQ (true , json_token::object_end    == reader.next ());
+      TEST_EQ (0    , reader.depth ());
+      TEST_EQ (true , json_token::eos           == reader.next ());
+      TEST_EQ (true , json_token::eos           == reader.next ());
+      TEST_EQ (json.size (), reader.pos ());
+      TEST_EQ (false, reader.skip ());
+    }
+
+    // Skipping a whole container
+    {
+      std::wstring  json = LR"([{"a":[1,2]},3])";
+      json_reader   reader (json.c_str (), json.c_str () + json.size ());
+
+      TEST_EQ (true , json_token::array_begin   == reader.next ());
+      TEST_EQ (true , json_token::object_begin  == reader.next ());
+      TEST_EQ (true , reader.skip ());
+      TEST_EQ (true , json_token::object_end    == reader.token ());
+      TEST_EQ (1    , reader.depth ());
+      TEST_EQ (true , json_token::number_value  == reader.next ());
+      TEST_EQ (true , json_token::array_end     == reader.next ());
+    }
+
+    // Errors are sticky
+    {
+      std::wstring  json = L"[1,x]";
+      json_reader   reader (json.c_str (), json.c_str () + json.size ());
+
+      TEST_EQ (true , json_token::array_begin   == reader.next ());
+      TEST_EQ (true , json_token::number_value  == reader.next ());
+      TEST_EQ (true , json_token::error         == reader.next ());
+      TEST_EQ (3    , reader.pos ());
+      TEST_EQ (true , json_token::error         == reader.next ());
+    }
+
+    // Range of tokens
+    {
+      std::wstring  json = LR"({"a":[null]})";
+      json_reader   reader (json.c_str (), json.c_str () + json.size ());
+
+      auto count = 0;
+      for (auto token : reader)
+      {
+        TEST_EQ (true, token != json_token::eos && token != json_token::error);
+        ++count;
+      }
+      TEST_EQ (6    , count);
+      TEST_EQ (true , json_token::eos == reader.token ());
+    }
+
+    // UTF-8 input, escapes are encoded as UTF-8
+    {
+      std::string       json = u8"[\"\u00e5\\u00e5\\ud83d\\ude00\\ud83d\"]";
+      json_utf8_reader  reader (json.c_str (), json.c_str () + json.size ());
+
+      TEST_EQ (true , json_token::array_begin   == reader.next ());
+      TEST_EQ (true , json_token::string_value  == reader.next ());
+      TEST_EQ (true , std::string (u8"\u00e5\u00e5\U0001F600\uFFFD") == reader.string ());
+      TEST_EQ (true , json_token::array_end     == reader.next ());
+      TEST_EQ (true , json_token::eos           == reader.next ());
+    }
+  }
+
+  void ondemand_test_cases ()
+  {
+    std::wcout << "Running 'ondemand_test_cases'..." << std::endl;
+
+    using namespace cpp_json::parser;
+
+    std::wstring json = LR"( {"skip":[{"id":"]"}], "user":{"name":"x\ty", "id":1234, "tags":["a",[1,2],"c"], "ok":true, "none":null}, "n":-1.5} )";
+
+    // Member lookup, skipped members are never parsed
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      TEST_EQ (1234 , doc[L"user"][L"id"].as_int64 ());
+      TEST_EQ (false, doc.failed ());
+    }
+
+    // Lookups in document order
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      auto user = doc[L"user"];
+      TEST_EQ (true , json_token::object_begin == user.token ());
+      TEST_EQ (true , std::wstring (L"x\ty") == user[L"name"].as_string ());
+      TEST_EQ (1234 , user[L"id"].as_int64 ());
+
+      auto tags = user[L"tags"];
+      TEST_EQ (true , std::wstring (L"a") == tags.at (0).as_string ());
+      TEST_EQ (true , std::wstring (L"c") == tags.at (2).as_string ());
+      TEST_EQ (false, tags.at (1).is_valid ());   // Already passed
+      TEST_EQ (false, tags.at (3).is_valid ());   // Out of range
+      TEST_EQ (false, tags.is_valid ());          // The array has ended
+
+      TEST_EQ (true , user[L"ok"].as_bool ());
+      TEST_EQ (true , user[L"none"].is_null ());
+      TEST_EQ (-1.5 , doc[L"n"].as_double ());
+      TEST_EQ (false, user.is_valid ());
+      TEST_EQ (false, doc.failed ());
+    }
+
+    // Already passed and missing members
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      auto user = doc[L"user"];
+      auto id   = user[L"id"];
+      TEST_EQ (false, user[L"name"].is_valid ());
+      TEST_EQ (false, id.is_valid ());            // Passed while looking for name
+      TEST_EQ (7    , id.as_int64 (7));
+      TEST_EQ (false, doc[L"missing"][L"id"].is_valid ());
+      TEST_EQ (false, doc[L"n"].is_valid ());
+    }
+
+    // Navigating back up skips the rest of a nested value
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      auto tags = doc[L"user"][L"tags"];
+      TEST_EQ (1.0  , tags.at (1).at (0).as_double ());
+      TEST_EQ (-1.5 , doc[L"n"].as_double ());
+    }
+
+    // Conversions
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      auto user = doc[L"user"];
+      TEST_EQ (0    , user[L"name"].as_int64 ());
+      std::int64_t  i;
+      auto          n = doc[L"n"];
+      TEST_EQ (false, n.get_int64 (i));
+      TEST_EQ (-1.5 , n.as_double ());
+    }
+
+    // for_each_member and for_each_element
+    {
+      json_ondemand doc (json.c_str (), json.c_str () + json.size ());
+
+      std::wstring names;
+      auto result = doc[L"user"].for_each_member ([&names] (std::wstring const & name, json_ondemand::value v)
+        {
+          names += name + L";";
+          if (name == L"tags")
+          {
+            // Only partially read
+            v.at (0);
+          }
+        });
+      TEST_EQ (true , result);
+      TEST_EQ (true , std::wstring (L"name;id;tags;ok;none;") == names);
+      TEST_EQ (-1.5 , doc[L"n"].as_double ());
+
+      std::wstring  arr = L"[1,[2],3]";
+      json_ondemand adoc (arr.c_str (), arr.c_str () + arr.size ());
+      double sum = 0;
+      TEST_EQ (true , adoc.root ().for_each_element ([&sum] (json_ondemand::value v) { sum += v.as_double (); }));
+      TEST_EQ (4.0  , sum);
+    }
+
+    // Invalid input is only found when it's passed
+    {
+      std::wstring  bad = LR"({"a":1, "b":[1,}, "c":x})";
+      json_ondemand doc (bad.c_str (), bad.c_str () + bad.size ());
+
+      TEST_EQ (1    , doc[L"a"].as_int64 ());
+      TEST_EQ (false, doc.failed ());
+      TEST_EQ (false, doc[L"c"].is_valid ());
+      TEST_EQ (true , doc.failed ());
+
+      std::wstring  scalar = L"1";
+      json_ondemand sdoc (scalar.c_str (), scalar.c_str () + scalar.size ());
+      TEST_EQ (false, sdoc.root ().is_valid ());
+      TEST_EQ (true , sdoc.failed ());
+    }
+
+    // UTF-8 input, navigating doesn't allocate once the buffers are warm
+    {
+      std::string json8 = u8R"({"skip":[{"a":"å"},[1,2,3]],"user":{"id":42,"name":"å"}})";
+
+      json_utf8_ondemand doc (json8.c_str (), json8.c_str () + json8.size ());
+
+      std::string const user  = "user";
+      std::string const id    = "id";
+      auto before = get_allocation_counters ();
+      auto u      = doc[user];
+      auto v      = u[id].as_int64 ();
+      auto after  = get_allocation_counters ();
+
+      TEST_EQ (42   , v);
+      TEST_EQ (0U   , (after - before).allocations);
+      TEST_EQ (true , std::string (u8"å") == u[u8"name"].as_string ());
+    }
+  }
+
+  // Returns at most 'max_read' bytes per read like a pipe
+  struct string_block_source : cpp_json::parser::json_block_source
+  {
+    string_block_source (std::string const & s, std::size_t max_read)
+      : s         (s)
+      , max_read  (max_read)
+    {
+    }
+
+    std::size_t read (char * buffer, std::size_t size) override
+    {
+      auto sz = std::min (std::min (size, max_read), s.size () - pos);
+      std::copy (s.begin () + pos, s.begin () + pos + sz, buffer);
+      pos += sz;
+      return sz;
+    }
+
+  private:
+    std::string const & s         ;
+    std::size_t const   max_read  ;
+    std::size_t         pos       = 0;
+  };
+
+  void stream_test_cases ()
+  {
+    std::wcout << "Running 'stream_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+    using cpp_json::parser::basic_json_reader   ;
+    using cpp_json::parser::json_block_iterator ;
+    using cpp_json::parser::json_block_stream   ;
+    using cpp_json::parser::json_token          ;
+
+    // Fetching a block may throw, so the parser kernels are only noexcept for pointers
+    static_assert (!cpp_json::parser::details::json_nothrow_advance<json_block_iterator>::value , "");
+    static_assert ( cpp_json::parser::details::json_nothrow_advance<char const *>::value        , "");
+
+    // Pointer ranges ending inside an escape, exact size buffers so reading past
+    //  the end is caught by sanitizers
+    for (auto && truncated : { "[\"\\", "[\"\\u", "[\"\\u00" })
+    {
+      auto size   = std::strlen (truncated);
+      std::unique_ptr<char[]> buffer (new char[size]);
+      std::memcpy (buffer.get (), truncated, size);
+
+      auto begin  = static_cast<char const *> (buffer.get ());
+      auto end    = begin + size;
+
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+      TEST_EQ (false, json_parser::parse (begin, end, pos, doc));
+      TEST_EQ (size , pos);
+
+      cpp_json::parser::json_utf8_reader reader (begin, end);
+      TEST_EQ (true , json_token::array_begin == reader.next ());
+      TEST_EQ (true , json_token::error       == reader.next ());
+
+      cpp_json::parser::json_utf8_ondemand ondemand (begin, end);
+      TEST_EQ (false, ondemand.root ().at (0).is_valid ());
+      TEST_EQ (true , ondemand.failed ());
+    }
+
+    std::string json = R"( {"a" : [1, true, null, "x\ty", -1.5E2, false], "bb":{"c":"\u00e5\ud83d\ude00"}, "d":[[],{}]} )";
+
+    // Shifts the block boundaries over every char of the input
+    for (std::size_t padding = 0; padding < 70; ++padding)
+    {
+      auto padded = std::string (padding, ' ') + json;
+
+      std::size_t         expected_pos;
+      json_document::ptr  expected;
+      TEST_EQ (true, json_parser::parse (padded.c_str (), padded.c_str () + padded.size (), expected_pos, expected));
+
+      for (auto background : { true, false })
+      {
+        for (std::size_t max_read : { 1, 3, 100 })
+        {
+          string_block_source source (padded, max_read);
+          json_block_stream   stream (source, json_block_stream::min_block_size, 3, background);
+
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          TEST_EQ (true         , json_parser::parse (stream.begin (), stream.end (), pos, doc));
+          TEST_EQ (expected_pos , pos);
+          TEST_EQ (true         , doc && expected->to_string () == doc->to_string ());
+        }
+      }
+    }
+
+    // Errors are reported at the same position as for contiguous input
+    for (auto invalid : { "[1,2", "[1,2,]", "[tru]", "[nul", "{\"a\":1} x", "[\"abc", "" })
+    {
+      std::string json_invalid = invalid;
+
+      std::size_t         expected_pos;
+      json_document::ptr  doc;
+      TEST_EQ (false, json_parser::parse (json_invalid.c_str (), json_invalid.c_str () + json_invalid.size (), expected_pos, doc));
+
+      string_block_source source (json_invalid, 2);
+      json_block_stream   stream (source);
+
+      std::size_t pos;
+      TEST_EQ (false        , json_parser::parse (stream.begin (), stream.end (), pos, doc));
+      TEST_EQ (expected_pos , pos);
+    }
+
+    // Pull reader over a stream
+    {
+      auto                padded = std::string (60, ' ') + json;
+      string_block_source source (padded, 5);
+      json_block_stream   stream (source, 0);
+
+      basic_json_reader<char, json_block_iterator> reader (stream.begin (), stream.end ());
+
+      auto count = 0;
+      for (auto token : reader)
+      {
+        if (token == json_token::member_key && reader.string () == "bb")
+        {
+          TEST_EQ (true, json_token::object_begin == reader.next ());
+          TEST_EQ (true, reader.skip ());
+        }
+        ++count;
+      }
+      TEST_EQ (19   , count);
+      TEST_EQ (true , json_token::eos == reader.token ());
+      TEST_EQ (padded.size (), reader.pos ());
+    }
+
+    // Reading a C stream, read errors are reported by failed
+    {
+      using cpp_json::parser::json_file_source;
+
+      if (auto file = std::tmpfile ())
+      {
+        std::fwrite (json.data (), 1, json.size (), file);
+        std::rewind (file);
+
+        json_file_source  source (file);
+        json_block_stream stream (source, 0);
+
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        TEST_EQ (true , json_parser::parse (stream.begin (), stream.end (), pos, doc));
+        TEST_EQ (json.size (), pos);
+        TEST_EQ (false, source.failed ());
+
+        std::fclose (file);
+      }
+
+#ifdef __GLIBC__
+      // Reading a directory fails with EISDIR
+      if (auto dir = std::fopen (".", "rb"))
+      {
+        json_file_source  source (dir);
+        json_block_stream stream (source, 0);
+
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        TEST_EQ (false, json_parser::parse (stream.begin (), stream.end (), pos, doc));
+        TEST_EQ (0U   , pos);
+        TEST_EQ (true , source.failed ());
+
+        std::fclose (dir);
+      }
+#endif
+    }
+
+    // Abandoning a stream before the end stops the background thread
+    {
+      std::string         large (100000, ' ');
+      string_block_source source (large, 10);
+      json_block_stream   stream (source, 100);
+
+      auto b = stream.begin ();
+      TEST_EQ (' ', *b);
+    }
+  }
+
+  void batch_test_cases ()
+  {
+    std::wcout << "Running 'batch_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_strings_type inputs =
+      {
+        LR"({"a":[1,2,{"b":null}],"c":"d"})"  ,
+        LR"([[[[{"x":[1,[2,[3` ]]]]}]]]])"    ,  // Fails deep inside, builder state must be recycled
+        LR"([])"                              ,
+        LR"({"a":})"                          ,
+        LR"([true, false, "\u00e5"])"         ,
+        LR"({"z":{"y":{"x":[]}}})"            ,
+        L""                                   ,
+      };
+
+    // Replicate to get more inputs than chunks
+    auto batch = inputs;
+    for (auto iter = 0; iter < 50; ++iter)
+    {
+      batch.insert (batch.end (), inputs.begin (), inputs.end ());
+    }
+
+    std::vector<doc_string_type>  expected_json   ;
+    std::vector<std::size_t>      expected_pos    ;
+    std::vector<doc_string_type>  expected_error  ;
+    std::size_t                   expected_failures = 0;
+    for (auto && json : batch)
+    {
+      std::size_t         pos   ;
+      json_document::ptr  doc   ;
+      doc_string_type     error ;
+      if (!json_parser::parse (json, pos, doc, error))
+      {
+        ++expected_failures;
+      }
+      expected_json.push_back (doc ? doc->to_string () : doc_string_type ());
+      expected_pos.push_back (pos);
+      expected_error.push_back (error);
+    }
+
+    for (std::size_t concurrency : { 1, 2, 4 })
+    {
+      json_batch_parser parser (concurrency);
+      TEST_EQ (concurrency, parser.concurrency ());
+
+      // Batches reuse the threads and their builder state
+      for (auto iter = 0; iter < 3; ++iter)
+      {
+        json_batch_results results;
+        TEST_EQ (expected_failures, parser.parse_batch (batch, results));
+        TEST_EQ (batch.size (), results.size ());
+
+        auto sz = batch.size ();
+        for (auto i = 0U; i < sz; ++i)
+        {
+          auto && r = results[i];
+          TEST_EQ (expected_pos[i], r.pos);
+          TEST_EQ (true, expected_error[i] == r.error);
+          TEST_EQ (true, expected_json[i] == (r.document ? r.document->to_string () : doc_string_type ()));
+        }
+      }
+
+      TEST_EQ (0U, parser.parse_batch (doc_strings_type ()).size ());
+    }
+  }
+
+  void session_test_cases ()
+  {
+    std::wcout << "Running 'session_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_strings_type inputs =
+      {
+        LR"({"a":[1,2,{"b":null}],"c":"d"})"  ,
+        LR"([[[[{"x":[1,[2,[3` ]]]]}]]]])"    ,  // Fails deep inside, the session must recover
+        LR"([])"                              ,
+        LR"({"a":})"                          ,
+        LR"([true, false, "\u00e5", 1e3])"    ,
+        LR"({"z":{"y":{"x":[]}}})"            ,
+        L""                                   ,
+      };
+
+    for (auto reuse_documents : { false, true })
+    {
+      json_parse_session session (reuse_documents);
+
+      for (auto iter = 0; iter < 3; ++iter)
+      {
+        for (auto && json : inputs)
+        {
+          std::size_t         expected_pos  ;
+          json_document::ptr  expected_doc  ;
+          doc_string_type     expected_error;
+          auto expected = json_parser::parse (json, expected_pos, expected_doc, expected_error);
+
+          std::size_t         pos   ;
+          json_document::ptr  doc   ;
+          doc_string_type     error ;
+          TEST_EQ (expected, session.parse (json, pos, doc, error));
+          TEST_EQ (expected_pos, pos);
+          TEST_EQ (true, expected_error == error);
+          TEST_EQ (true, (expected_doc ? expected_doc->to_string () : doc_string_type ()) == (doc ? doc->to_string () : doc_string_type ()));
+        }
+      }
+    }
+
+    // A document still referenced by the caller, directly or through a derived document, is never reused
+    {
+      json_parse_session session (true);
+
+      std::size_t         pos   ;
+      json_document::ptr  first ;
+      TEST_EQ (true, session.parse (LR"([1,"two",{"three":3}])", pos, first));
+
+      json_document::ptr  second;
+      TEST_EQ (true, session.parse (LR"({"x":[null]})", pos, second));
+      TEST_EQ (true, first != second);
+      TEST_EQ (true, first->to_string () == LR"([1, "two", {"three":3}])");
+
+      // 'derived' shares the unchanged elements of 'second'
+      auto derived = second->set_bool ({ L"y" }, true);
+      TEST_EQ (true, derived != nullptr);
+      second.reset ();
+
+      json_document::ptr  third;
+      TEST_EQ (true, session.parse (LR"([false])", pos, third));
+      TEST_EQ (true, derived->to_string () == LR"({"x":[null], "y":true})");
+      TEST_EQ (true, third->to_string () == LR"([false])");
+
+      // Released, so the storage of 'third' is reused
+      auto third_raw = third.get ();
+      third.reset ();
+      json_document::ptr  fourth;
+      TEST_EQ (true, session.parse (LR"({"four":[4]})", pos, fourth));
+      TEST_EQ (true, third_raw == fourth.get ());
+      TEST_EQ (true, fourth->to_string () == LR"({"four":[4]})");
+    }
+
+    // Steady state parsing with a session allocates less than json_parser::parse
+    {
+      auto json = doc_string_type (LR"({"a":[1,2,3,{"b":[true,false,null]}],"c":"d","e":{"f":{"g":[]}}})");
+
+      auto count_allocations = [&json] (std::function<void ()> const & parse)
+        {
+          // Warm up
+          parse ();
+          parse ();
+
+          auto before = get_allocation_counters ();
+          for (auto iter = 0; iter < 10; ++iter)
+          {
+            parse ();
+          }
+          return (get_allocation_counters () - before).allocations;
+        };
+
+      auto naive_allocations = count_allocations ([&json] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          json_parser::parse (json, pos, doc);
+        });
+
+      json_parse_session session;
+      auto session_allocations = count_allocations ([&json, &session] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          session.parse (json, pos, doc);
+        });
+
+      json_parse_session reuse_session (true);
+      auto reuse_allocations = count_allocations ([&json, &reuse_session] ()
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          reuse_session.parse (json, pos, doc);
+        });
+
+      TEST_EQ (true, session_allocations < naive_allocations);
+      TEST_EQ (true, reuse_allocations < session_allocations);
+    }
+  }
+
+  // Counts the memory taken from a resource
+  struct counting_resource : cpp_json::document::json_memory_resource
+  {
+    std::size_t allocations = 0;
+    std::size_t live_bytes  = 0;
+
+  protected:
+    void * do_allocate (std::size_t bytes, std::size_t alignment) override
+    {
+      ++allocations;
+      live_bytes += bytes;
+      return cpp_json::document::json_new_delete_resource ()->allocate (bytes, alignment);
+    }
+
+    void do_deallocate (void * p, std::size_t bytes, std::size_t alignment) override
+    {
+      live_bytes -= bytes;
+      cpp_json::document::json_new_delete_resource ()->deallocate (p, bytes, alignment);
+    }
+
+    bool do_is_equal (json_memory_resource const & other) const noexcept override
+    {
+      return this == &other;
+    }
+  };
+
+  void memory_resource_test_cases ()
+  {
+    std::wcout << "Running 'memory_resource_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    auto json = doc_string_type (LR"({"name":"a string longer than the small string buffer","values":[1,2,3,{"x":null}],"empty":[]})");
+
+    std::size_t         expected_pos;
+    json_document::ptr  expected;
+    TEST_EQ (true, json_parser::parse (json, expected_pos, expected));
+
+    // The document and all its values are allocated from the resource
+    {
+      counting_resource resource;
+
+      {
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        TEST_EQ (true, json_parser::parse (json, pos, doc, &resource));
+        TEST_EQ (expected_pos, pos);
+        TEST_EQ (true, expected->to_string () == doc->to_string ());
+        TEST_EQ (true, resource.allocations > 0);
+        TEST_EQ (true, resource.live_bytes > 0);
+
+        auto names  = doc->root ()->names ();
+        auto value  = doc->root ()->get (L"name")->as_string ();
+        TEST_EQ (3U, names.size ());
+        TEST_EQ (true, value == L"a string longer than the small string buffer");
+
+        // Derived documents use the resource of the source document
+        auto allocations = resource.allocations;
+        auto derived = doc->set_string ({ L"values", L"3", L"x" }, L"another string longer than the small string buffer");
+        TEST_EQ (true, derived != nullptr);
+        TEST_EQ (true, resource.allocations > allocations);
+        TEST_EQ (true, derived->root ()->get (L"values")->at (3)->get (L"x")->as_string () == L"another string longer than the small string buffer");
+      }
+
+      // Everything is returned when the documents are released
+      TEST_EQ (0U, resource.live_bytes);
+
+      // Errors and projections
+      {
+        std::size_t         pos   ;
+        json_document::ptr  doc   ;
+        doc_string_type     error ;
+        TEST_EQ (false, json_parser::parse (LR"({"a":[1,2,})", pos, doc, error, &resource));
+        TEST_EQ (true, !error.empty ());
+
+        json_projection projection;
+        TEST_EQ (true, projection.add (L"/values/3"));
+        TEST_EQ (true, json_parser::parse (json, projection, pos, doc, &resource));
+        TEST_EQ (true, doc->to_string () == LR"({"values":[{"x":null}]})");
+      }
+
+      TEST_EQ (0U, resource.live_bytes);
+    }
+
+    // Sessions keep their buffers in the resource between parses
+    {
+      counting_resource resource;
+
+      {
+        json_parse_session session (true, &resource);
+        for (auto iter = 0; iter < 3; ++iter)
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          TEST_EQ (true, session.parse (json, pos, doc));
+          TEST_EQ (true, expected->to_string () == doc->to_string ());
+        }
+      }
+
+      TEST_EQ (0U, resource.live_bytes);
+    }
+
+    // A monotonic resource starting with a stack buffer, grows into the upstream resource
+    {
+      counting_resource upstream;
+
+      {
+        char                    buffer[256];
+        json_monotonic_resource resource (buffer, sizeof (buffer), &upstream);
+
+        std::vector<json_document::ptr> documents;
+        for (auto iter = 0; iter < 10; ++iter)
+        {
+          std::size_t         pos ;
+          json_document::ptr  doc ;
+          TEST_EQ (true, json_parser::parse (json, pos, doc, &resource));
+          TEST_EQ (true, expected->to_string () == doc->to_string ());
+          documents.push_back (doc);
+        }
+
+        TEST_EQ (true, upstream.allocations > 0);
+        TEST_EQ (resource.upstream_allocated (), upstream.live_bytes);
+
+        // Chunks grow geometrically
+        TEST_EQ (true, upstream.allocations < 10);
+
+        documents.clear ();
+        TEST_EQ (true, upstream.live_bytes > 0);
+
+        resource.release ();
+        TEST_EQ (0U, upstream.live_bytes);
+        TEST_EQ (0U, resource.upstream_allocated ());
+      }
+
+      TEST_EQ (0U, upstream.live_bytes);
+    }
+
+    // Chunk sizes start over after release
+    {
+      json_monotonic_resource resource;
+      auto size = 3 * json_monotonic_resource::default_chunk_size;
+      for (auto iter = 0; iter < 100; ++iter)
+      {
+        resource.allocate (size);
+        resource.release ();
+      }
+      resource.allocate (size);
+      TEST_EQ (true, resource.upstream_allocated () <= 4 * json_monotonic_resource::default_chunk_size);
+    }
+
+    // Alignment
+    {
+      json_monotonic_resource resource;
+      auto p1 = resource.allocate (1, 1);
+      auto p2 = resource.allocate (8, 8);
+      auto p3 = resource.allocate (3, 1);
+      auto p4 = resource.allocate (16, 16);
+      TEST_EQ (true, p1 != p2);
+      TEST_EQ (0U, reinterpret_cast<std::uintptr_t> (p2) % 8);
+      TEST_EQ (true, p3 != p4);
+      TEST_EQ (0U, reinterpret_cast<std::uintptr_t> (p4) % 16);
+
+      TEST_EQ (true, *json_new_delete_resource () == *json_new_delete_resource ());
+      TEST_EQ (true, resource != *json_new_delete_resource ());
+    }
+  }
+
+  void instrumentation_test_cases ()
+  {
+    std::wcout << "Running 'instrumentation_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+    using cpp_json::parser::json_counting_instrumentation ;
+    using cpp_json::parser::json_cycle_instrumentation    ;
+    using cpp_json::parser::json_no_instrumentation       ;
+    using cpp_json::parser::json_phase                    ;
+
+    // The default policy adds nothing to the parser
+    TEST_EQ (
+        sizeof (cpp_json::parser::json_parser<details::builder_json_context>)
+      , sizeof (cpp_json::parser::json_parser<details::builder_json_context, json_no_instrumentation>)
+      );
+    TEST_EQ (true, std::is_empty<json_no_instrumentation>::value);
+
+    doc_string_type json = LR"( {"a": [1, 22, null, true], "b\n": "x\u00e5\t", "c": {"d": [[]], "e": false}} )";
+
+    {
+      json_counting_instrumentation i;
+      std::size_t         pos;
+      json_document::ptr  doc;
+      TEST_EQ (true, json_parser::parse_instrumented (json, pos, doc, i));
+      TEST_EQ (json.size (), pos);
+      TEST_EQ (true, doc && doc->to_string () == L"{\"a\":[1, 22, null, true], \"b\\n\":\"xå\\t\", \"c\":{\"d\":[[]], \"e\":false}}");
+
+      TEST_EQ (13U  , i.white_space_bytes);
+      TEST_EQ (28U  , i.string_bytes);
+      TEST_EQ (3U   , i.number_bytes);
+      TEST_EQ (13U  , i.literal_bytes);
+      TEST_EQ (4U   , i.plain_strings);
+      TEST_EQ (2U   , i.escaped_strings);
+      TEST_EQ (3U   , i.escapes);
+      TEST_EQ (2U   , i.numbers);
+      TEST_EQ (3U   , i.literals);
+      TEST_EQ (3U   , i.arrays);
+      TEST_EQ (2U   , i.objects);
+      TEST_EQ (5U   , i.array_values);
+      TEST_EQ (5U   , i.object_members);
+      TEST_EQ (4U   , i.max_array_size);
+      TEST_EQ (3U   , i.max_object_size);
+      TEST_EQ (4U   , i.max_depth);
+
+      // State is kept between parses
+      TEST_EQ (true, json_parser::parse_instrumented (json, pos, doc, i));
+      TEST_EQ (4U   , i.escaped_strings);
+      TEST_EQ (4U   , i.max_depth);
+    }
+
+    {
+      json_cycle_instrumentation i;
+      std::size_t         pos;
+      json_document::ptr  doc;
+      TEST_EQ (true, json_parser::parse_instrumented (json, pos, doc, i));
+      TEST_EQ (5U   , i.objects + i.arrays);
+      TEST_EQ (true , i.ticks (json_phase::context) > 0);
+    }
+
+    {
+      json_counting_instrumentation i;
+      std::size_t         pos;
+      json_document::ptr  doc;
+      TEST_EQ (false, json_parser::parse_instrumented (doc_string_type (L"[1, tru]"), pos, doc, i));
+      TEST_EQ (false, static_cast<bool> (doc));
+      TEST_EQ (1U   , i.numbers);
+      TEST_EQ (0U   , i.literals);
+    }
+  }
+
+  void memory_usage_test_cases ()
+  {
+    std::wcout << "Running 'memory_usage_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    doc_string_type long_string (100, L'x');
+    doc_string_type json = LR"({"short":"a","long":")" + long_string + LR"(","array":[1,2,3],"object":{}})";
+
+    std::size_t         pos;
+    json_document::ptr  doc;
+
+    auto before = get_allocation_counters ();
+    TEST_EQ (true, json_parser::parse (json, pos, doc));
+    auto live = (get_allocation_counters () - before).live_bytes;
+
+    auto usage = doc->memory_usage ();
+
+    TEST_EQ (true , usage.document > 0);
+    TEST_EQ (true , usage.number_nodes > 0);
+    TEST_EQ (true , usage.string_nodes > 0);
+    TEST_EQ (true , usage.array_nodes > 0);
+    TEST_EQ (true , usage.object_nodes > 0);
+    TEST_EQ (true , usage.node_slack > 0);
+    TEST_EQ (true , usage.node_slack < usage.number_nodes + usage.string_nodes + usage.array_nodes + usage.object_nodes);
+    // Only the long string is stored outside the string object
+    TEST_EQ (true , usage.string_payload >= (long_string.size () + 1) * sizeof (doc_char_type));
+    TEST_EQ (true , usage.string_payload < 2 * (long_string.size () + 1) * sizeof (doc_char_type));
+    TEST_EQ (true , usage.array_members >= 3 * sizeof (details::array_member));
+    TEST_EQ (true , usage.object_members >= 4 * sizeof (details::object_member));
+
+    TEST_EQ (
+        usage.document + usage.number_nodes + usage.string_nodes + usage.array_nodes + usage.object_nodes
+      + usage.string_payload + usage.array_members + usage.object_members
+      , usage.total ()
+      );
+
+    // malloc adds overhead to each allocation, allow 20%
+    if (allocation_counter_includes_malloc ())
+    {
+      TEST_EQ (true, usage.total () <= live);
+      TEST_EQ (true, live <= usage.total () + usage.total () / 5);
+    }
+
+    TEST_EQ (0U, usage.retained);
+
+    // Elements shared with another document are counted by the original document,
+    //  which the updated document keeps alive
+    auto updated = doc->set_number ({ L"array", L"0" }, 4);
+    TEST_EQ (true, updated != nullptr);
+    auto updated_usage = updated->memory_usage ();
+    TEST_EQ (usage.total (), updated_usage.retained);
+    TEST_EQ (true, updated_usage.total () - updated_usage.retained < usage.total ());
+
+    // Documents retained through other documents are counted once
+    auto again = updated->set_number ({ L"array", L"1" }, 5);
+    TEST_EQ (true, again != nullptr);
+    auto again_usage = again->memory_usage ();
+    TEST_EQ (usage.total () + updated_usage.total () - updated_usage.retained, again_usage.retained);
+  }
+
+  void lazy_test_cases ()
+  {
+    std::wcout << "Running 'lazy_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    auto json = doc_string_type (LR"({"a":[1,{"b":[true,null]},"x"], "c":{"d":{"e":-1.5}}, "f":[], "g":"y"})");
+
+    std::size_t         pos   ;
+    json_document::ptr  eager ;
+    TEST_EQ (true, json_parser::parse (json, pos, eager));
+
+    auto parse_lazy = [&json] (std::size_t depth, std::size_t min_size) -> json_document::ptr
+      {
+        json_lazy_options options;
+        options.depth     = depth;
+        options.min_size  = min_size;
+
+        std::size_t         pos ;
+        json_document::ptr  doc ;
+        auto result = json_parser::parse (json, options, pos, doc);
+        TEST_EQ (true       , result);
+        TEST_EQ (json.size (), pos);
+        return doc;
+      };
+
+    // Same content as an eager document at any depth
+    for (std::size_t depth : { 0, 1, 2, 3, 10 })
+    {
+      auto doc = parse_lazy (depth, 0);
+      TEST_EQ (true, doc && doc->to_string () == eager->to_string ());
+    }
+
+    // Containers are built the first time they are accessed
+    {
+      auto doc = parse_lazy (1, 0);
+
+      auto before = doc->memory_usage ();
+      TEST_EQ (true , before.lazy_nodes > 0);
+      TEST_EQ (true , before.lazy_source > 0);
+      TEST_EQ (0U   , before.array_nodes);
+
+      auto root = doc->root ();
+      TEST_EQ (4U   , root->size ());
+      TEST_EQ (false, root->get (L"a")->is_scalar ());
+      TEST_EQ (false, root->get (L"a")->is_error ());
+
+      auto a = root->get (L"a");
+      TEST_EQ (3U   , a->size ());
+      TEST_EQ (1.0  , a->at (0)->as_number ());
+      TEST_EQ (true , a->at (1)->get (L"b")->at (0)->as_bool ());
+      TEST_EQ (true , a->at (1)->get (L"b")->at (1)->is_null ());
+      TEST_EQ (true , a->get (L"b")->is_error ());
+      TEST_EQ (-1.5 , root->get (L"c")->get (L"d")->get (L"e")->as_number ());
+      TEST_EQ (0U   , root->get (L"f")->size ());
+
+      // Built once
+      TEST_EQ (true , a->at (1) == root->get (L"a")->at (1));
+
+      TEST_EQ (true , doc->memory_usage ().array_nodes > 0);
+    }
+
+    // Queries and updates see through deferred containers
+    {
+      auto doc = parse_lazy (1, 0);
+
+      auto updated = doc->set_number ({ L"c", L"d", L"e" }, 2);
+      TEST_EQ (true , updated != nullptr);
+      TEST_EQ (2.0  , updated->root ()->get (L"c")->get (L"d")->get (L"e")->as_number ());
+      TEST_EQ (-1.5 , doc->root ()->get (L"c")->get (L"d")->get (L"e")->as_number ());
+
+      auto erased = parse_lazy (1, 0)->erase ({ L"a", L"1" });
+      TEST_EQ (true , erased && erased->root ()->get (L"a")->size () == 2);
+    }
+
+    // Small containers are built directly
+    {
+      auto doc = parse_lazy (1, 1000);
+      TEST_EQ (0U   , doc->memory_usage ().lazy_nodes);
+      TEST_EQ (true , doc->to_string () == eager->to_string ());
+    }
+
+    // Deferred containers are validated
+    {
+      auto invalid = doc_string_type (LR"({"a":[1,{"b":[tru]}]})");
+
+      std::size_t         eager_pos;
+      json_lazy_options   options;
+      json_document::ptr  doc;
+      TEST_EQ (false    , json_parser::parse (invalid, eager_pos, doc));
+      TEST_EQ (false    , json_parser::parse (invalid, options, pos, doc));
+      TEST_EQ (eager_pos, pos);
+      TEST_EQ (false    , json_parser::parse (LR"({"a":[1,]})", options, pos, doc));
+    }
+
+    // Concurrent readers build a container once
+    {
+      doc_string_type big = L"[[";
+      for (auto iter = 0; iter < 1000; ++iter)
+      {
+        big += iter > 0 ? L"," : L"";
+        big += LR"({"id":1,"v":[1,2,3]})";
+      }
+      big += L"]]";
+
+      json_lazy_options   options;
+      json_document::ptr  doc;
+      TEST_EQ (true, json_parser::parse (big, options, pos, doc));
+
+      auto inner = doc->root ()->at (0);
+
+      std::vector<json_element::ptr>  seen (4);
+      std::vector<std::thread>        threads;
+      for (auto iter = 0U; iter < seen.size (); ++iter)
+      {
+        threads.emplace_back ([&seen, inner, iter] () { seen[iter] = inner->at (999)->get (L"v"); });
+      }
+
+      for (auto && t : threads)
+      {
+        t.join ();
+      }
+
+      for (auto && e : seen)
+      {
+        TEST_EQ (true, e == seen[0] && e->size () == 3);
+      }
+    }
+  }
+
+  void snapshot_test_cases ()
+  {
+    std::wcout << "Running 'snapshot_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    auto json = doc_string_type (LR"({"a":[1,{"b":[true,false,null]},"x\ty",-1.5E2], "c":{"a":"x\ty","0":"zero"}, "d":[], "e":{}})");
+
+    std::size_t         pos ;
+    json_document::ptr  doc ;
+    TEST_EQ (true, json_parser::parse (json, pos, doc));
+
+    std::vector<char> image;
+    json_snapshot::save (*doc, image);
+    TEST_EQ (0U, image.size () % 8);
+
+    json_document::ptr snapshot;
+    TEST_EQ (true, json_snapshot::load (image, snapshot));
+    TEST_EQ (true, snapshot && snapshot->to_string () == doc->to_string ());
+
+    // Navigation
+    {
+      auto root = snapshot->root ();
+      TEST_EQ (4U   , root->size ());
+      TEST_EQ (false, root->is_scalar ());
+      TEST_EQ (true , root->names () == doc->root ()->names ());
+
+      auto a = root->get (L"a");
+      TEST_EQ (4U   , a->size ());
+      TEST_EQ (1.0  , a->at (0)->as_number ());
+      TEST_EQ (true , a->at (1)->get (L"b")->at (0)->as_bool ());
+      TEST_EQ (false, a->at (1)->get (L"b")->at (1)->as_bool ());
+      TEST_EQ (true , a->at (1)->get (L"b")->at (2)->is_null ());
+      TEST_EQ (true , a->at (2)->as_string () == L"x\ty");
+      TEST_EQ (-150.0, a->at (3)->as_number ());
+      TEST_EQ (true , a->at (3)->as_string () == doc->root ()->get (L"a")->at (3)->as_string ());
+      TEST_EQ (true , a->at (4)->is_error ());
+      TEST_EQ (true , a->get (L"b")->is_error ());
+      TEST_EQ (true , root->get (L"missing")->is_error ());
+      TEST_EQ (0U   , root->get (L"d")->size ());
+      TEST_EQ (0U   , root->get (L"e")->size ());
+      TEST_EQ (false, root->get (L"e")->is_scalar ());
+
+      // Elements are created once, null/true/false are shared
+      TEST_EQ (true , a == snapshot->root ()->get (L"a"));
+      TEST_EQ (true , a->at (1)->get (L"b")->at (2) == root->get (L"a")->at (1)->get (L"b")->at (2));
+    }
+
+    // Queries return the same elements as on the document
+    {
+      TEST_EQ (true , snapshot->root ()->get (L"a")->is_array ());
+      TEST_EQ (false, snapshot->root ()->get (L"c")->is_array ());
+      TEST_EQ (false, snapshot->root ()->get (L"a")->at (0)->is_array ());
+
+      doc_strings_type pointers =
+        {
+          L"/a/1/b/0", L"/c/0", L"/c/1", L"/c/a", L"/a/9", L"/a/b", L"/a/0/0", L"/d/0", L"/e/0", L"/a/-", L"/missing",
+        };
+
+      for (auto && p : pointers)
+      {
+        std::size_t qpos;
+        json_query  query;
+        TEST_EQ (true, json_query::compile_pointer (p, qpos, query));
+
+        auto expected = query.evaluate (*doc);
+        auto actual   = query.evaluate (*snapshot);
+        TEST_EQ (expected->is_error ()  , actual->is_error ());
+        TEST_EQ (expected->is_array ()  , actual->is_array ());
+        TEST_EQ (expected->size ()      , actual->size ());
+        TEST_EQ (true                   , expected->as_string () == actual->as_string ());
+      }
+
+      // On an object an index is a member name
+      std::size_t qpos;
+      json_query  query;
+      TEST_EQ (true , json_query::compile_pointer (L"/c/1", qpos, query));
+      TEST_EQ (true , query.evaluate (*snapshot)->is_error ());
+      TEST_EQ (true , json_query::compile_pointer (L"/c/0", qpos, query));
+      TEST_EQ (true , query.evaluate (*snapshot)->as_string () == L"zero");
+    }
+
+    // Read-only
+    TEST_EQ (true, snapshot->set_number ({ L"a", L"0" }, 2) == nullptr);
+    TEST_EQ (true, snapshot->erase ({ L"a" }) == nullptr);
+
+    // Strings are stored once
+    {
+      doc_string_type repeated = L"[";
+      for (auto iter = 0; iter < 100; ++iter)
+      {
+        repeated += iter > 0 ? L"," : L"";
+        repeated += LR"({"name":"a long repeated string value"})";
+      }
+      repeated += L"]";
+
+      json_document::ptr rdoc;
+      TEST_EQ (true, json_parser::parse (repeated, pos, rdoc));
+
+      std::vector<char> rimage;
+      json_snapshot::save (*rdoc, rimage);
+      // 100 copies of the string would be larger than the whole image
+      TEST_EQ (true, rimage.size () < 100 * doc_string_type (L"a long repeated string value").size () * sizeof (doc_char_type));
+    }
+
+    // Lazy documents are built while saved
+    {
+      json_lazy_options   options;
+      json_document::ptr  lazy;
+      TEST_EQ (true, json_parser::parse (json, options, pos, lazy));
+
+      std::vector<char> limage;
+      json_snapshot::save (*lazy, limage);
+      TEST_EQ (true, limage == image);
+    }
+
+    // Invalid images
+    {
+      json_document::ptr invalid;
+      TEST_EQ (false, json_snapshot::load (std::vector<char> (), invalid));
+      TEST_EQ (false, json_snapshot::load (std::vector<char> (image.begin (), image.end () - 8), invalid));
+
+      auto corrupt = image;
+      corrupt[0] = 'x';
+      TEST_EQ (false, json_snapshot::load (corrupt, invalid));
+      TEST_EQ (true , invalid == nullptr);
+
+      TEST_EQ (false, json_snapshot::load (std::string ("no_such_snapshot.bin"), invalid));
+    }
+
+    // Corrupt nodes with a consistent header read as error elements and empty strings
+    {
+      details::snapshot_header header;
+      std::memcpy (&header, image.data (), sizeof (header));
+
+      auto word = [&image] (std::uint64_t offset)
+      {
+        std::uint64_t value;
+        std::memcpy (&value, &image[static_cast<std::size_t> (offset)], sizeof (value));
+        return value;
       };
 
-      auto size = result->size ();
+      auto corrupt = [&image] (std::uint64_t offset, std::uint64_t value)
+      {
+        auto copy = image;
+        std::memcpy (&copy[static_cast<std::size_t> (offset)], &value, sizeof (value));
+        json_document::ptr result;
+        TEST_EQ (true, json_snapshot::load (copy, result));
+        return result;
+      };
 
-      for (auto && oracle : oracles)
+      // The root is {"a":..., "c":..., "d":..., "e":...}, its words are tag and index,
+      //  count and count * (name, hash, child)
+      auto root = [&header] (std::uint64_t w)
       {
-        auto index = oracle.index;
-        auto actual =
-            index > -1
-          ? result->at (index)
-          : result
-          ;
+        return header.root + w * sizeof (std::uint64_t);
+      };
 
-        std::cout << "Testing against index: " << index << std::endl;
+      auto tag = static_cast<std::uint64_t> (details::snapshot_tag::object_value);
 
-        TEST_EQ (oracle.size      , actual->size ());
-        TEST_EQ (oracle.at        , actual->at  (size)->is_error ());
-        TEST_EQ (oracle.get       , actual->get (L"")->is_error ());
-        TEST_EQ (oracle.names     , actual->names ().empty ());
-        TEST_EQ (oracle.is_error  , actual->is_error ());
-        TEST_EQ (oracle.is_scalar , actual->is_scalar ());
-        TEST_EQ (oracle.is_null   , actual->is_null ());
-        TEST_EQ (oracle.as_bool   , actual->as_bool ());
-        TEST_EQ (oracle.as_number , actual->as_number ());
-        TEST_EQ (oracle.as_string , to_ascii (actual->as_string ()));
+      TEST_EQ (true , corrupt (root (0), tag | (header.nodes << 8))->root ()->is_error ());
+      TEST_EQ (true , corrupt (root (0), 0x7F)->root ()->is_error ());
+      TEST_EQ (true , corrupt (root (1), ~0ULL)->root ()->is_error ());
+      TEST_EQ (true , corrupt (root (1), header.size)->root ()->is_error ());
+
+      // Child offsets outside the nodes or not on a node
+      TEST_EQ (true , corrupt (root (4), 0)->root ()->get (L"a")->is_error ());
+      TEST_EQ (true , corrupt (root (4), header.strings)->root ()->get (L"a")->is_error ());
+      TEST_EQ (true , corrupt (root (4), ~0ULL)->root ()->get (L"a")->is_error ());
+      TEST_EQ (true , corrupt (root (4), header.root + 1)->root ()->get (L"a")->is_error ());
+
+      // A node with the index of another node
+      auto shared = corrupt (word (root (4)), static_cast<std::uint64_t> (details::snapshot_tag::array_value) | (word (root (0)) & ~0xFFULL));
+      TEST_EQ (false, shared->root ()->is_error ());
+      TEST_EQ (true , shared->root ()->get (L"a")->is_error ());
+
+      // Names outside the string table
+      TEST_EQ (true , corrupt (root (2), header.size)->root ()->names ()[0].empty ());
+      TEST_EQ (true , corrupt (root (2), ~0ULL)->root ()->names ()[0].empty ());
+      TEST_EQ (true , corrupt (root (2), 3)->root ()->names ()[0].empty ());
+    }
+
+    // Files are mapped
+    {
+      auto file_name = std::string ("snapshot_test_cases.bin");
+      TEST_EQ (true, json_snapshot::save (*doc, file_name));
+
+      json_document::ptr mapped;
+      TEST_EQ (true, json_snapshot::load (file_name, mapped));
+      TEST_EQ (true, mapped && mapped->to_string () == doc->to_string ());
+      TEST_EQ (image.size (), mapped->memory_usage ().snapshot);
+
+      mapped.reset ();
+      std::remove (file_name.c_str ());
+    }
+
+    // Concurrent readers get the same elements
+    {
+      std::vector<json_element::ptr>  seen (4);
+      std::vector<std::thread>        threads;
+      for (auto iter = 0U; iter < seen.size (); ++iter)
+      {
+        threads.emplace_back ([&seen, &snapshot, iter] () { seen[iter] = snapshot->root ()->get (L"a")->at (1)->get (L"b"); });
       }
 
+      for (auto && t : threads)
       {
-        auto actual     = result->at (8);
-        auto true_value = actual->at (0);
-        auto null_value = actual->at (1);
+        t.join ();
+      }
 
-        TEST_EQ (2        , actual->size ());
-        TEST_EQ (true     , true_value->as_bool ());
-        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
-        TEST_EQ (false    , null_value->as_bool ());
-        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+      for (auto && e : seen)
+      {
+        TEST_EQ (true, e == seen[0] && e->size () == 3);
       }
+    }
+  }
 
+  void transcode_test_cases ()
+  {
+    std::wcout << "Running 'transcode_test_cases'..." << std::endl;
+
+    using namespace cpp_json::parser;
+
+    auto bytes = [] (std::initializer_list<int> bs)
       {
-        auto actual     = result->at (11);
-        auto true_value = actual->at (0);
-        auto null_value = actual->at (1);
+        std::vector<char> result;
+        for (auto b : bs)
+        {
+          result.push_back (static_cast<char> (b));
+        }
+        return result;
+      };
 
-        TEST_EQ (2        , actual->size ());
-        TEST_EQ (true     , true_value->as_bool ());
-        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
-        TEST_EQ (false    , null_value->as_bool ());
-        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+    std::size_t pos;
+
+    // Writer
+    {
+      json_utf8_writer w;
+      w.object_begin ();
+      w.member_key ("a\"\\\n\x01/");
+      w.array_begin ();
+      w.number_value (1);
+      w.number_value (0.1);
+      w.number_value (-1.5E300);
+      w.number_value (std::numeric_limits<double>::quiet_NaN ());
+      w.array_end ();
+      w.member_key ("b");
+      w.object_begin ();
+      w.object_end ();
+      w.member_key ("c");
+      w.bool_value (true);
+      w.member_key ("d");
+      w.null_value ();
+      w.object_end ();
+      TEST_EQ (true, w.output == R"({"a\"\\\n\u0001/":[1,0.1,-1.5e+300,"NaN"],"b":{},"c":true,"d":null})");
+
+      w.clear ();
+      w.array_begin ();
+      w.string_value ("x\xc3\xa5");
+      w.array_end ();
+      TEST_EQ (true, w.output == "[\"x\xc3\xa5\"]");
+
+      // Numbers round trip
+      json_writer ww;
+      ww.array_begin ();
+      ww.number_value (1.0 / 3);
+      ww.array_end ();
+      TEST_EQ (true, ww.output == L"[0.33333333333333331]");
+    }
+
+    // Encodings
+    {
+      auto json = std::string (R"([1,-1,0.5,"a",true,false,null,{},1e300,-0])");
+
+      std::vector<char> cbor;
+      TEST_EQ (true, json_cbor::from_json (json, pos, cbor));
+      TEST_EQ (true, cbor == bytes ({
+          0x9F, 0x01, 0x20, 0xFA, 0x3F, 0x00, 0x00, 0x00, 0x61, 0x61, 0xF5, 0xF4, 0xF6, 0xBF, 0xFF
+        , 0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C, 0xFA, 0x80, 0x00, 0x00, 0x00, 0xFF
+        }));
+
+      std::vector<char> msgpack;
+      TEST_EQ (true, json_msgpack::from_json (json, pos, msgpack));
+      TEST_EQ (true, msgpack == bytes ({
+          0x9A, 0x01, 0xFF, 0xCA, 0x3F, 0x00, 0x00, 0x00, 0xA1, 0x61, 0xC3, 0xC2, 0xC0, 0x80
+        , 0xCB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C, 0xCA, 0x80, 0x00, 0x00, 0x00
+        }));
+
+      // Integers use the smallest encoding
+      TEST_EQ (true, json_cbor::from_json (std::string ("[24,-25,256,65536,4294967296]"), pos, cbor));
+      TEST_EQ (true, cbor == bytes ({
+          0x9F, 0x18, 0x18, 0x38, 0x18, 0x19, 0x01, 0x00, 0x1A, 0x00, 0x01, 0x00, 0x00
+        , 0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0xFF
+        }));
+      TEST_EQ (true, json_msgpack::from_json (std::string ("[128,-33,-129,65536]"), pos, msgpack));
+      TEST_EQ (true, msgpack == bytes ({ 0x94, 0xCC, 0x80, 0xD0, 0xDF, 0xD1, 0xFF, 0x7F, 0xCE, 0x00, 0x01, 0x00, 0x00 }));
+
+      // MessagePack headers are back-patched with the smallest header that fits
+      std::string large = "{\"a\":[";
+      for (auto iter = 0; iter < 70000; ++iter)
+      {
+        large += iter > 0 ? ",0" : "0";
+      }
+      large += "],\"b\":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]}";
+      TEST_EQ (true, json_msgpack::from_json (large, pos, msgpack));
+      TEST_EQ (true, std::vector<char> (msgpack.begin (), msgpack.begin () + 8) == bytes ({ 0x82, 0xA1, 0x61, 0xDD, 0x00, 0x01, 0x11, 0x70 }));
+      TEST_EQ (true, std::vector<char> (msgpack.end () - 25, msgpack.end () - 20) == bytes ({ 0xA1, 0x62, 0xDC, 0x00, 0x14 }));
+      TEST_EQ (8U + 70000U + 5U + 20U, msgpack.size ());
+
+      std::string back;
+      TEST_EQ (true, json_msgpack::to_json (msgpack, pos, back));
+      TEST_EQ (true, back == large);
+
+      // The unused header bytes of nested and sibling containers are all removed
+      TEST_EQ (true, json_msgpack::from_json (std::string (R"([[1,[2]],{"a":[]},[]])"), pos, msgpack));
+      TEST_EQ (true, msgpack == bytes ({ 0x93, 0x92, 0x01, 0x91, 0x02, 0x81, 0xA1, 0x61, 0x90, 0x90 }));
+    }
+
+    // Round trips, wide and UTF-8 input encode the same
+    {
+      auto json     = std::string ("{\"name\":\"x\\t\xc3\xa5\xf0\x9f\x98\x80\\u00e5\\ud83d\\ude00\\u0001\",\"values\":[1.5,-2,1e-7,123456789012,[],{\"\":null}],\"flag\":false}");
+      auto wjson    = std::wstring (L"{\"name\":\"x\\t\u00e5\U0001F600\\u00e5\\ud83d\\ude00\\u0001\",\"values\":[1.5,-2,1e-7,123456789012,[],{\"\":null}],\"flag\":false}");
+      auto expected = std::string ("{\"name\":\"x\\t\xc3\xa5\xf0\x9f\x98\x80\xc3\xa5\xf0\x9f\x98\x80\\u0001\",\"values\":[1.5,-2,1e-07,123456789012,[],{\"\":null}],\"flag\":false}");
+
+      std::vector<char> cbor;
+      std::vector<char> wcbor;
+      std::string       back;
+      TEST_EQ (true, json_cbor::from_json (json, pos, cbor));
+      TEST_EQ (true, json_cbor::from_json (wjson, pos, wcbor));
+      TEST_EQ (true, cbor == wcbor);
+      TEST_EQ (true, json_cbor::to_json (cbor, pos, back));
+      TEST_EQ (true, back == expected);
+      TEST_EQ (cbor.size (), pos);
+
+      std::vector<char> msgpack;
+      std::vector<char> wmsgpack;
+      TEST_EQ (true, json_msgpack::from_json (json, pos, msgpack));
+      TEST_EQ (true, json_msgpack::from_json (wjson, pos, wmsgpack));
+      TEST_EQ (true, msgpack == wmsgpack);
+      TEST_EQ (true, json_msgpack::to_json (msgpack, pos, back));
+      TEST_EQ (true, back == expected);
+
+      // The output of the writer encodes the same
+      std::vector<char> again;
+      TEST_EQ (true, json_msgpack::from_json (back, pos, again));
+      TEST_EQ (true, again == msgpack);
+      TEST_EQ (true, json_cbor::from_json (back, pos, again));
+      TEST_EQ (true, again == cbor);
+    }
+
+    // Invalid JSON fails at the position of the error with empty output
+    {
+      auto json = std::string (R"({"a":[1,2,}])");
+
+      std::size_t                         expected_pos;
+      cpp_json::document::json_document::ptr doc;
+      cpp_json::document::json_parser::parse (json.data (), json.data () + json.size (), expected_pos, doc);
+
+      std::vector<char> cbor (3);
+      TEST_EQ (false, json_cbor::from_json (json, pos, cbor));
+      TEST_EQ (expected_pos, pos);
+      TEST_EQ (true, cbor.empty ());
+
+      std::vector<char> msgpack;
+      TEST_EQ (false, json_msgpack::from_json (json, pos, msgpack));
+      TEST_EQ (expected_pos, pos);
+    }
+
+    // CBOR produced by other encoders
+    {
+      std::string json;
+
+      // Definite lengths
+      TEST_EQ (true, json_cbor::to_json (bytes ({ 0xA2, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, 0x03 }), pos, json));
+      TEST_EQ (true, json == R"({"a":1,"b":[2,3]})");
+
+      // Indefinite length text, tags, half floats and undefined
+      TEST_EQ (true, json_cbor::to_json (bytes ({ 0x85, 0x7F, 0x61, 0x61, 0x62, 0x62, 0x63, 0xFF, 0xC1, 0x1A, 0x00, 0x00, 0x00, 0x01, 0xF9, 0x3C, 0x00, 0xF9, 0xC4, 0x00, 0xF7 }), pos, json));
+      TEST_EQ (true, json == R"(["abc",1,1,-4,null])");
+
+      // Byte strings, non-text keys, simple values, truncated input, trailing data, stray breaks
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x81, 0x41, 0x00 }), pos, json));
+      TEST_EQ (true , json.empty ());
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0xA1, 0x01, 0x02 }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x81, 0xF0 }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x82, 0x01 }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x63, 0x61 }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x80, 0x80 }), pos, json));
+      TEST_EQ (1U   , pos);
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x81, 0xFF }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (bytes ({ 0x9B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }), pos, json));
+      TEST_EQ (false, json_cbor::to_json (std::vector<char> (100000, static_cast<char> (0x81)), pos, json));
+    }
+
+    // MessagePack produced by other encoders
+    {
+      std::string json;
+
+      TEST_EQ (true, json_msgpack::to_json (bytes ({ 0xDE, 0x00, 0x01, 0xD9, 0x01, 0x61, 0x93, 0xD3, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xCF, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0xE0 }), pos, json));
+      TEST_EQ (true, json == R"({"a":[-2,4294967296,-32]})");
+
+      // Binary, extensions, non-string keys, truncated input
+      TEST_EQ (false, json_msgpack::to_json (bytes ({ 0x91, 0xC4, 0x00 }), pos, json));
+      TEST_EQ (false, json_msgpack::to_json (bytes ({ 0x91, 0xD4, 0x00, 0x00 }), pos, json));
+      TEST_EQ (false, json_msgpack::to_json (bytes ({ 0x81, 0x01, 0x02 }), pos, json));
+      TEST_EQ (false, json_msgpack::to_json (bytes ({ 0x92, 0x01 }), pos, json));
+      TEST_EQ (false, json_msgpack::to_json (bytes ({ 0xDD, 0xFF, 0xFF, 0xFF, 0xFF }), pos, json));
+      TEST_EQ (false, json_msgpack::to_json (std::vector<char> (100000, static_cast<char> (0x91)), pos, json));
+    }
+  }
+
+  void cache_test_cases ()
+  {
+    std::wcout << "Running 'cache_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+
+    auto json = doc_string_type (LR"({"a":[1,2,3],"b":"x"})");
+
+    std::size_t         expected_pos;
+    json_document::ptr  expected    ;
+    TEST_EQ (true, json_parser::parse (json, expected_pos, expected));
+
+    // Hits return the same document
+    {
+      json_document_cache cache (1 << 20);
+
+      std::size_t         pos   ;
+      json_document::ptr  first ;
+      json_document::ptr  second;
+      TEST_EQ (true, cache.parse (json, pos, first));
+      TEST_EQ (expected_pos, pos);
+      TEST_EQ (true, first->to_string () == expected->to_string ());
+
+      pos = 0;
+      TEST_EQ (true, cache.parse (doc_string_type (json), pos, second));
+      TEST_EQ (expected_pos, pos);
+      TEST_EQ (true, first == second);
+
+      // The same characters as UTF-8 are a different entry
+      std::string         ajson (json.begin (), json.end ());
+      json_document::ptr  third;
+      TEST_EQ (true, cache.parse (ajson.data (), ajson.data () + ajson.size (), pos, third));
+      TEST_EQ (true, third != first && third->to_string () == first->to_string ());
+
+      json_document::ptr other;
+      TEST_EQ (true, cache.parse (doc_string_type (LR"({"a":[1,2,3],"b":"y"})"), pos, other));
+      TEST_EQ (true, other != first);
+
+      auto stats = cache.stats ();
+      TEST_EQ (1U, stats.hits);
+      TEST_EQ (3U, stats.misses);
+      TEST_EQ (3U, stats.documents);
+      TEST_EQ (0U, stats.evictions);
+      TEST_EQ (true, stats.bytes >= 3 * first->memory_usage ().total ());
+
+      // Cached documents are built when parsed, reading them doesn't add to their footprint
+      auto usage = first->memory_usage ().total ();
+      TEST_EQ (true, first->to_string () == expected->to_string ());
+      TEST_EQ (usage, first->memory_usage ().total ());
+
+      // Cached documents are immutable, updates create new documents
+      auto updated = second->set_number ({ L"a", L"0" }, 9);
+      TEST_EQ (true, cache.parse (json, pos, second));
+      TEST_EQ (1.0, second->root ()->get (L"a")->at (0)->as_number ());
+      TEST_EQ (9.0, updated->root ()->get (L"a")->at (0)->as_number ());
+
+      cache.clear ();
+      TEST_EQ (0U, cache.stats ().documents);
+      TEST_EQ (0U, cache.stats ().bytes);
+      TEST_EQ (true, cache.parse (json, pos, second));
+      TEST_EQ (true, second != first);
+    }
+
+    // Failed parses aren't cached
+    {
+      json_document_cache cache (1 << 20);
+
+      auto invalid = doc_string_type (LR"({"a":[1,2,}])");
+      std::size_t         invalid_pos ;
+      json_document::ptr  doc         ;
+      json_parser::parse (invalid, invalid_pos, doc);
+
+      std::size_t pos;
+      TEST_EQ (false, cache.parse (invalid, pos, doc));
+      TEST_EQ (invalid_pos, pos);
+      TEST_EQ (true , doc == nullptr);
+      TEST_EQ (false, cache.parse (invalid, pos, doc));
+      TEST_EQ (0U   , cache.stats ().documents);
+      TEST_EQ (2U   , cache.stats ().misses);
+    }
+
+    // The least recently used documents are evicted
+    {
+      auto a = doc_string_type (LR"([1,"a"])");
+      auto b = doc_string_type (LR"([2,"b"])");
+      auto c = doc_string_type (LR"([3,"c"])");
+
+      std::size_t         pos ;
+      json_document::ptr  doc ;
+
+      std::size_t footprint;
+      {
+        json_document_cache probe (1 << 20, 1);
+        probe.parse (a, pos, doc);
+        footprint = probe.stats ().bytes;
       }
 
+      json_document_cache cache (footprint * 5 / 2, 1);
+      TEST_EQ (true, cache.parse (a, pos, doc));
+      TEST_EQ (true, cache.parse (b, pos, doc));
+      TEST_EQ (true, cache.parse (a, pos, doc));
+      TEST_EQ (true, cache.parse (c, pos, doc));
+
+      auto stats = cache.stats ();
+      TEST_EQ (1U, stats.evictions);
+      TEST_EQ (2U, stats.documents);
+      TEST_EQ (true, stats.bytes <= footprint * 5 / 2);
+
+      // a was used more recently than b
+      TEST_EQ (true, cache.parse (a, pos, doc));
+      TEST_EQ (2U, cache.stats ().hits);
+      TEST_EQ (true, cache.parse (b, pos, doc));
+      TEST_EQ (2U, cache.stats ().hits);
+
+      // Documents larger than the budget aren't cached
+      json_document_cache tiny (1);
+      TEST_EQ (true, tiny.parse (a, pos, doc));
+      TEST_EQ (true, doc->to_string () == L"[1, \"a\"]");
+      TEST_EQ (0U  , tiny.stats ().documents);
+    }
+
+    // Concurrent callers get the same document
+    {
+      json_document_cache cache (1 << 20, 4);
+
+      std::vector<json_document::ptr> seen (4);
+      std::vector<std::thread>        threads;
+      for (auto iter = 0U; iter < seen.size (); ++iter)
       {
-        auto actual     = result->at (11);
-        auto names      = actual->names ();
-        auto true_value = actual->get (L"xyz");
-        auto null_value = actual->get (L"zyx");
+        threads.emplace_back ([&cache, &seen, &json, iter] ()
+          {
+            for (auto i = 0; i < 100; ++i)
+            {
+              std::size_t pos;
+              cache.parse (json, pos, seen[iter]);
+            }
+          });
+      }
 
-        doc_strings_type oracle = {L"xyz", L"zyx"};
+      for (auto && t : threads)
+      {
+        t.join ();
+      }
 
-        TEST_EQ (2        , actual->size ());
-        TEST_EQ (true     , names == oracle);
-        TEST_EQ (true     , true_value->as_bool ());
-        TEST_EQ ("true"   , to_ascii (true_value->as_string ()));
-        TEST_EQ (false    , null_value->as_bool ());
-        TEST_EQ ("null"   , to_ascii (null_value->as_string ()));
+      for (auto && d : seen)
+      {
+        TEST_EQ (true, d && d == seen[0]);
       }
 
-      // TODO: Test mutability
+      auto stats = cache.stats ();
+      TEST_EQ (400U, stats.hits + stats.misses);
+      TEST_EQ (1U  , stats.documents);
     }
-    else
+  }
+
+#ifdef CPP_JSON__ZLIB
+  void gzip_test_cases ()
+  {
+    std::wcout << "Running 'gzip_test_cases'..." << std::endl;
+
+    using namespace cpp_json::document;
+    using cpp_json::parser::json_block_stream   ;
+    using cpp_json::parser::json_gzip_source    ;
+    using cpp_json::parser::json_memory_source  ;
+
+    std::string json;
+    json += "[";
+    for (auto iter = 0; iter < 2000; ++iter)
     {
-      ++errors;
-      std::cout
-        << "FAILURE: Pos: " << pos << std::endl;
+      json += iter > 0 ? "," : "";
+      json += R"({"id":)" + std::to_string (iter) + R"(,"name":"x\u00e5","values":[true,null,1.5]})";
+    }
+    json += "]";
+
+    std::size_t         expected_pos;
+    json_document::ptr  expected;
+    TEST_EQ (true, json_parser::parse (json.c_str (), json.c_str () + json.size (), expected_pos, expected));
+
+    auto parse_gzip = [] (std::string const & compressed, std::size_t buffer_size, std::size_t & pos, json_document::ptr & doc, bool & failed)
+    {
+      json_memory_source  source  (compressed.c_str (), compressed.c_str () + compressed.size ());
+      json_gzip_source    gzip    (source, buffer_size);
+      json_block_stream   stream  (gzip, 4096, 3);
+
+      auto result = json_parser::parse (stream.begin (), stream.end (), pos, doc);
+      failed = gzip.failed ();
+      return result;
+    };
+
+    auto compressed = gzip_compress (json);
+    TEST_EQ (true, compressed.size () < json.size ());
+
+    for (std::size_t buffer_size : { 1, 7, 4096 })
+    {
+      std::size_t         pos   ;
+      json_document::ptr  doc   ;
+      bool                failed;
+      TEST_EQ (true         , parse_gzip (compressed, buffer_size, pos, doc, failed));
+      TEST_EQ (false        , failed);
+      TEST_EQ (expected_pos , pos);
+      TEST_EQ (true         , doc && expected->to_string () == doc->to_string ());
+    }
+
+    // Concatenated gzip members
+    {
+      auto half = json.size () / 2;
+      auto concatenated = gzip_compress (json.substr (0, half)) + gzip_compress (json.substr (half));
+
+      std::size_t         pos   ;
+      json_document::ptr  doc   ;
+      bool                failed;
+      TEST_EQ (true         , parse_gzip (concatenated, 100, pos, doc, failed));
+      TEST_EQ (false        , failed);
+      TEST_EQ (true         , doc && expected->to_string () == doc->to_string ());
+    }
+
+    // Truncated and corrupt input
+    {
+      std::size_t         pos   ;
+      json_document::ptr  doc   ;
+      bool                failed;
+
+      auto truncated = compressed.substr (0, compressed.size () / 2);
+      TEST_EQ (false        , parse_gzip (truncated, 100, pos, doc, failed));
+      TEST_EQ (true         , failed);
+
+      // Corrupt data is not always detected by inflate before the parser stops
+      auto corrupt = compressed;
+      corrupt[corrupt.size () / 2] ^= 0x55;
+      corrupt[corrupt.size () / 2 + 1] ^= 0x55;
+      TEST_EQ (false        , parse_gzip (corrupt, 100, pos, doc, failed));
+
+      auto corrupt_header = compressed;
+      corrupt_header[0] ^= 0x55;
+      TEST_EQ (false        , parse_gzip (corrupt_header, 100, pos, doc, failed));
+      TEST_EQ (true         , failed);
+      TEST_EQ (0U           , pos);
     }
   }
+#endif
 
 }
 
@@ -897,6 +4151,27 @@ int main (int argc, char const * * argvs)
 
     manual_test_cases ();
     document_test_cases ();
+    persistent_test_cases ();
+    query_test_cases ();
+    skip_test_cases ();
+    nesting_test_cases ();
+    projection_test_cases ();
+    array_reader_test_cases ();
+    reader_test_cases ();
+    ondemand_test_cases ();
+    stream_test_cases ();
+    batch_test_cases ();
+    session_test_cases ();
+    memory_resource_test_cases ();
+    instrumentation_test_cases ();
+    memory_usage_test_cases ();
+    lazy_test_cases ();
+    snapshot_test_cases ();
+    transcode_test_cases ();
+    cache_test_cases ();
+#ifdef CPP_JSON__ZLIB
+    gzip_test_cases ();
+#endif
 
 #ifdef CPP_JSON__FILESYSTEM
     generate_test_results (exe);
@@ -906,6 +4181,13 @@ int main (int argc, char const * * argvs)
 # endif
 #endif
 
+    allocation_test_cases (exe);
+
+    if (argc > 2)
+    {
+      benchmark_test_cases (exe, argvs[2], count);
+    }
+
     if (errors > 0)
     {
       std::cout << errors << " errors detected" << std::endl;